@@ -32,7 +32,7 @@ Bam2FastQ::Bam2FastQ()
       mySamHeader(),
       myPool(),
       myMateMap(true),
-      myCompression(InputFile::DEFAULT),
+      myGzip(false),
       myUnpairedFile(NULL),
       myFirstFile(NULL),
       mySecondFile(NULL),
@@ -51,6 +51,8 @@ Bam2FastQ::Bam2FastQ()
       mySecondFileNameExt(""),
       myUnpairedFileNameExt(""),
       myOutFastqs(),
+      myRGFiles(),
+      myRecordBuffer(),
       myFqList(NULL)
 {
 }
@@ -77,7 +79,7 @@ void Bam2FastQ::printDescription(std::ostream& os)
 void Bam2FastQ::printUsage(std::ostream& os)
 {
     BamExecutable::printUsage(os);
-    os << "\t./bam bam2FastQ --in <inputFile> [--readName] [--splitRG] [--qualField <tag>] [--refFile <referenceFile>] [--outBase <outputFileBase>] [--firstOut <1stReadInPairOutFile>] [--merge|--secondOut <2ndReadInPairOutFile>] [--unpairedOut <unpairedOutFile>] [--firstRNExt <firstInPairReadNameExt>] [--secondRNExt <secondInPairReadNameExt>] [--rnPlus] [--noReverseComp] [--region <chr>[:<pos>[:<base>]]] [--gzip] [--noeof] [--params]" << std::endl;
+    os << "\t./bam bam2FastQ --in <inputFile> [--readName] [--splitRG] [--qualField <tag>] [--refFile <referenceFile>] [--outBase <outputFileBase>] [--firstOut <1stReadInPairOutFile>] [--merge|--secondOut <2ndReadInPairOutFile>] [--stdout] [--unpairedOut <unpairedOutFile>] [--firstRNExt <firstInPairReadNameExt>] [--secondRNExt <secondInPairReadNameExt>] [--rnPlus] [--noReverseComp] [--region <chr>[:<pos>[:<base>]]] [--gzip] [--noeof] [--params] [--threads <numThreads>] [--level <0-9>] [--mateStats] [--spillSize <numRecords>] [--tmpPrefix <prefix>] [--maxOpen <numFiles>]" << std::endl;
     os << "\tRequired Parameters:" << std::endl;
     os << "\t\t--in       : the SAM/BAM file to convert to FastQ" << std::endl;
     os << "\tOptional Parameters:" << std::endl;
@@ -88,6 +90,10 @@ void Bam2FastQ::printUsage(std::ostream& os)
     os << "\t\t                  rather than from the Quality field (default)" << std::endl;
     os << "\t\t--merge         : Generate 1 interleaved (merged) FASTQ for paired-ends (unpaired in a separate file)\n"
               << "\t\t                  use firstOut to override the filename of the interleaved file." << std::endl;
+    os << "\t\t--stdout        : Stream the interleaved (merged) paired-end FASTQ to stdout as each pair\n"
+              << "\t\t                  is found, to pipe it directly into an aligner.  Unpaired reads are\n"
+              << "\t\t                  written to unpairedOut.  Cannot be used with splitRG, firstOut,\n"
+              << "\t\t                  secondOut, or writing outBase/unpairedOut to stdout." << std::endl;
     os << "\t\t--refFile       : Reference file for converting '=' in the sequence to the actual base" << std::endl;
     os << "\t\t                  if '=' are found and the refFile is not specified, 'N' is written to the FASTQ" << std::endl;
     os << "\t\t--firstRNExt    : read name extension to use for first read in a pair\n"
@@ -102,6 +108,18 @@ void Bam2FastQ::printUsage(std::ostream& os)
     os << "\t\t--gzip          : Compress the output FASTQ files using gzip\n";
     os << "\t\t--noeof         : Do not expect an EOF block on a bam file." << std::endl;
     os << "\t\t--params        : Print the parameter settings to stderr" << std::endl;
+    os << "\t\t--threads       : number of threads for compressing --gzip output (default 0)" << std::endl;
+    os << "\t\t--level         : gzip compression level, 0 to 9 (default -1: zlib default)" << std::endl;
+    os << "\t\t--mateStats     : Print the occupancy & collision statistics of the mate map used\n"
+              << "\t\t                  to pair the reads of a coordinate sorted file\n";
+    os << "\t\t--spillSize     : Maximum number of reads waiting for their mates to keep in memory\n"
+              << "\t\t                  when pairing a coordinate sorted file.  The reads whose mates\n"
+              << "\t\t                  are furthest away are written to temporary files until their\n"
+              << "\t\t                  mates are reached.  Default is 0: keep all reads in memory.\n";
+    os << "\t\t--tmpPrefix     : Prefix of the --spillSize temporary files (Default: outBase)\n";
+    os << "\t\t--maxOpen       : Maximum number of --splitRG files to keep open at a time.  Others\n"
+              << "\t\t                  are buffered in memory & reopened to append to them.\n"
+              << "\t\t                  Default is " << OutputFileCache::DEFAULT_MAX_OPEN << ".\n";
     os << "\tOptional OutputFile Names:" << std::endl;
     os << "\t\t--outBase       : Base output name for generated output files" << std::endl;
     os << "\t\t--firstOut      : Output name for the first in pair file" << std::endl;
@@ -125,9 +143,14 @@ int Bam2FastQ::execute(int argc, char **argv)
     String unpairedOut = "";
 
     bool interleave = false;
+    bool toStdout = false;
     bool noeof = false;
     bool gzip = false;
     bool params = false;
+    bool mateStats = false;
+    int spillSize = 0;
+    String tmpPrefix = "";
+    int maxOpen = OutputFileCache::DEFAULT_MAX_OPEN;
     String region = "";
     char nucleotide = ' ';
 
@@ -142,7 +165,7 @@ int Bam2FastQ::execute(int argc, char **argv)
     myRNPlus = false;
     myFirstRNExt = DEFAULT_FIRST_EXT;
     mySecondRNExt = DEFAULT_SECOND_EXT;
-    myCompression = InputFile::DEFAULT;
+    myGzip = false;
 
 
     ParameterList inputParameters;
@@ -154,6 +177,7 @@ int Bam2FastQ::execute(int argc, char **argv)
         LONG_PARAMETER("splitRG", &mySplitRG)
         LONG_STRINGPARAMETER("qualField", &myQField)
         LONG_PARAMETER("merge", &interleave)
+        LONG_PARAMETER("stdout", &toStdout)
         LONG_STRINGPARAMETER("refFile", &refFile)
         LONG_STRINGPARAMETER("firstRNExt", &myFirstRNExt)
         LONG_STRINGPARAMETER("secondRNExt", &mySecondRNExt)
@@ -163,6 +187,11 @@ int Bam2FastQ::execute(int argc, char **argv)
         LONG_PARAMETER("gzip", &gzip)
         LONG_PARAMETER("noeof", &noeof)
         LONG_PARAMETER("params", &params)
+        LONG_BAM_OUTPUT_PARAMETERS()
+        LONG_PARAMETER("mateStats", &mateStats)
+        LONG_INTPARAMETER("spillSize", &spillSize)
+        LONG_STRINGPARAMETER("tmpPrefix", &tmpPrefix)
+        LONG_INTPARAMETER("maxOpen", &maxOpen)
         LONG_PARAMETER_GROUP("Optional OutputFile Names")
         LONG_STRINGPARAMETER("outBase", &myOutBase)
         LONG_STRINGPARAMETER("firstOut", &firstOut)
@@ -182,7 +211,7 @@ int Bam2FastQ::execute(int argc, char **argv)
     if(noeof)
     {
         // Set that the eof block is not required.
-        BgzfFileType::setRequireEofBlock(false);
+        setRequireEofBlock(false);
     }
 
     String chr = "";
@@ -275,6 +304,37 @@ int Bam2FastQ::execute(int argc, char **argv)
         return(-1);
     }
 
+    // Streaming the pairs to stdout, so they cannot go to other files
+    // or share stdout with the unpaired reads.
+    if(toStdout)
+    {
+        if(mySplitRG || !firstOut.IsEmpty() || !secondOut.IsEmpty() ||
+           (myOutBase[0] == '-') || (unpairedOut[0] == '-'))
+        {
+            printUsage(std::cerr);
+            inputParameters.Status();
+            std::cerr << "ERROR: Cannot specify --stdout with --splitRG, --firstOut, --secondOut,\n"
+                      << "or writing --outBase/--unpairedOut to stdout.\n";
+            return(-1);
+        }
+        interleave = true;
+        firstOut = "-";
+    }
+
+    if(spillSize < 0)
+    {
+        printUsage(std::cerr);
+        inputParameters.Status();
+        std::cerr << "ERROR: --spillSize cannot be negative.\n";
+        return(-1);
+    }
+
+    if(!processBamIoParameters())
+    {
+        inputParameters.Status();
+        return(-1);
+    }
+
     // Check to see if the out file was specified, if not, generate it from
     // the input filename.
     if(myOutBase == "")
@@ -293,6 +353,7 @@ int Bam2FastQ::execute(int argc, char **argv)
 
     if(mySplitRG)
     {
+        myRGFiles.setLimits(maxOpen);
         std::string fqList = myOutBase.c_str();
         fqList += ".list";
         myFqList = ifopen(fqList.c_str(), "w");
@@ -313,10 +374,10 @@ int Bam2FastQ::execute(int argc, char **argv)
     // If output is gziped
     if(gzip)
     {
-        myCompression = InputFile::GZIP;
-	      myFirstFileNameExt += ".gz";
-	      mySecondFileNameExt += ".gz";
-	      myUnpairedFileNameExt += ".gz";
+        myGzip = true;
+        myFirstFileNameExt += ".gz";
+        mySecondFileNameExt += ".gz";
+        myUnpairedFileNameExt += ".gz";
     }
 
     getFileName(firstOut, myFirstFileNameExt);
@@ -351,12 +412,12 @@ int Bam2FastQ::execute(int argc, char **argv)
     // Open the output files if not splitting RG
     if(!mySplitRG)
     {
-        myUnpairedFile = ifopen(unpairedOut, "w", myCompression);
+        myUnpairedFile = openFastQ(unpairedOut);
 
         // Only open the first file if it is different than an already opened file.
         if(firstOut != unpairedOut)
         {
-            myFirstFile = ifopen(firstOut, "w", myCompression);
+            myFirstFile = openFastQ(firstOut);
         }
         else
         {
@@ -374,7 +435,7 @@ int Bam2FastQ::execute(int argc, char **argv)
         }
         else
         {
-            mySecondFile = ifopen(secondOut, "w", myCompression);
+            mySecondFile = openFastQ(secondOut);
         }
     
         if(myUnpairedFile == NULL)
@@ -408,13 +469,29 @@ int Bam2FastQ::execute(int argc, char **argv)
     }
 
     // Setup the '=' translation if the reference was specified.
+    GenomeSequence* refPtr = NULL;
     if(!refFile.IsEmpty())
     {
-        GenomeSequence* refPtr = new GenomeSequence(refFile);
+        refPtr = new GenomeSequence(refFile);
         samIn.SetReadSequenceTranslation(SamRecord::BASES);
         samIn.SetReference(refPtr);
     }
 
+    // Spill reads waiting for far away mates if requested.
+    if(!readName && (spillSize > 0))
+    {
+        if(tmpPrefix.IsEmpty())
+        {
+            tmpPrefix = myOutBase;
+            if(tmpPrefix[0] == '-')
+            {
+                tmpPrefix = "bam2FastQ";
+            }
+        }
+        myMateMap.enableSpill(myPool, mySamHeader, tmpPrefix.c_str(),
+                              spillSize, refPtr);
+    }
+
     SamRecord* recordPtr;
     int16_t samFlag;
 
@@ -474,7 +551,11 @@ int Bam2FastQ::execute(int argc, char **argv)
     }
 
     samIn.Close();
-    closeFiles();
+    if(!closeFiles() && (returnStatus == SamStatus::SUCCESS))
+    {
+        std::cerr << "ERROR: Failed to write the FASTQ files.\n";
+        returnStatus = SamStatus::FAIL_IO;
+    }
     
     // Output the results
     std::cerr << "\nFound " << myNumPairs << " read pairs.\n";
@@ -485,6 +566,10 @@ int Bam2FastQ::execute(int argc, char **argv)
                   << " reads, so they were written as unpaired\n"
                   << "  (not included in either of the above counts).\n";
     }
+    if(mateStats && !readName)
+    {
+        myMateMap.printStats(std::cerr);
+    }
     if(myNumQualTagErrors != 0)
     {
         std::cerr << myNumQualTagErrors << " records did not have tag "
@@ -633,7 +718,7 @@ void Bam2FastQ::handlePairedCoord(SamRecord& samRec)
 }
 
 
-void Bam2FastQ::writeFastQ(SamRecord& samRec, IFILE filePtr,
+void Bam2FastQ::writeFastQ(SamRecord& samRec, FastQWriter* filePtr,
                            const std::string& fileNameExt, const char* readNameExt)
 {
     static int16_t flag;
@@ -644,6 +729,7 @@ void Bam2FastQ::writeFastQ(SamRecord& samRec, IFILE filePtr,
     static std::string rgListStr;
     static std::string fileName;
     static std::string fq2;
+    int rgIndex = -1;
     if(mySplitRG)
     {
         rg = samRec.getString("RG").c_str();
@@ -651,7 +737,11 @@ void Bam2FastQ::writeFastQ(SamRecord& samRec, IFILE filePtr,
 
         OutFastqMap::iterator it;
         it = myOutFastqs.find(rgFastqExt);
-        if(it == myOutFastqs.end())
+        if(it != myOutFastqs.end())
+        {
+            rgIndex = it->second;
+        }
+        else
         {
             // New file.
             fileName = myOutBase.c_str();
@@ -664,8 +754,14 @@ void Bam2FastQ::writeFastQ(SamRecord& samRec, IFILE filePtr,
                 rg = ".";
             }
             fileName += rgFastqExt;
-            filePtr = ifopen(fileName.c_str(), "w", myCompression);
-            myOutFastqs[rgFastqExt] = filePtr;
+            rgIndex = myRGFiles.add(fileName.c_str(), myGzip,
+                                    myCompressionLevel);
+            if(rgIndex < 0)
+            {
+                throw(std::runtime_error("Bam2FastQ failed to open " +
+                                         fileName));
+            }
+            myOutFastqs[rgFastqExt] = rgIndex;
 
             if(fileNameExt != mySecondFileNameExt || myFirstFileNameExt == mySecondFileNameExt)
             {
@@ -696,12 +792,8 @@ void Bam2FastQ::writeFastQ(SamRecord& samRec, IFILE filePtr,
                          rgListStr.c_str());
             }
         }
-        else
-        {
-            filePtr = it->second;
-        }
     }
-    if(filePtr == NULL)
+    else if(filePtr == NULL)
     {
         throw(std::runtime_error("Programming ERROR/EXITING: Bam2FastQ filePtr not set."));
         return;
@@ -754,16 +846,19 @@ void Bam2FastQ::writeFastQ(SamRecord& samRec, IFILE filePtr,
         }
     }
     
-    if(myRNPlus)
+    if(rgIndex >= 0)
     {
-
-        ifprintf(filePtr, "@%s%s\n%s\n+%s%s\n%s\n", readName, readNameExt,
-                 sequence.c_str(), readName, readNameExt, quality.c_str());
+        // Read group files are buffered & opened/closed by the cache.
+        myRecordBuffer.clear();
+        FastQWriter::appendRecord(myRecordBuffer, readName, readNameExt,
+                                  sequence, quality.c_str(), myRNPlus);
+        myRGFiles.write(rgIndex, myRecordBuffer.data(),
+                        myRecordBuffer.size());
     }
     else
     {
-        ifprintf(filePtr, "@%s%s\n%s\n+\n%s\n", readName, readNameExt,
-                 sequence.c_str(), quality.c_str());
+        filePtr->writeRecord(readName, readNameExt, sequence,
+                             quality.c_str(), myRNPlus);
     }
     // Release the record.
     myPool.releaseRecord(&samRec);
@@ -804,8 +899,22 @@ void Bam2FastQ::cleanUpMateMap(uint64_t readPos, bool flushAll)
 }
 
 
-void Bam2FastQ::closeFiles()
+FastQWriter* Bam2FastQ::openFastQ(const char* fileName)
 {
+    FastQWriter* fastQ = new FastQWriter();
+    if(!fastQ->open(fileName, myGzip, myCompressionLevel))
+    {
+        delete fastQ;
+        return(NULL);
+    }
+    return(fastQ);
+}
+
+
+bool Bam2FastQ::closeFiles()
+{
+    bool status = true;
+
     // NULL out any duplicate file pointers
     // so files are only closed once.
     if(myFirstFile == myUnpairedFile)
@@ -823,17 +932,20 @@ void Bam2FastQ::closeFiles()
 
     if(myUnpairedFile != NULL)
     {
-        ifclose(myUnpairedFile);
+        status &= myUnpairedFile->close();
+        delete myUnpairedFile;
         myUnpairedFile = NULL;
     }
     if(myFirstFile != NULL)
     {
-        ifclose(myFirstFile);
+        status &= myFirstFile->close();
+        delete myFirstFile;
         myFirstFile = NULL;
     }
     if(mySecondFile != NULL)
     {
-        ifclose(mySecondFile);
+        status &= mySecondFile->close();
+        delete mySecondFile;
         mySecondFile = NULL;
     }
 
@@ -843,14 +955,10 @@ void Bam2FastQ::closeFiles()
         myFqList = NULL;
     }
 
-    // Loop through the fastq map and close those files.
-    for (OutFastqMap::iterator it=myOutFastqs.begin(); 
-         it!=myOutFastqs.end(); ++it)
-    {
-        ifclose(it->second);
-        it->second = NULL;
-    }
+    // Close the read group files.
+    status &= myRGFiles.closeAll();
     myOutFastqs.clear();
+    return(status);
 }
 
 
@@ -32,6 +32,8 @@
 #include "SamRecord.h"
 #include "MateMapByCoord.h"
 #include "SamCoordOutput.h"
+#include "FastQWriter.h"
+#include "OutputFileCache.h"
 
 class Bam2FastQ : public BamExecutable
 {
@@ -53,23 +55,27 @@ private:
     void handlePairedCoord(SamRecord& samRec);
     // Handles a record, writing the fastq to the specified file.
     // Releases the record.
-    void writeFastQ(SamRecord& samRec, IFILE filePtr,
+    void writeFastQ(SamRecord& samRec, FastQWriter* filePtr,
                     const std::string& fileNameExt,
                     const char* readNameExt = "");
     void cleanUpMateMap(uint64_t readPos, bool flushAll = false);
 
-    void closeFiles();
+    // Open a FASTQ for writing, returning NULL on failure.
+    FastQWriter* openFastQ(const char* fileName);
+
+    // Close the FASTQ files, returning false if any writes failed.
+    bool closeFiles();
     void getFileName(String& fn, const std::string& ext);
 
     SamFileHeader mySamHeader;
     SamRecordPool myPool;
     MateMapByCoord myMateMap;
 
-    InputFile::ifileCompression myCompression;
+    bool myGzip;
 
-    IFILE myUnpairedFile;
-    IFILE myFirstFile;
-    IFILE mySecondFile;
+    FastQWriter* myUnpairedFile;
+    FastQWriter* myFirstFile;
+    FastQWriter* mySecondFile;
 
     int myNumMateFailures;
     int myNumPairs;
@@ -91,11 +97,14 @@ private:
     std::string myUnpairedFileNameExt;
 
     #ifdef __GXX_EXPERIMENTAL_CXX0X__
-    typedef std::unordered_map<std::string, IFILE> OutFastqMap;
+    typedef std::unordered_map<std::string, int> OutFastqMap;
     #else
-    typedef std::map<std::string, IFILE> OutFastqMap;
+    typedef std::map<std::string, int> OutFastqMap;
     #endif
+    // Index of each read group file in myRGFiles.
     OutFastqMap myOutFastqs;
+    OutputFileCache myRGFiles;
+    std::string myRecordBuffer;
     IFILE myFqList;
 };
 
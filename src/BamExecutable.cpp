@@ -24,8 +24,15 @@
 #include <string.h>
 #include <stdlib.h>
 #include "BamExecutable.h"
+#include "BgzfFileType.h"
+#include "BgzfPipe.h"
+#include "BgzfReader.h"
+#include "ThreadPool.h"
 
 BamExecutable::BamExecutable()
+    : myNumThreads(0),
+      myCompressionLevel(-1),
+      myIsStage(false)
 {
 }
 
@@ -60,3 +67,86 @@ void BamExecutable::printUsage(std::ostream& os)
     os << std::endl;
     printDescription(os);
 }
+
+
+int BamExecutable::setupStage(int argc, char** argv)
+{
+    myIsStage = true;
+    return(initStage(argc, argv));
+}
+
+
+int BamExecutable::runStage(SamFileHeader& header, SamRecordSource& samIn,
+                            SamRecordSink& samOut)
+{
+    std::cerr << getProgramName() << " cannot be run as a pipeline stage"
+              << std::endl;
+    return(-1);
+}
+
+
+int BamExecutable::initStage(int argc, char** argv)
+{
+    std::cerr << getProgramName() << " cannot be run as a pipeline stage"
+              << std::endl;
+    return(-1);
+}
+
+
+void BamExecutable::addBamIoParameters(LongParamContainer& params)
+{
+    params.addInt("threads", &myNumThreads);
+}
+
+
+void BamExecutable::addBamOutputParameters(LongParamContainer& params)
+{
+    addBamIoParameters(params);
+    params.addInt("level", &myCompressionLevel);
+}
+
+
+bool BamExecutable::processBamIoParameters()
+{
+    if(myNumThreads < 0)
+    {
+        std::cerr << "ERROR: --threads must be 0 or greater, but was "
+                  << myNumThreads << std::endl;
+        return(false);
+    }
+    if((myCompressionLevel < -1) || (myCompressionLevel > 9))
+    {
+        std::cerr << "ERROR: --level must be between 0 and 9 (or -1 for "
+                  << "the default), but was " << myCompressionLevel
+                  << std::endl;
+        return(false);
+    }
+    if(!myIsStage)
+    {
+        ThreadPool::setSharedPoolSize(myNumThreads);
+    }
+    return(true);
+}
+
+
+void BamExecutable::setRequireEofBlock(bool requireEofBlock)
+{
+    BgzfFileType::setRequireEofBlock(requireEofBlock);
+    BgzfReader::setRequireEofBlock(requireEofBlock);
+}
+
+
+bool BamExecutable::openForWrite(SamFile& samFile, const char* filename,
+                                 SamFileHeader* header)
+{
+    int len = strlen(filename);
+    bool isBam = (len >= 4) && (strcmp(filename + len - 4, ".bam") == 0);
+
+    if(isBam && ((ThreadPool::getSharedPool() != NULL) ||
+                 (myCompressionLevel != -1)))
+    {
+        return(BgzfPipe::openForWrite(samFile, filename,
+                                      myCompressionLevel, header));
+    }
+    return(samFile.OpenForWrite(filename, header));
+}
@@ -20,6 +20,19 @@
 
 #include "StringBasics.h"
 #include "Parameters.h"
+#include "SamFile.h"
+#include "SamRecordStream.h"
+
+/// Add the BAM threading parameters to a parameter list
+/// defined with BEGIN_LONG_PARAMETERS (must be used in a BamExecutable).
+#define LONG_BAM_IO_PARAMETERS()                                \
+    LONG_INTPARAMETER("threads", &myNumThreads)
+
+/// Add the BAM threading & compression level parameters to a parameter
+/// list for executables that write BAM files.
+#define LONG_BAM_OUTPUT_PARAMETERS()                            \
+    LONG_BAM_IO_PARAMETERS()                                    \
+    LONG_INTPARAMETER("level", &myCompressionLevel)
 
 /// Base Class BAM Executable.
 class BamExecutable
@@ -37,8 +50,64 @@ public:
     
     virtual const char* getProgramName() {return("bam");}
 
+    ///////////////////////////////////////////////////////////////////
+    // Running as a stage of "bam pipeline", reading & writing records
+    // from/to the other stages rather than files.  Tools that support
+    // this override initStage & runStage.
+
+    /// Setup to run as a pipeline stage by parsing the tool's parameters
+    /// the same as execute (they start at argv[2]).  The pipeline handles
+    /// the BAM threading & compression.  Returns 0 on success.
+    int setupStage(int argc, char** argv);
+
+    /// Return whether or not the stage reads its input twice, calling
+    /// Rewind on its record source between the passes.
+    virtual bool stageRewindsInput() {return(false);}
+
+    /// Run the stage after setupStage, processing the records read from
+    /// samIn and writing them to samOut.  Returns 0 on success.
+    virtual int runStage(SamFileHeader& header, SamRecordSource& samIn,
+                         SamRecordSink& samOut);
+
 
 protected:
+    /// Parse the parameters for setupStage, returning 0 on success.
+    /// By default, this reports that the tool cannot be a pipeline stage.
+    virtual int initStage(int argc, char** argv);
+
+    /// Add the BAM threading parameters to the container.
+    void addBamIoParameters(LongParamContainer& params);
+
+    /// Add the BAM threading & compression level parameters to the
+    /// container.
+    void addBamOutputParameters(LongParamContainer& params);
+
+    /// Validate the BAM threading/compression parameters and setup the
+    /// shared thread pool (unless running as a pipeline stage).
+    /// Returns false if the parameters are invalid.
+    bool processBamIoParameters();
+
+    /// Set whether or not BGZF files must end with the empty EOF block,
+    /// both when read by SamFile & by the multi-threaded read-ahead.
+    static void setRequireEofBlock(bool requireEofBlock);
+
+    /// Open the SamFile for writing.  If threads or a compression level
+    /// were requested, BAM output is compressed by a BgzfWriter (on the
+    /// shared thread pool if there is one), otherwise this is the same
+    /// as calling samFile.OpenForWrite.
+    bool openForWrite(SamFile& samFile, const char* filename,
+                      SamFileHeader* header = NULL);
+
+    /// Number of threads for compressing BAM output, 0 to compress it on
+    /// the main thread.
+    int myNumThreads;
+
+    /// Deflate level for BAM output: 0 (uncompressed BGZF) to 9,
+    /// -1 for the zlib default.
+    int myCompressionLevel;
+
+    /// Whether or not this is running as a pipeline stage.
+    bool myIsStage;
 
 private:
 };
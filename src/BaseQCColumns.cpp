@@ -0,0 +1,376 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "BaseQCColumns.h"
+
+const char BaseQCColumns::MAGIC[4] = {'B', 'Q', 'C', 1};
+
+static const char* COLUMN_NAMES[BaseQCColumns::NUM_COLUMNS] =
+{
+    "Position", "TotalReads", "Dups", "QCFail", "Mapped", "Paired",
+    "ProperPaired", "ZeroMapQual", "MapQual<10", "MapQual255", "PassMapQual",
+    "SumMapQual", "AverageMapQualCount", "Depth", "Q20Bases"
+};
+
+
+static inline void appendValue(std::string& buffer, uint64_t value, int width)
+{
+    for(int i = 0; i < width; i++)
+    {
+        buffer += (char)((value >> (8 * i)) & 0xFF);
+    }
+}
+
+
+const char* BaseQCColumns::getName(int column)
+{
+    return(COLUMN_NAMES[column]);
+}
+
+
+int BaseQCColumns::getWidth(int column)
+{
+    // The sum of the mapping qualities can exceed 32 bits.
+    if(column == SUM_MAPQ)
+    {
+        return(8);
+    }
+    return(4);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// BaseQCColumnWriter
+//
+
+BaseQCColumnWriter::BaseQCColumnWriter()
+    : myWriter(),
+      myRefIndices(),
+      myChromosome(),
+      myRefIndex(-1),
+      myNumPositions(0),
+      myBuffer()
+{
+}
+
+
+BaseQCColumnWriter::~BaseQCColumnWriter()
+{
+    close();
+}
+
+
+bool BaseQCColumnWriter::open(const char* filename, SamFileHeader& header)
+{
+    close();
+    if(!myWriter.open(filename))
+    {
+        return(false);
+    }
+
+    myRefIndices.clear();
+    myChromosome.clear();
+    myRefIndex = -1;
+    myNumPositions = 0;
+    for(int i = 0; i < BaseQCColumns::NUM_COLUMNS; i++)
+    {
+        myColumns[i].clear();
+        myColumns[i].reserve(BaseQCColumns::BLOCK_POSITIONS);
+    }
+
+    myBuffer.assign(BaseQCColumns::MAGIC, sizeof(BaseQCColumns::MAGIC));
+    appendValue(myBuffer, BaseQCColumns::NUM_COLUMNS, 4);
+    for(int i = 0; i < BaseQCColumns::NUM_COLUMNS; i++)
+    {
+        appendValue(myBuffer, BaseQCColumns::getWidth(i), 1);
+        myBuffer.append(BaseQCColumns::getName(i),
+                        strlen(BaseQCColumns::getName(i)) + 1);
+    }
+    const SamReferenceInfo& refInfo = header.getReferenceInfo();
+    int32_t numRefs = refInfo.getNumEntries();
+    // An extra reference for positions of chromosomes not in the header.
+    appendValue(myBuffer, numRefs + 1, 4);
+    for(int32_t i = 0; i < numRefs; i++)
+    {
+        const char* refName = refInfo.getReferenceLabel(i).c_str();
+        myRefIndices[refName] = i;
+        myBuffer.append(refName, strlen(refName) + 1);
+    }
+    myBuffer.append("*", 2);
+    myWriter.write(myBuffer.data(), myBuffer.size());
+    return(true);
+}
+
+
+void BaseQCColumnWriter::add(const char* chromosome, const uint64_t* values)
+{
+    if((myNumPositions == 0) || (myChromosome != chromosome))
+    {
+        writeBlock();
+        myChromosome = chromosome;
+        std::map<std::string, int32_t>::iterator iter =
+            myRefIndices.find(myChromosome);
+        if(iter == myRefIndices.end())
+        {
+            myRefIndex = myRefIndices.size();
+        }
+        else
+        {
+            myRefIndex = iter->second;
+        }
+    }
+
+    for(int i = 0; i < BaseQCColumns::NUM_COLUMNS; i++)
+    {
+        myColumns[i].push_back(values[i]);
+    }
+    if(++myNumPositions == BaseQCColumns::BLOCK_POSITIONS)
+    {
+        writeBlock();
+    }
+}
+
+
+bool BaseQCColumnWriter::close()
+{
+    if(!myWriter.isOpen())
+    {
+        return(false);
+    }
+    writeBlock();
+    return(myWriter.close());
+}
+
+
+void BaseQCColumnWriter::writeBlock()
+{
+    if(myNumPositions == 0)
+    {
+        return;
+    }
+    myBuffer.clear();
+    appendValue(myBuffer, myRefIndex, 4);
+    appendValue(myBuffer, myNumPositions, 4);
+    for(int i = 0; i < BaseQCColumns::NUM_COLUMNS; i++)
+    {
+        int width = BaseQCColumns::getWidth(i);
+        for(unsigned int j = 0; j < myNumPositions; j++)
+        {
+            appendValue(myBuffer, myColumns[i][j], width);
+        }
+        myColumns[i].clear();
+    }
+    myWriter.write(myBuffer.data(), myBuffer.size());
+    myNumPositions = 0;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// BaseQCColumnReader
+//
+
+BaseQCColumnReader::BaseQCColumnReader()
+    : myReader(),
+      myFailed(false),
+      myRefNames(),
+      myFileWidths(),
+      myRefIndex(-1),
+      myNumPositions(0),
+      myBuffer()
+{
+}
+
+
+bool BaseQCColumnReader::open(const char* filename)
+{
+    myFailed = false;
+    myRefNames.clear();
+    myFileWidths.clear();
+    myRefIndex = -1;
+    myNumPositions = 0;
+    if(!myReader.open(filename))
+    {
+        return(false);
+    }
+
+    char magic[sizeof(BaseQCColumns::MAGIC)];
+    uint64_t numColumns = 0;
+    if(!readBytes(magic, sizeof(magic)) ||
+       (memcmp(magic, BaseQCColumns::MAGIC, sizeof(magic)) != 0) ||
+       !readValue(4, numColumns))
+    {
+        myFailed = true;
+        return(false);
+    }
+
+    for(int i = 0; i < BaseQCColumns::NUM_COLUMNS; i++)
+    {
+        myFileColumns[i] = -1;
+    }
+    for(uint64_t i = 0; i < numColumns; i++)
+    {
+        uint64_t width = 0;
+        std::string name;
+        if(!readValue(1, width) || (width < 1) || (width > 8) ||
+           !readString(name))
+        {
+            myFailed = true;
+            return(false);
+        }
+        myFileWidths.push_back(width);
+        for(int j = 0; j < BaseQCColumns::NUM_COLUMNS; j++)
+        {
+            if(name == BaseQCColumns::getName(j))
+            {
+                myFileColumns[j] = i;
+            }
+        }
+    }
+    for(int i = 0; i < BaseQCColumns::NUM_COLUMNS; i++)
+    {
+        if(myFileColumns[i] < 0)
+        {
+            myFailed = true;
+            return(false);
+        }
+    }
+
+    uint64_t numRefs = 0;
+    if(!readValue(4, numRefs))
+    {
+        myFailed = true;
+        return(false);
+    }
+    myRefNames.resize(numRefs);
+    for(uint64_t i = 0; i < numRefs; i++)
+    {
+        if(!readString(myRefNames[i]))
+        {
+            myFailed = true;
+            return(false);
+        }
+    }
+    return(true);
+}
+
+
+bool BaseQCColumnReader::readBlock()
+{
+    myNumPositions = 0;
+    if(myReader.isEOF())
+    {
+        return(false);
+    }
+    uint64_t refIndex = 0;
+    uint64_t numPositions = 0;
+    if(!readValue(4, refIndex) || (refIndex >= myRefNames.size()) ||
+       !readValue(4, numPositions) ||
+       (numPositions > BaseQCColumns::BLOCK_POSITIONS))
+    {
+        myFailed = true;
+        return(false);
+    }
+    myRefIndex = refIndex;
+
+    for(unsigned int i = 0; i < myFileWidths.size(); i++)
+    {
+        int width = myFileWidths[i];
+        myBuffer.resize(width * numPositions);
+        if((numPositions == 0) ||
+           !readBytes(&(myBuffer[0]), myBuffer.size()))
+        {
+            myFailed = true;
+            return(false);
+        }
+        for(int j = 0; j < BaseQCColumns::NUM_COLUMNS; j++)
+        {
+            if(myFileColumns[j] != (int)i)
+            {
+                continue;
+            }
+            myColumns[j].resize(numPositions);
+            const unsigned char* data = (const unsigned char*)myBuffer.data();
+            for(uint64_t k = 0; k < numPositions; k++)
+            {
+                uint64_t value = 0;
+                for(int b = width - 1; b >= 0; b--)
+                {
+                    value = (value << 8) | data[k * width + b];
+                }
+                myColumns[j][k] = value;
+            }
+        }
+    }
+    myNumPositions = numPositions;
+    return(true);
+}
+
+
+const char* BaseQCColumnReader::getChromosome() const
+{
+    return(myRefNames[myRefIndex].c_str());
+}
+
+
+void BaseQCColumnReader::getValues(unsigned int index, uint64_t* values) const
+{
+    for(int i = 0; i < BaseQCColumns::NUM_COLUMNS; i++)
+    {
+        values[i] = myColumns[i][index];
+    }
+}
+
+
+bool BaseQCColumnReader::readBytes(void* buffer, unsigned int length)
+{
+    return(myReader.read(buffer, length) == (int)length);
+}
+
+
+bool BaseQCColumnReader::readValue(int width, uint64_t& value)
+{
+    unsigned char bytes[8];
+    if(!readBytes(bytes, width))
+    {
+        return(false);
+    }
+    value = 0;
+    for(int i = width - 1; i >= 0; i--)
+    {
+        value = (value << 8) | bytes[i];
+    }
+    return(true);
+}
+
+
+bool BaseQCColumnReader::readString(std::string& value)
+{
+    value.clear();
+    char c;
+    while(readBytes(&c, 1))
+    {
+        if(c == 0)
+        {
+            return(true);
+        }
+        value += c;
+    }
+    return(false);
+}
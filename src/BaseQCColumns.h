@@ -0,0 +1,157 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//////////////////////////////////////////////////////////////////////////
+// Binary columnar file of the per position baseQC statistics.
+
+#ifndef __BASE_QC_COLUMNS_H__
+#define __BASE_QC_COLUMNS_H__
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "BgzfWriter.h"
+#include "BgzfReader.h"
+#include "SamFileHeader.h"
+
+/// Layout of a baseQC column file, a BGZF file containing:
+///   - the magic "BQC\1"
+///   - uint32 number of columns, then for each column its uint8 width in
+///     bytes & its null terminated name
+///   - uint32 number of references, then each null terminated name
+///   - blocks of up to BLOCK_POSITIONS positions of a single reference:
+///     int32 reference index, uint32 number of positions, then each
+///     column's values for all of the positions.
+/// All integers are little endian.  Readers find the columns by name, so
+/// columns may be added without breaking older readers.
+class BaseQCColumns
+{
+public:
+    /// The columns, in the order they are written.
+    enum Column
+    {
+        POSITION, TOTAL_READS, DUPS, QC_FAIL, MAPPED, PAIRED, PROPER_PAIRED,
+        ZERO_MAPQ, LT10_MAPQ, MAPQ_255, PASS_MAPQ, SUM_MAPQ, MAPQ_COUNT,
+        DEPTH, Q20, NUM_COLUMNS
+    };
+
+    /// Return the name of the specified column.
+    static const char* getName(int column);
+
+    /// Return the width in bytes of the specified column.
+    static int getWidth(int column);
+
+    /// Maximum number of positions in a block.
+    static const unsigned int BLOCK_POSITIONS = 0x1000;
+
+    static const char MAGIC[4];
+};
+
+
+/// Writes the per position baseQC statistics to a column file.
+class BaseQCColumnWriter
+{
+public:
+    BaseQCColumnWriter();
+
+    /// Closes the file if it is still open.
+    ~BaseQCColumnWriter();
+
+    /// Open the file ("-" writes to stdout) & write the header with the
+    /// reference names of the SAM/BAM header.
+    bool open(const char* filename, SamFileHeader& header);
+
+    /// Add the column values (indexed by BaseQCColumns::Column) of a
+    /// position of the specified chromosome.
+    void add(const char* chromosome, const uint64_t* values);
+
+    /// Write any buffered positions & close the file.  Returns false if
+    /// any write failed.
+    bool close();
+
+private:
+    BaseQCColumnWriter(const BaseQCColumnWriter&);
+    BaseQCColumnWriter& operator=(const BaseQCColumnWriter&);
+
+    // Write the buffered positions as a block.
+    void writeBlock();
+
+    BgzfWriter myWriter;
+    std::map<std::string, int32_t> myRefIndices;
+    std::string myChromosome;
+    int32_t myRefIndex;
+    unsigned int myNumPositions;
+    std::vector<uint64_t> myColumns[BaseQCColumns::NUM_COLUMNS];
+    std::string myBuffer;
+};
+
+
+/// Reads the blocks of a baseQC column file.
+class BaseQCColumnReader
+{
+public:
+    BaseQCColumnReader();
+
+    /// Open the file & read its header.  Returns false if the file could
+    /// not be read or is missing any of the columns.
+    bool open(const char* filename);
+
+    /// Read the next block, returning false at the end of the file or if
+    /// it is invalid (see hasFailed).
+    bool readBlock();
+
+    /// Return whether or not reading failed due to an invalid file.
+    bool hasFailed() const { return(myFailed || myReader.hasFailed()); }
+
+    /// Return the chromosome of the current block.
+    const char* getChromosome() const;
+
+    /// Return the number of positions in the current block.
+    unsigned int getNumPositions() const { return(myNumPositions); }
+
+    /// Return the values (indexed by BaseQCColumns::Column) of a position
+    /// of the current block.
+    void getValues(unsigned int index, uint64_t* values) const;
+
+    /// Close the file.
+    void close() { myReader.close(); }
+
+private:
+    // Read exactly length bytes, returning false if they could not be.
+    bool readBytes(void* buffer, unsigned int length);
+
+    // Read a little endian integer of the specified width.
+    bool readValue(int width, uint64_t& value);
+
+    // Read a null terminated string.
+    bool readString(std::string& value);
+
+    BgzfReader myReader;
+    bool myFailed;
+    std::vector<std::string> myRefNames;
+    // Width of each column in the file, & the index in the file of each
+    // known column.
+    std::vector<int> myFileWidths;
+    int myFileColumns[BaseQCColumns::NUM_COLUMNS];
+    int32_t myRefIndex;
+    unsigned int myNumPositions;
+    std::vector<uint64_t> myColumns[BaseQCColumns::NUM_COLUMNS];
+    std::string myBuffer;
+};
+
+#endif
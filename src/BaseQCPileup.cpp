@@ -0,0 +1,276 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include <stdexcept>
+#include "BaseQCPileup.h"
+#include "PileupElementBaseQCStats.h"
+#include "PosList.h"
+#include "SamFlag.h"
+
+// Reference ID of a pileup that has no positions.
+static const int32_t NO_REF_ID = -2;
+
+BaseQCPileup::BaseQCPileup(int bufferSize, BaseQCAccumulator* accumulator)
+    : myAccumulator(accumulator),
+      myExcludeList(NULL),
+      myRefID(NO_REF_ID),
+      myChromosome(),
+      myStart(0),
+      myEnd(0),
+      myMask(1)
+{
+    while(myMask + 1 < bufferSize)
+    {
+        myMask = (myMask << 1) | 1;
+    }
+    for(int i = 0; i < BaseQCColumns::NUM_COLUMNS; i++)
+    {
+        myChanges[i].assign(myMask + 1, 0);
+        myTotals[i] = 0;
+    }
+}
+
+
+void BaseQCPileup::processAlignmentRegion(SamRecord& record, int startPos,
+                                          int endPos, PosList* excludeList)
+{
+    int32_t refID = record.getReferenceID();
+    int32_t position = record.get0BasedPosition();
+
+    // Analyze the positions before this record, since the file is sorted
+    // no more records will cover them.
+    if(refID != myRefID)
+    {
+        flushPileup();
+        myRefID = refID;
+        myChromosome = record.getReferenceName();
+        myStart = position;
+        myEnd = position;
+    }
+    else
+    {
+        flushPileup(position);
+    }
+
+    if(excludeList != NULL)
+    {
+        myExcludeList = excludeList;
+    }
+
+    Cigar* cigar = record.getCigarInfo();
+    if(cigar == NULL)
+    {
+        throw std::runtime_error("Failed to retrieve cigar info from the record.");
+    }
+
+    // The record's positions in the region, positions before the start
+    // of the window were already analyzed (the records are not sorted).
+    int32_t start = std::max(std::max(position, (int32_t)startPos), myStart);
+    int32_t end = record.get0BasedAlignmentEnd();
+    if((endPos != -1) && (end >= endPos))
+    {
+        end = endPos - 1;
+    }
+    if(start > end)
+    {
+        return;
+    }
+    if(end + 1 - myStart > myMask)
+    {
+        growWindow(end + 1);
+    }
+    myEnd = std::max(myEnd, end + 2);
+
+    // Same counts as PileupElementBaseQCStats::addEntry.
+    addChange(BaseQCColumns::TOTAL_READS, start, end, 1);
+    uint16_t flag = record.getFlag();
+    if(SamFlag::isDuplicate(flag))
+    {
+        addChange(BaseQCColumns::DUPS, start, end, 1);
+    }
+    if(SamFlag::isQCFailure(flag))
+    {
+        addChange(BaseQCColumns::QC_FAIL, start, end, 1);
+    }
+    if((PileupElementBaseQCStats::ourFilterDups &&
+        SamFlag::isDuplicate(flag)) ||
+       (PileupElementBaseQCStats::ourFilterQCFail &&
+        SamFlag::isQCFailure(flag)) ||
+       !SamFlag::isMapped(flag))
+    {
+        // Filtered.
+        return;
+    }
+
+    addChange(BaseQCColumns::MAPPED, start, end, 1);
+    if(SamFlag::isPaired(flag))
+    {
+        addChange(BaseQCColumns::PAIRED, start, end, 1);
+        if(SamFlag::isProperPair(flag))
+        {
+            addChange(BaseQCColumns::PROPER_PAIRED, start, end, 1);
+        }
+    }
+
+    int mapQuality = record.getMapQuality();
+    if(mapQuality < 10)
+    {
+        addChange(BaseQCColumns::LT10_MAPQ, start, end, 1);
+        if(mapQuality == 0)
+        {
+            addChange(BaseQCColumns::ZERO_MAPQ, start, end, 1);
+        }
+    }
+    if(mapQuality >= PileupElementBaseQCStats::ourMinMapQuality)
+    {
+        addChange(BaseQCColumns::PASS_MAPQ, start, end, 1);
+    }
+    if(mapQuality == 255)
+    {
+        // Not included in the average mapping quality.
+        addChange(BaseQCColumns::MAPQ_255, start, end, 1);
+        return;
+    }
+    addChange(BaseQCColumns::SUM_MAPQ, start, end, mapQuality);
+    addChange(BaseQCColumns::MAPQ_COUNT, start, end, 1);
+    if(mapQuality < PileupElementBaseQCStats::ourMinMapQuality)
+    {
+        return;
+    }
+
+    // The depth & Q20 bases are only counted for the aligned bases.
+    const char* quality = record.getQuality();
+    int qualityLen = 0;
+    if((quality[0] != '*') || (quality[1] != 0))
+    {
+        qualityLen = strlen(quality);
+    }
+    int32_t refPos = position;
+    int32_t queryIndex = 0;
+    for(int i = 0; (i < cigar->size()) && (refPos <= end); i++)
+    {
+        const Cigar::CigarOperator& op = (*cigar)[i];
+        if(Cigar::isMatchOrMismatch(op.operation))
+        {
+            int32_t blockStart = std::max(refPos, start);
+            int32_t blockEnd = std::min(refPos + (int32_t)op.count - 1, end);
+            if(blockStart <= blockEnd)
+            {
+                addChange(BaseQCColumns::DEPTH, blockStart, blockEnd, 1);
+
+                // Add each run of Q20 bases.
+                int32_t runStart = -1;
+                int index = queryIndex + blockStart - refPos;
+                for(int32_t pos = blockStart; pos <= blockEnd; pos++, index++)
+                {
+                    bool q20 = (index < qualityLen) &&
+                        (quality[index] >= PileupElementBaseQCStats::Q20_CHAR_VAL);
+                    if(q20 && (runStart < 0))
+                    {
+                        runStart = pos;
+                    }
+                    else if(!q20 && (runStart >= 0))
+                    {
+                        addChange(BaseQCColumns::Q20, runStart, pos - 1, 1);
+                        runStart = -1;
+                    }
+                }
+                if(runStart >= 0)
+                {
+                    addChange(BaseQCColumns::Q20, runStart, blockEnd, 1);
+                }
+            }
+        }
+        if(Cigar::foundInReference(op.operation))
+        {
+            refPos += op.count;
+        }
+        if(Cigar::foundInQuery(op.operation))
+        {
+            queryIndex += op.count;
+        }
+    }
+}
+
+
+void BaseQCPileup::flushPileup()
+{
+    flushPileup(myEnd);
+    // The next record starts a new window, even on the same reference.
+    myRefID = NO_REF_ID;
+}
+
+
+void BaseQCPileup::flushPileup(int32_t position)
+{
+    if(position <= myStart)
+    {
+        return;
+    }
+
+    uint64_t values[BaseQCColumns::NUM_COLUMNS];
+    int32_t last = std::min(position, myEnd);
+    for(int32_t pos = myStart; pos < last; pos++)
+    {
+        int index = pos & myMask;
+        for(int i = BaseQCColumns::TOTAL_READS; i < BaseQCColumns::NUM_COLUMNS;
+            i++)
+        {
+            myTotals[i] += myChanges[i][index];
+            myChanges[i][index] = 0;
+        }
+        if((myTotals[BaseQCColumns::TOTAL_READS] == 0) ||
+           ((myExcludeList != NULL) &&
+            myExcludeList->hasPosition(myRefID, pos)))
+        {
+            // Not covered (or excluded, in which case no reads are
+            // counted at this position).
+            continue;
+        }
+        values[BaseQCColumns::POSITION] = pos;
+        for(int i = BaseQCColumns::TOTAL_READS; i < BaseQCColumns::NUM_COLUMNS;
+            i++)
+        {
+            values[i] = myTotals[i];
+        }
+        myAccumulator->analyze(myChromosome.c_str(), values);
+    }
+    myStart = position;
+    myEnd = std::max(myEnd, myStart);
+}
+
+
+void BaseQCPileup::growWindow(int32_t position)
+{
+    int32_t mask = myMask;
+    while(position - myStart > mask)
+    {
+        mask = (mask << 1) | 1;
+    }
+    for(int i = 0; i < BaseQCColumns::NUM_COLUMNS; i++)
+    {
+        std::vector<int64_t> changes(mask + 1, 0);
+        for(int32_t pos = myStart; pos < myEnd; pos++)
+        {
+            changes[pos & mask] = myChanges[i][pos & myMask];
+        }
+        myChanges[i].swap(changes);
+    }
+    myMask = mask;
+}
@@ -0,0 +1,103 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//////////////////////////////////////////////////////////////////////////
+// Pileup of the per position baseQC statistics that adds each read to
+// per column arrays once rather than to a pileup element per position.
+
+#ifndef __BASE_QC_PILEUP_H__
+#define __BASE_QC_PILEUP_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "SamRecord.h"
+#include "BaseQCColumns.h"
+
+class PosList;
+class BaseQCAccumulator;
+
+/// Generates the same per position statistics as a
+/// Pileup<PileupElementBaseQCStats, BaseQCAnalyzer>, using the filter
+/// settings of PileupElementBaseQCStats, with the positions analyzed into
+/// the accumulator in order.
+///
+/// Each read is decoded once: the counts that are the same for every
+/// position it covers (the flag & mapping quality counts) are added as
+/// a change at its first position that is undone after its last, as are
+/// the depth of each aligned block & each run of Q20 bases.  The changes
+/// are kept in a contiguous array per column covering a window of
+/// positions, and are summed as the positions are analyzed.
+class BaseQCPileup
+{
+public:
+    /// bufferSize is the initial number of positions in the window, it
+    /// grows if a read covers more.
+    BaseQCPileup(int bufferSize, BaseQCAccumulator* accumulator);
+
+    /// Add the positions of the record that are in the region from
+    /// startPos up to (not including) endPos (-1 for no end) & not in
+    /// the exclude list.  Positions before the record's start are
+    /// analyzed first, so the records must be sorted.
+    void processAlignmentRegion(SamRecord& record, int startPos, int endPos,
+                                PosList* excludeList = NULL);
+
+    /// Add all of the positions of the record.
+    void processAlignment(SamRecord& record)
+    { processAlignmentRegion(record, 0, -1); }
+
+    /// Analyze all of the remaining positions.
+    void flushPileup();
+
+private:
+    BaseQCPileup(const BaseQCPileup&);
+    BaseQCPileup& operator=(const BaseQCPileup&);
+
+    // Analyze the positions before the specified position.
+    void flushPileup(int32_t position);
+
+    // Grow the window so it includes the specified position.
+    void growWindow(int32_t position);
+
+    // Add a change of the column over the positions from start to end
+    // (inclusive).
+    inline void addChange(int column, int32_t start, int32_t end,
+                          int64_t change)
+    {
+        myChanges[column][start & myMask] += change;
+        myChanges[column][(end + 1) & myMask] -= change;
+    }
+
+    BaseQCAccumulator* myAccumulator;
+    PosList* myExcludeList;
+
+    int32_t myRefID;
+    std::string myChromosome;
+
+    // Start of the window: the first position that is not yet analyzed.
+    int32_t myStart;
+    // Position after the last change in the window.
+    int32_t myEnd;
+    // The window size is a power of 2, so a position's index in the
+    // window is the position & myMask.
+    int32_t myMask;
+    std::vector<int64_t> myChanges[BaseQCColumns::NUM_COLUMNS];
+    // Sum of the changes of the analyzed positions.
+    int64_t myTotals[BaseQCColumns::NUM_COLUMNS];
+};
+
+#endif
@@ -0,0 +1,211 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <vector>
+
+#include "BgzfPipe.h"
+#include "BgzfWriter.h"
+
+namespace
+{
+    // Size of the reads from the pipe.
+    const unsigned int PIPE_READ_SIZE = 0x10000;
+
+    // State of a single output being compressed.
+    struct PipeOutput
+    {
+        std::string filename;
+        int pipeFd;
+        BgzfWriter writer;
+        std::thread thread;
+        bool success;
+    };
+
+    // Outputs that have not yet been finished.  Allocated and never freed
+    // so an exit() while threads are still running does not destroy them.
+    std::vector<PipeOutput*>* ourOutputs = NULL;
+    std::mutex ourOutputsMutex;
+    unsigned int ourPipeCount = 0;
+
+    // Copy the pipe contents into the writer until the SamFile closes it.
+    void runPipe(PipeOutput* output)
+    {
+        std::vector<char> buffer(PIPE_READ_SIZE);
+        bool success = true;
+        while(true)
+        {
+            ssize_t numRead = read(output->pipeFd, &(buffer[0]), PIPE_READ_SIZE);
+            if(numRead == 0)
+            {
+                // The SamFile closed its end.
+                break;
+            }
+            if(numRead < 0)
+            {
+                if(errno == EINTR)
+                {
+                    continue;
+                }
+                success = false;
+                break;
+            }
+            // Keep draining the pipe even after a failure so the
+            // SamFile does not block or get a SIGPIPE.
+            if(success && !output->writer.write(&(buffer[0]), numRead))
+            {
+                success = false;
+            }
+        }
+        if(!output->writer.close())
+        {
+            success = false;
+        }
+        ::close(output->pipeFd);
+        output->success = success;
+    }
+
+
+    std::string getPipeName()
+    {
+        const char* tmpDir = getenv("TMPDIR");
+        if((tmpDir == NULL) || (tmpDir[0] == '\0'))
+        {
+            tmpDir = "/tmp";
+        }
+        std::ostringstream name;
+        // Use the ubam extension so SamFile writes uncompressed BAM.
+        name << tmpDir << "/bamUtil." << getpid() << "."
+             << ourPipeCount++ << ".ubam";
+        return(name.str());
+    }
+}
+
+
+bool BgzfPipe::openForWrite(SamFile& samFile, const char* filename,
+                            int level, SamFileHeader* header)
+{
+    std::lock_guard<std::mutex> lock(ourOutputsMutex);
+    if(ourOutputs == NULL)
+    {
+        ourOutputs = new std::vector<PipeOutput*>;
+    }
+
+    PipeOutput* output = new PipeOutput;
+    output->filename = filename;
+    output->pipeFd = -1;
+    output->success = false;
+
+    // A filename starting with '-' is stdout.
+    const char* outName = (filename[0] == '-') ? "-" : filename;
+    if(!output->writer.open(outName, level))
+    {
+        std::cerr << "Failed to open " << filename << " for writing\n";
+        delete output;
+        return(false);
+    }
+
+    std::string pipeName = getPipeName();
+    if(mkfifo(pipeName.c_str(), S_IRUSR | S_IWUSR) != 0)
+    {
+        std::cerr << "Failed to create the compression pipe " << pipeName
+                  << ": " << strerror(errno) << std::endl;
+        delete output;
+        return(false);
+    }
+
+    // Open the read end without blocking so the SamFile can open the
+    // write end without waiting on the compression thread.
+    output->pipeFd = open(pipeName.c_str(), O_RDONLY | O_NONBLOCK);
+    if(output->pipeFd < 0)
+    {
+        std::cerr << "Failed to open the compression pipe " << pipeName
+                  << ": " << strerror(errno) << std::endl;
+        unlink(pipeName.c_str());
+        delete output;
+        return(false);
+    }
+
+    // Open without the header: a header larger than the pipe buffer would
+    // block until the compression thread drains the pipe.
+    bool opened = samFile.OpenForWrite(pipeName.c_str());
+
+    // Both ends are open (or the SamFile failed), so the name is not
+    // needed anymore.
+    unlink(pipeName.c_str());
+
+    if(!opened)
+    {
+        ::close(output->pipeFd);
+        delete output;
+        return(false);
+    }
+
+    // The SamFile has the write end, so reads can now block.
+    int flags = fcntl(output->pipeFd, F_GETFL);
+    fcntl(output->pipeFd, F_SETFL, flags & ~O_NONBLOCK);
+
+    output->thread = std::thread(runPipe, output);
+
+    // Now that the pipe is being drained, write the header.
+    if((header != NULL) && !samFile.WriteHeader(*header))
+    {
+        // Closing the write end stops the compression thread.
+        samFile.Close();
+        output->thread.join();
+        delete output;
+        return(false);
+    }
+
+    ourOutputs->push_back(output);
+    return(true);
+}
+
+
+bool BgzfPipe::finishAll()
+{
+    std::lock_guard<std::mutex> lock(ourOutputsMutex);
+    if(ourOutputs == NULL)
+    {
+        return(true);
+    }
+
+    bool success = true;
+    for(unsigned int i = 0; i < ourOutputs->size(); i++)
+    {
+        PipeOutput* output = (*ourOutputs)[i];
+        output->thread.join();
+        if(!output->success)
+        {
+            std::cerr << "Failed writing " << output->filename << std::endl;
+            success = false;
+        }
+        delete output;
+    }
+    ourOutputs->clear();
+    return(success);
+}
@@ -0,0 +1,52 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//////////////////////////////////////////////////////////////////////////
+// Routes the output of a SamFile through a BgzfWriter so BAM files can be
+// compressed on the shared thread pool and at a selectable level.
+
+#ifndef __BGZF_PIPE_H__
+#define __BGZF_PIPE_H__
+
+#include "SamFile.h"
+
+/// SamFile always compresses BAM output itself on the calling thread, so
+/// to compress in parallel, the SamFile is instead opened to write
+/// uncompressed BAM into a named pipe (fifo).  A background thread reads
+/// the pipe and compresses the stream into the real output file using a
+/// BgzfWriter.  All of the SamFile processing (sort validation, sequence
+/// translation, etc) is unchanged.
+class BgzfPipe
+{
+public:
+    /// Open the SamFile to write BAM through a BgzfWriter to the specified
+    /// filename ("-.bam" writes to stdout) using the specified compression
+    /// level (-1 is the zlib default, 0 is uncompressed BGZF).
+    /// Returns false if the output could not be opened.
+    static bool openForWrite(SamFile& samFile, const char* filename,
+                             int level, SamFileHeader* header = NULL);
+
+    /// Wait for the compression of all outputs opened by openForWrite to
+    /// complete.  Their SamFiles must have been closed first.
+    /// Returns false if writing any of them failed.
+    static bool finishAll();
+
+private:
+    BgzfPipe();
+};
+
+#endif
@@ -0,0 +1,346 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <memory>
+#include <zlib.h>
+
+#include "BgzfReader.h"
+#include "ThreadPool.h"
+
+// Size of the BGZF block header & footer.
+static const unsigned int BGZF_HEADER_SIZE = 18;
+static const unsigned int BGZF_FOOTER_SIZE = 8;
+
+// Maximum size of a BGZF block, compressed or uncompressed.
+static const unsigned int BGZF_MAX_BLOCK_SIZE = 0x10000;
+
+// Empty block that marks the end of a BGZF file.
+static const unsigned char BGZF_EOF[] =
+{
+    31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 'B', 'C', 2, 0, 27, 0,
+    3, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+// Number of blocks per thread to read ahead of the caller.
+static const unsigned int BLOCKS_PER_THREAD = 4;
+
+
+static inline uint16_t unpackUint16(const unsigned char* buffer)
+{
+    return(buffer[0] | (buffer[1] << 8));
+}
+
+
+static inline uint32_t unpackUint32(const unsigned char* buffer)
+{
+    return(buffer[0] | (buffer[1] << 8) | (buffer[2] << 16) |
+           ((uint32_t)buffer[3] << 24));
+}
+
+
+// Check that the header is a gzip header with the BGZF extra field.
+static bool isBgzfHeader(const unsigned char* header)
+{
+    return((header[0] == 31) && (header[1] == 139) && (header[2] == 8) &&
+           ((header[3] & 4) != 0) && (unpackUint16(header + 10) == 6) &&
+           (header[12] == 'B') && (header[13] == 'C') &&
+           (unpackUint16(header + 14) == 2));
+}
+
+
+bool BgzfReader::ourRequireEofBlock = true;
+
+
+BgzfReader::BgzfReader()
+    : myFile(NULL),
+      myFileEOF(false),
+      myFileFailed(false),
+      myFailed(false),
+      myLastBlockEof(false),
+      myMissingEofBlock(false),
+      myBuffer(),
+      myBufferPos(0),
+      myPending()
+{
+}
+
+
+BgzfReader::~BgzfReader()
+{
+    close();
+}
+
+
+bool BgzfReader::open(const char* filename)
+{
+    close();
+
+    myFile = fopen(filename, "rb");
+    if(myFile == NULL)
+    {
+        return(false);
+    }
+
+    // Make sure this is a BGZF file before reading ahead.
+    unsigned char header[BGZF_HEADER_SIZE];
+    if((fread(header, 1, BGZF_HEADER_SIZE, myFile) != BGZF_HEADER_SIZE) ||
+       !isBgzfHeader(header) || (fseek(myFile, 0, SEEK_SET) != 0))
+    {
+        close();
+        return(false);
+    }
+
+    myFileEOF = false;
+    myFileFailed = false;
+    myFailed = false;
+    myLastBlockEof = false;
+    myMissingEofBlock = false;
+    myBuffer.clear();
+    myBufferPos = 0;
+    return(true);
+}
+
+
+int BgzfReader::read(void* buffer, unsigned int length)
+{
+    if(myFile == NULL)
+    {
+        return(-1);
+    }
+
+    char* bufferPtr = (char*)buffer;
+    unsigned int numRead = 0;
+    while(numRead < length)
+    {
+        if(myBufferPos >= myBuffer.size())
+        {
+            if(!nextBlock())
+            {
+                break;
+            }
+            continue;
+        }
+        unsigned int copyLen = myBuffer.size() - myBufferPos;
+        if(copyLen > (length - numRead))
+        {
+            copyLen = length - numRead;
+        }
+        memcpy(bufferPtr + numRead, myBuffer.data() + myBufferPos, copyLen);
+        myBufferPos += copyLen;
+        numRead += copyLen;
+    }
+
+    if(myFailed)
+    {
+        return(-1);
+    }
+    return(numRead);
+}
+
+
+bool BgzfReader::isEOF()
+{
+    if(myFile == NULL)
+    {
+        return(true);
+    }
+    // Skip past any empty blocks.
+    while(myBufferPos >= myBuffer.size())
+    {
+        if(!nextBlock())
+        {
+            return(true);
+        }
+    }
+    return(false);
+}
+
+
+void BgzfReader::close()
+{
+    // Blocks still being decompressed own their data, so they can just
+    // be dropped.
+    myPending.clear();
+    if(myFile != NULL)
+    {
+        fclose(myFile);
+        myFile = NULL;
+    }
+    myBuffer.clear();
+    myBufferPos = 0;
+}
+
+
+bool BgzfReader::inflateBlock(const std::string& block, std::string& data)
+{
+    if(block.size() < (BGZF_HEADER_SIZE + BGZF_FOOTER_SIZE))
+    {
+        return(false);
+    }
+    const unsigned char* blockPtr = (const unsigned char*)block.data();
+    const unsigned char* footerPtr =
+        blockPtr + block.size() - BGZF_FOOTER_SIZE;
+    uint32_t expectedCrc = unpackUint32(footerPtr);
+    uint32_t expectedSize = unpackUint32(footerPtr + 4);
+    if(expectedSize > BGZF_MAX_BLOCK_SIZE)
+    {
+        return(false);
+    }
+
+    data.resize(expectedSize);
+    if(expectedSize == 0)
+    {
+        // Empty block, such as the EOF marker.
+        return(true);
+    }
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    zs.next_in = (Bytef*)(blockPtr + BGZF_HEADER_SIZE);
+    zs.avail_in = block.size() - BGZF_HEADER_SIZE - BGZF_FOOTER_SIZE;
+    zs.next_out = (Bytef*)&(data[0]);
+    zs.avail_out = expectedSize;
+
+    // Raw inflate (negative window bits) since the gzip wrapper is
+    // checked here.
+    if(inflateInit2(&zs, -15) != Z_OK)
+    {
+        return(false);
+    }
+    int status = inflate(&zs, Z_FINISH);
+    inflateEnd(&zs);
+
+    if((status != Z_STREAM_END) || (zs.total_out != expectedSize))
+    {
+        return(false);
+    }
+
+    uint32_t crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, (const Bytef*)data.data(), expectedSize);
+    return(crc == expectedCrc);
+}
+
+
+bool BgzfReader::readRawBlock(std::string& block)
+{
+    unsigned char header[BGZF_HEADER_SIZE];
+    size_t numRead = fread(header, 1, BGZF_HEADER_SIZE, myFile);
+    if(numRead == 0)
+    {
+        if(ourRequireEofBlock && !myLastBlockEof)
+        {
+            // Truncated at a block boundary.
+            myMissingEofBlock = true;
+            myFileFailed = true;
+            return(false);
+        }
+        myFileEOF = true;
+        return(false);
+    }
+    if((numRead != BGZF_HEADER_SIZE) || !isBgzfHeader(header))
+    {
+        // Truncated or not a BGZF block.
+        myFileFailed = true;
+        return(false);
+    }
+
+    unsigned int blockSize = unpackUint16(header + 16) + 1;
+    if(blockSize < (BGZF_HEADER_SIZE + BGZF_FOOTER_SIZE))
+    {
+        myFileFailed = true;
+        return(false);
+    }
+
+    block.resize(blockSize);
+    memcpy(&(block[0]), header, BGZF_HEADER_SIZE);
+    unsigned int remaining = blockSize - BGZF_HEADER_SIZE;
+    if(fread(&(block[BGZF_HEADER_SIZE]), 1, remaining, myFile) != remaining)
+    {
+        // Truncated block.
+        myFileFailed = true;
+        return(false);
+    }
+    myLastBlockEof = ((blockSize == sizeof(BGZF_EOF)) &&
+                      (memcmp(block.data(), BGZF_EOF, blockSize) == 0));
+    return(true);
+}
+
+
+void BgzfReader::readAhead(unsigned int maxPending)
+{
+    ThreadPool* pool = ThreadPool::getSharedPool();
+    while(!myFileEOF && !myFileFailed && (myPending.size() < maxPending))
+    {
+        std::shared_ptr<std::string> block = std::make_shared<std::string>();
+        if(!readRawBlock(*block))
+        {
+            return;
+        }
+
+        auto inflateTask = [block]()
+            {
+                InflatedBlock result;
+                result.valid = inflateBlock(*block, result.data);
+                return(result);
+            };
+
+        if(pool == NULL)
+        {
+            // No threads, so decompress it when it is needed.
+            myPending.push_back(std::async(std::launch::deferred,
+                                           inflateTask));
+        }
+        else
+        {
+            myPending.push_back(pool->submit(inflateTask));
+        }
+    }
+}
+
+
+bool BgzfReader::nextBlock()
+{
+    ThreadPool* pool = ThreadPool::getSharedPool();
+    unsigned int maxPending = 1;
+    if(pool != NULL)
+    {
+        maxPending = BLOCKS_PER_THREAD * pool->getNumThreads();
+    }
+
+    readAhead(maxPending);
+    if(myPending.empty())
+    {
+        // Failed if the file ended in the middle of a block.
+        myFailed = myFileFailed;
+        return(false);
+    }
+
+    InflatedBlock block = myPending.front().get();
+    myPending.pop_front();
+    if(!block.valid)
+    {
+        myFailed = true;
+        return(false);
+    }
+    myBuffer.swap(block.data);
+    myBufferPos = 0;
+
+    // Start on the next blocks while this one is being consumed.
+    readAhead(maxPending);
+    return(true);
+}
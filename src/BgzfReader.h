@@ -0,0 +1,112 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//////////////////////////////////////////////////////////////////////////
+// Reader for BGZF (blocked gzip) files that decompresses the blocks ahead
+// of the caller on the shared thread pool.
+
+#ifndef __BGZF_READER_H__
+#define __BGZF_READER_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <deque>
+#include <future>
+
+/// Reads a BGZF file, reading ahead of the caller and decompressing the
+/// upcoming blocks on the shared ThreadPool (if one has been set up) into
+/// a ring of decompressed blocks that are handed back in file order.
+class BgzfReader
+{
+public:
+    BgzfReader();
+
+    /// Closes the file if it is still open.
+    ~BgzfReader();
+
+    /// Open the specified file for reading.  Returns false if the file
+    /// could not be opened or does not start with a BGZF block.
+    bool open(const char* filename);
+
+    /// Return whether or not this reader is open.
+    bool isOpen() const { return(myFile != NULL); }
+
+    /// Read up to length bytes into buffer, returning the number of bytes
+    /// read, which is only less than length at the end of the file.
+    /// Returns -1 if the file is not open or is not valid BGZF.
+    int read(void* buffer, unsigned int length);
+
+    /// Return whether or not all of the data has been read.
+    bool isEOF();
+
+    /// Return whether or not the last read failed due to an invalid or
+    /// truncated block, or a missing EOF block.
+    bool hasFailed() const { return(myFailed); }
+
+    /// Return whether or not the file ended without the empty EOF block.
+    bool isMissingEofBlock() const { return(myMissingEofBlock); }
+
+    /// Set whether or not the file must end with the empty EOF block
+    /// (the default), matching BgzfFileType::setRequireEofBlock.
+    static void setRequireEofBlock(bool requireEofBlock)
+    { ourRequireEofBlock = requireEofBlock; }
+
+    /// Close the file, discarding any blocks that were read ahead.
+    void close();
+
+    /// Decompress a complete BGZF block (header through footer) into data,
+    /// checking the CRC and size.  Returns false if the block is invalid.
+    static bool inflateBlock(const std::string& block, std::string& data);
+
+private:
+    BgzfReader(const BgzfReader&);
+    BgzfReader& operator=(const BgzfReader&);
+
+    // Result of decompressing a block.
+    struct InflatedBlock
+    {
+        bool valid;
+        std::string data;
+    };
+
+    // Read the next compressed block from the file, returning false at
+    // the end of the file or if the block is invalid (sets myFileFailed).
+    bool readRawBlock(std::string& block);
+
+    // Read & start decompressing blocks until maxPending are outstanding.
+    void readAhead(unsigned int maxPending);
+
+    // Replace myBuffer with the next decompressed block.
+    // Returns false at the end of the file or on failure.
+    bool nextBlock();
+
+    FILE* myFile;
+    bool myFileEOF;
+    bool myFileFailed;
+    bool myFailed;
+    // Whether the last block read from the file was the EOF block.
+    bool myLastBlockEof;
+    bool myMissingEofBlock;
+    std::string myBuffer;
+    unsigned int myBufferPos;
+    std::deque<std::future<InflatedBlock> > myPending;
+
+    static bool ourRequireEofBlock;
+};
+
+#endif
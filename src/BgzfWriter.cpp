@@ -0,0 +1,301 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <memory>
+#include <zlib.h>
+
+#include "BgzfWriter.h"
+#include "ThreadPool.h"
+
+// Size of the BGZF block header & footer.
+static const unsigned int BGZF_HEADER_SIZE = 18;
+static const unsigned int BGZF_FOOTER_SIZE = 8;
+
+// Header of a BGZF block, the last 2 bytes are replaced with the block size.
+static const unsigned char BGZF_HEADER[BGZF_HEADER_SIZE] =
+{
+    31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 'B', 'C', 2, 0, 0, 0
+};
+
+// Empty block that marks the end of a BGZF file.
+static const unsigned char BGZF_EOF[] =
+{
+    31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 'B', 'C', 2, 0, 27, 0,
+    3, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+// Number of blocks per thread that may be waiting to be written.
+static const unsigned int BLOCKS_PER_THREAD = 4;
+
+
+static inline void packUint16(unsigned char* buffer, uint16_t value)
+{
+    buffer[0] = value & 0xFF;
+    buffer[1] = (value >> 8) & 0xFF;
+}
+
+
+static inline void packUint32(unsigned char* buffer, uint32_t value)
+{
+    buffer[0] = value & 0xFF;
+    buffer[1] = (value >> 8) & 0xFF;
+    buffer[2] = (value >> 16) & 0xFF;
+    buffer[3] = (value >> 24) & 0xFF;
+}
+
+
+BgzfWriter::BgzfWriter()
+    : myFile(NULL),
+      myCloseFile(false),
+      myLevel(Z_DEFAULT_COMPRESSION),
+      myFailed(false),
+      myBuffer(),
+      myPending()
+{
+}
+
+
+BgzfWriter::~BgzfWriter()
+{
+    close();
+}
+
+
+bool BgzfWriter::open(const char* filename, int level, bool append)
+{
+    close();
+
+    if(strcmp(filename, "-") == 0)
+    {
+        myFile = stdout;
+        myCloseFile = false;
+    }
+    else
+    {
+        myFile = fopen(filename, append ? "ab" : "wb");
+        myCloseFile = true;
+    }
+    if(myFile == NULL)
+    {
+        return(false);
+    }
+    myLevel = level;
+    myFailed = false;
+    myBuffer.clear();
+    myBuffer.reserve(MAX_BLOCK_INPUT);
+    return(true);
+}
+
+
+bool BgzfWriter::write(const void* data, unsigned int length)
+{
+    if(myFile == NULL)
+    {
+        return(false);
+    }
+
+    const char* dataPtr = (const char*)data;
+    while(length > 0)
+    {
+        unsigned int copyLen = MAX_BLOCK_INPUT - myBuffer.size();
+        if(copyLen > length)
+        {
+            copyLen = length;
+        }
+        myBuffer.append(dataPtr, copyLen);
+        dataPtr += copyLen;
+        length -= copyLen;
+
+        if(myBuffer.size() == MAX_BLOCK_INPUT)
+        {
+            submitBlock();
+        }
+    }
+    return(!myFailed);
+}
+
+
+bool BgzfWriter::flush()
+{
+    if(myFile == NULL)
+    {
+        return(false);
+    }
+    if(!myBuffer.empty())
+    {
+        submitBlock();
+    }
+    writePending(0);
+    if(fflush(myFile) != 0)
+    {
+        myFailed = true;
+    }
+    return(!myFailed);
+}
+
+
+bool BgzfWriter::close(bool writeEof)
+{
+    if(myFile == NULL)
+    {
+        return(false);
+    }
+
+    flush();
+
+    if(writeEof &&
+       (fwrite(BGZF_EOF, 1, sizeof(BGZF_EOF), myFile) != sizeof(BGZF_EOF)))
+    {
+        myFailed = true;
+    }
+
+    if(myCloseFile)
+    {
+        if(fclose(myFile) != 0)
+        {
+            myFailed = true;
+        }
+    }
+    else if(fflush(myFile) != 0)
+    {
+        myFailed = true;
+    }
+    myFile = NULL;
+    return(!myFailed);
+}
+
+
+bool BgzfWriter::compressBlock(const char* data, unsigned int length,
+                               int level, std::string& block)
+{
+    if(length > MAX_BLOCK_INPUT)
+    {
+        return(false);
+    }
+
+    block.resize(MAX_BLOCK_SIZE);
+    unsigned char* blockPtr = (unsigned char*)&(block[0]);
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    zs.next_in = (Bytef*)data;
+    zs.avail_in = length;
+    zs.next_out = blockPtr + BGZF_HEADER_SIZE;
+    zs.avail_out = MAX_BLOCK_SIZE - BGZF_HEADER_SIZE - BGZF_FOOTER_SIZE;
+
+    // Raw deflate (negative window bits) since the gzip wrapper is
+    // written here.
+    if(deflateInit2(&zs, level, Z_DEFLATED, -15, 8,
+                    Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        return(false);
+    }
+    int status = deflate(&zs, Z_FINISH);
+    deflateEnd(&zs);
+
+    if(status != Z_STREAM_END)
+    {
+        // Did not fit in a block, which can only happen for data that
+        // does not compress, so store it instead which always fits.
+        if(level != 0)
+        {
+            return(compressBlock(data, length, 0, block));
+        }
+        return(false);
+    }
+
+    unsigned int blockSize =
+        BGZF_HEADER_SIZE + zs.total_out + BGZF_FOOTER_SIZE;
+
+    memcpy(blockPtr, BGZF_HEADER, BGZF_HEADER_SIZE);
+    packUint16(blockPtr + 16, blockSize - 1);
+
+    uint32_t crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, (const Bytef*)data, length);
+    unsigned char* footerPtr = blockPtr + blockSize - BGZF_FOOTER_SIZE;
+    packUint32(footerPtr, crc);
+    packUint32(footerPtr + 4, length);
+
+    block.resize(blockSize);
+    return(true);
+}
+
+
+void BgzfWriter::submitBlock()
+{
+    ThreadPool* pool = ThreadPool::getSharedPool();
+    if(pool == NULL)
+    {
+        // No threads, so compress & write it now.
+        std::string block;
+        if(!compressBlock(myBuffer.data(), myBuffer.size(), myLevel, block))
+        {
+            myFailed = true;
+        }
+        writeBlock(block);
+        myBuffer.clear();
+        return;
+    }
+
+    // Hand off the buffer to a worker thread and start a new one.
+    std::shared_ptr<std::string> input = std::make_shared<std::string>();
+    input->swap(myBuffer);
+    myBuffer.reserve(MAX_BLOCK_INPUT);
+    int level = myLevel;
+    myPending.push_back(pool->submit([input, level]()
+        {
+            std::string block;
+            if(!compressBlock(input->data(), input->size(), level, block))
+            {
+                block.clear();
+            }
+            return(block);
+        }));
+
+    // Keep the number of outstanding blocks bounded.
+    writePending(BLOCKS_PER_THREAD * pool->getNumThreads());
+}
+
+
+void BgzfWriter::writePending(unsigned int maxPending)
+{
+    while(myPending.size() > maxPending)
+    {
+        std::string block = myPending.front().get();
+        myPending.pop_front();
+        if(block.empty())
+        {
+            // Failed to compress the block.
+            myFailed = true;
+        }
+        writeBlock(block);
+    }
+}
+
+
+void BgzfWriter::writeBlock(const std::string& block)
+{
+    if(block.empty() || myFailed)
+    {
+        return;
+    }
+    if(fwrite(block.data(), 1, block.size(), myFile) != block.size())
+    {
+        myFailed = true;
+    }
+}
@@ -0,0 +1,97 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//////////////////////////////////////////////////////////////////////////
+// Writer for BGZF (blocked gzip) files that compresses the blocks on the
+// shared thread pool.
+
+#ifndef __BGZF_WRITER_H__
+#define __BGZF_WRITER_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <deque>
+#include <future>
+
+/// Writes a BGZF file, compressing each block on the shared ThreadPool
+/// (if one has been set up) while writing the blocks in their original
+/// order.  Blocks are always cut at the same uncompressed offsets, so the
+/// output for a given compression level is byte-identical regardless of
+/// the number of threads.
+class BgzfWriter
+{
+public:
+    /// Maximum number of uncompressed bytes stored in a single block.
+    static const unsigned int MAX_BLOCK_INPUT = 0xff00;
+
+    /// Maximum size of a compressed block including header and footer.
+    static const unsigned int MAX_BLOCK_SIZE = 0x10000;
+
+    BgzfWriter();
+
+    /// Closes the file if it is still open.
+    ~BgzfWriter();
+
+    /// Open the specified file for writing ("-" writes to stdout).
+    /// level is the deflate compression level: -1 is the zlib default,
+    /// 0 writes uncompressed (stored) BGZF blocks, 9 is the best compression.
+    /// If append is true, the blocks are added to the end of an existing
+    /// file (that was closed without its EOF block).
+    bool open(const char* filename, int level = -1, bool append = false);
+
+    /// Return whether or not this writer is open.
+    bool isOpen() const { return(myFile != NULL); }
+
+    /// Write the specified data, compressing blocks as they fill.
+    bool write(const void* data, unsigned int length);
+
+    /// Close the current block even if it is not full.
+    bool flush();
+
+    /// Flush all data, write the BGZF EOF block (unless writeEof is false
+    /// because more blocks will be appended later), and close the file.
+    /// Returns false if any write failed.
+    bool close(bool writeEof = true);
+
+    /// Compress the specified data (at most MAX_BLOCK_INPUT bytes) into
+    /// a single complete BGZF block.  Returns false on failure.
+    static bool compressBlock(const char* data, unsigned int length,
+                              int level, std::string& block);
+
+private:
+    BgzfWriter(const BgzfWriter&);
+    BgzfWriter& operator=(const BgzfWriter&);
+
+    // Hand the buffered data off to be compressed.
+    void submitBlock();
+
+    // Write completed blocks until at most maxPending are outstanding.
+    void writePending(unsigned int maxPending);
+
+    // Write a compressed block to the file.
+    void writeBlock(const std::string& block);
+
+    FILE* myFile;
+    bool myCloseFile;
+    int myLevel;
+    bool myFailed;
+    std::string myBuffer;
+    std::deque<std::future<std::string> > myPending;
+};
+
+#endif
@@ -0,0 +1,448 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//////////////////////////////////////////////////////////////////////////
+// This file contains the processing for the executable option "checksum"
+// which prints order-independent checksums of the records in a SAM/BAM
+// file.
+
+#include <string.h>
+#include "Checksum.h"
+#include "SamInputFile.h"
+#include "BgzfFileType.h"
+
+// Name of each field in the order of their Field bits.
+static const char* FIELD_NAMES[] = {"name", "flag", "pos", "cigar",
+                                    "seq", "qual"};
+static const int NUM_FIELDS = 6;
+
+// Seed for the tags, after the Field bits.
+static const uint64_t TAGS_SEED = 0x40;
+
+Checksum::Checksum()
+    : BamExecutable(),
+      myFields(ALL_FIELDS),
+      myTags(""),
+      myTagsString(""),
+      myCounts(),
+      mySums(),
+      myRefNameHashes()
+{
+}
+
+
+void Checksum::printChecksumDescription(std::ostream& os)
+{
+    os << " checksum - Print order-independent checksums of the records in a SAM/BAM file" << std::endl;
+}
+
+
+void Checksum::printDescription(std::ostream& os)
+{
+    printChecksumDescription(os);
+}
+
+
+void Checksum::printUsage(std::ostream& os)
+{
+    BamExecutable::printUsage(os);
+    os << "\t./bam checksum --in <inputFile> [--out <outputFile>] [--fields <field[,field]*>] [--tags <Tag:Type[,Tag:Type]*>] [--noeof] [--params] [--threads <numThreads>]" << std::endl;
+    os << "\tRequired Parameters:" << std::endl;
+    os << "\t\t--in      : the SAM/BAM file to checksum" << std::endl;
+    os << "\tOptional Parameters:" << std::endl;
+    os << "\t\t--out     : the file to write the checksums to (default: stdout)" << std::endl;
+    os << "\t\t--fields  : the record fields to checksum, any of:" << std::endl;
+    os << "\t\t            name,flag,pos,cigar,seq,qual (default: all of them)" << std::endl;
+    os << "\t\t--tags    : also checksum the specified Tags formatted as Tag:Type,Tag:Type,..." << std::endl;
+    os << "\t\t--noeof   : do not expect an EOF block on a bam file." << std::endl;
+    os << "\t\t--params  : print the parameter settings to stderr" << std::endl;
+    os << "\t\t--threads : number of threads for decompressing BAM input (default 0)" << std::endl;
+    os << "\tNotes:" << std::endl;
+    os << "\t\tThe checksum of each record is summed per reference & for the whole file, so" << std::endl;
+    os << "\t\tthe checksums do not depend on the order of the records.  The fields are" << std::endl;
+    os << "\t\tchecksummed in their BAM encoding, so lower case bases match upper case." << std::endl;
+    os << "\t\tPositions are checksummed with their reference name, so reordering the @SQ" << std::endl;
+    os << "\t\tlines does not change the checksums." << std::endl;
+    os << "\t\tReferences without records are not printed, '*' is the records without a reference." << std::endl;
+    os << std::endl;
+}
+
+
+int Checksum::execute(int argc, char **argv)
+{
+    // Extract command line arguments.
+    String inFile = "";
+    String outFile = "-";
+    String fields = "";
+    bool noeof = false;
+    bool params = false;
+
+    ParameterList inputParameters;
+    BEGIN_LONG_PARAMETERS(longParameterList)
+        LONG_PARAMETER_GROUP("Required Parameters")
+        LONG_STRINGPARAMETER("in", &inFile)
+        LONG_PARAMETER_GROUP("Optional Parameters")
+        LONG_STRINGPARAMETER("out", &outFile)
+        LONG_STRINGPARAMETER("fields", &fields)
+        LONG_STRINGPARAMETER("tags", &myTags)
+        LONG_PARAMETER("noeof", &noeof)
+        LONG_PARAMETER("params", &params)
+        LONG_BAM_IO_PARAMETERS()
+        LONG_PHONEHOME(VERSION)
+        END_LONG_PARAMETERS();
+   
+    inputParameters.Add(new LongParameters ("Input Parameters", 
+                                            longParameterList));
+
+    // parameters start at index 2 rather than 1.
+    inputParameters.Read(argc, argv, 2);
+
+    // If no eof block is required for a bgzf file, set the bgzf file type to 
+    // not look for it.
+    if(noeof)
+    {
+        // Set that the eof block is not required.
+        setRequireEofBlock(false);
+    }
+
+    // Check to see if the in file was specified, if not, report an error.
+    if(inFile == "")
+    {
+        printUsage(std::cerr);
+        inputParameters.Status();
+        // In file was not specified but it is mandatory.
+        std::cerr << "--in is a mandatory argument, "
+                  << "but was not specified" << std::endl;
+        return(-1);
+    }
+
+    if(!parseFields(fields))
+    {
+        printUsage(std::cerr);
+        inputParameters.Status();
+        std::cerr << "Invalid --fields: " << fields.c_str()
+                  << ", valid fields are name,flag,pos,cigar,seq,qual"
+                  << std::endl;
+        return(-1);
+    }
+
+    if(!processBamIoParameters())
+    {
+        inputParameters.Status();
+        return(-1);
+    }
+
+    if(params)
+    {
+        inputParameters.Status();
+    }
+
+    return(processFile(inFile.c_str(), outFile.c_str()));
+}
+
+
+uint64_t Checksum::hashBytes(const void* data, unsigned int length,
+                             uint64_t seed)
+{
+    // 64-bit MurmurHash2 (MurmurHash64A).
+    static const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    static const int r = 47;
+
+    uint64_t h = seed ^ (length * m);
+
+    const unsigned char* pos = (const unsigned char*)data;
+    const unsigned char* end = pos + (length & ~7);
+    while(pos != end)
+    {
+        uint64_t k;
+        memcpy(&k, pos, sizeof(uint64_t));
+        pos += sizeof(uint64_t);
+
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+
+        h ^= k;
+        h *= m;
+    }
+
+    // Remaining bytes.
+    unsigned int tail = length & 7;
+    if(tail != 0)
+    {
+        uint64_t k = 0;
+        for(unsigned int i = tail; i > 0; i--)
+        {
+            k = (k << 8) | pos[i - 1];
+        }
+        h ^= k;
+        h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return(h);
+}
+
+
+bool Checksum::parseFields(const String& fields)
+{
+    if(fields.IsEmpty())
+    {
+        myFields = ALL_FIELDS;
+        return(true);
+    }
+
+    myFields = 0;
+    std::string fieldList = fields.c_str();
+    size_t start = 0;
+    while(start <= fieldList.size())
+    {
+        size_t end = fieldList.find(',', start);
+        if(end == std::string::npos)
+        {
+            end = fieldList.size();
+        }
+        std::string field = fieldList.substr(start, end - start);
+        int i = 0;
+        for(; i < NUM_FIELDS; i++)
+        {
+            if(field == FIELD_NAMES[i])
+            {
+                myFields |= (1 << i);
+                break;
+            }
+        }
+        if(i == NUM_FIELDS)
+        {
+            return(false);
+        }
+        start = end + 1;
+    }
+    return(true);
+}
+
+
+bool Checksum::hashRecord(SamRecord& record, uint64_t& hash)
+{
+    const unsigned char* buf =
+        (const unsigned char*)record.getRecordBuffer(SamRecord::NONE);
+    if(buf == NULL)
+    {
+        return(false);
+    }
+
+    // Offsets of the fields in the BAM record, including the block size.
+    uint8_t readNameLen = buf[12];
+    uint16_t numCigar = 0;
+    int32_t readLen = 0;
+    memcpy(&numCigar, buf + 16, sizeof(uint16_t));
+    memcpy(&readLen, buf + 20, sizeof(int32_t));
+    const unsigned char* cigar = buf + 36 + readNameLen;
+    const unsigned char* seq = cigar + (numCigar * sizeof(uint32_t));
+    const unsigned char* qual = seq + ((readLen + 1) / 2);
+
+    // Seed each field with its bit so the fields are not interchangeable.
+    hash = 0;
+    if(myFields & NAME)
+    {
+        // Skip the null terminator.
+        unsigned int nameLen = (readNameLen > 0) ? readNameLen - 1 : 0;
+        hash = hashBytes(buf + 36, nameLen, hash ^ NAME);
+    }
+    if(myFields & FLAG)
+    {
+        hash = hashBytes(buf + 18, sizeof(uint16_t), hash ^ FLAG);
+    }
+    if(myFields & POS)
+    {
+        // Reference name & position.  Hash the name rather than the id so
+        // the checksum does not depend on the order of the @SQ lines.
+        int32_t refID = 0;
+        memcpy(&refID, buf + 4, sizeof(int32_t));
+        uint64_t refHash = 0;
+        if((refID >= -1) && (refID + 1 < (int32_t)myRefNameHashes.size()))
+        {
+            refHash = myRefNameHashes[refID + 1];
+        }
+        else
+        {
+            // Reference id that is not in the header, so it has no name.
+            refHash = hashBytes(buf + 4, sizeof(int32_t), 0);
+        }
+        hash = hashBytes(&refHash, sizeof(uint64_t), hash ^ POS);
+        hash = hashBytes(buf + 8, sizeof(int32_t), hash);
+    }
+    if(myFields & CIGAR)
+    {
+        hash = hashBytes(cigar, numCigar * sizeof(uint32_t), hash ^ CIGAR);
+    }
+    if(myFields & SEQ)
+    {
+        // The length distinguishes a trailing '=' (0) from padding, and
+        // the padding of an odd length is not hashed in case it was not
+        // zeroed.
+        hash = hashBytes(buf + 20, sizeof(int32_t), hash ^ SEQ);
+        hash = hashBytes(seq, readLen / 2, hash);
+        if(readLen & 1)
+        {
+            unsigned char lastBase = seq[readLen / 2] & 0xF0;
+            hash = hashBytes(&lastBase, 1, hash);
+        }
+    }
+    if(myFields & QUAL)
+    {
+        hash = hashBytes(qual, readLen, hash ^ QUAL);
+    }
+    if(!myTags.IsEmpty())
+    {
+        if(!record.getTagsString(myTags.c_str(), myTagsString, ';'))
+        {
+            return(false);
+        }
+        hash = hashBytes(myTagsString.c_str(), myTagsString.Length(),
+                         hash ^ TAGS_SEED);
+    }
+    return(true);
+}
+
+
+int Checksum::processFile(const char* inputFileName,
+                          const char* outputFileName)
+{
+    // Open the file for reading, BAM files are decompressed on the
+    // shared thread pool if --threads was specified.
+    SamInputFile samIn;
+    samIn.OpenForRead(inputFileName);
+
+    // Read the sam header.
+    SamFileHeader samHeader;
+    samIn.ReadHeader(samHeader);
+
+    int numRefs = samHeader.getReferenceInfo().getNumEntries();
+    myCounts.assign(numRefs + 1, 0);
+    mySums.assign(numRefs + 1, 0);
+    myRefNameHashes.assign(1, hashBytes("*", 1, 0));
+    for(int i = 0; i < numRefs; i++)
+    {
+        const String& refName = samHeader.getReferenceLabel(i);
+        myRefNameHashes.push_back(hashBytes(refName.c_str(),
+                                            refName.Length(), 0));
+    }
+
+    SamRecord samRecord;
+    uint64_t hash = 0;
+
+    // Keep reading records until ReadRecord returns false.
+    while(samIn.ReadRecord(samHeader, samRecord))
+    {
+        if(!hashRecord(samRecord, hash))
+        {
+            std::cerr << "Failed to checksum record "
+                      << samIn.GetCurrentRecordCount();
+            if(!myTags.IsEmpty())
+            {
+                std::cerr << ", check the --tags: " << myTags.c_str();
+            }
+            std::cerr << std::endl;
+            return(-1);
+        }
+
+        unsigned int index = samRecord.getReferenceID() + 1;
+        if(index >= myCounts.size())
+        {
+            // Reference id that is not in the header.
+            myCounts.resize(index + 1, 0);
+            mySums.resize(index + 1, 0);
+        }
+        ++myCounts[index];
+        mySums[index] += hash;
+    }
+
+    SamStatus::Status returnStatus = samIn.GetStatus();
+    if(returnStatus != SamStatus::NO_MORE_RECS)
+    {
+        std::cerr << "Failed reading " << inputFileName << ": "
+                  << samIn.GetStatusMessage() << std::endl;
+        return(returnStatus);
+    }
+
+    IFILE outFile = ifopen(outputFileName, "w");
+    if(outFile == NULL)
+    {
+        std::cerr << "Failed to open the output file: " << outputFileName
+                  << std::endl;
+        return(-1);
+    }
+
+    // Write the settings so stored checksums can be recomputed the same way.
+    ifprintf(outFile, "#Fields:");
+    const char* delim = " ";
+    for(int i = 0; i < NUM_FIELDS; i++)
+    {
+        if(myFields & (1 << i))
+        {
+            ifprintf(outFile, "%s%s", delim, FIELD_NAMES[i]);
+            delim = ",";
+        }
+    }
+    ifprintf(outFile, "\n");
+    if(!myTags.IsEmpty())
+    {
+        ifprintf(outFile, "#Tags: %s\n", myTags.c_str());
+    }
+    ifprintf(outFile, "#Reference\tRecords\tChecksum\n");
+
+    // Addition is commutative, so the whole file's checksum is the sum of
+    // the reference checksums.
+    uint64_t totalCount = 0;
+    uint64_t totalSum = 0;
+    for(unsigned int i = 1; i <= myCounts.size(); i++)
+    {
+        // Print the records without a reference last.
+        unsigned int index = i % myCounts.size();
+        totalCount += myCounts[index];
+        totalSum += mySums[index];
+        if(myCounts[index] == 0)
+        {
+            continue;
+        }
+        if(index == 0)
+        {
+            ifprintf(outFile, "*");
+        }
+        else if((int)index <= numRefs)
+        {
+            ifprintf(outFile, "%s",
+                     samHeader.getReferenceLabel(index - 1).c_str());
+        }
+        else
+        {
+            ifprintf(outFile, "%d", index - 1);
+        }
+        ifprintf(outFile, "\t%llu\t%016llx\n",
+                 (unsigned long long)myCounts[index],
+                 (unsigned long long)mySums[index]);
+    }
+    ifprintf(outFile, "ALL\t%llu\t%016llx\n",
+             (unsigned long long)totalCount,
+             (unsigned long long)totalSum);
+    ifclose(outFile);
+
+    return(SamStatus::SUCCESS);
+}
@@ -0,0 +1,89 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//////////////////////////////////////////////////////////////////////////
+// This file contains the processing for the executable option "checksum"
+// which prints order-independent checksums of the records in a SAM/BAM
+// file.
+
+#ifndef __CHECKSUM_H__
+#define __CHECKSUM_H__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "BamExecutable.h"
+
+/// Computes a 64-bit hash of the selected fields of each record and sums
+/// them per reference and for the whole file.  Addition is commutative,
+/// so the checksums do not depend on the order of the records, and two
+/// files with the same records (in any order) have the same checksums.
+/// The fields are hashed in their BAM encoding, so a SAM file and its BAM
+/// conversion also have the same checksums.  Positions are hashed with
+/// their reference name rather than id, so the order of the @SQ lines
+/// does not matter.
+class Checksum : public BamExecutable
+{
+public:
+    Checksum();
+
+    static void printChecksumDescription(std::ostream& os);
+    void printDescription(std::ostream& os);
+    void printUsage(std::ostream& os);
+    int execute(int argc, char **argv);
+    virtual const char* getProgramName() {return("bam:checksum");}
+
+    /// Fields that can be included in the checksum.
+    enum Field
+    {
+        NAME  = 0x01,
+        FLAG  = 0x02,
+        POS   = 0x04,
+        CIGAR = 0x08,
+        SEQ   = 0x10,
+        QUAL  = 0x20,
+        ALL_FIELDS = 0x3F
+    };
+
+    /// Return the 64-bit hash of the specified bytes, starting from seed.
+    static uint64_t hashBytes(const void* data, unsigned int length,
+                              uint64_t seed);
+
+private:
+    // Set myFields from a comma separated list of field names, returning
+    // false if any are invalid.
+    bool parseFields(const String& fields);
+
+    // Set hash to the hash of the selected fields of the record, returning
+    // false if the fields or tags could not be read.
+    bool hashRecord(SamRecord& record, uint64_t& hash);
+
+    int processFile(const char* inputFileName, const char* outputFileName);
+
+    int myFields;
+    String myTags;
+    String myTagsString;
+
+    // Record counts & checksums indexed by reference id + 1, so the
+    // records without a reference (id -1) are first.
+    std::vector<uint64_t> myCounts;
+    std::vector<uint64_t> mySums;
+    // Hash of each reference name, indexed by reference id + 1 ("*" first).
+    std::vector<uint64_t> myRefNameHashes;
+};
+
+#endif
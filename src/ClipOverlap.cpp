@@ -19,9 +19,15 @@
 //////////////////////////////////////////////////////////////////////////
 // This file contains the processing for the executable option "clipOverlap"
 // which clips overlapping read pairs.
+#include <stdio.h>
+#include <algorithm>
+#include <sstream>
+#include <thread>
 #include "ClipOverlap.h"
 #include "SamFile.h"
 #include "BgzfFileType.h"
+#include "ThreadPool.h"
+#include "SamInputFile.h"
 #include "CigarHelper.h"
 #include "SamFlag.h"
 #include "SamHelper.h"
@@ -29,6 +35,11 @@
 
 ClipOverlap::ClipOverlap()
     : BamExecutable(),
+      myInFile(""),
+      myOutFile(""),
+      myReadName(false),
+      myNoRNValidate(false),
+      myPoolSize(DEFAULT_POOL_SIZE),
       myOverlapHandler(NULL),
       myPool(),
       myOverlapsOnly(false),
@@ -38,11 +49,28 @@ ClipOverlap::ClipOverlap()
       myNumPoolFailNoHandle(0),
       myNumPoolFailHandled(0),
       myNumOutOfOrder(0),
-      myPoolSkipOverlap(false)
+      myPoolSkipOverlap(false),
+      myMateStats(false),
+      mySpill(false),
+      myTmpPrefix(""),
+      myNumSpilled(0),
+      myReadNameBatches(),
+      myReadNameBatch(NULL),
+      myFreeRecords()
 {
 }
 
 
+ClipOverlap::~ClipOverlap()
+{
+    if(myOverlapHandler != NULL)
+    {
+        delete myOverlapHandler;
+        myOverlapHandler = NULL;
+    }
+}
+
+
 void ClipOverlap::printClipOverlapDescription(std::ostream& os)
 {
     os << " clipOverlap - Clip overlapping read pairs in a SAM/BAM File already sorted by Coordinate or ReadName" << std::endl;
@@ -58,7 +86,7 @@ void ClipOverlap::printDescription(std::ostream& os)
 void ClipOverlap::printUsage(std::ostream& os)
 {
     BamExecutable::printUsage(os);
-    os << "\t./bam clipOverlap --in <inputFile> --out <outputFile> [--storeOrig <tag>] [--readName] [--noRNValidate] [--stats] [--overlapsOnly] [--excludeFlags <flag>] [--poolSize <numRecords allowed to allocate>] [--poolSkipOverlap] [--noeof] [--params]" << std::endl;
+    os << "\t./bam clipOverlap --in <inputFile> --out <outputFile> [--storeOrig <tag>] [--readName] [--noRNValidate] [--stats] [--overlapsOnly] [--excludeFlags <flag>] [--poolSize <numRecords allowed to allocate>] [--poolSkipOverlap] [--spill] [--tmpPrefix <prefix>] [--mateStats] [--noeof] [--params] [--threads <numThreads>] [--level <0-9>]" << std::endl;
     os << "\tRequired Parameters:" << std::endl;
     os << "\t\t--in           : the SAM/BAM file to clip overlaping read pairs for" << std::endl;
     os << "\t\t--out          : the SAM/BAM file to be written" << std::endl;
@@ -72,26 +100,112 @@ void ClipOverlap::printUsage(std::ostream& os)
     os << "\t\t--unmapped     : Mark records that would be completely clipped as unmapped" << std::endl;
     os << "\t\t--noeof        : Do not expect an EOF block on a bam file." << std::endl;
     os << "\t\t--params       : Print the parameter settings to stderr" << std::endl;
+    os << "\t\t--threads      : number of threads for compressing BAM output (default 0)." << std::endl;
+    os << "\t\t                 With 2 or more, each reference of a coordinate sorted BAM with an" << std::endl;
+    os << "\t\t                 index is clipped on its own thread (splitting poolSize between them)" << std::endl;
+    os << "\t\t                 into a temporary file (<tmpPrefix>.part<N>.ubam)." << std::endl;
+    os << "\t\t--level        : BAM compression level, 0 (uncompressed BGZF) to 9 (default -1: zlib default)" << std::endl;
     os << "\tClipping By Coordinate Optional Parameters:" << std::endl;
     os << "\t\t--poolSize     : Maximum number of records the program is allowed to allocate" << std::endl;
     os << "\t\t                 for clipping on Coordinate sorted files. (Default: " << DEFAULT_POOL_SIZE << ")" << std::endl;
     os << "\t\t--poolSkipClip : Skip clipping reads to free of usable records when the" << std::endl;
     os << "\t\t                 poolSize is hit. The default action is to just clip the" << std::endl;
     os << "\t\t                 first read in a pair to free up the record." << std::endl;
+    os << "\t\t--spill        : When poolSize is hit, write the records waiting to be output" << std::endl;
+    os << "\t\t                 to temporary files instead of handling the first read in a" << std::endl;
+    os << "\t\t                 pair without waiting for its mate." << std::endl;
+    os << "\t\t--tmpPrefix    : Prefix of the --spill & --threads temporary files (Default: the output file)" << std::endl;
+    os << "\t\t--mateStats    : Print the occupancy & collision statistics of the mate map" << std::endl;
+    os << "\t\t                 used to pair the reads." << std::endl;
     os << std::endl;
 }
 
 
 int ClipOverlap::execute(int argc, char **argv)
+{
+    int status = readParameters(argc, argv);
+    if(status != 0)
+    {
+        return(status);
+    }
+
+    // Open the files & read/write the sam header.  The partitions are each
+    // read by a worker, so the input is only opened if not partitioning.
+    bool partition = canPartition();
+    SamInputFile samIn;
+    if(!partition)
+    {
+        if(myReadName)
+        {
+            if(!myNoRNValidate)
+            {
+                samIn.setSortedValidation(SamFile::QUERY_NAME);
+            }
+        }
+        else
+        {
+            samIn.setSortedValidation(SamFile::COORDINATE);
+        }
+        samIn.OpenForRead(myInFile, &mySamHeader);
+    }
+
+    SamFile samOut;
+    if(!openForWrite(samOut, myOutFile, &mySamHeader))
+    {
+        std::cerr << "Failed to open the output file: "
+                  << myOutFile.c_str() << std::endl;
+        return(-1);
+    }
+    SamFileSink samOutSink(samOut);
+
+    SamStatus::Status runStatus;
+    if(partition)
+    {
+        runStatus = processPartitions(samOutSink);
+    }
+    else
+    {
+        runStatus = processSteps(samIn, samOutSink);
+    }
+
+    samIn.Close();
+    samOut.Close();
+    return(printSummary(runStatus));
+}
+
+
+int ClipOverlap::initStage(int argc, char** argv)
+{
+    return(readParameters(argc, argv));
+}
+
+
+bool ClipOverlap::stageRewindsInput()
+{
+    return((myOverlapHandler != NULL) && (myOverlapHandler->numSteps() > 1));
+}
+
+
+int ClipOverlap::runStage(SamFileHeader& header, SamRecordSource& samIn,
+                          SamRecordSink& samOut)
+{
+    mySamHeader = header;
+    return(printSummary(processSteps(samIn, samOut)));
+}
+
+
+int ClipOverlap::readParameters(int argc, char** argv)
 {
     // Extract command line arguments.
-    String inFile = "";
-    String outFile = "";
+    myInFile = "";
+    myOutFile = "";
     String storeOrig = "";
-    bool readName = false;
-    bool noRNValidate = false;
+    myReadName = false;
+    myNoRNValidate = false;
     bool stats = false;
-    int poolSize = DEFAULT_POOL_SIZE;
+    myPoolSize = DEFAULT_POOL_SIZE;
+    mySpill = false;
+    myTmpPrefix = "";
     bool unmapped = false;
     bool noeof = false;
     bool params = false;
@@ -101,21 +215,25 @@ int ClipOverlap::execute(int argc, char **argv)
     ParameterList inputParameters;
     BEGIN_LONG_PARAMETERS(longParameterList)
         LONG_PARAMETER_GROUP("Required Parameters")
-        LONG_STRINGPARAMETER("in", &inFile)
-        LONG_STRINGPARAMETER("out", &outFile)
+        LONG_STRINGPARAMETER("in", &myInFile)
+        LONG_STRINGPARAMETER("out", &myOutFile)
         LONG_PARAMETER_GROUP("Optional Parameters")
         LONG_STRINGPARAMETER("storeOrig", &storeOrig)
-        LONG_PARAMETER("readName", &readName)
-        LONG_PARAMETER ("noRNValidate", &noRNValidate)
+        LONG_PARAMETER("readName", &myReadName)
+        LONG_PARAMETER ("noRNValidate", &myNoRNValidate)
         LONG_PARAMETER ("stats", &stats)
         LONG_PARAMETER ("overlapsOnly", &myOverlapsOnly)
         LONG_STRINGPARAMETER ("excludeFlags", &excludeFlags)
         LONG_PARAMETER("unmapped", &unmapped)
         LONG_PARAMETER("noeof", &noeof)
         LONG_PARAMETER("params", &params)
+        LONG_BAM_OUTPUT_PARAMETERS()
         LONG_PARAMETER_GROUP("Coordinate Processing Optional Parameters")
-        LONG_INTPARAMETER("poolSize", &poolSize)
+        LONG_INTPARAMETER("poolSize", &myPoolSize)
         LONG_PARAMETER("poolSkipOverlap", &myPoolSkipOverlap)
+        LONG_PARAMETER("spill", &mySpill)
+        LONG_STRINGPARAMETER("tmpPrefix", &myTmpPrefix)
+        LONG_PARAMETER("mateStats", &myMateStats)
         LONG_PHONEHOME(VERSION)
         BEGIN_LEGACY_PARAMETERS()
         LONG_PARAMETER ("clipsOnly", &myOverlapsOnly)
@@ -133,11 +251,11 @@ int ClipOverlap::execute(int argc, char **argv)
     if(noeof)
     {
         // Set that the eof block is not required.
-        BgzfFileType::setRequireEofBlock(false);
+        setRequireEofBlock(false);
     }
 
     // Check to see if the in file was specified, if not, report an error.
-    if(inFile == "")
+    if(myInFile == "")
     {
         printUsage(std::cerr);
         inputParameters.Status();
@@ -148,7 +266,7 @@ int ClipOverlap::execute(int argc, char **argv)
     }
 
     // Check to see if the out file was specified, if not, report an error.
-    if(outFile == "")
+    if(myOutFile == "")
     {
         printUsage(std::cerr);
         inputParameters.Status();
@@ -189,39 +307,68 @@ int ClipOverlap::execute(int argc, char **argv)
 
     myIntExcludeFlags = excludeFlags.AsInteger();
 
+    if(!processBamIoParameters())
+    {
+        inputParameters.Status();
+        return(-1);
+    }
+
     if(params)
     {
         inputParameters.Status();
     }
 
-    // For each step process the file.
-    // Open the files & read/write the sam header.
+    if(myTmpPrefix.IsEmpty())
+    {
+        myTmpPrefix = myOutFile;
+        if(myTmpPrefix[0] == '-')
+        {
+            myTmpPrefix = "clipOverlap";
+        }
+    }
+    return(0);
+}
+
+
+SamStatus::Status ClipOverlap::processSteps(SamRecordSource& samIn,
+                                            SamRecordSink& samOut)
+{
+    // For each step process the records, rereading them for each
+    // subsequent step.
     SamStatus::Status runStatus = SamStatus::SUCCESS;
     for(int i = 1; i <= myOverlapHandler->numSteps(); i++)
     {
-        // Open the file for reading.
-        mySamHeader.resetHeader();
-        SamFile samIn(inFile, SamFile::READ, &mySamHeader);
-        SamFile* samOutPtr = NULL;
-        // Check if writing, if so, open the output file.
+        if((i > 1) && !samIn.Rewind())
+        {
+            std::cerr << "Failed to reread the records: "
+                      << samIn.GetStatusMessage() << std::endl;
+            runStatus = SamStatus::FAIL_IO;
+            break;
+        }
+        SamRecordSink* samOutPtr = NULL;
+        // Check if writing, if so, write to the output.
         if(i == myOverlapHandler->numSteps())
         {
-            samOutPtr = new SamFile(outFile, SamFile::WRITE, &mySamHeader);
+            samOutPtr = &samOut;
         }
 
-        if(readName)
+        if(myReadName)
         {
-            if(!noRNValidate)
+            ThreadPool* pool = ThreadPool::getSharedPool();
+            if(pool != NULL)
             {
-                samIn.setSortedValidation(SamFile::QUERY_NAME);
+                runStatus = handleSortedByReadNameBatches(samIn, samOutPtr,
+                                                          *pool);
+            }
+            else
+            {
+                runStatus = handleSortedByReadName(samIn, samOutPtr);
             }
-            runStatus = handleSortedByReadName(samIn, samOutPtr);
         }
         else
         {
             // Coordinate sorted, so work with the pools.
-            samIn.setSortedValidation(SamFile::COORDINATE);
-            myPool.setMaxAllocatedRecs(poolSize);
+            myPool.setMaxAllocatedRecs(myPoolSize);
 
             // Reset the number of failures
             myNumMateFailures = 0;
@@ -229,13 +376,18 @@ int ClipOverlap::execute(int argc, char **argv)
             myNumPoolFailNoHandle = 0;
             myNumPoolFailHandled = 0;
             myNumOutOfOrder = 0;
+            myNumSpilled = 0;
 
             // Run by coordinate
             if(samOutPtr != NULL)
             {
                 // Setup the output buffer for writing.
-                SamCoordOutput outputBuffer(myPool);
-                outputBuffer.setOutputFile(samOutPtr, &mySamHeader);
+                SamCoordSink outputBuffer(myPool);
+                outputBuffer.setOutput(samOutPtr, &mySamHeader);
+                if(mySpill)
+                {
+                    outputBuffer.enableSpill(myTmpPrefix.c_str());
+                }
                 runStatus = handleSortedByCoord(samIn, &outputBuffer);
 
                 // Cleanup the output buffer.
@@ -244,6 +396,7 @@ int ClipOverlap::execute(int argc, char **argv)
                     std::cerr << "ERROR: Failed to flush the output buffer\n";
                     runStatus = SamStatus::FAIL_IO;
                 }
+                myNumSpilled = outputBuffer.getNumSpilled();
             }
             else
             {
@@ -255,18 +408,13 @@ int ClipOverlap::execute(int argc, char **argv)
         {
             break;
         }
-        // Close the input file, it will be reopened if there are 
-        // multiple steps.
-        samIn.Close();
-        if(samOutPtr != NULL)
-        {
-            samOutPtr->Close();
-            delete samOutPtr;
-            samOutPtr = NULL;
-        }
     }
+    return(runStatus);
+}
 
-    // Done processing.
+
+int ClipOverlap::printSummary(SamStatus::Status runStatus)
+{
     // Print Stats
     myOverlapHandler->printStats();
 
@@ -275,6 +423,12 @@ int ClipOverlap::execute(int argc, char **argv)
         std::cerr << "WARNING: did not find expected overlapping mates for "
                   << myNumMateFailures << " records." << std::endl;
     }
+    if(myNumSpilled != 0)
+    {
+        std::cerr << "Due to hitting the max record poolSize, wrote "
+                  << myNumSpilled << " records to temporary files."
+                  << std::endl;
+    }
     if(myNumPoolFail != 0)
     {
         // Had to skip clipping some records due to running out of
@@ -318,8 +472,290 @@ int ClipOverlap::execute(int argc, char **argv)
 }
 
 
-SamStatus::Status ClipOverlap::handleSortedByReadName(SamFile& samIn, 
-                                                      SamFile* samOutPtr)
+bool ClipOverlap::canPartition()
+{
+    // Partitions need multiple threads, a single step, and an index.
+    // The mate map stats are only printed for a single mate map.
+    if(myReadName || (myNumThreads < 2) || myMateStats ||
+       (myOverlapHandler->numSteps() != 1) || (myInFile == "-"))
+    {
+        return(false);
+    }
+    // Reads the header for the partitions.
+    SamInputFile samIn(ErrorHandler::RETURN);
+    return(samIn.OpenForRead(myInFile, &mySamHeader) && samIn.ReadBamIndex());
+}
+
+
+SamStatus::Status ClipOverlap::processPartitions(SamRecordSink& samOut)
+{
+    myNumMateFailures = 0;
+    myNumPoolFail = 0;
+    myNumPoolFailNoHandle = 0;
+    myNumPoolFailHandled = 0;
+    myNumOutOfOrder = 0;
+    myNumSpilled = 0;
+
+    // A partition per reference, followed by the unmapped reads that
+    // do not have a reference.  Overlapping mates are always on the same
+    // reference, so no pair is split across partitions.
+    PartitionList list;
+    list.next = 0;
+    list.copied = 0;
+    list.stop = false;
+    int32_t numRefs = mySamHeader.getReferenceInfo().getNumEntries();
+    for(int32_t i = 0; i <= numRefs; i++)
+    {
+        Partition partition;
+        partition.refID = (i == numRefs) ? -1 : i;
+        std::stringstream fileName;
+        fileName << myTmpPrefix << ".part" << i + 1 << ".ubam";
+        partition.fileName = fileName.str();
+        partition.handler = myOverlapHandler->clone();
+        partition.done = false;
+        partition.status = SamStatus::SUCCESS;
+        list.partitions.push_back(partition);
+    }
+
+    int numWorkers = std::min(myNumThreads, (int)list.partitions.size());
+    list.maxAhead = numWorkers;
+    std::vector<ClipOverlap*> workers;
+    std::vector<std::thread> threads;
+    for(int i = 0; i < numWorkers; i++)
+    {
+        workers.push_back(new ClipOverlap());
+        workers.back()->initPartitionWorker(*this, numWorkers);
+        threads.push_back(std::thread(&ClipOverlap::clipPartitions,
+                                      workers.back(), std::ref(list)));
+    }
+
+    // Copy each partition to the output once it is done.
+    SamStatus::Status runStatus = SamStatus::SUCCESS;
+    SamRecord record;
+    for(size_t i = 0; i < list.partitions.size(); i++)
+    {
+        Partition& partition = list.partitions[i];
+        {
+            std::unique_lock<std::mutex> lock(list.mutex);
+            while(!partition.done)
+            {
+                list.doneCond.wait(lock);
+            }
+        }
+        if(partition.status != SamStatus::SUCCESS)
+        {
+            runStatus = partition.status;
+            break;
+        }
+        myOverlapHandler->mergeStats(*(partition.handler));
+
+        SamFile partIn(ErrorHandler::RETURN);
+        SamFileHeader partHeader;
+        if(!partIn.OpenForRead(partition.fileName.c_str(), &partHeader))
+        {
+            std::cerr << "Failed to open the temporary file: "
+                      << partition.fileName << ": "
+                      << partIn.GetStatusMessage() << std::endl;
+            runStatus = SamStatus::FAIL_IO;
+            break;
+        }
+        while(partIn.ReadRecord(partHeader, record))
+        {
+            if(!samOut.WriteRecord(mySamHeader, record))
+            {
+                // Failed to write a record.
+                fprintf(stderr, "%s\n", samOut.GetStatusMessage());
+                runStatus = samOut.GetStatus();
+                break;
+            }
+        }
+        if((runStatus == SamStatus::SUCCESS) &&
+           (partIn.GetStatus() != SamStatus::NO_MORE_RECS))
+        {
+            std::cerr << "Failed to read the temporary file: "
+                      << partition.fileName << ": "
+                      << partIn.GetStatusMessage() << std::endl;
+            runStatus = partIn.GetStatus();
+        }
+        partIn.Close();
+        remove(partition.fileName.c_str());
+        if(runStatus != SamStatus::SUCCESS)
+        {
+            break;
+        }
+        {
+            // Let the workers start the next partition.
+            std::lock_guard<std::mutex> lock(list.mutex);
+            list.copied = i + 1;
+        }
+        list.copiedCond.notify_all();
+    }
+
+    if(runStatus != SamStatus::SUCCESS)
+    {
+        // Stop the workers from starting more partitions.
+        {
+            std::lock_guard<std::mutex> lock(list.mutex);
+            list.stop = true;
+        }
+        list.copiedCond.notify_all();
+    }
+    for(int i = 0; i < numWorkers; i++)
+    {
+        threads[i].join();
+        mergePartitionWorker(*(workers[i]));
+        delete workers[i];
+    }
+    for(size_t i = 0; i < list.partitions.size(); i++)
+    {
+        remove(list.partitions[i].fileName.c_str());
+        delete list.partitions[i].handler;
+    }
+    return(runStatus);
+}
+
+
+void ClipOverlap::initPartitionWorker(const ClipOverlap& parent,
+                                      int numWorkers)
+{
+    myInFile = parent.myInFile;
+    myOutFile = parent.myOutFile;
+    myReadName = false;
+    // The workers split the pool, but each needs enough records to pair
+    // the reads without constantly hitting the limit.
+    myPoolSize = parent.myPoolSize;
+    if(myPoolSize > 0)
+    {
+        myPoolSize = std::max(myPoolSize / numWorkers,
+                              std::min(myPoolSize, MIN_WORKER_POOL_SIZE));
+    }
+    mySamHeader = parent.mySamHeader;
+    // Each partition provides its own overlap handler.
+    myOverlapHandler = NULL;
+    myOverlapsOnly = parent.myOverlapsOnly;
+    myIntExcludeFlags = parent.myIntExcludeFlags;
+    myPoolSkipOverlap = parent.myPoolSkipOverlap;
+    myMateStats = false;
+    mySpill = parent.mySpill;
+    myTmpPrefix = parent.myTmpPrefix;
+}
+
+
+void ClipOverlap::clipPartitions(PartitionList& list)
+{
+    // Each worker reads the input with its own file & index.
+    SamInputFile samIn(ErrorHandler::RETURN);
+    samIn.setSortedValidation(SamFile::COORDINATE);
+    bool opened = (samIn.OpenForRead(myInFile, &mySamHeader) &&
+                   samIn.ReadBamIndex());
+    if(!opened)
+    {
+        std::cerr << "Failed to open " << myInFile << " & its index: "
+                  << samIn.GetStatusMessage() << std::endl;
+    }
+    myPool.setMaxAllocatedRecs(myPoolSize);
+
+    while(true)
+    {
+        Partition* partition = NULL;
+        {
+            // Wait for the output to catch up rather than fill the disk
+            // with clipped partitions that cannot be copied yet.
+            std::unique_lock<std::mutex> lock(list.mutex);
+            while(!list.stop && (list.next < list.partitions.size()) &&
+                  (list.next >= list.copied + list.maxAhead))
+            {
+                list.copiedCond.wait(lock);
+            }
+            if(list.stop || (list.next == list.partitions.size()))
+            {
+                break;
+            }
+            partition = &(list.partitions[list.next++]);
+        }
+
+        SamStatus::Status status = SamStatus::FAIL_IO;
+        if(opened)
+        {
+            try
+            {
+                status = clipPartition(samIn, *partition);
+            }
+            catch(std::exception& e)
+            {
+                std::cerr << "ERROR: " << e.what() << std::endl;
+                status = SamStatus::FAIL_IO;
+                // The handler belongs to the partition.
+                myOverlapHandler = NULL;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(list.mutex);
+            partition->status = status;
+            partition->done = true;
+        }
+        list.doneCond.notify_all();
+    }
+}
+
+
+SamStatus::Status ClipOverlap::clipPartition(SamInputFile& samIn,
+                                             const Partition& partition)
+{
+    if(!samIn.SetReadSection(partition.refID))
+    {
+        std::cerr << "Failed to read reference " << partition.refID
+                  << " from the index: " << samIn.GetStatusMessage()
+                  << std::endl;
+        return(samIn.GetStatus());
+    }
+
+    SamFile partOut(ErrorHandler::RETURN);
+    if(!partOut.OpenForWrite(partition.fileName.c_str(), &mySamHeader))
+    {
+        std::cerr << "Failed to open the temporary file: "
+                  << partition.fileName << ": "
+                  << partOut.GetStatusMessage() << std::endl;
+        return(SamStatus::FAIL_IO);
+    }
+    SamFileSink partSink(partOut);
+
+    SamCoordSink outputBuffer(myPool);
+    outputBuffer.setOutput(&partSink, &mySamHeader);
+    if(mySpill)
+    {
+        outputBuffer.enableSpill(partition.fileName.c_str());
+    }
+    myOverlapHandler = partition.handler;
+    SamStatus::Status status = handleSortedByCoord(samIn, &outputBuffer);
+
+    // Cleanup the output buffer.
+    if(!outputBuffer.flushAll())
+    {
+        std::cerr << "ERROR: Failed to flush the output buffer\n";
+        status = SamStatus::FAIL_IO;
+    }
+    myNumSpilled += outputBuffer.getNumSpilled();
+    myOverlapHandler = NULL;
+    partOut.Close();
+    return(status);
+}
+
+
+void ClipOverlap::mergePartitionWorker(const ClipOverlap& worker)
+{
+    myNumMateFailures += worker.myNumMateFailures;
+    myNumPoolFail += worker.myNumPoolFail;
+    myNumPoolFailNoHandle += worker.myNumPoolFailNoHandle;
+    myNumPoolFailHandled += worker.myNumPoolFailHandled;
+    myNumOutOfOrder += worker.myNumOutOfOrder;
+    myNumSpilled += worker.myNumSpilled;
+}
+
+
+SamStatus::Status ClipOverlap::handleSortedByReadName(SamRecordSource& samIn, 
+                                                      SamRecordSink* samOutPtr)
 {
     // Set returnStatus to success.  It will be changed
     // to the failure reason if any of the writes fail.
@@ -394,39 +830,10 @@ SamStatus::Status ClipOverlap::handleSortedByReadName(SamFile& samIn,
         if(strcmp(samRecord->getReadName(), 
                   prevSamRecord->getReadName()) == 0)
         {
-            bool overlap = false;
             // Same Read Name, so check clipping.
-            OverlapHandler::OverlapInfo prevClipInfo = 
-                myOverlapHandler->getOverlapInfo(*prevSamRecord);
-            OverlapHandler::OverlapInfo curClipInfo = 
-                myOverlapHandler->getOverlapInfo(*samRecord);
-            
-            // If either indicate a complete clipping, clip both.
-            if((prevClipInfo == OverlapHandler::NO_OVERLAP_WRONG_ORIENT) ||
-               (curClipInfo == OverlapHandler::NO_OVERLAP_WRONG_ORIENT))
-            {
-                overlap = true;
-                myOverlapHandler->handleNoOverlapWrongOrientation(*prevSamRecord);
-                // Don't update stats since this is the 2nd in the pair
-                myOverlapHandler->handleNoOverlapWrongOrientation(*samRecord, 
-                                                                  false);
-            }
-            else if((prevClipInfo == OverlapHandler::OVERLAP) ||
-                    (prevClipInfo == OverlapHandler::SAME_START))
-            {
-                // The previous read starts at or before the current one.
-                overlap = true;
-                myOverlapHandler->handleOverlapPair(*prevSamRecord,
-                                                    *samRecord);
-            }
-            else if(curClipInfo == OverlapHandler::OVERLAP)
-            {
-                // The current read starts before the previous one.
-                overlap = true;
-                myOverlapHandler->handleOverlapPair(*samRecord,
-                                                    *prevSamRecord);
-            }
-            
+            bool overlap = clipReadNamePair(*myOverlapHandler,
+                                            *prevSamRecord, *samRecord);
+
             // Found a read pair, so write both records if: 
             //   1) output file is specified
             //   AND
@@ -503,8 +910,225 @@ SamStatus::Status ClipOverlap::handleSortedByReadName(SamFile& samIn,
 }
 
 
-SamStatus::Status ClipOverlap::handleSortedByCoord(SamFile& samIn, 
-                                                   SamCoordOutput* outputBufferPtr)
+bool ClipOverlap::clipReadNamePair(OverlapHandler& handler,
+                                   SamRecord& prevRecord, SamRecord& record)
+{
+    bool overlap = false;
+    OverlapHandler::OverlapInfo prevClipInfo = 
+        handler.getOverlapInfo(prevRecord);
+    OverlapHandler::OverlapInfo curClipInfo = 
+        handler.getOverlapInfo(record);
+
+    // If either indicate a complete clipping, clip both.
+    if((prevClipInfo == OverlapHandler::NO_OVERLAP_WRONG_ORIENT) ||
+       (curClipInfo == OverlapHandler::NO_OVERLAP_WRONG_ORIENT))
+    {
+        overlap = true;
+        handler.handleNoOverlapWrongOrientation(prevRecord);
+        // Don't update stats since this is the 2nd in the pair
+        handler.handleNoOverlapWrongOrientation(record, false);
+    }
+    else if((prevClipInfo == OverlapHandler::OVERLAP) ||
+            (prevClipInfo == OverlapHandler::SAME_START))
+    {
+        // The previous read starts at or before the current one.
+        overlap = true;
+        handler.handleOverlapPair(prevRecord, record);
+    }
+    else if(curClipInfo == OverlapHandler::OVERLAP)
+    {
+        // The current read starts before the previous one.
+        overlap = true;
+        handler.handleOverlapPair(record, prevRecord);
+    }
+    return(overlap);
+}
+
+
+SamStatus::Status ClipOverlap::handleSortedByReadNameBatches(SamRecordSource& samIn,
+                                                             SamRecordSink* samOutPtr,
+                                                             ThreadPool& pool)
+{
+    // Set returnStatus to success.  It will be changed
+    // to the failure reason if any of the writes fail.
+    SamStatus::Status returnStatus = SamStatus::SUCCESS;
+
+    // Pair up the records the same way as handleSortedByReadName, but
+    // add them to the batch rather than clipping & writing them.
+    SamRecord* prevSamRecord = NULL;
+    SamRecord* samRecord = new SamRecord;
+    while(samIn.ReadRecord(mySamHeader, *samRecord))
+    {
+        int16_t flag = samRecord->getFlag();
+        if((flag & myIntExcludeFlags) != 0)
+        {
+            // This read should not be checked for overlaps, but write
+            // the previous record first if it has a different read name.
+            if((prevSamRecord != NULL) &&
+               (strcmp(samRecord->getReadName(), 
+                       prevSamRecord->getReadName()) != 0))
+            {
+                addReadNameItem(prevSamRecord, NULL, pool, samOutPtr,
+                                returnStatus);
+                prevSamRecord = NULL;
+            }
+            addReadNameItem(samRecord, NULL, pool, samOutPtr, returnStatus);
+        }
+        else if(prevSamRecord == NULL)
+        {
+            // Nothing to compare this record to yet.
+            prevSamRecord = samRecord;
+        }
+        else if(strcmp(samRecord->getReadName(), 
+                       prevSamRecord->getReadName()) == 0)
+        {
+            // Same Read Name, so clip the pair.
+            addReadNameItem(prevSamRecord, samRecord, pool, samOutPtr,
+                            returnStatus);
+            prevSamRecord = NULL;
+        }
+        else
+        {
+            // Read name does not match, so write the previous record
+            // & store this record as the previous.
+            addReadNameItem(prevSamRecord, NULL, pool, samOutPtr,
+                            returnStatus);
+            prevSamRecord = samRecord;
+        }
+
+        // Get a record to read into.
+        if(myFreeRecords.empty())
+        {
+            samRecord = new SamRecord;
+        }
+        else
+        {
+            samRecord = myFreeRecords.back();
+            myFreeRecords.pop_back();
+        }
+    }
+
+    // Write the previous record if there is one & the remaining batches.
+    if(prevSamRecord != NULL)
+    {
+        addReadNameItem(prevSamRecord, NULL, pool, samOutPtr, returnStatus);
+    }
+    if(myReadNameBatch != NULL)
+    {
+        submitReadNameBatch(pool);
+    }
+    while(!myReadNameBatches.empty())
+    {
+        writeReadNameBatch(samOutPtr, returnStatus);
+    }
+
+    delete samRecord;
+    for(unsigned int i = 0; i < myFreeRecords.size(); i++)
+    {
+        delete myFreeRecords[i];
+    }
+    myFreeRecords.clear();
+
+    if(samIn.GetStatus() != SamStatus::NO_MORE_RECS)
+    {
+        return(samIn.GetStatus());
+    }
+    return(returnStatus);
+}
+
+
+void ClipOverlap::addReadNameItem(SamRecord* first, SamRecord* second,
+                                  ThreadPool& pool, SamRecordSink* samOutPtr,
+                                  SamStatus::Status& returnStatus)
+{
+    if(myReadNameBatch == NULL)
+    {
+        myReadNameBatch = new ReadNameBatch();
+        myReadNameBatch->numRecords = 0;
+        myReadNameBatch->handler = myOverlapHandler->clone();
+    }
+    ReadNameItem item = {first, second, false};
+    myReadNameBatch->items.push_back(item);
+    myReadNameBatch->numRecords += (second == NULL) ? 1 : 2;
+
+    if(myReadNameBatch->numRecords >= READ_NAME_BATCH_SIZE)
+    {
+        submitReadNameBatch(pool);
+        // Limit the number of records waiting to be clipped/written.
+        while(myReadNameBatches.size() >
+              (unsigned int)(2 * pool.getNumThreads()))
+        {
+            writeReadNameBatch(samOutPtr, returnStatus);
+        }
+    }
+}
+
+
+void ClipOverlap::submitReadNameBatch(ThreadPool& pool)
+{
+    ReadNameBatch* batch = myReadNameBatch;
+    batch->done = pool.submit([batch]()
+        {
+            for(unsigned int i = 0; i < batch->items.size(); i++)
+            {
+                ReadNameItem& item = batch->items[i];
+                if(item.second != NULL)
+                {
+                    item.overlap = clipReadNamePair(*(batch->handler),
+                                                    *(item.first),
+                                                    *(item.second));
+                }
+            }
+        });
+    myReadNameBatches.push_back(batch);
+    myReadNameBatch = NULL;
+}
+
+
+void ClipOverlap::writeReadNameBatch(SamRecordSink* samOutPtr,
+                                     SamStatus::Status& returnStatus)
+{
+    ReadNameBatch* batch = myReadNameBatches.front();
+    myReadNameBatches.pop_front();
+    batch->done.get();
+
+    for(unsigned int i = 0; i < batch->items.size(); i++)
+    {
+        ReadNameItem& item = batch->items[i];
+        // Write single records if all records should be written, and
+        // pairs if all records should be written or the pair overlaps.
+        if((samOutPtr != NULL) && (!myOverlapsOnly || item.overlap))
+        {
+            if(!samOutPtr->WriteRecord(mySamHeader, *(item.first)))
+            {
+                // Failed to write a record.
+                fprintf(stderr, "%s\n", samOutPtr->GetStatusMessage());
+                returnStatus = samOutPtr->GetStatus();
+            }
+            if((item.second != NULL) &&
+               !samOutPtr->WriteRecord(mySamHeader, *(item.second)))
+            {
+                // Failed to write a record.
+                fprintf(stderr, "%s\n", samOutPtr->GetStatusMessage());
+                returnStatus = samOutPtr->GetStatus();
+            }
+        }
+        myFreeRecords.push_back(item.first);
+        if(item.second != NULL)
+        {
+            myFreeRecords.push_back(item.second);
+        }
+    }
+
+    // Merge the stats in the original order of the records.
+    myOverlapHandler->mergeStats(*(batch->handler));
+    delete batch->handler;
+    delete batch;
+}
+
+
+SamStatus::Status ClipOverlap::handleSortedByCoord(SamRecordSource& samIn, 
+                                                   SamCoordSink* outputBufferPtr)
 {
     MateMapByCoord mateMap;
 
@@ -656,6 +1280,11 @@ SamStatus::Status ClipOverlap::handleSortedByCoord(SamFile& samIn,
     // The calling method will cleanup the output buffer.
     cleanupMateMap(mateMap, outputBufferPtr);
 
+    if(myMateStats)
+    {
+        mateMap.printStats(std::cerr);
+    }
+
     if(returnStatus != SamStatus::NO_MORE_RECS)
     {
         // Failure.
@@ -669,15 +1298,30 @@ SamStatus::Status ClipOverlap::handleSortedByCoord(SamFile& samIn,
 ///////////////////////////////////////////////////////////////////
 // Methods to handle Coordinate Specific Clipping Operations.
 
-SamStatus::Status ClipOverlap::readCoordRecord(SamFile& samIn,
+SamStatus::Status ClipOverlap::readCoordRecord(SamRecordSource& samIn,
                                                SamRecord** recordPtr, 
                                                MateMapByCoord& mateMap,
-                                               SamCoordOutput* outputBufferPtr)
+                                               SamCoordSink* outputBufferPtr)
 {
     // Null pointer, so get a new pointer.
     if(*recordPtr == NULL)
     {
         *recordPtr = myPool.getRecord();
+        if((*recordPtr == NULL) && mySpill && (outputBufferPtr != NULL) &&
+           (outputBufferPtr->size() != 0) &&
+           (outputBufferPtr->size() >= (uint32_t)myPoolSize / 4))
+        {
+            // Failed to allocate a new record, but enough of the records
+            // are just waiting to be output that moving them to a
+            // temporary file frees the pool without giving up on waiting
+            // for a mate.
+            if(!outputBufferPtr->spill())
+            {
+                std::cerr << "Failed to spill the output buffer.\n";
+                return(SamStatus::FAIL_IO);
+            }
+            *recordPtr = myPool.getRecord();
+        }
         if(*recordPtr == NULL)
         {
             // Failed to allocate a new record.
@@ -715,7 +1359,7 @@ SamStatus::Status ClipOverlap::readCoordRecord(SamFile& samIn,
 // Methods to handle flushing records from the mate map and/or
 // the output buffer.
 bool ClipOverlap::forceRecordFlush(MateMapByCoord& mateMap,
-                                   SamCoordOutput* outputBufferPtr)
+                                   SamCoordSink* outputBufferPtr)
 {
     // The previous standard flush did not free up any records, so pop
     // the first record off of the mate map if there is one and process
@@ -779,7 +1423,7 @@ bool ClipOverlap::forceRecordFlush(MateMapByCoord& mateMap,
 
 
 bool ClipOverlap::flushOutputBuffer(MateMapByCoord& mateMap,
-                                    SamCoordOutput& outputBuffer,
+                                    SamCoordSink& outputBuffer,
                                     int32_t prevChrom,
                                     int32_t prevPos)
 {
@@ -798,7 +1442,7 @@ bool ClipOverlap::flushOutputBuffer(MateMapByCoord& mateMap,
 }
 
 void ClipOverlap::cleanupMateMap(MateMapByCoord& mateMap,
-                                 SamCoordOutput* outputBufferPtr,
+                                 SamCoordSink* outputBufferPtr,
                                  int32_t chrom, int32_t position)
 {
     // Cleanup any reads in the mateMap whose mates are prior to the position
@@ -22,16 +22,26 @@
 #ifndef __CLIP_OVERLAP_H__
 #define __CLIP_OVERLAP_H__
 
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
 #include "BamExecutable.h"
 #include "SamFile.h"
 #include "MateMapByCoord.h"
-#include "SamCoordOutput.h"
+#include "SamRecordStream.h"
 #include "OverlapHandler.h"
 
+class SamInputFile;
+class ThreadPool;
+
 class ClipOverlap : public BamExecutable
 {
 public:
     ClipOverlap();
+    ~ClipOverlap();
 
     static void printClipOverlapDescription(std::ostream& os);
     void printDescription(std::ostream& os);
@@ -39,46 +49,175 @@ public:
     int execute(int argc, char **argv);
     virtual const char* getProgramName() {return("bam:clipOverlap");}
 
+    bool stageRewindsInput();
+    int runStage(SamFileHeader& header, SamRecordSource& samIn,
+                 SamRecordSink& samOut);
+
+protected:
+    int initStage(int argc, char** argv);
+
 private:
     static const int DEFAULT_POOL_SIZE = 1000000;
+    // The fewest records a partition worker's share of --poolSize may be.
+    static const int MIN_WORKER_POOL_SIZE = 1000;
+
+    // Read & validate the parameters.  Returns 0 on success.
+    int readParameters(int argc, char** argv);
+
+    // Run each step of the overlap handler on the records, writing
+    // them to the output in the last step.
+    SamStatus::Status processSteps(SamRecordSource& samIn,
+                                   SamRecordSink& samOut);
+
+    // Print the stats/warnings and return the exit status.
+    int printSummary(SamStatus::Status runStatus);
+
+    ///////////////////////////////////////////////////////////////////
+    // Methods to clip each reference of an indexed BAM on its own thread.
+
+    // A reference (or the unmapped reads) clipped by a worker thread
+    // into a temporary file that is then copied to the output.
+    struct Partition
+    {
+        int32_t refID;
+        std::string fileName;
+        // Each partition has its own handler so the stats can be
+        // merged in the order of the references.
+        OverlapHandler* handler;
+        bool done;
+        SamStatus::Status status;
+    };
+
+    // Partitions shared by the worker threads.
+    struct PartitionList
+    {
+        std::vector<Partition> partitions;
+        size_t next;
+        // Number of partitions copied to the output.  Workers only start
+        // partitions before copied + maxAhead, so at most maxAhead
+        // partitions wait in temporary files.
+        size_t copied;
+        size_t maxAhead;
+        bool stop;
+        std::mutex mutex;
+        std::condition_variable doneCond;
+        std::condition_variable copiedCond;
+    };
+
+    // Return whether or not the input is an indexed BAM that can be
+    // clipped by reference on --threads (at least 2) worker threads,
+    // reading its header if so.
+    bool canPartition();
+
+    // Clip the references on worker threads, copying the results to the
+    // output in order as they complete.
+    SamStatus::Status processPartitions(SamRecordSink& samOut);
+
+    // Setup this object as a worker with the settings of the parent &
+    // its share of the parent's pool.
+    void initPartitionWorker(const ClipOverlap& parent, int numWorkers);
+
+    // Clip partitions until there are none left, run on a worker thread.
+    void clipPartitions(PartitionList& list);
 
-    SamStatus::Status handleSortedByReadName(SamFile& samIn,
-                                             SamFile* outFile);
+    // Clip the records of a single partition into its temporary file.
+    SamStatus::Status clipPartition(SamInputFile& samIn,
+                                    const Partition& partition);
 
-    SamStatus::Status handleSortedByCoord(SamFile& samIn,
-                                          SamCoordOutput* outputBufferPtr);
+    // Add the counts of the worker to this object's.
+    void mergePartitionWorker(const ClipOverlap& worker);
+
+    SamStatus::Status handleSortedByReadName(SamRecordSource& samIn,
+                                             SamRecordSink* outFile);
+
+    ///////////////////////////////////////////////////////////////////
+    // Methods to clip read name sorted records in batches on the pool.
+
+    // Number of records in each batch clipped on the thread pool.
+    static const unsigned int READ_NAME_BATCH_SIZE = 4096;
+
+    // Records to write in order.  If second is set, the records are
+    // mates to clip, and overlap is set once they have been clipped.
+    struct ReadNameItem
+    {
+        SamRecord* first;
+        SamRecord* second;
+        bool overlap;
+    };
+
+    // A batch of records clipped by a task on the thread pool with its
+    // own handler, so the stats can be merged in the order of the batches.
+    struct ReadNameBatch
+    {
+        std::vector<ReadNameItem> items;
+        unsigned int numRecords;
+        OverlapHandler* handler;
+        std::future<void> done;
+    };
+
+    // Same as handleSortedByReadName, but the pairs are clipped by
+    // tasks on the thread pool while the records are read & written.
+    SamStatus::Status handleSortedByReadNameBatches(SamRecordSource& samIn,
+                                                    SamRecordSink* outFile,
+                                                    ThreadPool& pool);
+
+    // Add a record or a pair to the batch, submitting it to the pool
+    // & writing the completed batches if it is full.
+    void addReadNameItem(SamRecord* first, SamRecord* second,
+                         ThreadPool& pool, SamRecordSink* samOutPtr,
+                         SamStatus::Status& returnStatus);
+
+    // Submit the current batch to the pool & start a new one.
+    void submitReadNameBatch(ThreadPool& pool);
+
+    // Wait for the oldest batch to be clipped and write its records.
+    void writeReadNameBatch(SamRecordSink* samOutPtr,
+                            SamStatus::Status& returnStatus);
+
+    // Clip the mates using the handler, returning whether or not
+    // the pair overlaps (or has the wrong orientation).
+    static bool clipReadNamePair(OverlapHandler& handler,
+                                 SamRecord& prevRecord, SamRecord& record);
+
+    SamStatus::Status handleSortedByCoord(SamRecordSource& samIn,
+                                          SamCoordSink* outputBufferPtr);
     
     ///////////////////////////////////////////////////////////////////
     // Methods to handle Coordinate Specific Processing.
     
     // Helper method to get a record ptr if needed and read the record.
     // returns success or the failure reason.
-    SamStatus::Status readCoordRecord(SamFile& samIn,
+    SamStatus::Status readCoordRecord(SamRecordSource& samIn,
                                       SamRecord** recordPtr,
                                       MateMapByCoord& mateMap, 
-                                      SamCoordOutput* outputBufferPtr);
+                                      SamCoordSink* outputBufferPtr);
 
     // Flush the first record from the mate map if there is one and flush the output buffer
     // up to and including that position (if there was nothing in the mateMap, flush everything).
     bool forceRecordFlush(MateMapByCoord& mateMap, 
-                          SamCoordOutput* outputBufferPtr);
+                          SamCoordSink* outputBufferPtr);
 
     // Flush up to the first record in the mate map, or if it is empty,
     // flush up to and including the specified position.
     bool flushOutputBuffer(MateMapByCoord& mateMap,
-                           SamCoordOutput& outputBuffer,
+                           SamCoordSink& outputBuffer,
                            int32_t prevChrom,
                            int32_t prevPos);
 
     // Cleanup the mate map up to the specified record. 
     // If chrom is -1, empty the entire mateMap.
     void cleanupMateMap(MateMapByCoord& mateMap,
-                        SamCoordOutput* outputBufferPtr,
+                        SamCoordSink* outputBufferPtr,
                         int32_t chrom = -1, int32_t position = -1);
 
     ///////////////////////////////////////////////////////////////////
     // Private Member Data
 
+    String myInFile;
+    String myOutFile;
+    bool myReadName;
+    bool myNoRNValidate;
+    int myPoolSize;
     SamFileHeader mySamHeader;
     OverlapHandler* myOverlapHandler;
     SamRecordPool myPool; // used just for coord reads.
@@ -91,6 +230,15 @@ private:
     uint32_t myNumPoolFailHandled;
     uint32_t myNumOutOfOrder;
     bool myPoolSkipOverlap;
+    bool myMateStats;
+    bool mySpill;
+    String myTmpPrefix;
+    uint64_t myNumSpilled;
+
+    // Read name batches being clipped, oldest first, & the one being filled.
+    std::deque<ReadNameBatch*> myReadNameBatches;
+    ReadNameBatch* myReadNameBatch;
+    std::vector<SamRecord*> myFreeRecords;
 };
 
 #endif
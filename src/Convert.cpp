@@ -41,7 +41,7 @@ void Convert::printDescription(std::ostream& os)
 void Convert::printUsage(std::ostream& os)
 {
     BamExecutable::printUsage(os);
-    os << "\t./bam convert --in <inputFile> --out <outputFile.sam/bam/ubam (ubam is uncompressed bam)> [--refFile <reference filename>] [--useBases|--useEquals|--useOrigSeq] [--lshift] [--noeof] [--params]" << std::endl;
+    os << "\t./bam convert --in <inputFile> --out <outputFile.sam/bam/ubam (ubam is uncompressed bam)> [--refFile <reference filename>] [--useBases|--useEquals|--useOrigSeq] [--lshift] [--noeof] [--params] [--threads <numThreads>] [--level <0-9>]" << std::endl;
     os << "\tRequired Parameters:" << std::endl;
     os << "\t\t--in         : the SAM/BAM file to be read" << std::endl;
     os << "\t\t--out        : the SAM/BAM file to be written" << std::endl;
@@ -51,6 +51,10 @@ void Convert::printUsage(std::ostream& os)
     os << "\t\t--noeof      : do not expect an EOF block on a bam file" << std::endl;
     os << "\t\t--params     : print the parameter settings" << std::endl;
     os << "\t\t--recover    : attempt error recovery while reading a bam file" << std::endl;
+    os << "\t\t--threads    : number of threads to use for compressing a BAM output file" << std::endl;
+    os << "\t\t               (default 0: compress on the main thread)" << std::endl;
+    os << "\t\t--level      : deflate level for a BAM output file, 0 (uncompressed BGZF) to 9" << std::endl;
+    os << "\t\t               (default -1: the zlib default level)" << std::endl;
     os << "\tOptional Sequence Parameters (only specify one):" << std::endl;
     os << "\t\t--useOrigSeq : Leave the sequence as is (default & used if reference is not specified)" << std::endl;
     os << "\t\t--useBases   : Convert any '=' in the sequence to the appropriate base using the reference (requires --refFile)" << std::endl;
@@ -106,6 +110,7 @@ int Convert::execute(int argc, char **argv)
         LONG_PARAMETER("noeof", &noeof)
         LONG_PARAMETER("recover", &recover)
         LONG_PARAMETER("params", &params)
+        LONG_BAM_OUTPUT_PARAMETERS()
         LONG_PARAMETER_GROUP("SequenceConversion")
             EXCLUSIVE_PARAMETER("useBases", &useBases)
             EXCLUSIVE_PARAMETER("useEquals", &useEquals)
@@ -124,7 +129,7 @@ int Convert::execute(int argc, char **argv)
     if(noeof)
     {
         // Set that the eof block is not required.
-        BgzfFileType::setRequireEofBlock(false);
+        setRequireEofBlock(false);
     }
     
     // Check to see if the in file was specified, if not, report an error.
@@ -148,6 +153,12 @@ int Convert::execute(int argc, char **argv)
         return(-1);
     }
 
+    if(!processBamIoParameters())
+    {
+        inputParameters.Status();
+        return(-1);
+    }
+
     // Check to see if the ref file was specified.
     // Open the reference.
     GenomeSequence* refPtr = NULL;
@@ -183,7 +194,7 @@ int Convert::execute(int argc, char **argv)
 
     // Open the output file for writing.
     SamFile samOut;
-    samOut.OpenForWrite(outFile);
+    openForWrite(samOut, outFile);
     samOut.SetWriteSequenceTranslation(translation);
     samOut.SetReference(refPtr);
 
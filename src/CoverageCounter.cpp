@@ -0,0 +1,366 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <algorithm>
+#include "CoverageCounter.h"
+#include "SamFlag.h"
+
+CoverageCounter::CoverageCounter()
+    : myHeader(NULL),
+      myOutput(NULL),
+      myThresholds(),
+      myMinMapQual(0),
+      mySectionRefID(-1),
+      mySectionStart(0),
+      mySectionEnd(0),
+      myLastPosition(0),
+      myTargets(),
+      myFirstTarget(0),
+      myDifferences(),
+      myFirstDifference(0),
+      myWindowStart(0),
+      myDepth(0),
+      myDepths(),
+      myReferenceID(-1),
+      myHistogram()
+{
+}
+
+
+void CoverageCounter::init(SamFileHeader& header, IFILE output,
+                           const std::vector<int>& thresholds, int minMapQual)
+{
+    myHeader = &header;
+    myOutput = output;
+    myThresholds = thresholds;
+    myMinMapQual = minMapQual;
+    myReferenceID = -1;
+    myHistogram.clear();
+
+    ifprintf(myOutput, "chrom\tchromStart\tchromEnd\tMeanDepth");
+    for(unsigned int i = 0; i < myThresholds.size(); i++)
+    {
+        ifprintf(myOutput, "\tBreadth>=%d(%%)", myThresholds[i]);
+    }
+    ifprintf(myOutput, "\n");
+}
+
+
+void CoverageCounter::startSection(int32_t refID, int32_t start, int32_t end)
+{
+    if(end == -1)
+    {
+        end = myHeader->getReferenceInfo().getReferenceLength(refID);
+    }
+    mySectionRefID = refID;
+    mySectionStart = start;
+    mySectionEnd = end;
+    myLastPosition = start;
+    myTargets.clear();
+    myFirstTarget = 0;
+    myDifferences.clear();
+    myFirstDifference = 0;
+    myWindowStart = start;
+    myDepth = 0;
+}
+
+
+void CoverageCounter::addTarget(int32_t start, int32_t end)
+{
+    Target target;
+    target.start = std::max(start, mySectionStart);
+    target.end = mySectionEnd;
+    if((end != -1) && (end < mySectionEnd))
+    {
+        target.end = end;
+    }
+    target.depthSum = 0;
+    target.numCovered.resize(myThresholds.size(), 0);
+    myTargets.push_back(target);
+}
+
+
+bool CoverageCounter::addRecord(SamRecord& record)
+{
+    int32_t position = record.get0BasedPosition();
+    if(position < myLastPosition)
+    {
+        if(position >= mySectionStart)
+        {
+            // Not sorted.
+            return(false);
+        }
+        // Starts before the section, so overlaps its start.
+        position = mySectionStart;
+    }
+    myLastPosition = position;
+
+    uint16_t flag = record.getFlag();
+    if(SamFlag::isDuplicate(flag) || SamFlag::isQCFailure(flag) ||
+       !SamFlag::isMapped(flag) || (record.getMapQuality() == 255) ||
+       (record.getMapQuality() < myMinMapQual))
+    {
+        return(true);
+    }
+
+    // The records are sorted, so the depth before this record is final.
+    if(position - myWindowStart >= WINDOW_SIZE)
+    {
+        flush(position);
+    }
+
+    Cigar* cigar = record.getCigarInfo();
+    if(cigar == NULL)
+    {
+        return(true);
+    }
+    int32_t refPos = record.get0BasedPosition();
+    for(int i = 0; i < cigar->size(); i++)
+    {
+        const Cigar::CigarOperator& op = (*cigar)[i];
+        if(!Cigar::foundInReference(op.operation))
+        {
+            continue;
+        }
+        int32_t blockEnd = refPos + op.count;
+        if(Cigar::foundInQuery(op.operation))
+        {
+            // Aligned block, clipped to the section.
+            int32_t start = std::max(refPos, mySectionStart);
+            int32_t end = std::min(blockEnd, mySectionEnd);
+            if(start < end)
+            {
+                addDifference(start, 1);
+                addDifference(end, -1);
+            }
+        }
+        refPos = blockEnd;
+    }
+    return(true);
+}
+
+
+void CoverageCounter::endSection()
+{
+    flush(mySectionEnd);
+
+    const char* refName =
+        myHeader->getReferenceLabel(mySectionRefID).c_str();
+    for(unsigned int i = 0; i < myTargets.size(); i++)
+    {
+        const Target& target = myTargets[i];
+        double length = target.end - target.start;
+        if(length < 1)
+        {
+            length = 1;
+        }
+        ifprintf(myOutput, "%s\t%d\t%d\t%.3f", refName, target.start,
+                 target.end, target.depthSum / length);
+        for(unsigned int j = 0; j < myThresholds.size(); j++)
+        {
+            ifprintf(myOutput, "\t%.3f",
+                     100 * target.numCovered[j] / length);
+        }
+        ifprintf(myOutput, "\n");
+    }
+    myTargets.clear();
+    myDifferences.clear();
+    myFirstDifference = 0;
+    mySectionRefID = -1;
+}
+
+
+bool CoverageCounter::addReferenceRecord(SamRecord& record)
+{
+    int32_t refID = record.getReferenceID();
+    if((refID < 0) ||
+       (refID >= myHeader->getReferenceInfo().getNumEntries()))
+    {
+        // Unmapped records are at the end of the file.
+        return(true);
+    }
+    if(refID < myReferenceID)
+    {
+        return(false);
+    }
+    advanceReference(refID);
+    return(addRecord(record));
+}
+
+
+void CoverageCounter::endReferences()
+{
+    advanceReference(myHeader->getReferenceInfo().getNumEntries());
+}
+
+
+void CoverageCounter::printHistogram()
+{
+    ifprintf(myOutput, "\nDepth\tBases\n");
+    for(unsigned int i = 0; i < myHistogram.size(); i++)
+    {
+        ifprintf(myOutput, "%u\t%llu\n", i,
+                 (unsigned long long)myHistogram[i]);
+    }
+}
+
+
+bool CoverageCounter::parseThresholds(const char* list,
+                                      std::vector<int>& thresholds)
+{
+    thresholds.clear();
+    const char* pos = list;
+    while(*pos != '\0')
+    {
+        char* end = NULL;
+        long threshold = strtol(pos, &end, 10);
+        if((end == pos) || (threshold < 1) || (threshold > 0x7FFFFFFF) ||
+           (!thresholds.empty() && (threshold <= thresholds.back())))
+        {
+            return(false);
+        }
+        thresholds.push_back(threshold);
+        if(*end == ',')
+        {
+            ++end;
+        }
+        else if(*end != '\0')
+        {
+            return(false);
+        }
+        pos = end;
+    }
+    return(true);
+}
+
+
+void CoverageCounter::addDifference(int32_t position, int32_t difference)
+{
+    unsigned int offset = position - myWindowStart + myFirstDifference;
+    if(offset >= myDifferences.size())
+    {
+        myDifferences.resize(offset + 1, 0);
+    }
+    myDifferences[offset] += difference;
+}
+
+
+void CoverageCounter::flush(int32_t position)
+{
+    position = std::min(position, mySectionEnd);
+    while(myWindowStart < position)
+    {
+        int32_t length = std::min(position - myWindowStart, WINDOW_SIZE);
+
+        // Prefix sum the differences into depths.  There are no
+        // differences past the end of the array, so the depth stays the
+        // same.
+        int32_t numDifferences =
+            std::min(length, (int32_t)(myDifferences.size() -
+                                       myFirstDifference));
+        myDepths.resize(length);
+        const int32_t* differences = myDifferences.data() + myFirstDifference;
+        for(int32_t i = 0; i < numDifferences; i++)
+        {
+            myDepth += differences[i];
+            myDepths[i] = myDepth;
+        }
+        std::fill(myDepths.begin() + numDifferences, myDepths.end(),
+                  myDepth);
+
+        // Skip the used differences rather than shifting the rest down
+        // every window, only moving them once they are half the array.
+        myFirstDifference += numDifferences;
+        if(myFirstDifference == myDifferences.size())
+        {
+            myDifferences.clear();
+            myFirstDifference = 0;
+        }
+        else if(myFirstDifference >= myDifferences.size() / 2)
+        {
+            myDifferences.erase(myDifferences.begin(),
+                                myDifferences.begin() + myFirstDifference);
+            myFirstDifference = 0;
+        }
+
+        countDepths(myWindowStart, length);
+        myWindowStart += length;
+    }
+}
+
+
+void CoverageCounter::countDepths(int32_t start, int32_t length)
+{
+    int32_t end = start + length;
+    // The targets are sorted by start, so skip past the ones that have
+    // ended.
+    while((myFirstTarget < myTargets.size()) &&
+          (myTargets[myFirstTarget].end <= start))
+    {
+        ++myFirstTarget;
+    }
+    // Targets may overlap, so the histogram only counts the positions
+    // past those already counted by the earlier targets.
+    int32_t counted = start;
+    for(unsigned int t = myFirstTarget;
+        (t < myTargets.size()) && (myTargets[t].start < end); t++)
+    {
+        Target& target = myTargets[t];
+        int32_t from = std::max(target.start, start);
+        int32_t to = std::min(target.end, end);
+        for(int32_t pos = from; pos < to; pos++)
+        {
+            uint32_t depth = myDepths[pos - start];
+            target.depthSum += depth;
+            for(unsigned int i = 0; (i < myThresholds.size()) &&
+                    (depth >= (uint32_t)myThresholds[i]); i++)
+            {
+                ++target.numCovered[i];
+            }
+        }
+        for(int32_t pos = std::max(from, counted); pos < to; pos++)
+        {
+            uint32_t depth = myDepths[pos - start];
+            if(depth >= myHistogram.size())
+            {
+                myHistogram.resize(depth + 1, 0);
+            }
+            ++myHistogram[depth];
+        }
+        counted = std::max(counted, to);
+    }
+}
+
+
+void CoverageCounter::advanceReference(int32_t refID)
+{
+    int32_t numRefs = myHeader->getReferenceInfo().getNumEntries();
+    while(myReferenceID < refID)
+    {
+        if(myReferenceID >= 0)
+        {
+            endSection();
+        }
+        ++myReferenceID;
+        if(myReferenceID < numRefs)
+        {
+            startSection(myReferenceID, 0, -1);
+            addTarget(0, -1);
+        }
+    }
+}
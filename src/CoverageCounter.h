@@ -0,0 +1,133 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//////////////////////////////////////////////////////////////////////////
+// Depth & coverage summaries of coordinate sorted records, calculated
+// from the start & end of each aligned block rather than a pileup.
+
+#ifndef __COVERAGE_COUNTER_H__
+#define __COVERAGE_COUNTER_H__
+
+#include <stdint.h>
+#include <vector>
+#include "SamFile.h"
+
+/// Calculates the depth of sections of the references.  Each aligned
+/// (match/mismatch) block of a record adds +1 at its start & -1 at its end
+/// to an array of depth differences that is prefix summed a window at a
+/// time once the records have moved past it.  Each target (a region or
+/// whole reference) of a section is reported with its mean depth & the
+/// percent of its bases covered to each threshold, and the depth of every
+/// base in a target is added once to a depth histogram, even if the base
+/// is in several targets.
+///
+/// A record's bases are included in the depth as counted for the baseQC
+/// Depth: duplicates, QC failures, unmapped records, and records with a
+/// mapping quality of 255 or less than the minimum are skipped.
+class CoverageCounter
+{
+public:
+    CoverageCounter();
+
+    /// Setup the counter to write the depth of the references in the
+    /// header to output, writing the header line.  The thresholds must be
+    /// in increasing order.
+    void init(SamFileHeader& header, IFILE output,
+              const std::vector<int>& thresholds, int minMapQual);
+
+    /// Start counting the depth of the section of the reference from
+    /// start to end (-1 for the end of the reference).
+    void startSection(int32_t refID, int32_t start, int32_t end);
+
+    /// Add a target of the current section to report.  The targets must be
+    /// added in order of their start.
+    void addTarget(int32_t start, int32_t end);
+
+    /// Add the aligned bases of the record to the current section.  Returns
+    /// false if the record is before the previous record.
+    bool addRecord(SamRecord& record);
+
+    /// Finish the section, writing the depth of each of its targets.
+    void endSection();
+
+    /// Add the record to the depth of whole references, moving to the
+    /// record's reference if it is later than the current one.  Returns
+    /// false if the record is not in coordinate order.
+    bool addReferenceRecord(SamRecord& record);
+
+    /// Finish the whole references, writing the references after the
+    /// last record.
+    void endReferences();
+
+    /// Write the depth histogram.
+    void printHistogram();
+
+    /// Parse a comma separated list of increasing depth thresholds.
+    static bool parseThresholds(const char* list, std::vector<int>& thresholds);
+
+private:
+    // Part of a section to report.
+    struct Target
+    {
+        int32_t start;
+        int32_t end;
+        uint64_t depthSum;
+        std::vector<uint64_t> numCovered;
+    };
+
+    // Number of positions converted from differences to depths at a time.
+    static const int32_t WINDOW_SIZE = 0x10000;
+
+    // Add a depth difference, growing the array if needed.
+    void addDifference(int32_t position, int32_t difference);
+
+    // Calculate the depth of the section up to position.
+    void flush(int32_t position);
+
+    // Add the depths of the window starting at start to the targets.
+    void countDepths(int32_t start, int32_t length);
+
+    // Move the whole reference counting to the reference.
+    void advanceReference(int32_t refID);
+
+    SamFileHeader* myHeader;
+    IFILE myOutput;
+    std::vector<int> myThresholds;
+    int myMinMapQual;
+
+    int32_t mySectionRefID;
+    int32_t mySectionStart;
+    int32_t mySectionEnd;
+    int32_t myLastPosition;
+    std::vector<Target> myTargets;
+    unsigned int myFirstTarget;
+
+    // Depth differences for positions starting at myWindowStart, which is
+    // at index myFirstDifference.
+    std::vector<int32_t> myDifferences;
+    unsigned int myFirstDifference;
+    int32_t myWindowStart;
+    int32_t myDepth;
+    std::vector<uint32_t> myDepths;
+
+    // Reference currently being counted in whole.
+    int32_t myReferenceID;
+
+    std::vector<uint64_t> myHistogram;
+};
+
+#endif
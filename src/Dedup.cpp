@@ -27,6 +27,7 @@
 #include "SamHelper.h"
 #include "SamStatus.h"
 #include "BgzfFileType.h"
+#include "SamInputFile.h"
 
 const int Dedup::DEFAULT_MIN_QUAL = 15;
 const uint32_t Dedup::CLIP_OFFSET = 1000;
@@ -75,7 +76,7 @@ void Dedup::printDescription(std::ostream& os)
 
 void Dedup::printUsage(std::ostream& os)
 {
-    os << "Usage: ./bam dedup --in <InputBamFile> --out <OutputBamFile> [--minQual <minPhred>] [--log <logFile>] [--oneChrom] [--rmDups] [--force] [--excludeFlags <flag>] [--verbose] [--noeof] [--params] [--recab] ";
+    os << "Usage: ./bam dedup --in <InputBamFile> --out <OutputBamFile> [--minQual <minPhred>] [--log <logFile>] [--oneChrom] [--rmDups] [--force] [--excludeFlags <flag>] [--verbose] [--noeof] [--params] [--threads <numThreads>] [--level <0-9>] [--recab] ";
     myRecab.printRecabSpecificUsageLine(os);
     os << std::endl << std::endl;
     os << "Required parameters :" << std::endl;
@@ -95,43 +96,123 @@ void Dedup::printUsage(std::ostream& os)
     os << "\t--verbose       : Turn on verbose mode" << std::endl;
     os << "\t--noeof         : Do not expect an EOF block on a bam file." << std::endl;
     os << "\t--params        : Print the parameter settings" << std::endl;
+    os << "\t--threads       : number of threads for compressing BAM output (default 0)" << std::endl;
+    os << "\t--level         : BAM compression level, 0 (uncompressed BGZF) to 9 (default -1: zlib default)" << std::endl;
     os << "\t--recab         : Recalibrate in addition to deduping" << std::endl;
     myRecab.printRecabSpecificUsage(os);
     os<< "\n" << std::endl;
 }
 
 int Dedup::execute(int argc, char** argv) 
+{
+    int status = readParameters(argc, argv);
+    if(status != 0)
+    {
+        return(status);
+    }
+
+    Logger::gLogger = new Logger(myLogFile.c_str(), myVerboseFlag);
+
+    /* -------------------------------------------------------------------
+     * The arguments are processed.  Prepare the input BAM file,
+     * instantiate dedup, and construct the read group library map
+     * ------------------------------------------------------------------*/
+
+    SamInputFile samIn;
+
+    // If the file isn't sorted it will throw an exception.
+    samIn.setSortedValidation(SamFile::COORDINATE);
+    samIn.OpenForRead(myInFile.c_str());
+
+    SamFileHeader header;
+    samIn.ReadHeader(header);
+
+    status = findDuplicates(header, samIn);
+    if(status != 0)
+    {
+        return(status);
+    }
+
+    // get ready to write the output file by making a second pass
+    // through the input file
+    samIn.Rewind();
+
+    SamFile samOut;
+    openForWrite(samOut, myOutFile.c_str());
+    samOut.WriteHeader(header);
+
+    SamFileSink samOutSink(samOut);
+    markDuplicates(header, samIn, samOutSink);
+
+    // We're done.  Close the files.
+    samIn.Close();
+    samOut.Close();
+    return 0;
+}
+
+
+int Dedup::initStage(int argc, char** argv)
+{
+    int status = readParameters(argc, argv);
+    if(status == 0)
+    {
+        Logger::gLogger = new Logger(myLogFile.c_str(), myVerboseFlag);
+    }
+    return(status);
+}
+
+
+int Dedup::runStage(SamFileHeader& header, SamRecordSource& samIn,
+                    SamRecordSink& samOut)
+{
+    int status = findDuplicates(header, samIn);
+    if(status != 0)
+    {
+        return(status);
+    }
+    if(!samIn.Rewind())
+    {
+        Logger::gLogger->error("Failed to reread the records of %s",
+                               myInFile.c_str());
+        return(-1);
+    }
+    markDuplicates(header, samIn, samOut);
+    return(0);
+}
+
+
+int Dedup::readParameters(int argc, char** argv)
 {
     /* --------------------------------
      * process the arguments
      * -------------------------------*/
-    String inFile, outFile, logFile;
     myDoRecab = false;
-    bool removeFlag = false;
-    bool verboseFlag = false;
+    myRemoveFlag = false;
+    myVerboseFlag = false;
     myForceFlag = false;
     myNumMissingMate = 0;
     myMinQual = DEFAULT_MIN_QUAL;
     String excludeFlags = "0xB04";
-    uint16_t intExcludeFlags = 0;
+    myIntExcludeFlags = 0;
     bool noeof = false;
     bool params = false;
 
     LongParamContainer parameters;
     parameters.addGroup("Required Parameters");
-    parameters.addString("in", &inFile);
-    parameters.addString("out", &outFile);
+    parameters.addString("in", &myInFile);
+    parameters.addString("out", &myOutFile);
     parameters.addGroup("Optional Parameters");
     parameters.addInt("minQual", & myMinQual);
-    parameters.addString("log", &logFile);
+    parameters.addString("log", &myLogFile);
     parameters.addBool("oneChrom", &myOneChrom);
     parameters.addBool("recab", &myDoRecab);
-    parameters.addBool("rmDups", &removeFlag);
+    parameters.addBool("rmDups", &myRemoveFlag);
     parameters.addBool("force", &myForceFlag);
     parameters.addString("excludeFlags", &excludeFlags);
-    parameters.addBool("verbose", &verboseFlag);
+    parameters.addBool("verbose", &myVerboseFlag);
     parameters.addBool("noeof", &noeof);
     parameters.addBool("params", &params);
+    addBamOutputParameters(parameters);
     parameters.addPhoneHome(VERSION);
     myRecab.addRecabSpecificParameters(parameters);
 
@@ -147,10 +228,10 @@ int Dedup::execute(int argc, char** argv)
     if(noeof)
     {
         // Set that the eof block is not required.
-        BgzfFileType::setRequireEofBlock(false);
+        setRequireEofBlock(false);
     }
 
-    if(inFile.IsEmpty())
+    if(myInFile.IsEmpty())
     {
         printUsage(std::cerr);
         inputParameters.Status();
@@ -159,17 +240,17 @@ int Dedup::execute(int argc, char** argv)
     }
     // inFile is not empty, so there is at least one character.  Check if
     // it is specifing stdin since that is not supported for Dedup.
-    if(inFile[0] == '-')
+    if((myInFile[0] == '-') && !myIsStage)
     {
         // ERROR: stdin specified, but since Dedup requires 2 passes through
         // the input file, stdin is not supported.
         printUsage(std::cerr);
         inputParameters.Status();
-        std::cerr << "ERROR: stdin ('" << inFile << "') is not a supported input file because Dedup requires two passes through the input file." << std::endl;
+        std::cerr << "ERROR: stdin ('" << myInFile << "') is not a supported input file because Dedup requires two passes through the input file." << std::endl;
         return EXIT_FAILURE;
     }
 
-    if(outFile.IsEmpty())
+    if(myOutFile.IsEmpty())
     {
         printUsage(std::cerr);
         inputParameters.Status();
@@ -177,9 +258,9 @@ int Dedup::execute(int argc, char** argv)
         return EXIT_FAILURE;
     }
 
-    intExcludeFlags = excludeFlags.AsInteger();
+    myIntExcludeFlags = excludeFlags.AsInteger();
 
-    if(myForceFlag && SamFlag::isDuplicate(intExcludeFlags))
+    if(myForceFlag && SamFlag::isDuplicate(myIntExcludeFlags))
     {
         printUsage(std::cerr);
         inputParameters.Status();
@@ -188,7 +269,7 @@ int Dedup::execute(int argc, char** argv)
         return EXIT_FAILURE;
     }
 
-    if(!SamFlag::isSecondary(intExcludeFlags))
+    if(!SamFlag::isSecondary(myIntExcludeFlags))
     {
         printUsage(std::cerr);
         inputParameters.Status();
@@ -196,7 +277,7 @@ int Dedup::execute(int argc, char** argv)
         return EXIT_FAILURE;
     }
 
-    if(!(intExcludeFlags & SamFlag::SUPPLEMENTARY_ALIGNMENT))
+    if(!(myIntExcludeFlags & SamFlag::SUPPLEMENTARY_ALIGNMENT))
     {
         printUsage(std::cerr);
         inputParameters.Status();
@@ -204,9 +285,9 @@ int Dedup::execute(int argc, char** argv)
         return EXIT_FAILURE;
     }
 
-    if(logFile.IsEmpty())
+    if(myLogFile.IsEmpty())
     {
-        logFile = outFile + ".log";
+        myLogFile = myOutFile + ".log";
     }
 
     if(myDoRecab)
@@ -219,27 +300,22 @@ int Dedup::execute(int argc, char** argv)
         }
     }
     
-    if(params)
+    if(!processBamIoParameters())
     {
         inputParameters.Status();
+        return EXIT_FAILURE;
     }
 
-    Logger::gLogger = new Logger(logFile.c_str(), verboseFlag);
-
-    /* -------------------------------------------------------------------
-     * The arguments are processed.  Prepare the input BAM file,
-     * instantiate dedup, and construct the read group library map
-     * ------------------------------------------------------------------*/
-
-    SamFile samIn;
-
-    samIn.OpenForRead(inFile.c_str());
-    // If the file isn't sorted it will throw an exception.
-    samIn.setSortedValidation(SamFile::COORDINATE);
+    if(params)
+    {
+        inputParameters.Status();
+    }
+    return(0);
+}
 
-    SamFileHeader header;
-    samIn.ReadHeader(header);
 
+int Dedup::findDuplicates(SamFileHeader& header, SamRecordSource& samIn)
+{
     buildReadGroupLibraryMap(header);
 
     lastReference = -1;
@@ -294,7 +370,7 @@ int Dedup::execute(int argc, char** argv)
         }
 
         // Determine if this read should be checked for duplicates.
-        if((!SamFlag::isMapped(flag)) || ((flag & intExcludeFlags) != 0))
+        if((!SamFlag::isMapped(flag)) || ((flag & myIntExcludeFlags) != 0))
         {
             ++excludedCount;
 
@@ -319,7 +395,7 @@ int Dedup::execute(int argc, char** argv)
             checkDups(*recordPtr, recordCount);
         }
         // let the user know we're not napping
-        if (verboseFlag && (recordCount % 100000 == 0))
+        if (myVerboseFlag && (recordCount % 100000 == 0))
         {
             Logger::gLogger->writeLog("recordCount=%u singleKeyMap=%u pairedKeyMap=%u, dictSize=%u", 
                                       recordCount, myFragmentMap.size(), 
@@ -328,10 +404,8 @@ int Dedup::execute(int argc, char** argv)
         }
     }
 
-    // we're finished reading record so clean up the duplicate search and
-    //  close the input file
+    // we're finished reading record so clean up the duplicate search.
     cleanupPriorReads(NULL);
-    samIn.Close();
 
     // print some statistics
     Logger::gLogger->writeLog("--------------------------------------------------------------------------");
@@ -367,19 +441,17 @@ int Dedup::execute(int argc, char** argv)
     std::sort(myDupList.begin(), myDupList.end(),
               std::less<uint32_t> ());
 
-    // get ready to write the output file by making a second pass
-    // through the input file
-    samIn.OpenForRead(inFile.c_str());
-    samIn.ReadHeader(header);
+    return(0);
+}
 
-    SamFile samOut;
-    samOut.OpenForWrite(outFile.c_str());
-    samOut.WriteHeader(header);
 
+void Dedup::markDuplicates(SamFileHeader& header, SamRecordSource& samIn,
+                           SamRecordSink& samOut)
+{
     // If we are recalibrating, output the model information.
     if(myDoRecab)
     {
-        myRecab.modelFitPrediction(outFile);
+        myRecab.modelFitPrediction(myOutFile);
     }
 
     // an iterator to run through the duplicate indices
@@ -387,7 +459,7 @@ int Dedup::execute(int argc, char** argv)
     bool moreDups = !myDupList.empty();
 
     // let the user know what we're doing
-    Logger::gLogger->writeLog("\nWriting %s", outFile.c_str());
+    Logger::gLogger->writeLog("\nWriting %s", myOutFile.c_str());
 
     // count the duplicate records as a check
     uint32_t singleDuplicates(0), pairedDuplicates(0);
@@ -425,7 +497,7 @@ int Dedup::execute(int argc, char** argv)
             }
 
             // write the record if we are not removing duplicates
-            if (!removeFlag ) samOut.WriteRecord(header, record);
+            if (!myRemoveFlag ) samOut.WriteRecord(header, record);
         }
         else
         {
@@ -444,29 +516,24 @@ int Dedup::execute(int argc, char** argv)
         }
 	
         // Let the user know we're still here
-        if (verboseFlag && (currentIndex % 100000 == 0)) {
+        if (myVerboseFlag && (currentIndex % 100000 == 0)) {
             Logger::gLogger->writeLog("recordCount=%u", currentIndex);
         }
     }
 
-    // We're done.  Close the files and print triumphant messages.
-    samIn.Close();
-    samOut.Close();
-
     Logger::gLogger->writeLog("Successfully %s %u unpaired and %u paired duplicate reads", 
-                              removeFlag ? "removed" : "marked" ,
+                              myRemoveFlag ? "removed" : "marked" ,
                               singleDuplicates,
                               pairedDuplicates/2);
     Logger::gLogger->writeLog("\nDedup complete!");
-    return 0;
 }
 
 // Now that we've reached coordinate on chromosome reference, look back and
 // clean up any previous positions from being tracked.
 void Dedup::cleanupPriorReads(SamRecord* record)
 {
-    static DupKey emptyKey;
-    static DupKey tempKey2;
+    static thread_local DupKey emptyKey;
+    static thread_local DupKey tempKey2;
 
     // Set where to stop cleaning out the structures.
     // Initialize to the end of the structures.
@@ -571,8 +638,8 @@ void Dedup::checkDups(SamRecord& record, uint32_t recordCount)
     // Only inside this method if the record is mapped.
 
     // Get the key for this record.
-    static DupKey key;
-    static DupKey mateKey;
+    static thread_local DupKey key;
+    static thread_local DupKey mateKey;
     key.updateKey(record, getLibraryID(record));
 
     int flag = record.getFlag(); 
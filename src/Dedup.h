@@ -40,6 +40,10 @@ public:
     int execute(int argc, char **argv);
     virtual const char* getProgramName() {return("bam:dedup");}
 
+    bool stageRewindsInput() {return(true);}
+    int runStage(SamFileHeader& header, SamRecordSource& samIn,
+                 SamRecordSink& samOut);
+
     Dedup():
         myRecab(),
         myDoRecab(false),
@@ -48,11 +52,20 @@ public:
         lastCoordinate(-1), lastReference(-1), numLibraries(0), 
         myNumMissingMate(0),
         myForceFlag(false),
-        myMinQual(15)
+        myMinQual(15),
+        myRemoveFlag(false),
+        myVerboseFlag(false),
+        myIntExcludeFlags(0),
+        myInFile(""),
+        myOutFile(""),
+        myLogFile("")
     {}
 
     ~Dedup();
 
+protected:
+    int initStage(int argc, char** argv);
+
 private:
     struct ReadData
     {
@@ -207,10 +220,27 @@ private:
     int myNumMissingMate;
     bool myForceFlag;
     int myMinQual;
+    bool myRemoveFlag;
+    bool myVerboseFlag;
+    uint16_t myIntExcludeFlags;
+    String myInFile;
+    String myOutFile;
+    String myLogFile;
 
     static const int DEFAULT_MIN_QUAL;
     static const uint32_t CLIP_OFFSET;
 
+    // Read & validate the parameters.  Returns 0 on success.
+    int readParameters(int argc, char** argv);
+
+    // First pass: find the duplicates, storing their record counts
+    // in myDupList.  Returns 0 on success.
+    int findDuplicates(SamFileHeader& header, SamRecordSource& samIn);
+
+    // Second pass: mark/remove the duplicates & write the records.
+    void markDuplicates(SamFileHeader& header, SamRecordSource& samIn,
+                        SamRecordSink& samOut);
+
     // Once record is read, look back at previous reads and determine 
     // if any no longer need to be kept for duplicate checking.
     // Call with NULL to cleanup all records.
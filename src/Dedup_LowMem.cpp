@@ -58,7 +58,7 @@ void Dedup_LowMem::printDescription(std::ostream& os)
 
 void Dedup_LowMem::printUsage(std::ostream& os)
 {
-    os << "Usage: ./bam dedup_LowMem --in <InputBamFile> --out <OutputBamFile> [--minQual <minPhred>] [--log <logFile>] [--oneChrom] [--rmDups] [--force] [--excludeFlags <flag>] [--verbose] [--noeof] [--params] [--recab] ";
+    os << "Usage: ./bam dedup_LowMem --in <InputBamFile> --out <OutputBamFile> [--minQual <minPhred>] [--log <logFile>] [--oneChrom] [--rmDups] [--force] [--excludeFlags <flag>] [--verbose] [--noeof] [--params] [--threads <numThreads>] [--level <0-9>] [--recab] ";
     myRecab.printRecabSpecificUsageLine(os);
     os << std::endl << std::endl;
     os << "Required parameters :" << std::endl;
@@ -78,6 +78,8 @@ void Dedup_LowMem::printUsage(std::ostream& os)
     os << "\t--verbose       : Turn on verbose mode" << std::endl;
     os << "\t--noeof         : Do not expect an EOF block on a bam file." << std::endl;
     os << "\t--params        : Print the parameter settings" << std::endl;
+    os << "\t--threads       : number of threads for compressing BAM output (default 0)" << std::endl;
+    os << "\t--level         : BAM compression level, 0 (uncompressed BGZF) to 9 (default -1: zlib default)" << std::endl;
     os << "\t--recab         : Recalibrate in addition to dedup_LowMem" << std::endl;
     myRecab.printRecabSpecificUsage(os);
     os << "\n" << std::endl;
@@ -115,6 +117,7 @@ int Dedup_LowMem::execute(int argc, char** argv)
     parameters.addBool("verbose", &verboseFlag);
     parameters.addBool("noeof", &noeof);
     parameters.addBool("params", &params);
+    addBamOutputParameters(parameters);
     parameters.addPhoneHome(VERSION);
     myRecab.addRecabSpecificParameters(parameters);
 
@@ -130,7 +133,7 @@ int Dedup_LowMem::execute(int argc, char** argv)
     if(noeof)
     {
         // Set that the eof block is not required.
-        BgzfFileType::setRequireEofBlock(false);
+        setRequireEofBlock(false);
     }
 
     if(inFile.IsEmpty())
@@ -191,6 +194,12 @@ int Dedup_LowMem::execute(int argc, char** argv)
         }
     }
 
+    if(!processBamIoParameters())
+    {
+        inputParameters.Status();
+        return EXIT_FAILURE;
+    }
+
     if(params)
     {
         inputParameters.Status();
@@ -346,7 +355,7 @@ int Dedup_LowMem::execute(int argc, char** argv)
     samIn.ReadHeader(header);
 
     SamFile samOut;
-    samOut.OpenForWrite(outFile.c_str());
+    openForWrite(samOut, outFile.c_str());
     samOut.WriteHeader(header);
 
     // If we are recalibrating, output the model information.
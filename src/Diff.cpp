@@ -20,6 +20,12 @@
 // which reads an SAM/BAM file and writes a SAM/BAM file with the 
 // specified previous values restored if the values are known.
 
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
 #include "Diff.h"
 #include "SamFile.h"
 #include "Parameters.h"
@@ -39,7 +45,8 @@ const char* Diff::QUAL_DIFF_TAG = "ZQ";
 const char* Diff::TAGS_DIFF_TAG = "ZT";
 
 Diff::Diff()
-    : myFreeSamRecords(),
+    : myRecord1(),
+      myRecord2(),
       myFile1Unmatched(),
       myFile2Unmatched(),
       myCompAll(false),
@@ -54,10 +61,15 @@ Diff::Diff()
       myTags(""),
       myOnlyDiffs(false),
       myBamOut(false),
+      myCompBuffers(false),
       myMaxAllowedRecs(1000000),
-      myAllocatedRecs(0),
       myThreshold(100000),
       myNumPoolOverflows(0),
+      mySpill(false),
+      myNumSpilled(0),
+      myTmpBase(),
+      myLaterRefs(false),
+      myPartitionEnd(),
       myFile1(),
       myFile2(),
       myDiffFileName("-"),
@@ -100,7 +112,7 @@ void Diff::printDescription(std::ostream& os)
 void Diff::printUsage(std::ostream& os)
 {
     BamExecutable::printUsage(os);
-    os << "\t./bam diff --in1 <inputFile> --in2 <inputFile> [--out <outputFile>] [--all] [--flag] [--mapQual] [--mate] [--isize] [--seq] [--baseQual] [--tags <Tag:Type[,Tag:Type]*>] [--everyTag] [--noCigar] [--noPos] [--onlyDiffs] [--recPoolSize <int>] [--posDiff <int>] [--noeof] [--params]" << std::endl;
+    os << "\t./bam diff --in1 <inputFile> --in2 <inputFile> [--out <outputFile>] [--all] [--flag] [--mapQual] [--mate] [--isize] [--seq] [--baseQual] [--tags <Tag:Type[,Tag:Type]*>] [--everyTag] [--noCigar] [--noPos] [--onlyDiffs] [--recPoolSize <int>] [--spill] [--posDiff <int>] [--noeof] [--params] [--threads <numThreads>] [--level <0-9>]" << std::endl;
     os << "\tRequired Parameters:" << std::endl;
     os << "\t\t--in1         : first coordinate sorted SAM/BAM file to be diffed" << std::endl;
     os << "\t\t--in2         : second coordinate sorted SAM/BAM file to be diffed" << std::endl;
@@ -124,9 +136,17 @@ void Diff::printUsage(std::ostream& os)
     os << "\t\t--onlyDiffs   : only print the fields that are different, otherwise for any diff all the fields that are compared are printed." << std::endl;
     os << "\t\t--recPoolSize : number of records to allow to be stored at a time, default value: " << myMaxAllowedRecs << std::endl;
     os << "\t\t                Set to -1 for unlimited number of records" << std::endl;
+    os << "\t\t--spill       : when recPoolSize is hit, write the oldest records waiting for a match" << std::endl;
+    os << "\t\t                to temporary files named after --out instead of reporting them as" << std::endl;
+    os << "\t\t                mismatches.  The records & their read names are spilled, leaving about" << std::endl;
+    os << "\t\t                2 bytes of memory per spilled record" << std::endl;
     os << "\t\t--posDiff     : max base pair difference between possibly matching records, default value: " << myThreshold << std::endl;
     os << "\t\t--noeof       : do not expect an EOF block on a bam file." << std::endl;
     os << "\t\t--params      : print the parameter settings" << std::endl;
+    os << "\t\t--threads     : number of threads for BAM input & output compression (default 0)" << std::endl;
+    os << "\t\t                If both inputs are indexed BAMs, 2 or more threads also diff the" << std::endl;
+    os << "\t\t                references in parallel using temporary files named after --out" << std::endl;
+    os << "\t\t--level       : BAM compression level, 0 (uncompressed BGZF) to 9 (default -1: zlib default)" << std::endl;
     os << std::endl;
 }
 
@@ -141,6 +161,7 @@ int Diff::execute(int argc, char **argv)
     bool noeof = false;
     bool params = false;
     myNumPoolOverflows = 0;
+    myNumSpilled = 0;
 
     ParameterList inputParameters;
     BEGIN_LONG_PARAMETERS(longParameterList)
@@ -160,9 +181,11 @@ int Diff::execute(int argc, char **argv)
         LONG_PARAMETER("noPos", &noPos)
         LONG_PARAMETER("onlyDiffs", &myOnlyDiffs)
         LONG_INTPARAMETER("recPoolSize", &myMaxAllowedRecs)
+        LONG_PARAMETER("spill", &mySpill)
         LONG_INTPARAMETER("posDiff", &myThreshold)
         LONG_PARAMETER("noeof", &noeof)
         LONG_PARAMETER("params", &params)
+        LONG_BAM_OUTPUT_PARAMETERS()
         LONG_PHONEHOME(VERSION)
         END_LONG_PARAMETERS();
    
@@ -194,7 +217,7 @@ int Diff::execute(int argc, char **argv)
     if(noeof)
     {
         // Set that the eof block is not required.
-        BgzfFileType::setRequireEofBlock(false);
+        setRequireEofBlock(false);
     }
     
     // Check to see if the in file was specified, if not, report an error.
@@ -260,32 +283,92 @@ int Diff::execute(int argc, char **argv)
     }
 
 
+    if(!processBamIoParameters())
+    {
+        inputParameters.Status();
+        return(-1);
+    }
+
     if(params)
     {
         inputParameters.Status();
     }
 
-    // Open the input files for reading.
-    myFile1.file.OpenForRead(inFile1);
-    myFile2.file.OpenForRead(inFile2);
+    myCompBuffers = isBamFile(inFile1) && isBamFile(inFile2);
+
+    myTmpBase = myDiffFileName.c_str();
+    if(myTmpBase.empty() || (myTmpBase[0] == '-'))
+    {
+        myTmpBase = "bamDiff";
+    }
+
+    int status = 0;
+    int32_t tailRefID = -1;
+    if(canPartition(inFile1, inFile2, tailRefID))
+    {
+        status = processPartitions(inFile1, inFile2, tailRefID);
+    }
+    else
+    {
+        // Open the input files for reading.
+        myFile1.file.OpenForRead(inFile1);
+        myFile2.file.OpenForRead(inFile2);
+
+        // Read the sam headers.
+        myFile1.file.ReadHeader(myFile1.header);
+        myFile2.file.ReadHeader(myFile2.header);
+
+        status = diffRecords();
+    }
+
+    if(myNumPoolOverflows != 0)
+    {
+        std::cerr << "WARNING: Matching records may incorrectly be reported as "
+                  << "mismatches due to running out of available records " 
+                  << myNumPoolOverflows
+                  << " time";
+        if(myNumPoolOverflows != 1)
+        {
+            std::cerr << "s";
+        }
+        std::cerr << ".\nTry increasing --recPoolSize from "
+                  << myMaxAllowedRecs << " or setting it "
+                  << "to -1 (unlimited).\n";
+    }
+    if(myNumSpilled != 0)
+    {
+        std::cerr << "Due to hitting the max recPoolSize, wrote "
+                  << myNumSpilled << " records to temporary files."
+                  << std::endl;
+    }
+
+    return(status);
+}
 
-    // Read the sam headers.
-    myFile1.file.ReadHeader(myFile1.header);
-    myFile2.file.ReadHeader(myFile2.header);
 
+int Diff::diffRecords()
+{
     SamRecord* tempRecord = NULL;
 
     bool need1 = true;
     bool need2 = true;
 
-    SamRecord* rec1 = getSamRecord();
-    SamRecord* rec2 = getSamRecord();
-
-    if((rec1 == NULL) || (rec2 == NULL))
+    // A record is needed from each file.
+    if((myMaxAllowedRecs != -1) && (myMaxAllowedRecs < 2))
     {
         fprintf(stderr, "Failed to allocate initial records, exiting!\n");
         return(-1);
     }
+    SamRecord* rec1 = &myRecord1;
+    SamRecord* rec2 = &myRecord2;
+
+    myFile1Unmatched.setHeader(myFile1.header);
+    myFile2Unmatched.setHeader(myFile2.header);
+    if(mySpill)
+    {
+        myFile1Unmatched.setSpillFile(myTmpBase + ".spill1");
+        myFile2Unmatched.setSpillFile(myTmpBase + ".spill2");
+    }
 
     // While one of the files still has records.
     while((rec1 != NULL) || (rec2 != NULL))
@@ -293,20 +376,28 @@ int Diff::execute(int argc, char **argv)
         if(need1 && (rec1 != NULL))
         {
             // Read from the 1st file.
-            if(!myFile1.file.ReadRecord(myFile1.header, *rec1))
+            if(!readRecord(myFile1, *rec1))
             {
-                // Failed to read from file1, so at the end of the file.
-                releaseSamRecord(rec1);
-                rec1 = NULL;
-
-                // Don't need file2's unmatched list anymore since there will
-                // be no more records from file 1, so flush list.
-                tempRecord = myFile2Unmatched.removeFirst();
-                while(tempRecord != NULL)
+                if(myLaterRefs &&
+                   (myFile1.file.GetStatus() == SamStatus::NO_MORE_RECS))
                 {
-                    writeDiffs(NULL, tempRecord);
-                    releaseSamRecord(tempRecord);
+                    // The later references are diffed by another
+                    // partition, so act as if their first record was read.
+                    rec1 = &myPartitionEnd;
+                }
+                else
+                {
+                    // Failed to read from file1, so at the end of the file.
+                    rec1 = NULL;
+
+                    // Don't need file2's unmatched list anymore since there
+                    // will be no more records from file 1, so flush list.
                     tempRecord = myFile2Unmatched.removeFirst();
+                    while(tempRecord != NULL)
+                    {
+                        writeDiffs(NULL, tempRecord);
+                        tempRecord = myFile2Unmatched.removeFirst();
+                    }
                 }
             }
             need1 = false;
@@ -314,19 +405,28 @@ int Diff::execute(int argc, char **argv)
         if(need2 && (rec2 != NULL))
         {
             // Read from the 2nd file.
-            if(!myFile2.file.ReadRecord(myFile2.header, *rec2))
+            if(!readRecord(myFile2, *rec2))
             {
-                // Failed to read from the 2nd file, so at the end of the file.
-                releaseSamRecord(rec2);
-                rec2 = NULL;
-                // Don't need file1's unmatched list anymore since there will
-                // be no more records from file 2, so flush list.
-                tempRecord = myFile1Unmatched.removeFirst();
-                while(tempRecord != NULL)
+                if(myLaterRefs &&
+                   (myFile2.file.GetStatus() == SamStatus::NO_MORE_RECS))
+                {
+                    // The later references are diffed by another
+                    // partition, so act as if their first record was read.
+                    rec2 = &myPartitionEnd;
+                }
+                else
                 {
-                    writeDiffs(tempRecord, NULL);
-                    releaseSamRecord(tempRecord);
+                    // Failed to read from the 2nd file, so at the end of
+                    // the file.
+                    rec2 = NULL;
+                    // Don't need file1's unmatched list anymore since there
+                    // will be no more records from file 2, so flush list.
                     tempRecord = myFile1Unmatched.removeFirst();
+                    while(tempRecord != NULL)
+                    {
+                        writeDiffs(tempRecord, NULL);
+                        tempRecord = myFile1Unmatched.removeFirst();
+                    }
                 }
             }
             need2 = false;
@@ -348,7 +448,6 @@ int Diff::execute(int argc, char **argv)
             // and write it.
             tempRecord = myFile2Unmatched.removeFirst();
             writeDiffs(NULL, tempRecord);
-            releaseSamRecord(tempRecord);
             tempRecord = myFile2Unmatched.getFirst();
         }
         
@@ -362,10 +461,17 @@ int Diff::execute(int argc, char **argv)
             // and write it.
             tempRecord = myFile1Unmatched.removeFirst();
             writeDiffs(tempRecord, NULL);
-            releaseSamRecord(tempRecord);
             tempRecord = myFile1Unmatched.getFirst();
        }
 
+        if(((rec1 == NULL) || (rec1 == &myPartitionEnd)) &&
+           ((rec2 == NULL) || (rec2 == &myPartitionEnd)))
+        {
+            // Both files are done with this partition and the records
+            // before it have been pruned, so break.
+            break;
+        }
+
         if(matchingRecs(rec1, rec2))
         {
             // Same fragment and read name.
@@ -386,17 +492,13 @@ int Diff::execute(int argc, char **argv)
                 // and there are more records in file2 that will need
                 // to compare against this one, so store this record.
                 myFile1Unmatched.addUnmatchedRecord(*rec1);
-                
-                // Need to get a new record since this one is stored for later use.
-                rec1 = getSamRecord();
+                limitUnmatched();
             }
             else
             {
                 // Either a match was found or there was no need to store the record,
                 // so write out the diffs.
                 writeDiffs(rec1, tempRecord);
-                // Release SamRecord ignores a call with NULL.
-                releaseSamRecord(tempRecord);
             }
             need1 = true;
             need2 = false;
@@ -414,39 +516,19 @@ int Diff::execute(int argc, char **argv)
                 // and there are more records in file1 that will need
                 // to compare against this one, so store this record.
                 myFile2Unmatched.addUnmatchedRecord(*rec2);
-                
-                // Need to get a new record.
-                rec2 = getSamRecord();
+                limitUnmatched();
             }
             else
             {
                 // Either a match was found or there was no need to store the record,
                 // so write out the diffs.
                 writeDiffs(tempRecord, rec2);
-                // Release SamRecord ignores a call with NULL.
-                releaseSamRecord(tempRecord);
             }
             need1 = false;
             need2 = true;
         }
     }
 
-    if(myNumPoolOverflows != 0)
-    {
-        std::cerr << "WARNING: Matching records may incorrectly be reported as "
-                  << "mismatches due to running out of available records " 
-                  << myNumPoolOverflows
-                  << " time";
-        if(myNumPoolOverflows != 1)
-        {
-            std::cerr << "s";
-        }
-        std::cerr << ".\nTry increasing --recPoolSize from "
-                  << myMaxAllowedRecs << " or setting it "
-                  << "to -1 (unlimited).\n";
-    }
-
-
     if(myFile1.file.GetStatus() != SamStatus::NO_MORE_RECS)
     {
         // Error.
@@ -462,9 +544,417 @@ int Diff::execute(int argc, char **argv)
 }
 
 
+bool Diff::readRecord(FileInfo& info, SamRecord& record)
+{
+    while(!info.file.ReadRecord(info.header, record))
+    {
+        if((info.file.GetStatus() != SamStatus::NO_MORE_RECS) ||
+           (info.nextSection >= info.sections.size()))
+        {
+            // Failed or there are no more sections to read.
+            return(false);
+        }
+        if(!info.file.SetReadSection(info.sections[info.nextSection++]))
+        {
+            return(false);
+        }
+    }
+    return(true);
+}
+
+
+bool Diff::canPartition(const String& inFile1, const String& inFile2,
+                        int32_t& tailRefID)
+{
+    // Partitions need multiple threads & an index for both files.
+    if((myNumThreads < 2) || (inFile1 == "-") || (inFile2 == "-"))
+    {
+        return(false);
+    }
+    SamInputFile samIn1(ErrorHandler::RETURN);
+    SamInputFile samIn2(ErrorHandler::RETURN);
+    SamFileHeader header1;
+    SamFileHeader header2;
+    if(!samIn1.OpenForRead(inFile1, &header1) || !samIn1.ReadBamIndex() ||
+       !samIn2.OpenForRead(inFile2, &header2) || !samIn2.ReadBamIndex())
+    {
+        return(false);
+    }
+    // The records are compared by reference id, so both files need the
+    // same references.
+    int32_t numRefs = header1.getReferenceInfo().getNumEntries();
+    if((numRefs == 0) ||
+       (numRefs != header2.getReferenceInfo().getNumEntries()))
+    {
+        return(false);
+    }
+    // The records of the last references are diffed with the unmapped
+    // reads, so there must be another partition before them.
+    tailRefID = std::min(lastReference(samIn1, header1, numRefs),
+                         lastReference(samIn2, header2, numRefs));
+    if(tailRefID < 1)
+    {
+        return(false);
+    }
+    myFile1.header = header1;
+    myFile2.header = header2;
+    return(true);
+}
+
+
+int32_t Diff::lastReference(SamInputFile& samIn, SamFileHeader& header,
+                            int32_t numRefs)
+{
+    SamRecord record;
+    for(int32_t refID = numRefs - 1; refID >= 0; refID--)
+    {
+        if(samIn.SetReadSection(refID) && samIn.ReadRecord(header, record))
+        {
+            return(refID);
+        }
+    }
+    return(-1);
+}
+
+
+int Diff::processPartitions(const String& inFile1, const String& inFile2,
+                            int32_t tailRefID)
+{
+    // A partition per reference.  The unmatched records of a reference
+    // are pruned once both files move past it, so diffing each reference
+    // on its own gives the same results as a sequential diff, other than
+    // for records that move to a different reference, which are only
+    // matched sequentially if they happen to be read at the same time.
+    // The unmapped reads without a reference compare less than every
+    // reference, so they are matched against the unmatched records of
+    // the last references that have records: diff those together.
+    PartitionList list;
+    list.next = 0;
+    list.copied = 0;
+    list.stop = false;
+    int32_t numRefs = myFile1.header.getReferenceInfo().getNumEntries();
+    for(int32_t i = 0; i <= tailRefID; i++)
+    {
+        Partition partition;
+        partition.refIDs.push_back(i);
+        if(i == tailRefID)
+        {
+            for(int32_t refID = i + 1; refID < numRefs; refID++)
+            {
+                partition.refIDs.push_back(refID);
+            }
+            partition.refIDs.push_back(-1);
+        }
+        std::stringstream partBase;
+        partBase << myTmpBase << ".part" << i + 1;
+        partition.tmpBase = partBase.str();
+        partition.diffName = partBase.str() + ".diff";
+        partition.only1Name = partBase.str() + ".only1.ubam";
+        partition.only2Name = partBase.str() + ".only2.ubam";
+        partition.bamDiffName = partBase.str() + ".diff.ubam";
+        partition.done = false;
+        partition.status = 0;
+        list.partitions.push_back(partition);
+    }
+
+    int numWorkers = std::min(myNumThreads, (int)list.partitions.size());
+    list.maxAhead = numWorkers;
+    std::vector<Diff*> workers;
+    std::vector<std::thread> threads;
+    for(int i = 0; i < numWorkers; i++)
+    {
+        workers.push_back(new Diff());
+        workers.back()->initPartitionWorker(*this);
+        threads.push_back(std::thread(&Diff::diffPartitions,
+                                      workers.back(), std::ref(list),
+                                      std::string(inFile1.c_str()),
+                                      std::string(inFile2.c_str())));
+    }
+
+    // Copy each partition to the outputs once it is done.
+    int status = 0;
+    for(size_t i = 0; i < list.partitions.size(); i++)
+    {
+        Partition& partition = list.partitions[i];
+        {
+            std::unique_lock<std::mutex> lock(list.mutex);
+            while(!partition.done)
+            {
+                list.doneCond.wait(lock);
+            }
+        }
+        if(partition.status != 0)
+        {
+            status = partition.status;
+            break;
+        }
+
+        bool copied = true;
+        if(myBamOut)
+        {
+            copied =
+                copyBamPartition(partition.bamDiffName, myBamDiff,
+                                 myBamDiffName, myFile1.header) &&
+                copyBamPartition(partition.only1Name, myBamOnly1,
+                                 myBamOnly1Name, myFile1.header) &&
+                copyBamPartition(partition.only2Name, myBamOnly2,
+                                 myBamOnly2Name, myFile2.header);
+        }
+        else
+        {
+            copied = copyDiffPartition(partition.diffName);
+        }
+        if(!copied)
+        {
+            status = SamStatus::FAIL_IO;
+            break;
+        }
+        {
+            // Let the workers start the next partition.
+            std::lock_guard<std::mutex> lock(list.mutex);
+            list.copied = i + 1;
+        }
+        list.copiedCond.notify_all();
+    }
+
+    if(status != 0)
+    {
+        // Stop the workers from starting more partitions.
+        {
+            std::lock_guard<std::mutex> lock(list.mutex);
+            list.stop = true;
+        }
+        list.copiedCond.notify_all();
+    }
+    for(int i = 0; i < numWorkers; i++)
+    {
+        threads[i].join();
+        myNumPoolOverflows += workers[i]->myNumPoolOverflows;
+        myNumSpilled += workers[i]->myNumSpilled;
+        delete workers[i];
+    }
+    for(size_t i = 0; i < list.partitions.size(); i++)
+    {
+        remove(list.partitions[i].diffName.c_str());
+        remove(list.partitions[i].only1Name.c_str());
+        remove(list.partitions[i].only2Name.c_str());
+        remove(list.partitions[i].bamDiffName.c_str());
+    }
+    return(status);
+}
+
+
+void Diff::initPartitionWorker(const Diff& parent)
+{
+    myCompAll = parent.myCompAll;
+    myCompCigar = parent.myCompCigar;
+    myCompPos = parent.myCompPos;
+    myCompBaseQual = parent.myCompBaseQual;
+    myCompSeq = parent.myCompSeq;
+    myCompFlag = parent.myCompFlag;
+    myCompMapQ = parent.myCompMapQ;
+    myCompMate = parent.myCompMate;
+    myCompISize = parent.myCompISize;
+    myTags = parent.myTags;
+    myEveryTag = parent.myEveryTag;
+    myOnlyDiffs = parent.myOnlyDiffs;
+    myBamOut = parent.myBamOut;
+    myCompBuffers = parent.myCompBuffers;
+    myMaxAllowedRecs = parent.myMaxAllowedRecs;
+    myThreshold = parent.myThreshold;
+    myNumPoolOverflows = 0;
+    mySpill = parent.mySpill;
+    myNumSpilled = 0;
+}
+
+
+void Diff::diffPartitions(PartitionList& list, std::string inFile1,
+                          std::string inFile2)
+{
+    // Each worker reads the inputs with its own files & indexes.
+    bool opened = false;
+    try
+    {
+        opened = (myFile1.file.OpenForRead(inFile1.c_str(), &myFile1.header) &&
+                  myFile1.file.ReadBamIndex() &&
+                  myFile2.file.OpenForRead(inFile2.c_str(), &myFile2.header) &&
+                  myFile2.file.ReadBamIndex());
+    }
+    catch(std::exception& e)
+    {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+    }
+    if(!opened)
+    {
+        std::cerr << "Failed to open " << inFile1 << " & " << inFile2
+                  << " with their indexes" << std::endl;
+    }
+
+    while(true)
+    {
+        Partition* partition = NULL;
+        {
+            // Wait for the outputs to catch up rather than fill the disk
+            // with diffed partitions that cannot be copied yet.
+            std::unique_lock<std::mutex> lock(list.mutex);
+            while(!list.stop && (list.next < list.partitions.size()) &&
+                  (list.next >= list.copied + list.maxAhead))
+            {
+                list.copiedCond.wait(lock);
+            }
+            if(list.stop || (list.next == list.partitions.size()))
+            {
+                break;
+            }
+            partition = &(list.partitions[list.next++]);
+        }
+
+        int status = SamStatus::FAIL_IO;
+        if(opened)
+        {
+            try
+            {
+                status = diffPartition(*partition);
+            }
+            catch(std::exception& e)
+            {
+                std::cerr << "ERROR: " << e.what() << std::endl;
+                status = SamStatus::FAIL_IO;
+                // The unmatched records are left over, so do not diff
+                // any more partitions on this worker.
+                opened = false;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(list.mutex);
+            partition->status = status;
+            partition->done = true;
+        }
+        list.doneCond.notify_all();
+    }
+}
+
+
+int Diff::diffPartition(const Partition& partition)
+{
+    // The outputs are only opened if there are diffs to write.
+    myTmpBase = partition.tmpBase;
+    myDiffFileName = partition.diffName.c_str();
+    myBamDiffName = partition.bamDiffName.c_str();
+    myBamOnly1Name = partition.only1Name.c_str();
+    myBamOnly2Name = partition.only2Name.c_str();
+
+    myLaterRefs = (partition.refIDs.back() != -1);
+    myFile1.sections = partition.refIDs;
+    myFile1.nextSection = 1;
+    myFile2.sections = partition.refIDs;
+    myFile2.nextSection = 1;
+    if(!myFile1.file.SetReadSection(partition.refIDs[0]) ||
+       !myFile2.file.SetReadSection(partition.refIDs[0]))
+    {
+        std::cerr << "Failed to read reference " << partition.refIDs[0]
+                  << " from the indexes" << std::endl;
+        return(SamStatus::FAIL_IO);
+    }
+
+    int status = diffRecords();
+
+    // Close the temporary files.
+    if(myDiffFile != NULL)
+    {
+        ifclose(myDiffFile);
+        myDiffFile = NULL;
+    }
+    if(myBamDiff.IsOpen())
+    {
+        myBamDiff.Close();
+    }
+    if(myBamOnly1.IsOpen())
+    {
+        myBamOnly1.Close();
+    }
+    if(myBamOnly2.IsOpen())
+    {
+        myBamOnly2.Close();
+    }
+    return(status);
+}
+
+
+bool Diff::copyBamPartition(const std::string& partName, SamFile& out,
+                            const String& outName, SamFileHeader& header)
+{
+    FILE* exists = fopen(partName.c_str(), "rb");
+    if(exists == NULL)
+    {
+        // The worker had no records to write to this file.
+        return(true);
+    }
+    fclose(exists);
+
+    SamFile partIn(ErrorHandler::RETURN);
+    SamFileHeader partHeader;
+    if(!partIn.OpenForRead(partName.c_str(), &partHeader))
+    {
+        std::cerr << "Failed to open the temporary file: " << partName
+                  << ": " << partIn.GetStatusMessage() << std::endl;
+        return(false);
+    }
+    SamRecord record;
+    while(partIn.ReadRecord(partHeader, record))
+    {
+        if(!out.IsOpen())
+        {
+            // not yet open.
+            openForWrite(out, outName.c_str(), &header);
+        }
+        out.WriteRecord(header, record);
+    }
+    if(partIn.GetStatus() != SamStatus::NO_MORE_RECS)
+    {
+        std::cerr << "Failed to read the temporary file: " << partName
+                  << ": " << partIn.GetStatusMessage() << std::endl;
+        return(false);
+    }
+    partIn.Close();
+    remove(partName.c_str());
+    return(true);
+}
+
+
+bool Diff::copyDiffPartition(const std::string& partName)
+{
+    FILE* partIn = fopen(partName.c_str(), "rb");
+    if(partIn == NULL)
+    {
+        // The worker had no diffs to write.
+        return(true);
+    }
+    bool copied = true;
+    char buffer[0x10000];
+    size_t numRead = 0;
+    while((numRead = fread(buffer, 1, sizeof(buffer), partIn)) > 0)
+    {
+        if(!checkDiffFile() ||
+           (ifwrite(myDiffFile, buffer, numRead) != numRead))
+        {
+            std::cerr << "Failed to write the diffs to " << myDiffFileName
+                      << std::endl;
+            copied = false;
+            break;
+        }
+    }
+    fclose(partIn);
+    remove(partName.c_str());
+    return(copied);
+}
+
+
 bool Diff::matchingRecs(SamRecord* rec1, SamRecord* rec2)
 {
-    if((rec1 == NULL) || (rec2 == NULL))
+    if((rec1 == NULL) || (rec2 == NULL) ||
+       (rec1 == &myPartitionEnd) || (rec2 == &myPartitionEnd))
     {
         // one or both of the records is NULL, so return false.
         return(false);
@@ -492,6 +982,15 @@ bool Diff::lessThan(SamRecord* rec1, SamRecord* rec2, int threshold)
     {
         return(true);
     }
+    // The end of a partition is after all of its records.
+    if(rec1 == &myPartitionEnd)
+    {
+        return(false);
+    }
+    if(rec2 == &myPartitionEnd)
+    {
+        return(true);
+    }
 
     int32_t rec1ChromID = rec1->getReferenceID();
     int32_t rec2ChromID = rec2->getReferenceID();
@@ -528,7 +1027,7 @@ bool Diff::lessThan(SamRecord* rec1, SamRecord* rec2, int threshold)
 
 void Diff::writeBamDiffs(SamRecord* rec1, SamRecord* rec2)
 {
-    static String tempString;
+    String& tempString = myTempBuffer;
 
     if((rec1 == NULL) && (rec2 != NULL))
     {
@@ -536,7 +1035,7 @@ void Diff::writeBamDiffs(SamRecord* rec1, SamRecord* rec2)
         if(!myBamOnly2.IsOpen())
         {
             // not yet open.
-            myBamOnly2.OpenForWrite(myBamOnly2Name.c_str(), &myFile2.header);
+            openForWrite(myBamOnly2, myBamOnly2Name.c_str(), &myFile2.header);
         }
         myBamOnly2.WriteRecord(myFile2.header, *rec2);
     }
@@ -546,7 +1045,7 @@ void Diff::writeBamDiffs(SamRecord* rec1, SamRecord* rec2)
         if(!myBamOnly1.IsOpen())
         {
             // not yet open.
-            myBamOnly1.OpenForWrite(myBamOnly1Name.c_str(), &myFile1.header);
+            openForWrite(myBamOnly1, myBamOnly1Name.c_str(), &myFile1.header);
         }
         myBamOnly1.WriteRecord(myFile1.header, *rec1);
     }
@@ -561,7 +1060,7 @@ void Diff::writeBamDiffs(SamRecord* rec1, SamRecord* rec2)
         if(!myBamDiff.IsOpen())
         {
             // not yet open.
-            myBamDiff.OpenForWrite(myBamDiffName.c_str(), &myFile1.header);
+            openForWrite(myBamDiff, myBamDiffName.c_str(), &myFile1.header);
         }
 
         //  Add the fields from rec2.
@@ -773,6 +1272,14 @@ bool Diff::getDiffs(SamRecord* rec1, SamRecord* rec2)
         // Neither is set, so no diffs.
         return(false);
     }
+
+    // Most matched records are identical, so first check the raw fields
+    // before parsing them.
+    if(myCompBuffers && (rec1 != NULL) && (rec2 != NULL) &&
+       sameBamFields(*rec1, *rec2))
+    {
+        return(false);
+    }
     
     myTags1.Clear();
     myTags2.Clear();
@@ -897,82 +1404,156 @@ bool Diff::getDiffs(SamRecord* rec1, SamRecord* rec2)
 }
 
 
-bool Diff::writeReadName(SamRecord& record)
+bool Diff::sameBamFields(SamRecord& rec1, SamRecord& rec2)
 {
-    uint8_t nameLen = record.getReadNameLength();
-    if(nameLen > 0)
+    const char* buf1 = (const char*)rec1.getRecordBuffer(SamRecord::NONE);
+    const char* buf2 = (const char*)rec2.getRecordBuffer(SamRecord::NONE);
+    if((buf1 == NULL) || (buf2 == NULL))
     {
-        // it has a read name, so write it.
-        // Subtract 1 since the length includes the null.
-        --nameLen;
-        if(ifwrite(myDiffFile, record.getReadName(), nameLen) != nameLen)
-        {
-            // Failed to write the entire read name.
-            return(false);
-        }
-    }  
-    return(true);
-}
+        return(false);
+    }
 
+    // Fixed length fields, offsets include the block size.
+    if((myCompPos && (memcmp(buf1 + 4, buf2 + 4, 8) != 0)) ||
+       (myCompMapQ && (buf1[13] != buf2[13])) ||
+       (myCompFlag && (memcmp(buf1 + 18, buf2 + 18, 2) != 0)) ||
+       (myCompMate && (memcmp(buf1 + 24, buf2 + 24, 8) != 0)) ||
+       (myCompISize && (memcmp(buf1 + 32, buf2 + 32, 4) != 0)))
+    {
+        return(false);
+    }
 
-SamRecord* Diff::getSamRecord()
-{
-    // Get new samRecord.
-    SamRecord* returnSam = NULL;
-    if(!myFreeSamRecords.empty())
+    int32_t blockSize1 = 0;
+    int32_t blockSize2 = 0;
+    uint16_t numCigar1 = 0;
+    uint16_t numCigar2 = 0;
+    int32_t seqLen1 = 0;
+    int32_t seqLen2 = 0;
+    memcpy(&blockSize1, buf1, sizeof(int32_t));
+    memcpy(&blockSize2, buf2, sizeof(int32_t));
+    memcpy(&numCigar1, buf1 + 16, sizeof(uint16_t));
+    memcpy(&numCigar2, buf2 + 16, sizeof(uint16_t));
+    memcpy(&seqLen1, buf1 + 20, sizeof(int32_t));
+    memcpy(&seqLen2, buf2 + 20, sizeof(int32_t));
+
+    // The variable length fields follow the read name.
+    const char* cigar1 = buf1 + 36 + (uint8_t)buf1[12];
+    const char* cigar2 = buf2 + 36 + (uint8_t)buf2[12];
+    if(myCompCigar &&
+       ((numCigar1 != numCigar2) ||
+        (memcmp(cigar1, cigar2, numCigar1 * sizeof(uint32_t)) != 0)))
+    {
+        return(false);
+    }
+    if((myCompSeq || myCompBaseQual) && (seqLen1 != seqLen2))
+    {
+        return(false);
+    }
+    const char* seq1 = cigar1 + numCigar1 * sizeof(uint32_t);
+    const char* seq2 = cigar2 + numCigar2 * sizeof(uint32_t);
+    if(myCompSeq && (memcmp(seq1, seq2, (seqLen1 + 1) / 2) != 0))
     {
-        // have free already allocated records, so get one of those.
-        returnSam = myFreeSamRecords.top();
-        myFreeSamRecords.pop();
+        return(false);
+    }
+    const char* qual1 = seq1 + (seqLen1 + 1) / 2;
+    const char* qual2 = seq2 + (seqLen2 + 1) / 2;
+    if(myCompBaseQual && (memcmp(qual1, qual2, seqLen1) != 0))
+    {
+        return(false);
     }
-    else if((myMaxAllowedRecs == -1) || (myAllocatedRecs < myMaxAllowedRecs))
+    if(myEveryTag || !myTags.IsEmpty())
     {
-        // There were no free records, but either there is no max or
-        // there is still room to allocate more.
-        returnSam = new SamRecord();
-        ++myAllocatedRecs;
-        if(returnSam == NULL)
+        // Compare all of the tags, a difference in tags that are not
+        // being compared just means the fields are parsed.
+        const char* tags1 = qual1 + seqLen1;
+        const char* tags2 = qual2 + seqLen2;
+        int32_t tagLen1 = blockSize1 + sizeof(int32_t) - (tags1 - buf1);
+        int32_t tagLen2 = blockSize2 + sizeof(int32_t) - (tags2 - buf2);
+        if((tagLen1 != tagLen2) || (tagLen1 < 0) ||
+           (memcmp(tags1, tags2, tagLen1) != 0))
         {
-            // Failed allocation.
-            throw(std::runtime_error("Failed to allocate SamRecord"));
+            return(false);
         }
     }
-    else
+    return(true);
+}
+
+
+bool Diff::isBamFile(const String& fileName)
+{
+    if(fileName.IsEmpty() || (fileName[0] == '-'))
     {
-        // There are no more free ones and we have already hit the
-        // max number allowed to be allocated, so flush the first record from
-        // the larger list.
-        ++myNumPoolOverflows;
+        // Cannot peek at stdin.
+        return(false);
+    }
+    IFILE file = ifopen(fileName, "rb");
+    if(file == NULL)
+    {
+        return(false);
+    }
+    char magic[4];
+    bool isBam = ((ifread(file, magic, sizeof(magic)) == sizeof(magic)) &&
+                  (memcmp(magic, "BAM\1", sizeof(magic)) == 0));
+    ifclose(file);
+    return(isBam);
+}
 
-        if(myFile1Unmatched.size() >= myFile2Unmatched.size())
-        {
-            // remove from file1.
-            returnSam = myFile1Unmatched.removeFirst();
-            // write out the record as unmatched.
-            writeDiffs(returnSam, NULL);
-        }
-        else
+
+bool Diff::writeReadName(SamRecord& record)
+{
+    uint8_t nameLen = record.getReadNameLength();
+    if(nameLen > 0)
+    {
+        // it has a read name, so write it.
+        // Subtract 1 since the length includes the null.
+        --nameLen;
+        if(ifwrite(myDiffFile, record.getReadName(), nameLen) != nameLen)
         {
-            // remove from file2.
-            returnSam = myFile2Unmatched.removeFirst();
-            // write out the record as unmatched.
-            writeDiffs(NULL, returnSam);
+            // Failed to write the entire read name.
+            return(false);
         }
-    }
-    return(returnSam);
+    }  
+    return(true);
 }
 
 
-void Diff::releaseSamRecord(SamRecord* record)
+void Diff::limitUnmatched()
 {
-    if(record == NULL)
+    // Each stored record takes one of the --recPoolSize records, along
+    // with the record being read from the other file.
+    if((myMaxAllowedRecs == -1) ||
+       ((myFile1Unmatched.memSize() + myFile2Unmatched.memSize() + 1) <
+        myMaxAllowedRecs))
     {
-        // Nothing to release, so just return.
         return;
     }
 
-    // Release the samRecord to be reused.
-    myFreeSamRecords.push(record);
+    if(mySpill)
+    {
+        UnmatchedRecords& unmatched =
+            (myFile1Unmatched.memSize() >= myFile2Unmatched.memSize()) ?
+            myFile1Unmatched : myFile2Unmatched;
+        uint32_t numSpilled = unmatched.spillOldest();
+        if(numSpilled == 0)
+        {
+            throw(std::runtime_error("Failed to spill the unmatched records"));
+        }
+        myNumSpilled += numSpilled;
+        return;
+    }
+
+    // Flush the first record from the larger list.
+    ++myNumPoolOverflows;
+    if(myFile1Unmatched.size() >= myFile2Unmatched.size())
+    {
+        // write out the record from file1 as unmatched.
+        writeDiffs(myFile1Unmatched.removeFirst(), NULL);
+    }
+    else
+    {
+        // write out the record from file2 as unmatched.
+        writeDiffs(NULL, myFile2Unmatched.removeFirst());
+    }
 }
 
 
@@ -992,83 +1573,634 @@ bool Diff::checkDiffFile()
 }
 
 
-void Diff::UnmatchedRecords::addUnmatchedRecord(SamRecord& record)
+Diff::UnmatchedRecords::UnmatchedRecords()
+    : myListUnmatched(),
+      myFragmentMap(),
+      myKey(),
+      myHeader(NULL),
+      myRuns(),
+      myNumInRuns(0),
+      myNumRunFiles(0),
+      mySpillName(),
+      myRecords(),
+      myFirstRecord(&myRecords[0]),
+      myFirstLoaded(false),
+      myRemovedRecord(&myRecords[1]),
+      myReadBuffer()
+{
+}
+
+
+Diff::UnmatchedRecords::~UnmatchedRecords()
+{
+    setSpillFile("");
+}
+
+
+void Diff::UnmatchedRecords::setSpillFile(const std::string& fileName)
+{
+    for(unsigned int i = 0; i < myRuns.size(); i++)
+    {
+        removeRun(myRuns[i]);
+    }
+    myRuns.clear();
+    myNumInRuns = 0;
+    myFirstLoaded = false;
+    mySpillName = fileName;
+}
+
+
+void Diff::UnmatchedRecords::setKey(SamRecord& record)
 {
     // Lookup which read this is, first, last, or intermediate
-    uint16_t flag = record.getFlag();
+    myKey = (char)('0' + SamFlag::getFragmentType(record.getFlag()));
+    myKey += record.getReadName();
+}
+
+
+uint64_t Diff::UnmatchedRecords::hashKey(const std::string& key)
+{
+    // FNV-1a followed by a final mix so the upper bits are usable for
+    // the filter.
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for(unsigned int i = 0; i < key.size(); i++)
+    {
+        hash ^= (unsigned char)key[i];
+        hash *= 0x100000001b3ULL;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return(hash);
+}
+
 
-    UnmatchedRecords::mapType* mapPtr =
-        &(myFragmentMaps[SamFlag::getFragmentType(flag)]);
+void Diff::UnmatchedRecords::addUnmatchedRecord(SamRecord& record)
+{
+    const char* buffer = (const char*)record.getRecordBuffer(SamRecord::NONE);
+    if(buffer == NULL)
+    {
+        throw(std::runtime_error("Failed to get the record's BAM buffer"));
+    }
+    int32_t blockSize = 0;
+    memcpy(&blockSize, buffer, sizeof(int32_t));
 
     // Add the record to the unmatched list, and add the position of this record
     // in the list to the map.
-    (*mapPtr)[record.getReadName()] = myListUnmatched.insert(myListUnmatched.end(), &record);
+    setKey(record);
+    listType::iterator entry =
+        myListUnmatched.insert(myListUnmatched.end(), Entry());
+    entry->key = myKey;
+    entry->buffer.assign(buffer, blockSize + sizeof(int32_t));
+    std::pair<mapType::iterator, bool> added =
+        myFragmentMap.insert(mapType::value_type(myKey, entry));
+    if(added.second)
+    {
+        // A record with this key may be in a run; it is replaced by this
+        // one just as a record in memory would be.
+        hideKey(myKey);
+    }
+    else
+    {
+        added.first->second = entry;
+    }
 }
 
 
 SamRecord* Diff::UnmatchedRecords::removeFragmentMatch(SamRecord& record)
 {
-    // Lookup which read this is, first, last, or intermediate
-    uint16_t flag = record.getFlag();
-    
-    UnmatchedRecords::mapType* mapPtr =
-        &(myFragmentMaps[SamFlag::getFragmentType(flag)]);
-    
-    SamRecord* returnRecord = NULL;
-    
+    setKey(record);
+
     // Check to see if it was found.
-    myUnmatchedFileIter = mapPtr->find(record.getReadName());
-    if(myUnmatchedFileIter != mapPtr->end())
+    mapType::iterator found = myFragmentMap.find(myKey);
+    if(found != myFragmentMap.end())
     {
-        // Found a match.  Iter->second is an iterator into the list.
-        returnRecord = *(myUnmatchedFileIter->second);
+        // Found a match.  Found->second is an iterator into the list.
+        const std::string& buffer = found->second->buffer;
+        parseBuffer(buffer.data(), buffer.size(), *myRemovedRecord);
         // Remove it from the list and map.
-        myListUnmatched.erase(myUnmatchedFileIter->second);
-        mapPtr->erase(myUnmatchedFileIter);
+        eraseEntry(found->second);
+        myFragmentMap.erase(found);
+        return(myRemovedRecord);
     }
 
-    return(returnRecord);
+    unsigned int runIndex;
+    uint32_t index;
+    uint64_t offset;
+    if(!findInRuns(myKey, runIndex, index, offset))
+    {
+        return(NULL);
+    }
+    readRunRecord(*(myRuns[runIndex]), offset, *myRemovedRecord);
+    removeFromRun(runIndex, index);
+    return(myRemovedRecord);
 }
 
 
 SamRecord* Diff::UnmatchedRecords::removeFirst()
 {
-    if(myListUnmatched.empty())
+    if(getFirst() == NULL)
     {
         // The list is empty, so return NULL.
         return(NULL);
     }
+    std::swap(myFirstRecord, myRemovedRecord);
+    myFirstLoaded = false;
 
-    // Get the first entry from the list.
-    SamRecord* returnRec = myListUnmatched.front();
-    
-    // Remove the record from the map, by first looking up which read this is, 
-    // first, last, or intermediate
-    uint16_t flag = returnRec->getFlag();
-
-    UnmatchedRecords::mapType* mapPtr =
-        &(myFragmentMaps[SamFlag::getFragmentType(flag)]);
-
-    // Remove it from the map.
-    mapPtr->erase(returnRec->getReadName());
+    if(!myRuns.empty())
+    {
+        // The first record is the first one left in the oldest run.
+        Run& run = *(myRuns.front());
+        setKey(*myRemovedRecord);
+        // Remove it from the key lookup as if erasing its hash entry.
+        mapType::iterator found = myFragmentMap.find(myKey);
+        if(found != myFragmentMap.end())
+        {
+            myFragmentMap.erase(found);
+        }
+        else if(run.findable[run.first])
+        {
+            run.findable[run.first] = false;
+        }
+        else
+        {
+            hideKey(myKey);
+        }
+        removeFromRun(0, run.first);
+        return(myRemovedRecord);
+    }
 
-    // Remove it from the list.
-    myListUnmatched.pop_front();
-    
-    return(returnRec);
+    // Remove it from the map & the list.
+    listType::iterator first = myListUnmatched.begin();
+    myFragmentMap.erase(first->key);
+    eraseEntry(first);
+    return(myRemovedRecord);
 }
 
 
 SamRecord* Diff::UnmatchedRecords::getFirst()
 {
-    if(myListUnmatched.empty())
+    // The pruning checks the first record after every record is read,
+    // so only read it once.
+    if(myFirstLoaded)
+    {
+        return(myFirstRecord);
+    }
+    if(!myRuns.empty())
+    {
+        Run& run = *(myRuns.front());
+        readRunRecord(run, run.firstOffset, *myFirstRecord);
+    }
+    else if(!myListUnmatched.empty())
+    {
+        const std::string& buffer = myListUnmatched.front().buffer;
+        parseBuffer(buffer.data(), buffer.size(), *myFirstRecord);
+    }
+    else
     {
         // The list is empty, so return NULL.
         return(NULL);
     }
+    myFirstLoaded = true;
+    return(myFirstRecord);
+}
 
-    // Get the first entry from the list.
-    SamRecord* returnRec = myListUnmatched.front();
-    
-    return(returnRec);
+
+uint32_t Diff::UnmatchedRecords::spillOldest()
+{
+    uint32_t numRecords = (myListUnmatched.size() + 1) / 2;
+    if(numRecords == 0)
+    {
+        return(0);
+    }
+    Run* run = createRun(numRecords);
+    // Add it before anything can throw so the file is removed.
+    myRuns.push_back(run);
+
+    // Write the records in the order they were added, keeping each key's
+    // record index & offset to sort.
+    std::vector<std::pair<std::string, std::pair<uint32_t, uint64_t> > > keys;
+    keys.reserve(numRecords);
+    for(uint32_t i = 0; i < numRecords; i++)
+    {
+        listType::iterator entry = myListUnmatched.begin();
+        if(fwrite(entry->buffer.data(), 1, entry->buffer.size(),
+                  run->file) != entry->buffer.size())
+        {
+            throw(std::runtime_error("Failed to write the temporary file " +
+                                     run->fileName));
+        }
+        mapType::iterator found = myFragmentMap.find(entry->key);
+        if((found != myFragmentMap.end()) && (found->second == entry))
+        {
+            run->findable[i] = true;
+            myFragmentMap.erase(found);
+        }
+        keys.push_back(std::make_pair(std::string(),
+                                      std::make_pair(i, run->recordsEnd)));
+        keys.back().first.swap(entry->key);
+        run->recordsEnd += entry->buffer.size();
+        myListUnmatched.erase(entry);
+    }
+    run->numLeft = numRecords;
+    myNumInRuns += numRecords;
+
+    std::sort(keys.begin(), keys.end());
+    run->keysEnd = run->recordsEnd;
+    for(uint32_t i = 0; i < numRecords; i++)
+    {
+        addKeyToRun(*run, keys[i].first, keys[i].second.first,
+                    keys[i].second.second);
+    }
+    finishRun(*run);
+
+    // The runs are in decreasing tiers, so merging the last MERGE_RUNS
+    // runs once they have the same tier may complete the previous tier.
+    while(myRuns.size() >= MERGE_RUNS)
+    {
+        unsigned int first = myRuns.size() - MERGE_RUNS;
+        if(myRuns[first]->tier != myRuns.back()->tier)
+        {
+            break;
+        }
+        mergeRuns(first);
+    }
+    return(numRecords);
+}
+
+
+void Diff::UnmatchedRecords::mergeRuns(unsigned int first)
+{
+    // Records before each run's first record were all removed, so they
+    // are dropped, shifting the run's indexes & offsets.
+    unsigned int numRuns = myRuns.size() - first;
+    Run** runs = &(myRuns[first]);
+    uint32_t numRecords = 0;
+    for(unsigned int i = 0; i < numRuns; i++)
+    {
+        numRecords += runs[i]->numRecords - runs[i]->first;
+    }
+    Run* merged = createRun(numRecords);
+    merged->tier = runs[0]->tier + 1;
+
+    // Copy the records, in the order they were added, & their state.
+    std::vector<uint32_t> indexShift(numRuns, 0);
+    std::vector<uint64_t> offsetShift(numRuns, 0);
+    uint32_t index = 0;
+    char copyBuffer[65536];
+    for(unsigned int i = 0; i < numRuns; i++)
+    {
+        Run& run = *(runs[i]);
+        indexShift[i] = index - run.first;
+        offsetShift[i] = merged->recordsEnd - run.firstOffset;
+        for(uint32_t j = run.first; j < run.numRecords; j++)
+        {
+            merged->removed[index] = run.removed[j];
+            merged->findable[index] = run.findable[j];
+            ++index;
+        }
+        merged->numLeft += run.numLeft;
+
+        if(fseek(run.file, run.firstOffset, SEEK_SET) != 0)
+        {
+            throw(std::runtime_error("Failed to read the temporary file " +
+                                     run.fileName));
+        }
+        uint64_t left = run.recordsEnd - run.firstOffset;
+        while(left != 0)
+        {
+            size_t size = std::min(left, (uint64_t)sizeof(copyBuffer));
+            if(fread(copyBuffer, 1, size, run.file) != size)
+            {
+                throw(std::runtime_error("Failed to read the temporary file " +
+                                         run.fileName));
+            }
+            if(fwrite(copyBuffer, 1, size, merged->file) != size)
+            {
+                throw(std::runtime_error("Failed to write the temporary file " +
+                                         merged->fileName));
+            }
+            left -= size;
+        }
+        merged->recordsEnd += run.recordsEnd - run.firstOffset;
+    }
+    merged->keysEnd = merged->recordsEnd;
+
+    // Read the first kept key of each run.
+    std::vector<std::string> keys(numRuns);
+    std::vector<uint32_t> indexes(numRuns, 0);
+    std::vector<uint64_t> offsets(numRuns, 0);
+    std::vector<uint64_t> keyOffsets(numRuns, 0);
+    std::vector<bool> valid(numRuns, false);
+    for(unsigned int i = 0; i < numRuns; i++)
+    {
+        keyOffsets[i] = runs[i]->recordsEnd;
+        if(fseek(runs[i]->file, keyOffsets[i], SEEK_SET) != 0)
+        {
+            throw(std::runtime_error("Failed to read the temporary file " +
+                                     runs[i]->fileName));
+        }
+        do
+        {
+            valid[i] = readRunKey(*(runs[i]), keyOffsets[i], keys[i],
+                                  indexes[i], offsets[i]);
+        } while(valid[i] && (indexes[i] < runs[i]->first));
+    }
+
+    // Repeatedly write the smallest key; there are few runs, so just scan
+    // them.
+    while(true)
+    {
+        int smallest = -1;
+        for(unsigned int i = 0; i < numRuns; i++)
+        {
+            if(valid[i] && ((smallest < 0) || (keys[i] < keys[smallest])))
+            {
+                smallest = i;
+            }
+        }
+        if(smallest < 0)
+        {
+            break;
+        }
+        addKeyToRun(*merged, keys[smallest],
+                    indexes[smallest] + indexShift[smallest],
+                    offsets[smallest] + offsetShift[smallest]);
+        do
+        {
+            valid[smallest] = readRunKey(*(runs[smallest]),
+                                         keyOffsets[smallest], keys[smallest],
+                                         indexes[smallest], offsets[smallest]);
+        } while(valid[smallest] &&
+                (indexes[smallest] < runs[smallest]->first));
+    }
+    finishRun(*merged);
+
+    for(unsigned int i = 0; i < numRuns; i++)
+    {
+        removeRun(runs[i]);
+    }
+    myRuns.resize(first);
+    myRuns.push_back(merged);
+}
+
+
+Diff::UnmatchedRecords::Run*
+Diff::UnmatchedRecords::createRun(uint32_t numRecords)
+{
+    std::stringstream fileName;
+    fileName << mySpillName << "." << ++myNumRunFiles;
+
+    Run* run = new Run;
+    run->fileName = fileName.str();
+    run->numRecords = numRecords;
+    run->numLeft = 0;
+    run->tier = 0;
+    run->first = 0;
+    run->firstOffset = 0;
+    run->removed.assign(numRecords, false);
+    run->findable.assign(numRecords, false);
+    // Round the filter up to a whole number of words.
+    run->bloom.assign(((uint64_t)numRecords * BLOOM_BITS_PER_KEY + 63) / 64 + 1,
+                      0);
+    run->numKeys = 0;
+    run->recordsEnd = 0;
+    run->keysEnd = 0;
+    run->file = fopen(run->fileName.c_str(), "w+b");
+    if(run->file == NULL)
+    {
+        delete run;
+        throw(std::runtime_error("Failed to create the temporary file " +
+                                 fileName.str()));
+    }
+    return(run);
+}
+
+
+void Diff::UnmatchedRecords::addKeyToRun(Run& run, const std::string& key,
+                                         uint32_t index, uint64_t offset)
+{
+    if((run.numKeys % RUN_BLOCK_KEYS) == 0)
+    {
+        run.blockKeys.push_back(key);
+        run.blockOffsets.push_back(run.keysEnd);
+    }
+
+    // Set the key's bits in the filter, deriving the bit positions from
+    // the two halves of the hash.
+    uint64_t hash = hashKey(key);
+    uint64_t numBits = run.bloom.size() * 64;
+    uint64_t step = (hash >> 32) | 1;
+    for(unsigned int i = 0; i < BLOOM_HASHES; i++)
+    {
+        uint64_t bit = (hash + i * step) % numBits;
+        run.bloom[bit >> 6] |= ((uint64_t)1) << (bit & 63);
+    }
+
+    // Each key is its length, the key, the record's index, & the
+    // record's offset (native endian, only this process reads the file).
+    uint16_t length = key.size();
+    if((fwrite(&length, sizeof(length), 1, run.file) != 1) ||
+       (fwrite(key.data(), 1, length, run.file) != length) ||
+       (fwrite(&index, sizeof(index), 1, run.file) != 1) ||
+       (fwrite(&offset, sizeof(offset), 1, run.file) != 1))
+    {
+        throw(std::runtime_error("Failed to write the temporary file " +
+                                 run.fileName));
+    }
+    run.keysEnd += sizeof(length) + length + sizeof(index) + sizeof(offset);
+    ++run.numKeys;
+}
+
+
+void Diff::UnmatchedRecords::finishRun(Run& run)
+{
+    if(fflush(run.file) != 0)
+    {
+        throw(std::runtime_error("Failed to write the temporary file " +
+                                 run.fileName));
+    }
+}
+
+
+bool Diff::UnmatchedRecords::readRunKey(Run& run, uint64_t& keyOffset,
+                                        std::string& key, uint32_t& index,
+                                        uint64_t& offset)
+{
+    if(keyOffset >= run.keysEnd)
+    {
+        return(false);
+    }
+    uint16_t length = 0;
+    if(fread(&length, sizeof(length), 1, run.file) != 1)
+    {
+        throw(std::runtime_error("Failed to read the temporary file " +
+                                 run.fileName));
+    }
+    key.resize(length);
+    if(((length != 0) && (fread(&(key[0]), 1, length, run.file) != length)) ||
+       (fread(&index, sizeof(index), 1, run.file) != 1) ||
+       (fread(&offset, sizeof(offset), 1, run.file) != 1))
+    {
+        throw(std::runtime_error("Failed to read the temporary file " +
+                                 run.fileName));
+    }
+    keyOffset += sizeof(length) + length + sizeof(index) + sizeof(offset);
+    return(true);
+}
+
+
+void Diff::UnmatchedRecords::removeRun(Run* run)
+{
+    fclose(run->file);
+    remove(run->fileName.c_str());
+    delete run;
+}
+
+
+void Diff::UnmatchedRecords::parseBuffer(const char* buffer, uint32_t size,
+                                         SamRecord& record)
+{
+    if(record.setBuffer(buffer, size, *myHeader) != SamStatus::SUCCESS)
+    {
+        throw(std::runtime_error("Failed to parse a stored unmatched record"));
+    }
+}
+
+
+void Diff::UnmatchedRecords::readRunRecord(Run& run, uint64_t offset,
+                                           SamRecord& record)
+{
+    int32_t blockSize = 0;
+    if((fseek(run.file, offset, SEEK_SET) != 0) ||
+       (fread(&blockSize, sizeof(int32_t), 1, run.file) != 1))
+    {
+        throw(std::runtime_error("Failed to read the temporary file " +
+                                 run.fileName));
+    }
+    uint32_t size = blockSize + sizeof(int32_t);
+    myReadBuffer.resize(size);
+    memcpy(&(myReadBuffer[0]), &blockSize, sizeof(int32_t));
+    if(fread(&(myReadBuffer[sizeof(int32_t)]), 1, blockSize, run.file) !=
+       (uint32_t)blockSize)
+    {
+        throw(std::runtime_error("Failed to read the temporary file " +
+                                 run.fileName));
+    }
+    parseBuffer(myReadBuffer.data(), size, record);
+}
+
+
+bool Diff::UnmatchedRecords::findInRuns(const std::string& key,
+                                        unsigned int& runIndex,
+                                        uint32_t& index, uint64_t& offset)
+{
+    uint64_t hash = hashKey(key);
+    uint64_t step = (hash >> 32) | 1;
+    std::string runKey;
+    for(runIndex = 0; runIndex < myRuns.size(); runIndex++)
+    {
+        Run& run = *(myRuns[runIndex]);
+        uint64_t numBits = run.bloom.size() * 64;
+        bool inFilter = true;
+        for(unsigned int i = 0; (i < BLOOM_HASHES) && inFilter; i++)
+        {
+            uint64_t bit = (hash + i * step) % numBits;
+            inFilter =
+                ((run.bloom[bit >> 6] & (((uint64_t)1) << (bit & 63))) != 0);
+        }
+        if(!inFilter)
+        {
+            continue;
+        }
+
+        // Records with the same key may start in the block before the
+        // first block starting at or after the key.
+        size_t block =
+            std::lower_bound(run.blockKeys.begin(), run.blockKeys.end(),
+                             key) - run.blockKeys.begin();
+        if(block != 0)
+        {
+            --block;
+        }
+        if(fseek(run.file, run.blockOffsets[block], SEEK_SET) != 0)
+        {
+            throw(std::runtime_error("Failed to read the temporary file " +
+                                     run.fileName));
+        }
+        uint64_t keyOffset = run.blockOffsets[block];
+        while(readRunKey(run, keyOffset, runKey, index, offset))
+        {
+            int cmp = runKey.compare(key);
+            if(cmp > 0)
+            {
+                // Passed where the key would be.
+                break;
+            }
+            if((cmp == 0) && run.findable[index])
+            {
+                return(true);
+            }
+        }
+    }
+    return(false);
+}
+
+
+void Diff::UnmatchedRecords::hideKey(const std::string& key)
+{
+    unsigned int runIndex;
+    uint32_t index;
+    uint64_t offset;
+    if(findInRuns(key, runIndex, index, offset))
+    {
+        myRuns[runIndex]->findable[index] = false;
+    }
+}
+
+
+void Diff::UnmatchedRecords::removeFromRun(unsigned int runIndex,
+                                           uint32_t index)
+{
+    Run* run = myRuns[runIndex];
+    if((runIndex == 0) && (index == run->first))
+    {
+        myFirstLoaded = false;
+    }
+    run->removed[index] = true;
+    run->findable[index] = false;
+    --run->numLeft;
+    --myNumInRuns;
+    if(run->numLeft == 0)
+    {
+        removeRun(run);
+        myRuns.erase(myRuns.begin() + runIndex);
+        return;
+    }
+
+    // Move the first record past the removed ones.
+    while(run->removed[run->first])
+    {
+        int32_t blockSize = 0;
+        if((fseek(run->file, run->firstOffset, SEEK_SET) != 0) ||
+           (fread(&blockSize, sizeof(int32_t), 1, run->file) != 1))
+        {
+            throw(std::runtime_error("Failed to read the temporary file " +
+                                     run->fileName));
+        }
+        run->firstOffset += blockSize + sizeof(int32_t);
+        ++run->first;
+    }
+}
+
+
+void Diff::UnmatchedRecords::eraseEntry(listType::iterator entry)
+{
+    if(myRuns.empty() && (entry == myListUnmatched.begin()))
+    {
+        myFirstLoaded = false;
+    }
+    myListUnmatched.erase(entry);
 }
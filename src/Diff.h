@@ -22,11 +22,16 @@
 #ifndef __DIFF_H__
 #define __DIFF_H__
 
-#include <stack>
+#include <stdio.h>
 #include <list>
-#include <map>
+#include <unordered_map>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
 #include "BamExecutable.h"
 #include "SamFile.h"
+#include "SamInputFile.h"
 
 class Diff : public BamExecutable
 {
@@ -56,48 +61,259 @@ private:
     class FileInfo
     {
     public:
-        SamFile file;
+        FileInfo() : file(), header(), sections(), nextSection(0) {}
+
+        SamInputFile file;
         SamFileHeader header;
+        // Index sections (reference ids) to read after the current one
+        // when diffing a partition.
+        std::vector<int32_t> sections;
+        size_t nextSection;
     };
     
     
+    // Records waiting for a match, stored as their BAM buffers in a hash
+    // keyed on the read name & fragment.  Optionally, the oldest records
+    // are moved to run files on disk: each run holds the records in the
+    // order they were added followed by their keys sorted.  Only a Bloom
+    // filter, a sparse index of the sorted keys & a couple of bits per
+    // record are kept in memory for a run, so a key that is not in a run
+    // rarely reads its file.
     class UnmatchedRecords
     {
     public:
-        UnmatchedRecords()
-            : myListUnmatched(),
-              myFragmentMaps(4),
-              myUnmatchedFileIter()
-        {
-        }
+        UnmatchedRecords();
+
+        // Removes the run files if there are any.
+        ~UnmatchedRecords();
 
         // Return the number of elements in this unmatched record container.
-        inline int size() { return(myListUnmatched.size()); }
-        
-        // Add the specified record to the list of unmatched records.
+        inline uint64_t size()
+        { return(myListUnmatched.size() + myNumInRuns); }
+
+        // Return the number of records kept in memory.
+        inline int memSize() { return(myListUnmatched.size()); }
+
+        // Set the header used to read back the records.
+        void setHeader(SamFileHeader& header) { myHeader = &header; }
+
+        // Set the name the run files are named after.
+        void setSpillFile(const std::string& fileName);
+
+        // Add a copy of the specified record to the unmatched records.
         void addUnmatchedRecord(SamRecord& record);
 
         // Get and remove the record that matches the specified record's
         // query(read) name and fragment (first/last/mid/unknown).
-        // If no match is found, return NULL.
+        // If no match is found, return NULL.  The returned record is
+        // valid until the next call.
         SamRecord* removeFragmentMatch(SamRecord& record);
         
         // Remove the first entry from this unmatched file container, returning a pointer
-        // to the record.
+        // to the record, which is valid until the next call.
         SamRecord* removeFirst();
         // Get the first entry from this unmatched file container, returning a pointer
         // to the record without removing it.
         SamRecord* getFirst();
 
+        // Move the oldest half of the records in memory to a new run,
+        // returning the number of records moved (0 if there are none).
+        uint32_t spillOldest();
+
     private:
+        UnmatchedRecords(const UnmatchedRecords&);
+        UnmatchedRecords& operator=(const UnmatchedRecords&);
+
+        struct Entry
+        {
+            std::string key;
+            // The record's BAM buffer.
+            std::string buffer;
+        };
+
+        // Records moved to disk, in the order they were added, followed by
+        // their keys sorted, each with the record's index & offset.
+        struct Run
+        {
+            std::string fileName;
+            FILE* file;
+            uint32_t numRecords;
+            uint32_t numLeft;
+            // 0 for a spilled run, 1 more than the runs merged into it.
+            unsigned int tier;
+            // The first record not yet removed & its offset in the file.
+            uint32_t first;
+            uint64_t firstOffset;
+            // Whether each record was removed, & whether it can be found
+            // by its key (like the hash, only the latest record added with
+            // a key can be found).
+            std::vector<bool> removed;
+            std::vector<bool> findable;
+            std::vector<uint64_t> bloom;
+            // The first key of each block of RUN_BLOCK_KEYS keys & its
+            // offset in the file.
+            std::vector<std::string> blockKeys;
+            std::vector<uint64_t> blockOffsets;
+            uint32_t numKeys;
+            // The keys start at the end of the records.
+            uint64_t recordsEnd;
+            uint64_t keysEnd;
+        };
+
+        typedef std::list<Entry> listType;
+        typedef std::unordered_map<std::string, listType::iterator> mapType;
+
+        // Set myKey to the fragment & read name of the record.
+        void setKey(SamRecord& record);
+
+        static uint64_t hashKey(const std::string& key);
+
+        // Parse the BAM buffer into the specified record.
+        void parseBuffer(const char* buffer, uint32_t size,
+                         SamRecord& record);
+
+        // Read the run's record at the specified offset into the record.
+        void readRunRecord(Run& run, uint64_t offset, SamRecord& record);
+
+        // Merge the runs from the specified one to the last into a single
+        // run of the next tier.
+        void mergeRuns(unsigned int first);
+
+        // Open a new run file for the specified number of records.
+        Run* createRun(uint32_t numRecords);
+
+        // Add a key to the end of the run being created.
+        void addKeyToRun(Run& run, const std::string& key, uint32_t index,
+                         uint64_t offset);
+
+        // Finish writing a run.
+        void finishRun(Run& run);
+
+        // Read the key at the run's current file position, which is the
+        // specified key offset, advancing the offset.  Returns false at
+        // the end of the keys.
+        bool readRunKey(Run& run, uint64_t& keyOffset, std::string& key,
+                        uint32_t& index, uint64_t& offset);
+
+        // Close & remove the run's file & delete it.
+        void removeRun(Run* run);
+
+        // Find the record that can be found by the key in the runs,
+        // setting its run, index & offset.
+        bool findInRuns(const std::string& key, unsigned int& runIndex,
+                        uint32_t& index, uint64_t& offset);
+
+        // Make the record that can be found by the key unfindable, as
+        // when the hash entry for the key is replaced or erased.
+        void hideKey(const std::string& key);
 
-        typedef std::map<std::string, std::list<SamRecord*>::iterator> mapType;
-        std::list<SamRecord*> myListUnmatched;
-        std::vector<mapType> myFragmentMaps;
-        std::map<std::string,std::list<SamRecord*>::iterator>::iterator myUnmatchedFileIter;
+        // Mark a record of a run removed, removing the run once empty.
+        void removeFromRun(unsigned int runIndex, uint32_t index);
 
+        // Remove the entry from the list.
+        void eraseEntry(listType::iterator entry);
+
+        static const unsigned int RUN_BLOCK_KEYS = 64;
+        static const unsigned int MERGE_RUNS = 8;
+        static const unsigned int BLOOM_BITS_PER_KEY = 10;
+        static const unsigned int BLOOM_HASHES = 7;
+
+        listType myListUnmatched;
+        mapType myFragmentMap;
+        std::string myKey;
+        SamFileHeader* myHeader;
+
+        // The runs, oldest first; all are older than the records in memory.
+        std::vector<Run*> myRuns;
+        uint64_t myNumInRuns;
+        unsigned int myNumRunFiles;
+        std::string mySpillName;
+
+        // getFirst's record is kept until the first entry changes, when
+        // it becomes the removed record.
+        SamRecord myRecords[2];
+        SamRecord* myFirstRecord;
+        bool myFirstLoaded;
+        SamRecord* myRemovedRecord;
+        std::string myReadBuffer;
+    };
+
+    // Diff the records of myFile1 & myFile2, returning the status.
+    int diffRecords();
+
+    // Read the next record from the file, moving on to the file's next
+    // section when the current one is done.
+    bool readRecord(FileInfo& info, SamRecord& record);
+
+    ///////////////////////////////////////////////////////////////////
+    // Methods to diff each reference of two indexed BAMs on its own thread.
+
+    // References diffed by a worker thread into temporary files that are
+    // then copied to the outputs.
+    struct Partition
+    {
+        std::vector<int32_t> refIDs;
+        std::string tmpBase;
+        std::string diffName;
+        std::string only1Name;
+        std::string only2Name;
+        std::string bamDiffName;
+        bool done;
+        int status;
+    };
+
+    // Partitions shared by the worker threads.
+    struct PartitionList
+    {
+        std::vector<Partition> partitions;
+        size_t next;
+        // Number of partitions copied to the outputs.  Workers only start
+        // partitions before copied + maxAhead, so at most maxAhead
+        // partitions wait in temporary files.
+        size_t copied;
+        size_t maxAhead;
+        bool stop;
+        std::mutex mutex;
+        std::condition_variable doneCond;
+        std::condition_variable copiedCond;
     };
 
+    // Return whether or not both inputs are indexed BAMs with the same
+    // number of references that can be diffed by reference on --threads
+    // (at least 2) worker threads.
+    // tailRefID is set to the first of the last references, which are
+    // diffed together with the unmapped reads.
+    bool canPartition(const String& inFile1, const String& inFile2,
+                      int32_t& tailRefID);
+
+    // Return the last reference of the indexed file that has records,
+    // -1 if none do.
+    int32_t lastReference(SamInputFile& samIn, SamFileHeader& header,
+                          int32_t numRefs);
+
+    // Diff the references on worker threads, copying the results to the
+    // outputs in order as they complete.
+    int processPartitions(const String& inFile1, const String& inFile2,
+                          int32_t tailRefID);
+
+    // Setup this object as a worker with the settings of the parent.
+    void initPartitionWorker(const Diff& parent);
+
+    // Diff partitions until there are none left, run on a worker thread.
+    void diffPartitions(PartitionList& list, std::string inFile1,
+                        std::string inFile2);
+
+    // Diff the records of a single partition into its temporary files.
+    int diffPartition(const Partition& partition);
+
+    // Copy the records of a partition's temporary file to the output,
+    // opening it first if needed.  A missing file has no records.
+    bool copyBamPartition(const std::string& partName, SamFile& out,
+                          const String& outName, SamFileHeader& header);
+
+    // Copy a partition's temporary diff file to the diff output.
+    bool copyDiffPartition(const std::string& partName);
+
     // Check to see if the two records are a match - same read name & fragment.
     // Return true if they match, false if not.
     bool matchingRecs(SamRecord* rec1, SamRecord* rec2);
@@ -114,10 +330,19 @@ private:
     void writeDiffDiffs(SamRecord* rec1, SamRecord* rec2);
     void writeDiffs(SamRecord* rec1, SamRecord* rec2);
     bool getDiffs(SamRecord* rec1, SamRecord* rec2);
+
+    // Return true if the fields being compared are the same in the BAM
+    // buffers of both records.  False means they might differ.
+    bool sameBamFields(SamRecord& rec1, SamRecord& rec2);
+
+    // Return whether or not the file is a BAM file (not stdin).
+    static bool isBamFile(const String& fileName);
     bool writeReadName(SamRecord& record);
-    SamRecord* getSamRecord();
-    // If record is not NULL, adds it back to the free list.  If record is NULL, nothing is done.
-    void releaseSamRecord(SamRecord* record);
+
+    // Called after a record is stored: keep the records within
+    // --recPoolSize by spilling the oldest records of the longer unmatched
+    // list or, if not spilling, reporting it as unmatched.
+    void limitUnmatched();
 
     bool checkDiffFile();
     
@@ -137,7 +362,8 @@ private:
     static const char QUAL_DIFF_TYPE = 'Z';
     static const char TAGS_DIFF_TYPE = 'Z';
 
-    std::stack<SamRecord*> myFreeSamRecords;
+    SamRecord myRecord1;
+    SamRecord myRecord2;
 
     UnmatchedRecords myFile1Unmatched;
     UnmatchedRecords myFile2Unmatched;
@@ -155,11 +381,23 @@ private:
     bool myEveryTag;
     bool myOnlyDiffs;
     bool myBamOut;
+    // Whether or not both inputs are BAM files, so the records can first
+    // be compared by their BAM buffers.
+    bool myCompBuffers;
 
     int myMaxAllowedRecs;
-    int myAllocatedRecs;
     int myThreshold;
     int myNumPoolOverflows;
+    bool mySpill;
+    uint64_t myNumSpilled;
+    // Prefix of the temporary files.
+    std::string myTmpBase;
+
+    // Whether or not the records being diffed are followed by the
+    // records of another partition, which are represented by
+    // myPartitionEnd once a file has no more records.
+    bool myLaterRefs;
+    SamRecord myPartitionEnd;
 
     FileInfo myFile1;
     FileInfo myFile2;
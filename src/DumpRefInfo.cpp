@@ -80,7 +80,7 @@ int DumpRefInfo::execute(int argc, char **argv)
     if(noeof)
     {
         // Set that the eof block is not required.
-        BgzfFileType::setRequireEofBlock(false);
+        setRequireEofBlock(false);
     }
 
     // Check to see if the in file was specified, if not, report an error.
@@ -0,0 +1,200 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "FastQWriter.h"
+
+FastQWriter::FastQWriter()
+    : myOpen(false),
+      myGzip(false),
+      myFailed(false),
+      myFile(NULL),
+      myCloseFile(false),
+      myBufferSize(BUFFER_SIZE),
+      myBgzfWriter(),
+      myBuffer()
+{
+}
+
+
+FastQWriter::~FastQWriter()
+{
+    close();
+}
+
+
+bool FastQWriter::open(const char* filename, bool gzip, int level)
+{
+    close();
+
+    myGzip = gzip;
+    myFailed = false;
+    if(myGzip)
+    {
+        if(!myBgzfWriter.open(filename, level))
+        {
+            return(false);
+        }
+    }
+    else
+    {
+        if(strcmp(filename, "-") == 0)
+        {
+            myFile = stdout;
+            myCloseFile = false;
+        }
+        else
+        {
+            myFile = fopen(filename, "w");
+            myCloseFile = true;
+        }
+        if(myFile == NULL)
+        {
+            return(false);
+        }
+    }
+    myBufferSize = BUFFER_SIZE;
+    if(strcmp(filename, "-") == 0)
+    {
+        myBufferSize = PIPE_BUFFER_SIZE;
+    }
+    myBuffer.clear();
+    myBuffer.reserve(myBufferSize);
+    myOpen = true;
+    return(true);
+}
+
+
+bool FastQWriter::writeRecord(const char* readName, const char* readNameExt,
+                              const std::string& sequence,
+                              const char* quality, bool rnPlus)
+{
+    if(!myOpen)
+    {
+        return(false);
+    }
+
+    appendRecord(myBuffer, readName, readNameExt, sequence, quality, rnPlus);
+
+    if(myBuffer.size() >= myBufferSize)
+    {
+        writeBuffer();
+    }
+    return(!myFailed);
+}
+
+
+void FastQWriter::appendRecord(std::string& buffer, const char* readName,
+                               const char* readNameExt,
+                               const std::string& sequence,
+                               const char* quality, bool rnPlus)
+{
+    buffer += '@';
+    buffer += readName;
+    buffer += readNameExt;
+    buffer += '\n';
+    buffer += sequence;
+    buffer += "\n+";
+    if(rnPlus)
+    {
+        buffer += readName;
+        buffer += readNameExt;
+    }
+    buffer += '\n';
+    buffer += quality;
+    buffer += '\n';
+}
+
+
+bool FastQWriter::flush()
+{
+    if(!myOpen)
+    {
+        return(false);
+    }
+    writeBuffer();
+    if(myGzip)
+    {
+        if(!myBgzfWriter.flush())
+        {
+            myFailed = true;
+        }
+    }
+    else if(fflush(myFile) != 0)
+    {
+        myFailed = true;
+    }
+    return(!myFailed);
+}
+
+
+bool FastQWriter::close()
+{
+    if(!myOpen)
+    {
+        return(false);
+    }
+
+    writeBuffer();
+    if(myGzip)
+    {
+        if(!myBgzfWriter.close())
+        {
+            myFailed = true;
+        }
+    }
+    else
+    {
+        if(myCloseFile)
+        {
+            if(fclose(myFile) != 0)
+            {
+                myFailed = true;
+            }
+        }
+        else if(fflush(myFile) != 0)
+        {
+            myFailed = true;
+        }
+        myFile = NULL;
+    }
+    myOpen = false;
+    return(!myFailed);
+}
+
+
+void FastQWriter::writeBuffer()
+{
+    if(myBuffer.empty())
+    {
+        return;
+    }
+    if(myGzip)
+    {
+        // The BgzfWriter cuts the buffer into blocks & compresses them.
+        if(!myBgzfWriter.write(myBuffer.data(), myBuffer.size()))
+        {
+            myFailed = true;
+        }
+    }
+    else if(fwrite(myBuffer.data(), 1, myBuffer.size(), myFile) !=
+            myBuffer.size())
+    {
+        myFailed = true;
+    }
+    myBuffer.clear();
+}
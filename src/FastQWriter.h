@@ -0,0 +1,92 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//////////////////////////////////////////////////////////////////////////
+// Buffered writer for FASTQ files, optionally gzip compressed on the
+// shared thread pool.
+
+#ifndef __FASTQ_WRITER_H__
+#define __FASTQ_WRITER_H__
+
+#include <stdio.h>
+#include <string>
+#include "BgzfWriter.h"
+
+/// Writes FASTQ records, formatting them into a large buffer rather than
+/// printing each field.  Compressed output is written as BGZF: a series
+/// of independent gzip members that are compressed in parallel on the
+/// shared ThreadPool (if one has been set up) and are read back by
+/// standard gzip tools as a single stream.
+class FastQWriter
+{
+public:
+    FastQWriter();
+
+    /// Closes the file if it is still open.
+    ~FastQWriter();
+
+    /// Open the specified file for writing ("-" writes to stdout),
+    /// gzip compressing it at the specified level (-1 is the zlib
+    /// default) if gzip is true.
+    bool open(const char* filename, bool gzip, int level = -1);
+
+    /// Return whether or not this writer is open.
+    bool isOpen() const { return(myOpen); }
+
+    /// Write a FASTQ record.  If rnPlus is true, the read name is also
+    /// written on the '+' line.
+    bool writeRecord(const char* readName, const char* readNameExt,
+                     const std::string& sequence, const char* quality,
+                     bool rnPlus);
+
+    /// Append a FASTQ record to the buffer without writing it.
+    static void appendRecord(std::string& buffer, const char* readName,
+                             const char* readNameExt,
+                             const std::string& sequence,
+                             const char* quality, bool rnPlus);
+
+    /// Write the buffered records.
+    bool flush();
+
+    /// Flush & close the file.  Returns false if any write failed.
+    bool close();
+
+    /// Size the buffer is allowed to reach before it is written.
+    static const unsigned int BUFFER_SIZE = 0x100000;
+
+    /// Smaller buffer size used when writing to stdout, so a process
+    /// reading from a pipe gets the records sooner.
+    static const unsigned int PIPE_BUFFER_SIZE = 0x10000;
+
+private:
+    FastQWriter(const FastQWriter&);
+    FastQWriter& operator=(const FastQWriter&);
+
+    // Write the buffer to the file.
+    void writeBuffer();
+
+    bool myOpen;
+    bool myGzip;
+    bool myFailed;
+    FILE* myFile;
+    bool myCloseFile;
+    unsigned int myBufferSize;
+    BgzfWriter myBgzfWriter;
+    std::string myBuffer;
+};
+
+#endif
@@ -38,7 +38,7 @@ void Filter::printDescription(std::ostream& os)
 void Filter::printUsage(std::ostream& os)
 {
     BamExecutable::printUsage(os);
-    os << "\t./bam filter --in <inputFilename>  --refFile <referenceFilename>  --out <outputFilename> [--noeof] [--qualityThreshold <qualThresh>] [--defaultQualityInt <defaultQual>] [--mismatchThreshold <mismatchThresh>] [--params]"<< std::endl;
+    os << "\t./bam filter --in <inputFilename>  --refFile <referenceFilename>  --out <outputFilename> [--noeof] [--qualityThreshold <qualThresh>] [--defaultQualityInt <defaultQual>] [--mismatchThreshold <mismatchThresh>] [--params] [--threads <numThreads>] [--level <0-9>]"<< std::endl;
     os << "\tRequired Parameters:" << std::endl;
     os << "\t\t--in       : the SAM/BAM file to be read" << std::endl;
     os << "\t\t--refFile  : the reference file" << std::endl;
@@ -53,6 +53,8 @@ void Filter::printUsage(std::ostream& os)
               << "\t\t                      matches and mismatches allowed before clipping from the ends\n"
               << "\t\t                      (Defaults to .10)" << std::endl;
     os << "\t\t--params            : print the parameter settings" << std::endl;
+    os << "\t\t--threads           : number of threads for compressing BAM output (default 0)" << std::endl;
+    os << "\t\t--level             : BAM compression level, 0 (uncompressed BGZF) to 9 (default -1: zlib default)" << std::endl;
     os << std::endl;
 }
 
@@ -80,6 +82,7 @@ int Filter::execute(int argc, char **argv)
         LONG_INTPARAMETER("defaultQualityInt", &defaultQualityInt)
         LONG_DOUBLEPARAMETER("mismatchThreshold", &mismatchThreshold)
         LONG_PARAMETER("params", &params)
+        LONG_BAM_OUTPUT_PARAMETERS()
         LONG_PHONEHOME(VERSION)
         END_LONG_PARAMETERS();
    
@@ -94,7 +97,7 @@ int Filter::execute(int argc, char **argv)
     if(noeof)
     {
         // Set that the eof block is not required.
-        BgzfFileType::setRequireEofBlock(false);
+        setRequireEofBlock(false);
     }
     
     // Check to see if the in file was specified, if not, report an error.
@@ -117,6 +120,12 @@ int Filter::execute(int argc, char **argv)
         return(-1);
     }
 
+    if(!processBamIoParameters())
+    {
+        inputParameters.Status();
+        return(-1);
+    }
+
     if(params)
     {
         inputParameters.Status();
@@ -132,7 +141,7 @@ int Filter::execute(int argc, char **argv)
 
     // Open the output file.
     SamFile samOut;
-    samOut.OpenForWrite(outFile);
+    openForWrite(samOut, outFile);
 
     // Read the sam header.
     SamFileHeader samHeader;
@@ -23,6 +23,7 @@
 #include <bitset>
 #include "FindCigars.h"
 #include "SamFile.h"
+#include "SamInputFile.h"
 #include "Parameters.h"
 #include "BgzfFileType.h"
 
@@ -45,7 +46,7 @@ void FindCigars::printDescription(std::ostream& os)
 void FindCigars::printUsage(std::ostream& os)
 {
     BamExecutable::printUsage(os);
-    os << "\t./bam findCigars --in <inputFile> --out <outputFile.sam/bam/ubam (ubam is uncompressed bam)> [--cinsert] [--cdel] [--cpad] [--cskip] [--chardClip] [--csoftClip] [--nonM] [--noeof] [--params]" << std::endl;
+    os << "\t./bam findCigars --in <inputFile> --out <outputFile.sam/bam/ubam (ubam is uncompressed bam)> [--cinsert] [--cdel] [--cpad] [--cskip] [--chardClip] [--csoftClip] [--nonM] [--noeof] [--params] [--threads <numThreads>] [--level <0-9>]" << std::endl;
     os << "\tRequired Parameters:" << std::endl;
     os << "\t\t--in         : the SAM/BAM file to be read" << std::endl;
     os << "\t\t--out        : the SAM/BAM file to be written" << std::endl;
@@ -59,6 +60,8 @@ void FindCigars::printUsage(std::ostream& os)
     os << "\t\t--nonM       : output reads that contain any non match/mismatch (anything other than 'M', '=', 'X')" << std::endl;
     os << "\t\t--noeof      : do not expect an EOF block on a bam file." << std::endl;
     os << "\t\t--params     : print the parameter settings" << std::endl;
+    os << "\t\t--threads    : number of threads for BAM input & output compression (default 0)" << std::endl;
+    os << "\t\t--level      : BAM compression level, 0 (uncompressed BGZF) to 9 (default -1: zlib default)" << std::endl;
     os << std::endl;
 }
 
@@ -93,6 +96,7 @@ int FindCigars::execute(int argc, char **argv)
         LONG_PARAMETER("nonM", &nonM)
         LONG_PARAMETER("noeof", &noeof)
         LONG_PARAMETER("params", &params)
+        LONG_BAM_OUTPUT_PARAMETERS()
         LONG_PHONEHOME(VERSION)
         END_LONG_PARAMETERS();
    
@@ -107,7 +111,7 @@ int FindCigars::execute(int argc, char **argv)
     if(noeof)
     {
         // Set that the eof block is not required.
-        BgzfFileType::setRequireEofBlock(false);
+        setRequireEofBlock(false);
     }
     
     // Check to see if the in file was specified, if not, report an error.
@@ -166,6 +170,12 @@ int FindCigars::execute(int argc, char **argv)
         desiredOps[Cigar::softClip] = true;
     }
 
+    if(!processBamIoParameters())
+    {
+        inputParameters.Status();
+        return(-1);
+    }
+
     if(params)
     {
         inputParameters.Status();
@@ -180,12 +190,12 @@ int FindCigars::execute(int argc, char **argv)
     }
 
     // Open the input file for reading.
-    SamFile samIn;
+    SamInputFile samIn;
     samIn.OpenForRead(inFile);
 
     // Open the output file for writing.
     SamFile samOut;
-    samOut.OpenForWrite(outFile);
+    openForWrite(samOut, outFile);
 
     // Read the sam header.
     SamFileHeader samHeader;
@@ -18,6 +18,7 @@
 //////////////////////////////////////////////////////////////////////////
 #include "GapInfo.h"
 #include "SamFile.h"
+#include "SamInputFile.h"
 #include "BgzfFileType.h"
 #include "SamFlag.h"
 
@@ -42,7 +43,7 @@ void GapInfo::printDescription(std::ostream& os)
 void GapInfo::printUsage(std::ostream& os)
 {
     BamExecutable::printUsage(os);
-    os << "\t./bam gapInfo --in <inputFile> --out <outputFile> [--noeof] [--params]" << std::endl;
+    os << "\t./bam gapInfo --in <inputFile> --out <outputFile> [--noeof] [--params] [--threads <numThreads>]" << std::endl;
     os << "\tRequired Parameters:" << std::endl;
     os << "\t\t--in          : the SAM/BAM file to print read pair gap info for" << std::endl;
     os << "\t\t--out         : the output file to be written" << std::endl;
@@ -54,6 +55,7 @@ void GapInfo::printUsage(std::ostream& os)
     os << "\t\t--checkStrand : Check the strand flag and print \"Reverse\" if it is reverse complimented" << std::endl;
     os << "\t\t--noeof       : Do not expect an EOF block on a bam file." << std::endl;
     os << "\t\t--params      : Print the parameter settings to stderr" << std::endl;
+    os << "\t\t--threads     : number of threads for decompressing BAM input (default 0)" << std::endl;
 }
 
 
@@ -82,6 +84,7 @@ int GapInfo::execute(int argc, char **argv)
         LONG_PARAMETER("checkStrand", &checkStrand)
         LONG_PARAMETER("noeof", &noeof)
         LONG_PARAMETER("params", &params)
+        LONG_BAM_IO_PARAMETERS()
         LONG_PHONEHOME(VERSION)
         END_LONG_PARAMETERS();
    
@@ -96,7 +99,7 @@ int GapInfo::execute(int argc, char **argv)
     if(noeof)
     {
         // Set that the eof block is not required.
-        BgzfFileType::setRequireEofBlock(false);
+        setRequireEofBlock(false);
     }
 
     // Check to see if the in file was specified, if not, report an error.
@@ -121,6 +124,12 @@ int GapInfo::execute(int argc, char **argv)
         return(-1);
     }
 
+    if(!processBamIoParameters())
+    {
+        inputParameters.Status();
+        return(-1);
+    }
+
     if(params)
     {
         inputParameters.Status();
@@ -137,7 +146,7 @@ int GapInfo::processFile(const char* inputFileName, const char* outputFileName,
                          bool checkFirst, bool checkStrand)
 {
     // Open the file for reading.
-    SamFile samIn;
+    SamInputFile samIn;
     samIn.OpenForRead(inputFileName);
 
     // Read the sam header.
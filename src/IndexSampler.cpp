@@ -0,0 +1,186 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <random>
+#include "IndexSampler.h"
+#include "BamIndex.h"
+
+IndexSampler::IndexSampler()
+    : myWindows(),
+      mySampled(),
+      myTotalVolume(0),
+      mySampledVolume(0)
+{
+}
+
+
+bool IndexSampler::init(const char* indexFile, SamFileHeader& header,
+                        int32_t windowSize)
+{
+    myWindows.clear();
+    mySampled.clear();
+    myTotalVolume = 0;
+    mySampledVolume = 0;
+
+    BamIndex index;
+    if(index.readIndex(indexFile) != SamStatus::SUCCESS)
+    {
+        return(false);
+    }
+
+    const SamReferenceInfo& refInfo = header.getReferenceInfo();
+    for(int32_t refID = 0; refID < refInfo.getNumEntries(); refID++)
+    {
+        int32_t refLength = refInfo.getReferenceLength(refID);
+        for(int32_t start = 0; start < refLength; start += windowSize)
+        {
+            Window window;
+            window.refID = refID;
+            window.start = start;
+            window.end = std::min(refLength - start, windowSize) + start;
+            window.volume = 0;
+
+            // The upper 48 bits of a virtual offset are the file offset of
+            // the BGZF block, so the chunks approximate how many compressed
+            // bytes the window's records take.
+            SortedChunkList chunks;
+            if(!index.getChunksForRegion(refID, window.start, window.end,
+                                         chunks))
+            {
+                continue;
+            }
+            bool hasChunks = false;
+            while(!chunks.empty())
+            {
+                Chunk chunk = chunks.pop();
+                window.volume += (chunk.chunk_end >> 16) - (chunk.chunk_beg >> 16);
+                hasChunks = true;
+            }
+            if(!hasChunks)
+            {
+                // No records.
+                continue;
+            }
+            // Chunks within a single block still have data.
+            ++window.volume;
+            myTotalVolume += window.volume;
+            myWindows.push_back(window);
+        }
+    }
+    return(true);
+}
+
+
+void IndexSampler::sample(double fraction, uint64_t seed)
+{
+    mySampled.clear();
+    mySampledVolume = 0;
+
+    int numWindows = myWindows.size();
+    int numToSample = (int)ceil(fraction * numWindows);
+    numToSample = std::max(1, std::min(numToSample, numWindows));
+    if(numWindows == 0)
+    {
+        return;
+    }
+
+    // Partial Fisher-Yates shuffle, so every window is equally likely to
+    // be sampled.  Use the generator's output directly rather than a
+    // distribution so the same seed picks the same windows everywhere.
+    std::mt19937_64 generator(seed);
+    std::vector<int> indices(numWindows);
+    for(int i = 0; i < numWindows; i++)
+    {
+        indices[i] = i;
+    }
+    for(int i = 0; i < numToSample; i++)
+    {
+        int j = i + (int)(generator() % (uint64_t)(numWindows - i));
+        std::swap(indices[i], indices[j]);
+    }
+
+    // The windows are in position order, so sort the sampled windows by
+    // their index so the file is read in order.
+    std::sort(indices.begin(), indices.begin() + numToSample);
+    for(int i = 0; i < numToSample; i++)
+    {
+        mySampled.push_back(myWindows[indices[i]]);
+        mySampledVolume += myWindows[indices[i]].volume;
+    }
+}
+
+
+double IndexSampler::getSampledFraction() const
+{
+    if(myTotalVolume == 0)
+    {
+        return(0);
+    }
+    return(double(mySampledVolume) / myTotalVolume);
+}
+
+
+bool IndexSampler::estimateRatio(const std::vector<double>& numerators,
+                                 const std::vector<double>& denominators,
+                                 double& estimate, double& halfWidth) const
+{
+    // Every window was equally likely to be sampled, so the ratio of the
+    // sampled sums estimates the ratio of the sums over all windows.
+    int numSampled = mySampled.size();
+    double sumNum = 0;
+    double sumDenom = 0;
+    for(int i = 0; i < numSampled; i++)
+    {
+        sumNum += numerators[i];
+        sumDenom += denominators[i];
+    }
+    if(sumDenom <= 0)
+    {
+        return(false);
+    }
+    estimate = sumNum / sumDenom;
+
+    // Finite population correction: no sampling error once all of the
+    // windows are sampled.
+    double fpc = 1 - double(numSampled) / myWindows.size();
+    if(fpc <= 0)
+    {
+        halfWidth = 0;
+        return(true);
+    }
+    halfWidth = -1;
+    if(numSampled < 2)
+    {
+        return(true);
+    }
+    // Linearized variance of the ratio estimator with the windows as the
+    // sampling units:
+    //   (1 - n/N) * sum((num - R * denom)^2) / (n - 1) / (n * meanDenom^2)
+    double sumSquares = 0;
+    for(int i = 0; i < numSampled; i++)
+    {
+        double residual = numerators[i] - estimate * denominators[i];
+        sumSquares += residual * residual;
+    }
+    double meanDenom = sumDenom / numSampled;
+    double variance = fpc * sumSquares / (numSampled - 1) /
+        (numSampled * meanDenom * meanDenom);
+    halfWidth = 1.96 * sqrt(variance);
+    return(true);
+}
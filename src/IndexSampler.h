@@ -0,0 +1,90 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//////////////////////////////////////////////////////////////////////////
+// Random sampling of the windows of an indexed BAM file, and estimates
+// with confidence intervals from the sampled windows.
+
+#ifndef __INDEX_SAMPLER_H__
+#define __INDEX_SAMPLER_H__
+
+#include <stdint.h>
+#include <vector>
+#include "SamFile.h"
+
+/// Splits the references into fixed size windows, using the BAM index to
+/// skip windows without data, and picks a simple random sample (without
+/// replacement) of the requested fraction of the windows.
+///
+/// Statistics that are ratios of per record or per base counts are
+/// estimated by the ratio of their sums over the sampled windows.  Windows
+/// are the sampling units, so the confidence interval accounts for records
+/// of the same window being alike, & it includes the finite population
+/// correction so it shrinks to the exact value as all windows are sampled.
+class IndexSampler
+{
+public:
+    /// A window of a reference, 0-based with an exclusive end.
+    struct Window
+    {
+        int32_t refID;
+        int32_t start;
+        int32_t end;
+        uint64_t volume;
+    };
+
+    IndexSampler();
+
+    /// Read the index & split the references of the header into windows.
+    /// The index chunks of each window give its data (compressed bytes).
+    /// Returns false if the index could not be read.
+    bool init(const char* indexFile, SamFileHeader& header,
+              int32_t windowSize);
+
+    /// Randomly pick the fraction of the windows (at least 1), each window
+    /// equally likely.  The sampled windows are sorted by position.
+    void sample(double fraction, uint64_t seed);
+
+    /// Return the number of windows that have data.
+    int getNumWindows() const { return(myWindows.size()); }
+
+    /// Return the number of sampled windows.
+    int getNumSampled() const { return(mySampled.size()); }
+
+    /// Return the specified sampled window.
+    const Window& getSampled(int index) const { return(mySampled[index]); }
+
+    /// Return the fraction of the data in the sampled windows.
+    double getSampledFraction() const;
+
+    /// Estimate the ratio of the sums of numerators to denominators over
+    /// all windows from their values in each sampled window.  Sets the
+    /// half width of the 95% confidence interval, which is 0 if all windows
+    /// were sampled & negative if it cannot be calculated (fewer than 2
+    /// sampled windows).  Returns false if the denominators are all 0.
+    bool estimateRatio(const std::vector<double>& numerators,
+                       const std::vector<double>& denominators,
+                       double& estimate, double& halfWidth) const;
+
+private:
+    std::vector<Window> myWindows;
+    std::vector<Window> mySampled;
+    uint64_t myTotalVolume;
+    uint64_t mySampledVolume;
+};
+
+#endif
@@ -21,7 +21,7 @@
 #include <stdexcept>
 #include "Logger.h"
 
-Logger* Logger::gLogger = NULL;
+thread_local Logger* Logger::gLogger = NULL;
 
 // Constructor of logger
 Logger::Logger(const char* filename, bool verbose) 
@@ -31,7 +31,8 @@ class Logger {
 
   Logger() {} // default constructor prohibited
  public:
-  static Logger* gLogger;
+  // Per thread so each pipeline stage can have its own log.
+  static thread_local Logger* gLogger;
   Logger(const char* filename, bool verbose);
   void writeLog(const char* format, ...);
   void error(const char* format, ...);
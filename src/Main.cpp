@@ -33,6 +33,7 @@
 #include "ReadReference.h"
 #include "Revert.h"
 #include "Diff.h"
+#include "Checksum.h"
 #include "Squeeze.h"
 #include "FindCigars.h"
 #include "Stats.h"
@@ -46,7 +47,10 @@
 #include "Dedup_LowMem.h"
 #include "Recab.h"
 #include "Bam2FastQ.h"
+#include "Pipeline.h"
 #include "PhoneHome.h"
+#include "BgzfPipe.h"
+#include "ThreadPool.h"
 
 // May add option to print to console in red for errors.
 namespace console_color
@@ -91,10 +95,12 @@ void WriteUsage(std::ostream& os)
     Dedup::printDedupDescription(os);
     Dedup_LowMem::printDedup_LowMemDescription(os);
     Recab::printRecabDescription(os);
+    Pipeline::printPipelineDescription(os);
 
     os << "\nInformational Tools\n";
     Validate::printValidateDescription(os);
     Diff::printDiffDescription(os);
+    Checksum::printChecksumDescription(os);
     Stats::printStatsDescription(os);
     GapInfo::printGapInfoDescription(os);
 
@@ -164,6 +170,10 @@ BamExecutable* CreateBamExe(const std::string& name)
     {
         ret = new Diff();
     }
+    else if(name == "checksum")
+    {
+        ret = new Checksum();
+    }
     else if(name == "squeeze")
     {
         ret = new Squeeze();
@@ -221,6 +231,10 @@ BamExecutable* CreateBamExe(const std::string& name)
     {
         ret = new Convert();
     }
+    else if(name == "pipeline")
+    {
+        ret = new Pipeline(CreateBamExe);
+    }
 
     return ret;
 }
@@ -286,10 +300,16 @@ int main(int argc, char ** argv)
                     std::cerr << errorMsg << std::endl;
                     return(-1);
                 }
-                compStatus = ret;
-                PhoneHome::completionStatus(compStatus.c_str());
                 delete bamExe;
                 bamExe = NULL;
+                // Wait for any output still being compressed.
+                if(!BgzfPipe::finishAll() && (ret == 0))
+                {
+                    ret = -1;
+                }
+                ThreadPool::setSharedPoolSize(0);
+                compStatus = ret;
+                PhoneHome::completionStatus(compStatus.c_str());
             }
             else
             {
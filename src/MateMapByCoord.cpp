@@ -15,25 +15,48 @@
  *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <string.h>
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
 #include "MateMapByCoord.h"
 #include "SamHelper.h"
 
+// Starting number of slots in the table, must be a power of 2.
+static const uint32_t INITIAL_TABLE_SIZE = 1024;
+
 MateMapByCoord::MateMapByCoord(bool mateCoord)
-    : myMateBuffer(),
-      myMateCoord(mateCoord)
+    : myTable(INITIAL_TABLE_SIZE),
+      myMask(INITIAL_TABLE_SIZE - 1),
+      myOrder(),
+      myMateCoord(mateCoord),
+      myNextOrder(0),
+      myNumRecords(0),
+      myPool(NULL),
+      mySpillSize(0),
+      myRuns(),
+      myPeakRecords(0),
+      myNumLookups(0),
+      myNumProbes(0),
+      myMaxProbe(0),
+      myNumNameCollisions(0),
+      myNumResizes(0)
 {
+    for(uint32_t i = 0; i < myTable.size(); i++)
+    {
+        myTable[i].record = NULL;
+    }
 }
 
 
 MateMapByCoord::~MateMapByCoord()
 {
-    myMateBuffer.clear();
+    myTable.clear();
 }
 
 
 SamRecord* MateMapByCoord::getMate(SamRecord& record)
 {
-    SamRecord* mate = NULL;
     const char* readName = record.getReadName();
 
     // Get the key for finding this mate (its chrom/pos).
@@ -52,68 +75,356 @@ SamRecord* MateMapByCoord::getMate(SamRecord& record)
         mateKey = SamHelper::combineChromPos(record.getMateReferenceID(), 
                                          record.get0BasedMatePosition());
     }
+    uint32_t nameHash = hashReadName(readName);
 
-    std::pair<MATE_MAP::iterator,MATE_MAP::iterator> matches;
+    // Bring back any spilled records whose mates are at or before this
+    // record.
+    reload(SamHelper::combineChromPos(record.getReferenceID(), 
+                                      record.get0BasedPosition()));
 
-    // Find for the elements with this key.
-    matches = myMateBuffer.equal_range(mateKey);
+    ++myNumLookups;
 
-    // Loop through the elements that matched the key looking for the mate.
-    for(MATE_MAP::iterator iter = matches.first; 
-        iter != matches.second; iter++)
+    // Probe until an empty slot, only comparing read names
+    // when both the position & read name hash match.
+    uint32_t probeLen = 0;
+    for(uint32_t index = homeIndex(mateKey, nameHash);
+        myTable[index].record != NULL; index = (index + 1) & myMask)
     {
-        if(strcmp(((*iter).second)->getReadName(), readName) == 0)
+        ++probeLen;
+        MateEntry& entry = myTable[index];
+        if((entry.chromPos == mateKey) && (entry.nameHash == nameHash))
         {
-            // Found the match.
-            mate = (*iter).second;
-            // Remove the entry from the map.
-            myMateBuffer.erase(iter);
-            break;
+            if(strcmp(entry.record->getReadName(), readName) == 0)
+            {
+                // Found the match, remove it from the table.  Its
+                // heap entry is removed when it reaches the top.
+                SamRecord* mate = entry.record;
+                myNumProbes += probeLen;
+                removeIndex(index);
+                return(mate);
+            }
+            ++myNumNameCollisions;
         }
     }
-    return(mate);
+    myNumProbes += probeLen;
+    return(NULL);
 }
 
 
 void MateMapByCoord::add(SamRecord& record)
 {
-    uint64_t chromPos;
+    MateEntry entry;
 
     if(myMateCoord)
     {
-        chromPos = SamHelper::combineChromPos(record.getMateReferenceID(),
-                                              record.get0BasedMatePosition());
+        entry.chromPos = 
+            SamHelper::combineChromPos(record.getMateReferenceID(),
+                                       record.get0BasedMatePosition());
     }
     else
     {
-        chromPos = SamHelper::combineChromPos(record.getReferenceID(),
-                                              record.get0BasedPosition());
+        entry.chromPos = 
+            SamHelper::combineChromPos(record.getReferenceID(),
+                                       record.get0BasedPosition());
+    }
+    entry.order = myNextOrder++;
+    entry.nameHash = hashReadName(record.getReadName());
+    entry.record = &record;
+
+    reload(SamHelper::combineChromPos(record.getReferenceID(), 
+                                      record.get0BasedPosition()));
+
+    // Keep the table at most 70% full.
+    if((uint64_t)(myNumRecords + 1) * 10 > (uint64_t)myTable.size() * 7)
+    {
+        grow();
     }
+    insertEntry(entry);
+    myOrder.push(entry);
 
-    myMateBuffer.insert(MATE_MAP_PAIR(chromPos, &record));
+    if(myNumRecords > myPeakRecords)
+    {
+        myPeakRecords = myNumRecords;
+    }
+
+    if((mySpillSize != 0) && (myNumRecords > mySpillSize))
+    {
+        spill();
+    }
 }
 
 
 SamRecord* MateMapByCoord::first()
 {
-    MATE_MAP::iterator first = myMateBuffer.begin();
-    if(first == myMateBuffer.end())
+    cleanOrder();
+    // Spilled records are first if they are at or before the first
+    // record in memory.
+    if(!myRuns.empty() &&
+       (myOrder.empty() || (myRuns.nextKey() <= myOrder.top().chromPos)))
+    {
+        reload(myRuns.nextKey());
+        cleanOrder();
+    }
+    if(myOrder.empty())
     {
         return(NULL);
     }
 
     // Return the record from the first element.
-    return(first->second);
+    return(myOrder.top().record);
 }
 
 
 void MateMapByCoord::popFirst()
 {
-    MATE_MAP::iterator first = myMateBuffer.begin();
-    if(first != myMateBuffer.end())
+    if(first() != NULL)
     {
         // There is a first element, so remove it.
-        myMateBuffer.erase(first);
+        removeIndex(findEntry(myOrder.top()));
+        myOrder.pop();
     }
     return;
 }
+
+
+bool MateMapByCoord::enableSpill(SamRecordPool& pool, SamFileHeader& header,
+                                 const char* tmpPrefix, uint32_t maxRecords,
+                                 GenomeSequence* reference)
+{
+    if(!myMateCoord || (maxRecords == 0))
+    {
+        return(false);
+    }
+    myPool = &pool;
+    mySpillSize = maxRecords;
+    myRuns.setup(header, tmpPrefix, reference);
+    return(true);
+}
+
+
+void MateMapByCoord::printStats(std::ostream& os) const
+{
+    double avgProbes = 0;
+    if(myNumLookups != 0)
+    {
+        avgProbes = (double)myNumProbes / myNumLookups;
+    }
+    os << "Mate Map: " << myPeakRecords << " peak records in "
+       << myTable.size() << " slots ("
+       << std::fixed << std::setprecision(1)
+       << (100.0 * myPeakRecords / myTable.size()) << "% peak occupancy, "
+       << myNumResizes << " resizes)\n";
+    os << "Mate Map: " << myNumLookups << " lookups, "
+       << std::setprecision(2) << avgProbes << " average probes, "
+       << myMaxProbe << " longest insert probe, "
+       << myNumNameCollisions << " read name hash collisions\n";
+    if(mySpillSize != 0)
+    {
+        os << "Mate Map: " << myRuns.getNumSpilled()
+           << " records spilled to " << myRuns.getNumRuns()
+           << " temporary files\n";
+    }
+    os.unsetf(std::ios::floatfield);
+}
+
+
+uint32_t MateMapByCoord::hashReadName(const char* readName)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261U;
+    while(*readName != '\0')
+    {
+        hash ^= (unsigned char)(*readName++);
+        hash *= 16777619U;
+    }
+    return(hash);
+}
+
+
+uint32_t MateMapByCoord::homeIndex(uint64_t chromPos, uint32_t nameHash) const
+{
+    // Mix the position & name hash so neighboring positions spread out.
+    uint64_t key = chromPos ^ ((uint64_t)nameHash << 32) ^ nameHash;
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return((uint32_t)key & myMask);
+}
+
+
+int64_t MateMapByCoord::findEntry(const MateEntry& entry) const
+{
+    for(uint32_t index = homeIndex(entry.chromPos, entry.nameHash);
+        myTable[index].record != NULL; index = (index + 1) & myMask)
+    {
+        if((myTable[index].order == entry.order) &&
+           (myTable[index].record == entry.record))
+        {
+            return(index);
+        }
+    }
+    return(-1);
+}
+
+
+void MateMapByCoord::insertEntry(const MateEntry& entry)
+{
+    uint32_t probeLen = 1;
+    uint32_t index = homeIndex(entry.chromPos, entry.nameHash);
+    while(myTable[index].record != NULL)
+    {
+        index = (index + 1) & myMask;
+        ++probeLen;
+    }
+    myTable[index] = entry;
+    ++myNumRecords;
+    if(probeLen > myMaxProbe)
+    {
+        myMaxProbe = probeLen;
+    }
+}
+
+
+void MateMapByCoord::removeIndex(uint32_t index)
+{
+    uint32_t next = index;
+    while(true)
+    {
+        myTable[index].record = NULL;
+        // Find the next entry that may move into the empty slot: one
+        // whose home is not cyclically in (index, next].
+        uint32_t home;
+        do
+        {
+            next = (next + 1) & myMask;
+            if(myTable[next].record == NULL)
+            {
+                --myNumRecords;
+                return;
+            }
+            home = homeIndex(myTable[next].chromPos, myTable[next].nameHash);
+        } while((index <= next) ?
+                ((index < home) && (home <= next)) :
+                ((index < home) || (home <= next)));
+        myTable[index] = myTable[next];
+        index = next;
+    }
+}
+
+
+void MateMapByCoord::grow()
+{
+    std::vector<MateEntry> oldTable;
+    oldTable.swap(myTable);
+
+    myTable.resize(oldTable.size() * 2);
+    myMask = myTable.size() - 1;
+    for(uint32_t i = 0; i < myTable.size(); i++)
+    {
+        myTable[i].record = NULL;
+    }
+
+    // Reinsert sorted by position & then the order they were added, so
+    // records with the same key are still found in the order they were
+    // added.
+    std::vector<MateEntry> entries;
+    entries.reserve(myNumRecords);
+    for(uint32_t i = 0; i < oldTable.size(); i++)
+    {
+        if(oldTable[i].record != NULL)
+        {
+            entries.push_back(oldTable[i]);
+        }
+    }
+    std::sort(entries.begin(), entries.end(), LaterEntry());
+    myNumRecords = 0;
+    for(std::vector<MateEntry>::reverse_iterator iter = entries.rbegin();
+        iter != entries.rend(); iter++)
+    {
+        insertEntry(*iter);
+    }
+    ++myNumResizes;
+}
+
+
+void MateMapByCoord::cleanOrder()
+{
+    // Records found as mates are left in the heap, drop them once they
+    // reach the top.
+    while(!myOrder.empty() && (findEntry(myOrder.top()) < 0))
+    {
+        myOrder.pop();
+    }
+}
+
+
+void MateMapByCoord::spill()
+{
+    std::vector<MateEntry> entries;
+    entries.reserve(myNumRecords);
+    for(uint32_t i = 0; i < myTable.size(); i++)
+    {
+        if(myTable[i].record != NULL)
+        {
+            entries.push_back(myTable[i]);
+        }
+    }
+    // Sort descending by position & order, so the furthest half is first.
+    std::sort(entries.begin(), entries.end(), LaterEntry());
+    size_t numSpill = entries.size() / 2;
+
+    // Write the run in ascending order, keeping the order the records
+    // were added as the tag so ties are still broken the same way.
+    std::vector<SamSpillRuns::SpillRecord> run(numSpill);
+    for(size_t i = 0; i < numSpill; i++)
+    {
+        const MateEntry& entry = entries[numSpill - 1 - i];
+        run[i].key = entry.chromPos;
+        run[i].tag = entry.order;
+        run[i].record = entry.record;
+    }
+    if(!myRuns.writeRun(run))
+    {
+        throw(std::runtime_error("Failed to spill records waiting for their mates"));
+    }
+    for(size_t i = 0; i < numSpill; i++)
+    {
+        removeIndex(findEntry(entries[i]));
+        myPool->releaseRecord(entries[i].record);
+    }
+
+    // Rebuild the heap from the records still in memory rather than
+    // leaving the spilled ones to be dropped lazily.
+    entries.erase(entries.begin(), entries.begin() + numSpill);
+    myOrder = MATE_ORDER(LaterEntry(), entries);
+}
+
+
+void MateMapByCoord::reload(uint64_t chromPos)
+{
+    uint64_t order;
+    while(!myRuns.empty() && (myRuns.nextKey() <= chromPos))
+    {
+        SamRecord* record = myPool->getRecord();
+        if((record == NULL) || !myRuns.readNext(*record, order))
+        {
+            throw(std::runtime_error("Failed to read back records waiting for their mates"));
+        }
+        MateEntry entry;
+        // Stored by mate coordinate (the key the run is sorted by).
+        entry.chromPos = 
+            SamHelper::combineChromPos(record->getMateReferenceID(),
+                                       record->get0BasedMatePosition());
+        entry.order = order;
+        entry.nameHash = hashReadName(record->getReadName());
+        entry.record = record;
+        if((uint64_t)(myNumRecords + 1) * 10 > (uint64_t)myTable.size() * 7)
+        {
+            grow();
+        }
+        insertEntry(entry);
+        myOrder.push(entry);
+    }
+}
@@ -18,15 +18,27 @@
 #ifndef __MATE_MAP_BY_COORD_H__
 #define __MATE_MAP_BY_COORD_H__
 
-#include <map>
+#include <stdint.h>
+#include <iostream>
+#include <queue>
+#include <vector>
 
 #include "SamFile.h"
+#include "SamRecordPool.h"
+#include "SamRecordStream.h"
 
 
 /// Class for buffering up reads waiting to wait for the mate's match.
 /// Assumes the records are added in a coordinate sorted order.
 /// Assumes the mate chromosome/position information on reads are accurate
 /// otherwise the mates will not be found.
+///
+/// The records are stored in an open addressing (linear probing) hash
+/// table keyed on the chrom/pos & a hash of the read name, so finding a
+/// mate only compares read names when the hashes match.  A separate
+/// min-heap on chrom/pos orders the records for first()/popFirst().
+/// Optionally, records beyond a maximum can be spilled to temporary files
+/// that are read back as the file is processed.
 class MateMapByCoord
 {
 public:
@@ -56,17 +68,99 @@ public:
     /// Remove the first record from the map.
     void popFirst();
 
-protected:
+    /// Return the number of records in memory in the map.
+    uint32_t size() const { return(myNumRecords); }
 
-private:
-    typedef std::pair<uint64_t, SamRecord*> MATE_MAP_PAIR;
+    /// Keep at most maxRecords records in memory.  When there are more,
+    /// the half whose mates are furthest away are written to temporary
+    /// files starting with tmpPrefix & released to the pool.  They are
+    /// read back into records from the pool once a record at or past
+    /// their mate's position is looked up or added.  If reference is set,
+    /// '=' bases are spilled as the reference bases.
+    /// Only supported when storing by the mate's coordinate, returns
+    /// false otherwise.
+    bool enableSpill(SamRecordPool& pool, SamFileHeader& header,
+                     const char* tmpPrefix, uint32_t maxRecords,
+                     GenomeSequence* reference = NULL);
 
-    // Have to use multimap instead of unordered_multimap, since
-    // the first() and popFirst() methods expect it to be ordered
-    typedef std::multimap<uint64_t, SamRecord*> MATE_MAP;
+    /// Print the occupancy & collision statistics of the hash table.
+    void printStats(std::ostream& os) const;
 
-    MATE_MAP myMateBuffer;
+protected:
+
+private:
+    // Entry in the hash table, empty if record is NULL.
+    struct MateEntry
+    {
+        uint64_t chromPos;
+        // Order the record was added, breaks ties between equal positions.
+        uint64_t order;
+        uint32_t nameHash;
+        SamRecord* record;
+    };
+
+    // Greater than comparison for the min-heap of positions.
+    struct LaterEntry
+    {
+        bool operator()(const MateEntry& a, const MateEntry& b) const
+        {
+            if(a.chromPos != b.chromPos)
+            {
+                return(a.chromPos > b.chromPos);
+            }
+            return(a.order > b.order);
+        }
+    };
+
+    typedef std::priority_queue<MateEntry, std::vector<MateEntry>,
+                                LaterEntry> MATE_ORDER;
+
+    static uint32_t hashReadName(const char* readName);
+
+    // Return the table index to start probing for the specified key.
+    uint32_t homeIndex(uint64_t chromPos, uint32_t nameHash) const;
+
+    // Return the table index of the specified entry, or -1 if it
+    // is no longer in the table.
+    int64_t findEntry(const MateEntry& entry) const;
+
+    // Place the entry in the table, which must have room for it.
+    void insertEntry(const MateEntry& entry);
+
+    // Remove the entry at the specified index, shifting back the entries
+    // after it so there are no gaps in their probe sequences.
+    void removeIndex(uint32_t index);
+
+    // Double the size of the table.
+    void grow();
+
+    // Pop removed records off the top of the heap.
+    void cleanOrder();
+
+    // Write the records with the furthest positions to a spill run.
+    void spill();
+
+    // Read back the spilled records at or before the specified position.
+    void reload(uint64_t chromPos);
+
+    std::vector<MateEntry> myTable;
+    uint32_t myMask;
+    MATE_ORDER myOrder;
     bool myMateCoord;
+    uint64_t myNextOrder;
+    uint32_t myNumRecords;
+
+    SamRecordPool* myPool;
+    uint32_t mySpillSize;
+    SamSpillRuns myRuns;
+
+    // Statistics.
+    uint32_t myPeakRecords;
+    uint64_t myNumLookups;
+    uint64_t myNumProbes;
+    uint32_t myMaxProbe;
+    uint64_t myNumNameCollisions;
+    uint32_t myNumResizes;
 };
 
 
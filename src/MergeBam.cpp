@@ -85,7 +85,7 @@ void MergeBam::printDescription(std::ostream& os)
 void MergeBam::printUsage(std::ostream& os)
 {
     BamExecutable::printUsage(os);
-    os << "Usage: mergeBam [-v] [--log logFile] [--ignorePI] --list <listFile> --out <outFile>\n" << std::endl;
+    os << "Usage: mergeBam [-v] [--log logFile] [--ignorePI] [--threads <numThreads>] [--level <0-9>] --list <listFile> --out <outFile>\n" << std::endl;
     os << "Required parameters :" << std::endl;
     os << "--out/-o : Output BAM file (sorted)" << std::endl;
     os << "--in/-i  : BAM file to be input, must be more than one of these options." << std::endl;
@@ -108,6 +108,8 @@ void MergeBam::printUsage(std::ostream& os)
     os << "--ignorePI/-I : Ignore the RG PI field when comparing headers\n";
     os << "--log/-L : Log file" << std::endl;
     os << "--verbose/-v : Turn on verbose mode" << std::endl;
+    os << "--threads : Number of threads for compressing the output BAM file (default 0)" << std::endl;
+    os << "--level : Deflate level of the output BAM file, 0 is uncompressed BGZF (default -1: zlib default)" << std::endl;
 }
 
 // main function
@@ -124,6 +126,8 @@ int MergeBam::execute(int argc, char ** argv)
       { "ignorePI", no_argument, NULL, 'I'},
       { "regions", required_argument, NULL, 'r'},
       { "regionFile", required_argument, NULL, 'R'},
+      { "threads", required_argument, NULL, 'z'},
+      { "level", required_argument, NULL, 'Z'},
       { "noPhoneHome", no_argument, NULL, 'p'},
       { "nophonehome", no_argument, NULL, 'P'},
       { "phoneHomeThinning", required_argument, NULL, 't'},
@@ -173,6 +177,12 @@ int MergeBam::execute(int argc, char ** argv)
     case 'R':
       regionFile = optarg;
       break;
+    case 'z':
+      myNumThreads = atoi(optarg);
+      break;
+    case 'Z':
+      myCompressionLevel = atoi(optarg);
+      break;
     case 'p':
     case 'P':
       noPhoneHome = true;
@@ -203,6 +213,11 @@ int MergeBam::execute(int argc, char ** argv)
       }
   }
 
+  if(!processBamIoParameters())
+  {
+      return(-1);
+  }
+
   // create a logger object, now possible to write logs/warnings/errors
   Logger::gLogger = new Logger(s_logger.c_str(), b_verbose);
 
@@ -348,7 +363,7 @@ int MergeBam::execute(int argc, char ** argv)
 
   // Write an output file with new headers
   SamFile bam_out;
-  if ( !bam_out.OpenForWrite(s_out.c_str()) )
+  if ( !openForWrite(bam_out, s_out.c_str()) )
   {
     Logger::gLogger->error("Cannot open BAM file %s for writing",s_out.c_str());
   }
@@ -0,0 +1,240 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include "OutputFileCache.h"
+
+OutputFileCache::OutputFileCache()
+    : myOutputs(),
+      myOpenOutputs(),
+      myMaxOpen(DEFAULT_MAX_OPEN),
+      myMaxBuffered(DEFAULT_MAX_BUFFERED),
+      myNumBuffered(0),
+      myNumReopens(0),
+      myFailed(false)
+{
+}
+
+
+OutputFileCache::~OutputFileCache()
+{
+    closeAll();
+}
+
+
+void OutputFileCache::setLimits(unsigned int maxOpen, uint64_t maxBuffered)
+{
+    myMaxOpen = (maxOpen < 1) ? 1 : maxOpen;
+    myMaxBuffered = maxBuffered;
+}
+
+
+int OutputFileCache::add(const char* filename, bool bgzf, int level)
+{
+    FILE* file = fopen(filename, "wb");
+    if((file == NULL) || (fclose(file) != 0))
+    {
+        std::cerr << "Failed to open " << filename << " for writing\n";
+        return(-1);
+    }
+
+    Output* output = new Output();
+    output->filename = filename;
+    output->bgzf = bgzf;
+    output->level = level;
+    output->bgzfWriter = NULL;
+    output->file = NULL;
+    output->opened = false;
+    output->lruPos = myOpenOutputs.end();
+    myOutputs.push_back(output);
+    return(myOutputs.size() - 1);
+}
+
+
+bool OutputFileCache::write(int index, const void* data, unsigned int length)
+{
+    Output& output = *(myOutputs[index]);
+    output.buffer.append((const char*)data, length);
+    myNumBuffered += length;
+
+    if(output.buffer.size() >= FLUSH_SIZE)
+    {
+        writeOutput(index, false);
+    }
+
+    // Write out the largest buffers until under the memory limit.
+    while(myNumBuffered > myMaxBuffered)
+    {
+        int largest = 0;
+        for(unsigned int i = 1; i < myOutputs.size(); i++)
+        {
+            if(myOutputs[i]->buffer.size() >
+               myOutputs[largest]->buffer.size())
+            {
+                largest = i;
+            }
+        }
+        // Write partial blocks if there are no full ones.
+        writeOutput(largest, (myOutputs[largest]->buffer.size() <
+                              BgzfWriter::MAX_BLOCK_INPUT));
+    }
+    return(!myFailed);
+}
+
+
+bool OutputFileCache::closeAll()
+{
+    for(unsigned int i = 0; i < myOutputs.size(); i++)
+    {
+        writeOutput(i, true);
+        // BGZF files need the EOF block even if nothing was written.
+        if(myOutputs[i]->bgzf && (myOutputs[i]->bgzfWriter == NULL))
+        {
+            openOutput(i);
+        }
+        closeOutput(i, true);
+        delete myOutputs[i];
+    }
+    myOutputs.clear();
+    myOpenOutputs.clear();
+    myNumBuffered = 0;
+    return(!myFailed);
+}
+
+
+bool OutputFileCache::writeOutput(int index, bool all)
+{
+    Output& output = *(myOutputs[index]);
+    size_t length = output.buffer.size();
+    if(output.bgzf && !all)
+    {
+        length -= length % BgzfWriter::MAX_BLOCK_INPUT;
+    }
+    if(length == 0)
+    {
+        return(true);
+    }
+
+    if(!openOutput(index))
+    {
+        // Drop the data so the memory limit is still kept.
+        output.buffer.clear();
+        myNumBuffered -= length;
+        return(false);
+    }
+
+    bool success;
+    if(output.bgzf)
+    {
+        success = output.bgzfWriter->write(output.buffer.data(), length);
+    }
+    else
+    {
+        success = (fwrite(output.buffer.data(), 1, length, output.file) ==
+                   length);
+    }
+    if(!success)
+    {
+        std::cerr << "Failed to write " << output.filename << std::endl;
+        myFailed = true;
+    }
+    output.buffer.erase(0, length);
+    myNumBuffered -= length;
+    return(success);
+}
+
+
+bool OutputFileCache::openOutput(int index)
+{
+    Output& output = *(myOutputs[index]);
+    if((output.bgzfWriter != NULL) || (output.file != NULL))
+    {
+        // Already open, make it the most recently used.
+        myOpenOutputs.splice(myOpenOutputs.begin(), myOpenOutputs,
+                             output.lruPos);
+        return(true);
+    }
+
+    if(myOpenOutputs.size() >= myMaxOpen)
+    {
+        closeOutput(myOpenOutputs.back(), false);
+    }
+
+    // The file was created when it was added, so always append.
+    bool success;
+    if(output.bgzf)
+    {
+        output.bgzfWriter = new BgzfWriter();
+        success = output.bgzfWriter->open(output.filename.c_str(),
+                                          output.level, true);
+        if(!success)
+        {
+            delete output.bgzfWriter;
+            output.bgzfWriter = NULL;
+        }
+    }
+    else
+    {
+        output.file = fopen(output.filename.c_str(), "ab");
+        success = (output.file != NULL);
+    }
+    if(!success)
+    {
+        std::cerr << "Failed to reopen " << output.filename << std::endl;
+        myFailed = true;
+        return(false);
+    }
+
+    if(output.opened)
+    {
+        ++myNumReopens;
+    }
+    output.opened = true;
+    myOpenOutputs.push_front(index);
+    output.lruPos = myOpenOutputs.begin();
+    return(true);
+}
+
+
+bool OutputFileCache::closeOutput(int index, bool final)
+{
+    Output& output = *(myOutputs[index]);
+    bool success = true;
+    if(output.bgzfWriter != NULL)
+    {
+        success = output.bgzfWriter->close(final);
+        delete output.bgzfWriter;
+        output.bgzfWriter = NULL;
+    }
+    else if(output.file != NULL)
+    {
+        success = (fclose(output.file) == 0);
+        output.file = NULL;
+    }
+    else
+    {
+        return(true);
+    }
+    if(!success)
+    {
+        std::cerr << "Failed to write " << output.filename << std::endl;
+        myFailed = true;
+    }
+    myOpenOutputs.erase(output.lruPos);
+    output.lruPos = myOpenOutputs.end();
+    return(success);
+}
@@ -0,0 +1,121 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//////////////////////////////////////////////////////////////////////////
+// Buffered output to many files while only keeping a limited number of
+// them open.
+
+#ifndef __OUTPUT_FILE_CACHE_H__
+#define __OUTPUT_FILE_CACHE_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <list>
+#include <string>
+#include <vector>
+#include "BgzfWriter.h"
+
+/// Writes to many output files (like one per read group), buffering the
+/// data of each file in memory and only keeping the most recently written
+/// files open.  When too many are open, the least recently written one is
+/// closed (without a BGZF EOF block) and is appended to if it is written
+/// again.  The total memory buffered is also limited, so the memory and
+/// file descriptors used do not grow with the number of files.
+///
+/// BGZF compressed files are written in full blocks except when the
+/// memory limit forces out a small buffer or the file is closed, so the
+/// blocks (and output) match writing the file with a single BgzfWriter.
+class OutputFileCache
+{
+public:
+    /// Default maximum number of files to keep open.
+    static const unsigned int DEFAULT_MAX_OPEN = 128;
+
+    /// Default maximum number of bytes to buffer across all files.
+    static const uint64_t DEFAULT_MAX_BUFFERED = 0x10000000;
+
+    /// Amount a single file buffers before it is written.
+    static const unsigned int FLUSH_SIZE = BgzfWriter::MAX_BLOCK_INPUT * 16;
+
+    OutputFileCache();
+
+    /// Closes the files if they are still open.
+    ~OutputFileCache();
+
+    /// Set the maximum number of files to keep open & bytes to buffer.
+    void setLimits(unsigned int maxOpen,
+                   uint64_t maxBuffered = DEFAULT_MAX_BUFFERED);
+
+    /// Add an output file, creating it (empty) now so a bad name fails
+    /// right away.  If bgzf is true, the file is compressed as BGZF at the
+    /// specified level (-1 is the zlib default).
+    /// Returns the index used to write to the file, or -1 on failure.
+    int add(const char* filename, bool bgzf, int level = -1);
+
+    /// Write the data to the file at the specified index.
+    /// Returns false if a write has failed.
+    bool write(int index, const void* data, unsigned int length);
+
+    /// Write all of the buffered data & close the files, adding the EOF
+    /// block to BGZF files.  Returns false if any write failed.
+    bool closeAll();
+
+    /// Return the number of files.
+    unsigned int size() const { return(myOutputs.size()); }
+
+    /// Return the number of times a file was reopened to append to it.
+    uint32_t getNumReopens() const { return(myNumReopens); }
+
+private:
+    OutputFileCache(const OutputFileCache&);
+    OutputFileCache& operator=(const OutputFileCache&);
+
+    struct Output
+    {
+        std::string filename;
+        bool bgzf;
+        int level;
+        std::string buffer;
+        // Set while the file is open.
+        BgzfWriter* bgzfWriter;
+        FILE* file;
+        bool opened;
+        std::list<int>::iterator lruPos;
+    };
+
+    // Write the buffered data of the output at the specified index.
+    // Unless all is set, only full BGZF blocks are written.
+    bool writeOutput(int index, bool all);
+
+    // Open the output for appending, closing the least recently used
+    // output if too many are open.
+    bool openOutput(int index);
+
+    // Close the output, adding the BGZF EOF block if final is set.
+    bool closeOutput(int index, bool final);
+
+    std::vector<Output*> myOutputs;
+    // Open outputs, most recently used first.
+    std::list<int> myOpenOutputs;
+    unsigned int myMaxOpen;
+    uint64_t myMaxBuffered;
+    uint64_t myNumBuffered;
+    uint32_t myNumReopens;
+    bool myFailed;
+};
+
+#endif
@@ -43,6 +43,25 @@ void OverlapClipLowerBaseQual:: printStats()
 }
 
 
+OverlapHandler* OverlapClipLowerBaseQual::clone() const
+{
+    OverlapClipLowerBaseQual* handler = new OverlapClipLowerBaseQual();
+    handler->copySettings(*this);
+    return(handler);
+}
+
+
+void OverlapClipLowerBaseQual::mergeStats(const OverlapHandler& other)
+{
+    OverlapHandler::mergeStats(other);
+    // Clones are always the same type.
+    const OverlapClipLowerBaseQual& otherClip =
+        static_cast<const OverlapClipLowerBaseQual&>(other);
+    myNumForwardClips += otherClip.myNumForwardClips;
+    myNumReverseClips += otherClip.myNumReverseClips;
+}
+
+
 void OverlapClipLowerBaseQual::handleOverlapPair(SamRecord& firstRecord,
                                                  SamRecord& secondRecord)
 {
@@ -68,11 +87,11 @@ void OverlapClipLowerBaseQual::handleOverlapPair(SamRecord& firstRecord,
         }
         // If overlapEnd = 5 & overlapStart = 3, they overlap at
         // positions 3, 4, & 5.  So 5-3+1=3 positions.
-        myOverlaps.Push(end - overlapStart + 1);
+        addOverlap(end - overlapStart + 1);
     }
 
-    static CigarRoller newFirstCigar; // holds updated cigar.
-    static CigarRoller newSecondCigar; // holds updated cigar.
+    static thread_local CigarRoller newFirstCigar; // holds updated cigar.
+    static thread_local CigarRoller newSecondCigar; // holds updated cigar.
 
     // Determine which record will get clipped by determining
     // which record has a lower base quality in the overlapping region.
@@ -257,7 +276,7 @@ void OverlapClipLowerBaseQual::handleOverlapPair(SamRecord& firstRecord,
 bool OverlapClipLowerBaseQual::handleOverlapWithoutMate(SamRecord& record,
                                                         bool updateStats)
 {
-    static CigarRoller newCigar;
+    static thread_local CigarRoller newCigar;
 
     // Check if this is reverse and the mate is not.
     int16_t flag = record.getFlag();
@@ -266,8 +285,8 @@ bool OverlapClipLowerBaseQual::handleOverlapWithoutMate(SamRecord& record,
         if(myStats && updateStats)
         {
             ++myNumReverseClips;
-            myOverlaps.Push(record.get0BasedAlignmentEnd() - 
-                            record.get0BasedMatePosition() + 1);
+            addOverlap(record.get0BasedAlignmentEnd() - 
+                       record.get0BasedMatePosition() + 1);
         }
         handleNoOverlapWrongOrientation(record, updateStats, false);
     }
@@ -293,8 +312,8 @@ bool OverlapClipLowerBaseQual::handleOverlapWithoutMate(SamRecord& record,
                 }
                 // Update the overlap length - the difference
                 // between the mate start and this read's end.
-                myOverlaps.Push(record.get0BasedAlignmentEnd() -
-                                record.get0BasedMatePosition() + 1);
+                addOverlap(record.get0BasedAlignmentEnd() -
+                           record.get0BasedMatePosition() + 1);
             }
             // Write the original cigar into the specified tag.
             if(!myStoreOrigCigar.IsEmpty())
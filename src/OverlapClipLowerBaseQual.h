@@ -30,6 +30,10 @@ public:
 
     virtual void printStats();
 
+    virtual OverlapHandler* clone() const;
+
+    virtual void mergeStats(const OverlapHandler& other);
+
     virtual void handleOverlapPair(SamRecord& firstRecord,
                                    SamRecord& secondRecord);
 
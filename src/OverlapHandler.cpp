@@ -25,13 +25,25 @@ void OverlapHandler::printStats()
 {
     if(myStats)
     {
+        double mean = 0;
+        double variance = 0;
+        if(myNumOverlaps > 0)
+        {
+            mean = (double)myOverlapSum / myNumOverlaps;
+        }
+        if(myNumOverlaps > 1)
+        {
+            long double sum = myOverlapSum;
+            variance = (myOverlapSumSq - sum * sum / myNumOverlaps) /
+                (myNumOverlaps - 1);
+        }
         std::cerr << "Overlap Statistics:" << std::endl;
         std::cerr << "Number of overlapping pairs: "
-                  << myOverlaps.NumDataValues() << std::endl
+                  << myNumOverlaps << std::endl
                   << "Average # Reference Bases Overlapped: "
-                  << myOverlaps.Mean() << std::endl
+                  << mean << std::endl
                   << "Variance of Reference Bases overlapped: "
-                  << myOverlaps.Variance() << std::endl
+                  << variance << std::endl
                   << "Number of times orientation causes additional clipping: "
                   << myNumOrientationClips << std::endl;
     }
@@ -111,7 +123,7 @@ void OverlapHandler::handleNoOverlapWrongOrientation(SamRecord& record,
                                                      bool updateStats,
                                                      bool mateUnmapped)
 {
-    static CigarRoller newCigar; // holds updated cigar.
+    static thread_local CigarRoller newCigar; // holds updated cigar.
 
     if(myStats && updateStats)
     {
@@ -160,6 +172,32 @@ bool OverlapHandler::handleOverlapWithoutMate(SamRecord& record,
 }
 
 
+void OverlapHandler::mergeStats(const OverlapHandler& other)
+{
+    myNumOverlaps += other.myNumOverlaps;
+    myOverlapSum += other.myOverlapSum;
+    myOverlapSumSq += other.myOverlapSumSq;
+    myNumOrientationClips += other.myNumOrientationClips;
+}
+
+
+void OverlapHandler::addOverlap(int32_t length)
+{
+    ++myNumOverlaps;
+    myOverlapSum += length;
+    myOverlapSumSq += (int64_t)length * length;
+}
+
+
+void OverlapHandler::copySettings(const OverlapHandler& other)
+{
+    myStepNum = other.myStepNum;
+    myStoreOrigCigar = other.myStoreOrigCigar;
+    myStats = other.myStats;
+    myUnmap = other.myUnmap;
+}
+
+
 void OverlapHandler::markMateUnmapped(SamRecord& record)
 {
     // Mark the mate as unmapped if we are doing unmapping
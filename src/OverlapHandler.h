@@ -21,8 +21,8 @@
 #ifndef __OVERLAP_HANDLER_H__
 #define __OVERLAP_HANDLER_H__
 
+#include <stdint.h>
 #include "SamRecord.h"
-#include "SimpleStats.h"
 
 class OverlapHandler
 {
@@ -40,6 +40,7 @@ public:
     };
 
     OverlapHandler() {init();}
+    virtual ~OverlapHandler() {}
 
     void keepStats(bool keepStats) {myStats = keepStats;}
     virtual void printStats();
@@ -83,16 +84,36 @@ public:
 
     virtual int numSteps() {return(1);}
 
+    /// Create a new handler with the same settings, but no stats, to
+    /// handle a separate set of records (like a single chromosome) on
+    /// another thread.  The caller must delete the returned handler.
+    virtual OverlapHandler* clone() const = 0;
+
+    /// Add the stats of a handler created by clone to this handler's
+    /// stats as if this handler had handled the records.  Handlers
+    /// should be merged in the order of their records.
+    virtual void mergeStats(const OverlapHandler& other);
+
     void incrementStep() { ++myStepNum; }
 
 protected:
     // Will mark the mate as unmapped if myUnmap is set to true.
     void markMateUnmapped(SamRecord& record);
 
+    // Add the number of bases a pair overlaps to the stats.
+    void addOverlap(int32_t length);
+
+    // Copy the settings of the other handler, for clone.
+    void copySettings(const OverlapHandler& other);
+
     int myStepNum;
     String myStoreOrigCigar;
     bool myStats;
-    RunningStat myOverlaps;
+    // Exact sums of the overlap lengths, so merging the stats of clones
+    // gives the same mean/variance as handling all of the records here.
+    uint64_t myNumOverlaps;
+    int64_t myOverlapSum;
+    uint64_t myOverlapSumSq;
     int myNumOrientationClips;
     // If set to true, mark entirely clipped records as unmapped.
     bool myUnmap;
@@ -103,6 +124,9 @@ private:
         myStepNum = 1;
         myStoreOrigCigar = "";
         myStats = false;
+        myNumOverlaps = 0;
+        myOverlapSum = 0;
+        myOverlapSumSq = 0;
         myNumOrientationClips = 0;
         myUnmap = false;
     }
@@ -19,6 +19,7 @@
 // This file contains the processing for the executable option "stats"
 // which generates some statistics for SAM/BAM files.
 
+#include <math.h>
 #include <stdexcept>
 #include "PileupElementBaseQCStats.h"
 #include "SamFlag.h"
@@ -31,23 +32,7 @@
 bool PileupElementBaseQCStats::ourFilterDups = true;
 bool PileupElementBaseQCStats::ourFilterQCFail = true;
 int PileupElementBaseQCStats::ourMinMapQuality = 0;
-IFILE PileupElementBaseQCStats::ourOutputFile = 0;
 bool PileupElementBaseQCStats::ourPercentStats = false;
-RunningStat PileupElementBaseQCStats::avgTotalReads; 
-RunningStat PileupElementBaseQCStats::avgDups;
-RunningStat PileupElementBaseQCStats::avgQCFail;
-RunningStat PileupElementBaseQCStats::avgMapped;
-RunningStat PileupElementBaseQCStats::avgPaired;
-RunningStat PileupElementBaseQCStats::avgProperPaired;
-RunningStat PileupElementBaseQCStats::avgZeroMapQ;
-RunningStat PileupElementBaseQCStats::avgLT10MapQ;
-RunningStat PileupElementBaseQCStats::avgMapQ255;
-RunningStat PileupElementBaseQCStats::avgMapQPass;
-RunningStat PileupElementBaseQCStats::avgAvgMapQ;
-RunningStat PileupElementBaseQCStats::avgAvgMapQCount;
-RunningStat PileupElementBaseQCStats::avgDepth;
-RunningStat PileupElementBaseQCStats::avgQ20;
-bool PileupElementBaseQCStats::ourBaseSum = false;
 
 void PileupElementBaseQCStats::filterDups(bool filterDups)
 {
@@ -64,21 +49,16 @@ void PileupElementBaseQCStats::setMapQualFilter(int minMapQuality)
     ourMinMapQuality = minMapQuality;
 }
 
-void PileupElementBaseQCStats::setOutputFile(IFILE outputPtr)
-{
-    ourOutputFile = outputPtr;
-}
-
-void PileupElementBaseQCStats::printHeader()
+void PileupElementBaseQCStats::printHeader(IFILE outputPtr)
 {
     if(ourPercentStats)
     {
-        ifprintf(ourOutputFile, "chrom\tchromStart\tchromEnd\tDepth\tQ20Bases\tQ20BasesPct(%%)\tTotalReads\tMappedBases\tMappingRate(%%)\tMapRate_MQPass(%%)\tZeroMapQual(%%)\tMapQual<10(%%)\tPairedReads(%%)\tProperPaired(%%)\tDupRate(%%)\tQCFailRate(%%)\tAverageMapQuality\tAverageMapQualCount\n");
-        //    ifprintf(ourOutputFile, "chrom\tchromStart\tchromEnd\tDepth\tQ20Bases(e9)\tQ20BasesPct(%%)\tTotalReads(e6)\tMappedBases(e9)\tMappingRate(%%)\tMapRate_MQPass(%%)\tZeroMapQual(%%)\tMapQual<10(%%)\tPairedReads(%%)\tProperPaired(%%)\tDupRate(%%)\tQCFailRate(%%)\tAverageMapQuality\tAverageMapQualCount(e9)\n");
+        ifprintf(outputPtr, "chrom\tchromStart\tchromEnd\tDepth\tQ20Bases\tQ20BasesPct(%%)\tTotalReads\tMappedBases\tMappingRate(%%)\tMapRate_MQPass(%%)\tZeroMapQual(%%)\tMapQual<10(%%)\tPairedReads(%%)\tProperPaired(%%)\tDupRate(%%)\tQCFailRate(%%)\tAverageMapQuality\tAverageMapQualCount\n");
+        //    ifprintf(outputPtr, "chrom\tchromStart\tchromEnd\tDepth\tQ20Bases(e9)\tQ20BasesPct(%%)\tTotalReads(e6)\tMappedBases(e9)\tMappingRate(%%)\tMapRate_MQPass(%%)\tZeroMapQual(%%)\tMapQual<10(%%)\tPairedReads(%%)\tProperPaired(%%)\tDupRate(%%)\tQCFailRate(%%)\tAverageMapQuality\tAverageMapQualCount(e9)\n");
     }
     else
     {
-        ifprintf(ourOutputFile, "chrom\tchromStart\tchromEnd\tTotalReads\tDups\tQCFail\tMapped\tPaired\tProperPaired\tZeroMapQual\tMapQual<10\tMapQual255\tPassMapQual\tAverageMapQuality\tAverageMapQualCount\tDepth\tQ20Bases\n");
+        ifprintf(outputPtr, "chrom\tchromStart\tchromEnd\tTotalReads\tDups\tQCFail\tMapped\tPaired\tProperPaired\tZeroMapQual\tMapQual<10\tMapQual255\tPassMapQual\tAverageMapQuality\tAverageMapQualCount\tDepth\tQ20Bases\n");
     }
 }
 
@@ -89,36 +69,6 @@ void PileupElementBaseQCStats::setPercentStats(bool percentStats)
 }
 
 
-void PileupElementBaseQCStats::setBaseSum(bool baseSum)
-{
-    ourBaseSum = baseSum;
-}
-
-
-void PileupElementBaseQCStats::printSummary()
-{
-    if(ourBaseSum)
-    {
-        fprintf(stderr, "\nSummary of Pileup Stats (1st Row is Mean, 2nd Row is Standard Deviation)\nTotalReads\tDups\tQCFail\tMapped\tPaired\tProperPaired\tZeroMapQual\tMapQual<10\tMapQual255\tPassMapQual\tAverageMapQuality\tAverageMapQualCount\tDepth\tQ20Bases\n");
-        
-        fprintf(stderr, 
-                 "%f\t%f\t%f\t%f\t%f\t%f\t%f\t%f\t%f\t%f\t%f\t%f\t%f\t%f\n",
-                 avgTotalReads.Mean(), avgDups.Mean(), avgQCFail.Mean(),
-                 avgMapped.Mean(), avgPaired.Mean(), avgProperPaired.Mean(),
-                 avgZeroMapQ.Mean(), avgLT10MapQ.Mean(), avgMapQ255.Mean(), 
-                 avgMapQPass.Mean(), avgAvgMapQ.Mean(), avgAvgMapQCount.Mean(),
-                 avgDepth.Mean(), avgQ20.Mean());
-        fprintf(stderr, 
-                 "%f\t%f\t%f\t%f\t%f\t%f\t%f\t%f\t%f\t%f\t%f\t%f\t%f\t%f\n\n",
-                 avgTotalReads.StandardDeviation(), avgDups.StandardDeviation(), avgQCFail.StandardDeviation(),
-                 avgMapped.StandardDeviation(), avgPaired.StandardDeviation(), avgProperPaired.StandardDeviation(),
-                 avgZeroMapQ.StandardDeviation(), avgLT10MapQ.StandardDeviation(), avgMapQ255.StandardDeviation(), 
-                 avgMapQPass.StandardDeviation(), avgAvgMapQ.StandardDeviation(), avgAvgMapQCount.StandardDeviation(),
-                 avgDepth.StandardDeviation(), avgQ20.StandardDeviation());
-    }
-}
-
-
 PileupElementBaseQCStats::PileupElementBaseQCStats()
     : PileupElement()
 {
@@ -264,147 +214,136 @@ void PileupElementBaseQCStats::addEntry(SamRecord& record)
 // Perform the alalysis associated with this class.  May be a simple print, 
 // a calculation, or something else.  Typically performed when this element
 // has been fully populated by all records that cover the reference position.
-void PileupElementBaseQCStats::analyze()
+void PileupElementBaseQCStats::analyze(BaseQCAccumulator& accumulator)
 {
     // Only output if the position is covered.
     if(numEntries != 0)
     {
-        if(ourPercentStats)
-        {
-            int32_t startPos = getRefPosition();
-            myOutputString = getChromosome();
-            myOutputString += "\t";
-            myOutputString += startPos;
-            myOutputString += "\t";
-            myOutputString += startPos + 1;
-            myOutputString += "\t";
-            myOutputString += depth;
-            myOutputString += "\t";
-            myOutputString += numQ20;
-            //        myOutputString += (double(numQ20))/E9_CALC;
-            myOutputString += "\t";
-            if(depth == 0)
-            {
-                myOutputString += (double)0;
-            }
-            else
-            {
-                myOutputString += 100 * (double(numQ20))/depth;
-            }
-            myOutputString += "\t";
-            myOutputString += numEntries;
-            //        myOutputString += numEntries/E6_CALC;
-            myOutputString += "\t";
-            myOutputString += numMapped;
-            //        myOutputString += ((double)numMapped)/E9_CALC;
-            myOutputString += "\t";
-            if(numEntries == 0)
-            {
-                myOutputString += "0.000\t0.000\t0.000\t0.000\t0.000\t0.000\t0.000\t0.000";
-            }
-            else
-            {
-                myOutputString += 100 * ((double)numMapped)/numEntries;
-                myOutputString += "\t";
-                myOutputString += 100 * ((double)numMapQPass)/numEntries;
-                myOutputString += "\t";
-                myOutputString += 100 * ((double)numZeroMapQ)/numEntries;
-                myOutputString += "\t";
-                myOutputString += 100 * ((double)numLT10MapQ)/numEntries;
-                myOutputString += "\t";
-                myOutputString += 100 * ((double)numPaired)/numEntries;
-                myOutputString += "\t";
-                myOutputString += 100 * ((double)numProperPaired)/numEntries;
-                myOutputString += "\t";
-                myOutputString += 100 * ((double)numDups)/numEntries;
-                myOutputString += "\t";
-                myOutputString += 100 * ((double)numQCFail)/numEntries;
-            }
+        uint64_t values[BaseQCColumns::NUM_COLUMNS];
+        getColumns(values);
+        accumulator.analyze(getChromosome(), values);
+    }
+}
 
-            myOutputString += "\t";
-            if(averageMapQCount != 0)
-            {
-                myOutputString += ((double)sumMapQ)/averageMapQCount;
-            }
-            else
-            {
-                myOutputString += "0.000";
-            }
-            myOutputString += "\t";
-            myOutputString += averageMapQCount;
-            // myOutputString += ((double)averageMapQCount)/E9_CALC;
-            myOutputString += "\n";
-        
-            ifprintf(ourOutputFile, myOutputString.c_str());
+
+void PileupElementBaseQCStats::getColumns(uint64_t* values) const
+{
+    values[BaseQCColumns::POSITION] = getRefPosition();
+    values[BaseQCColumns::TOTAL_READS] = numEntries;
+    values[BaseQCColumns::DUPS] = numDups;
+    values[BaseQCColumns::QC_FAIL] = numQCFail;
+    values[BaseQCColumns::MAPPED] = numMapped;
+    values[BaseQCColumns::PAIRED] = numPaired;
+    values[BaseQCColumns::PROPER_PAIRED] = numProperPaired;
+    values[BaseQCColumns::ZERO_MAPQ] = numZeroMapQ;
+    values[BaseQCColumns::LT10_MAPQ] = numLT10MapQ;
+    values[BaseQCColumns::MAPQ_255] = numMapQ255;
+    values[BaseQCColumns::PASS_MAPQ] = numMapQPass;
+    values[BaseQCColumns::SUM_MAPQ] = sumMapQ;
+    values[BaseQCColumns::MAPQ_COUNT] = averageMapQCount;
+    values[BaseQCColumns::DEPTH] = depth;
+    values[BaseQCColumns::Q20] = numQ20;
+}
+
+
+void PileupElementBaseQCStats::formatColumns(String& output,
+                                             const char* chromosome,
+                                             const uint64_t* values)
+{
+    int32_t startPos = values[BaseQCColumns::POSITION];
+    int numEntries = values[BaseQCColumns::TOTAL_READS];
+    int depth = values[BaseQCColumns::DEPTH];
+    int numQ20 = values[BaseQCColumns::Q20];
+    int averageMapQCount = values[BaseQCColumns::MAPQ_COUNT];
+    uint64_t sumMapQ = values[BaseQCColumns::SUM_MAPQ];
+
+    output = chromosome;
+    output += "\t";
+    output += startPos;
+    output += "\t";
+    output += startPos + 1;
+    output += "\t";
+    if(ourPercentStats)
+    {
+        output += depth;
+        output += "\t";
+        output += numQ20;
+        //        output += (double(numQ20))/E9_CALC;
+        output += "\t";
+        if(depth == 0)
+        {
+            output += (double)0;
         }
         else
         {
-            // Summary stats.
-            int32_t startPos = getRefPosition();
-            myOutputString = getChromosome();
-            myOutputString += "\t";
-            myOutputString += startPos;
-            myOutputString += "\t";
-            myOutputString += startPos + 1;
-            myOutputString += "\t";
-            myOutputString += numEntries;
-            myOutputString += "\t";
-            myOutputString += numDups;
-            myOutputString += "\t";
-            myOutputString += numQCFail;
-            myOutputString += "\t";
-            myOutputString += numMapped;
-            myOutputString += "\t";
-            myOutputString += numPaired;
-            myOutputString += "\t";
-            myOutputString += numProperPaired;
-            myOutputString += "\t";
-            myOutputString += numZeroMapQ;
-            myOutputString += "\t";
-            myOutputString += numLT10MapQ;
-            myOutputString += "\t";
-            myOutputString += numMapQ255;
-            myOutputString += "\t";
-            myOutputString += numMapQPass;
-            myOutputString += "\t";
-            if(averageMapQCount != 0)
-            {
-                myOutputString += ((double)sumMapQ)/averageMapQCount;
-            }
-            else
+            output += 100 * (double(numQ20))/depth;
+        }
+        output += "\t";
+        output += numEntries;
+        //        output += numEntries/E6_CALC;
+        output += "\t";
+        output += (int)values[BaseQCColumns::MAPPED];
+        //        output += ((double)numMapped)/E9_CALC;
+        output += "\t";
+        if(numEntries == 0)
+        {
+            output += "0.000\t0.000\t0.000\t0.000\t0.000\t0.000\t0.000\t0.000";
+        }
+        else
+        {
+            static const int percentColumns[] =
+                {BaseQCColumns::MAPPED, BaseQCColumns::PASS_MAPQ,
+                 BaseQCColumns::ZERO_MAPQ, BaseQCColumns::LT10_MAPQ,
+                 BaseQCColumns::PAIRED, BaseQCColumns::PROPER_PAIRED,
+                 BaseQCColumns::DUPS, BaseQCColumns::QC_FAIL};
+            for(unsigned int i = 0;
+                i < sizeof(percentColumns)/sizeof(percentColumns[0]); i++)
             {
-                myOutputString += "0.000";
+                if(i != 0)
+                {
+                    output += "\t";
+                }
+                output += 100 * ((double)values[percentColumns[i]])/numEntries;
             }
-            myOutputString += "\t";
-            myOutputString += averageMapQCount;
-            myOutputString += "\t";
-            myOutputString += depth;
-            myOutputString += "\t";
-            myOutputString += numQ20;
-            myOutputString += "\n";
-        
-            ifprintf(ourOutputFile, myOutputString.c_str());
         }
-
-        if(ourBaseSum)
+        output += "\t";
+    }
+    else
+    {
+        // Summary stats.
+        static const int countColumns[] =
+            {BaseQCColumns::TOTAL_READS, BaseQCColumns::DUPS,
+             BaseQCColumns::QC_FAIL, BaseQCColumns::MAPPED,
+             BaseQCColumns::PAIRED, BaseQCColumns::PROPER_PAIRED,
+             BaseQCColumns::ZERO_MAPQ, BaseQCColumns::LT10_MAPQ,
+             BaseQCColumns::MAPQ_255, BaseQCColumns::PASS_MAPQ};
+        for(unsigned int i = 0;
+            i < sizeof(countColumns)/sizeof(countColumns[0]); i++)
         {
-            // Update the average values.
-            avgTotalReads.Push(numEntries);
-            avgDups.Push(numDups);
-            avgQCFail.Push(numQCFail);
-            avgMapped.Push(numMapped);
-            avgPaired.Push(numPaired);
-            avgProperPaired.Push(numProperPaired);
-            avgZeroMapQ.Push(numZeroMapQ);
-            avgLT10MapQ.Push(numLT10MapQ);
-            avgMapQ255.Push(numMapQ255);
-            avgMapQPass.Push(numMapQPass);
-            avgAvgMapQ.Push( ((double)sumMapQ)/averageMapQCount);
-            avgAvgMapQCount.Push(averageMapQCount);
-            avgDepth.Push(depth);
-            avgQ20.Push(numQ20);
+            output += (int)values[countColumns[i]];
+            output += "\t";
         }
     }
+
+    if(averageMapQCount != 0)
+    {
+        output += ((double)sumMapQ)/averageMapQCount;
+    }
+    else
+    {
+        output += "0.000";
+    }
+    output += "\t";
+    output += averageMapQCount;
+    if(!ourPercentStats)
+    {
+        output += "\t";
+        output += depth;
+        output += "\t";
+        output += numQ20;
+    }
+    // output += ((double)averageMapQCount)/E9_CALC;
+    output += "\n";
 }
 
 
@@ -434,6 +373,249 @@ void PileupElementBaseQCStats::initVars()
     numMapQ255 = 0;
     sumMapQ = 0;
     averageMapQCount = 0;
-    myOutputString.Clear();
 }
 
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// MergeableRunningStat
+//
+
+MergeableRunningStat::MergeableRunningStat()
+    : myNumValues(0),
+      myMean(0),
+      mySumSq(0)
+{
+}
+
+
+void MergeableRunningStat::push(double value)
+{
+    // Same calculation as RunningStat.
+    ++myNumValues;
+    if(myNumValues == 1)
+    {
+        myMean = value;
+        mySumSq = 0;
+    }
+    else
+    {
+        double prevMean = myMean;
+        myMean = prevMean + (value - prevMean) / myNumValues;
+        mySumSq += (value - prevMean) * (value - myMean);
+    }
+}
+
+
+void MergeableRunningStat::merge(const MergeableRunningStat& other)
+{
+    if(other.myNumValues == 0)
+    {
+        return;
+    }
+    if(myNumValues == 0)
+    {
+        *this = other;
+        return;
+    }
+    // Combine the means & sums of squares of the two sets of values.
+    uint64_t numValues = myNumValues + other.myNumValues;
+    double delta = other.myMean - myMean;
+    double weight = ((double)myNumValues * other.myNumValues) / numValues;
+    myMean += delta * other.myNumValues / numValues;
+    mySumSq += other.mySumSq + (delta * delta * weight);
+    myNumValues = numValues;
+}
+
+
+double MergeableRunningStat::mean() const
+{
+    if(myNumValues > 0)
+    {
+        return(myMean);
+    }
+    return(0.0);
+}
+
+
+double MergeableRunningStat::standardDeviation() const
+{
+    if(myNumValues > 1)
+    {
+        return(sqrt(mySumSq / (myNumValues - 1)));
+    }
+    return(0.0);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// BaseQCAccumulator
+//
+
+BaseQCAccumulator::BaseQCAccumulator()
+    : myOutputFile(NULL),
+      myColumnWriter(NULL),
+      myBaseSum(false),
+      myOutputString(),
+      myForward(NULL),
+      myBuffering(false),
+      myBufferedChromosome(),
+      myBufferedValues(),
+      myTotal(),
+      myReference(),
+      myReferenceName()
+{
+}
+
+
+void BaseQCAccumulator::setForward(BaseQCAccumulator* forward, bool buffer)
+{
+    myForward = forward;
+    myBuffering = buffer;
+    myBufferedValues.clear();
+}
+
+
+void BaseQCAccumulator::release()
+{
+    if(myBuffering)
+    {
+        myBuffering = false;
+        for(size_t i = 0; i < myBufferedValues.size();
+            i += BaseQCColumns::NUM_COLUMNS)
+        {
+            myForward->analyze(myBufferedChromosome.c_str(),
+                               &(myBufferedValues[i]));
+        }
+        myBufferedValues.clear();
+    }
+}
+
+
+void BaseQCAccumulator::analyze(const char* chromosome,
+                                const uint64_t* values)
+{
+    if(myForward != NULL)
+    {
+        if(myBuffering)
+        {
+            myBufferedChromosome = chromosome;
+            myBufferedValues.insert(myBufferedValues.end(), values,
+                                    values + BaseQCColumns::NUM_COLUMNS);
+        }
+        else
+        {
+            myForward->analyze(chromosome, values);
+        }
+        return;
+    }
+    if(myColumnWriter != NULL)
+    {
+        myColumnWriter->add(chromosome, values);
+    }
+    if(myOutputFile != NULL)
+    {
+        PileupElementBaseQCStats::formatColumns(myOutputString, chromosome,
+                                                values);
+        ifwrite(myOutputFile, myOutputString.c_str(),
+                myOutputString.Length());
+    }
+    if(myBaseSum)
+    {
+        // Update the average values.
+        push(chromosome, values);
+    }
+}
+
+
+void BaseQCAccumulator::push(const char* chromosome,
+                             const uint64_t* values)
+{
+    if(myReferenceName != chromosome)
+    {
+        mergeReference();
+        myReferenceName = chromosome;
+    }
+    myReference.push(values);
+}
+
+
+void BaseQCAccumulator::merge(const BaseQCAccumulator& other)
+{
+    mergeReference();
+    myTotal.merge(other.myTotal);
+    myTotal.merge(other.myReference);
+}
+
+
+void BaseQCAccumulator::mergeReference()
+{
+    myTotal.merge(myReference);
+    myReference = Summary();
+    myReferenceName.clear();
+}
+
+
+void BaseQCAccumulator::Summary::push(const uint64_t* values)
+{
+    avgTotalReads.push(values[BaseQCColumns::TOTAL_READS]);
+    avgDups.push(values[BaseQCColumns::DUPS]);
+    avgQCFail.push(values[BaseQCColumns::QC_FAIL]);
+    avgMapped.push(values[BaseQCColumns::MAPPED]);
+    avgPaired.push(values[BaseQCColumns::PAIRED]);
+    avgProperPaired.push(values[BaseQCColumns::PROPER_PAIRED]);
+    avgZeroMapQ.push(values[BaseQCColumns::ZERO_MAPQ]);
+    avgLT10MapQ.push(values[BaseQCColumns::LT10_MAPQ]);
+    avgMapQ255.push(values[BaseQCColumns::MAPQ_255]);
+    avgMapQPass.push(values[BaseQCColumns::PASS_MAPQ]);
+    avgAvgMapQ.push(((double)values[BaseQCColumns::SUM_MAPQ]) /
+                    (int)values[BaseQCColumns::MAPQ_COUNT]);
+    avgAvgMapQCount.push(values[BaseQCColumns::MAPQ_COUNT]);
+    avgDepth.push(values[BaseQCColumns::DEPTH]);
+    avgQ20.push(values[BaseQCColumns::Q20]);
+}
+
+
+void BaseQCAccumulator::Summary::merge(const Summary& other)
+{
+    avgTotalReads.merge(other.avgTotalReads);
+    avgDups.merge(other.avgDups);
+    avgQCFail.merge(other.avgQCFail);
+    avgMapped.merge(other.avgMapped);
+    avgPaired.merge(other.avgPaired);
+    avgProperPaired.merge(other.avgProperPaired);
+    avgZeroMapQ.merge(other.avgZeroMapQ);
+    avgLT10MapQ.merge(other.avgLT10MapQ);
+    avgMapQ255.merge(other.avgMapQ255);
+    avgMapQPass.merge(other.avgMapQPass);
+    avgAvgMapQ.merge(other.avgAvgMapQ);
+    avgAvgMapQCount.merge(other.avgAvgMapQCount);
+    avgDepth.merge(other.avgDepth);
+    avgQ20.merge(other.avgQ20);
+}
+
+
+void BaseQCAccumulator::printSummary()
+{
+    if(myBaseSum)
+    {
+        mergeReference();
+        fprintf(stderr, "\nSummary of Pileup Stats (1st Row is Mean, 2nd Row is Standard Deviation)\nTotalReads\tDups\tQCFail\tMapped\tPaired\tProperPaired\tZeroMapQual\tMapQual<10\tMapQual255\tPassMapQual\tAverageMapQuality\tAverageMapQualCount\tDepth\tQ20Bases\n");
+        
+        fprintf(stderr, 
+                 "%f\t%f\t%f\t%f\t%f\t%f\t%f\t%f\t%f\t%f\t%f\t%f\t%f\t%f\n",
+                 myTotal.avgTotalReads.mean(), myTotal.avgDups.mean(), myTotal.avgQCFail.mean(),
+                 myTotal.avgMapped.mean(), myTotal.avgPaired.mean(), myTotal.avgProperPaired.mean(),
+                 myTotal.avgZeroMapQ.mean(), myTotal.avgLT10MapQ.mean(), myTotal.avgMapQ255.mean(), 
+                 myTotal.avgMapQPass.mean(), myTotal.avgAvgMapQ.mean(), myTotal.avgAvgMapQCount.mean(),
+                 myTotal.avgDepth.mean(), myTotal.avgQ20.mean());
+        fprintf(stderr, 
+                 "%f\t%f\t%f\t%f\t%f\t%f\t%f\t%f\t%f\t%f\t%f\t%f\t%f\t%f\n\n",
+                 myTotal.avgTotalReads.standardDeviation(), myTotal.avgDups.standardDeviation(), myTotal.avgQCFail.standardDeviation(),
+                 myTotal.avgMapped.standardDeviation(), myTotal.avgPaired.standardDeviation(), myTotal.avgProperPaired.standardDeviation(),
+                 myTotal.avgZeroMapQ.standardDeviation(), myTotal.avgLT10MapQ.standardDeviation(), myTotal.avgMapQ255.standardDeviation(), 
+                 myTotal.avgMapQPass.standardDeviation(), myTotal.avgAvgMapQ.standardDeviation(), myTotal.avgAvgMapQCount.standardDeviation(),
+                 myTotal.avgDepth.standardDeviation(), myTotal.avgQ20.standardDeviation());
+    }
+}
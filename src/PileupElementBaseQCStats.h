@@ -22,12 +22,19 @@
 #ifndef __PILEUP_ELEMENT_BASE_QC_STATS_H__
 #define __PILEUP_ELEMENT_BASE_QC_STATS_H__
 
+#include <string>
+#include <vector>
 #include "PileupElement.h"
-#include "SimpleStats.h"
+#include "BaseQCColumns.h"
+
+class BaseQCAccumulator;
 
 class PileupElementBaseQCStats : public PileupElement
 {
 public:
+    // The filter & output format settings are shared by all pileups, set
+    // them before processing any records.
+
     /// Set whether or not to filter duplicates (default is to filter them).
     static void filterDups(bool filterDups);
     /// Set whether or not to filter QC failures (default is to filter them).
@@ -37,23 +44,12 @@ public:
     /// processed, and if it is below that, it will be filtered.
     static void setMapQualFilter(int minMapQuality);
 
-    /// Set the output file to the already opened file.
-    static void setOutputFile(IFILE outputPtr);
-
-    // Print the output format, make sure you call after setSumStats
-    // if you want summary statistics or your output file
-    // will have the wrong header..
-    static void printHeader();
+    /// Print the output format to the specified file.
+    static void printHeader(IFILE outputPtr);
 
     /// The default setting is to not do percentStats (percentStats = false)
     static void setPercentStats(bool percentStats);
 
-    /// Set whether or not a summary of all bases should be collected.
-    static void setBaseSum(bool baseSum);
-
-    /// Prints a summary to stderr if setBaseSum was passed true.
-    static void printSummary();
-
     PileupElementBaseQCStats();
 
     virtual ~PileupElementBaseQCStats();
@@ -61,13 +57,25 @@ public:
     // Add an entry to this pileup element.  
     virtual void addEntry(SamRecord& record);
 
-    // Perform the analysis associated with this class.
-    virtual void analyze();
+    // Perform the analysis associated with this class, writing the
+    // results to the accumulator.
+    void analyze(BaseQCAccumulator& accumulator);
 
     // Resets the entry, setting the new position associated with this element.
     virtual void reset(int32_t refPosition);
 
+    /// Set the values of the columns (indexed by BaseQCColumns::Column)
+    /// of this position.
+    void getColumns(uint64_t* values) const;
+
+    /// Format the column values of a position as a line of the pBaseQC
+    /// or cBaseQC (depending on setPercentStats) text output.
+    static void formatColumns(String& output, const char* chromosome,
+                              const uint64_t* values);
+
 private:
+    friend class BaseQCPileup;
+
     PileupElementBaseQCStats(const PileupElement& q);
 
     void initVars();
@@ -75,30 +83,11 @@ private:
     static bool ourFilterDups;
     static bool ourFilterQCFail;
     static int ourMinMapQuality;
-    static IFILE ourOutputFile;
     static bool ourPercentStats;
     static const int Q20_CHAR_VAL = 53;
     static const int E9_CALC = 1000000000;
     static const int E6_CALC = 1000000;
 
-    // These are for summary values.
-    static RunningStat avgTotalReads; 
-    static RunningStat avgDups;
-    static RunningStat avgQCFail;
-    static RunningStat avgMapped;
-    static RunningStat avgPaired;
-    static RunningStat avgProperPaired;
-    static RunningStat avgZeroMapQ;
-    static RunningStat avgLT10MapQ;
-    static RunningStat avgMapQ255;
-    static RunningStat avgMapQPass;
-    static RunningStat avgAvgMapQ;
-    static RunningStat avgAvgMapQCount;
-    static RunningStat avgDepth;
-    static RunningStat avgQ20;
-
-    static bool ourBaseSum;
-
     int numEntries;
     int numQ20;
     int depth;
@@ -114,8 +103,145 @@ private:
     int numMapQ255;
     uint64_t sumMapQ;
     int averageMapQCount;
+};
+
 
+/// Running mean & standard deviation (same as RunningStat) that can be
+/// merged with another, so values pushed on separate threads can be
+/// combined.
+class MergeableRunningStat
+{
+public:
+    MergeableRunningStat();
+
+    /// Add a value.
+    void push(double value);
+
+    /// Add the values of another, as if they had been pushed to this one,
+    /// although the result may differ from pushing them in the last digits.
+    void merge(const MergeableRunningStat& other);
+
+    double mean() const;
+    double standardDeviation() const;
+
+private:
+    uint64_t myNumValues;
+    double myMean;
+    // Sum of the squared differences from the mean.
+    double mySumSq;
+};
+
+
+/// Statistics of the analyzed pileup positions: writes each position
+/// to the output file & summarizes them if baseSum is set.  Each pileup
+/// analyzes into its own, so separate references can be processed on
+/// separate threads and their summaries merged afterwards.
+class BaseQCAccumulator
+{
+public:
+    BaseQCAccumulator();
+
+    /// Set the already opened file to write each position to
+    /// (NULL to not write them).
+    void setOutputFile(IFILE outputPtr) { myOutputFile = outputPtr; }
+    IFILE getOutputFile() { return(myOutputFile); }
+
+    /// Set the already opened column file to write each position to
+    /// (NULL to not write them).
+    void setColumnWriter(BaseQCColumnWriter* columnWriter)
+    { myColumnWriter = columnWriter; }
+    BaseQCColumnWriter* getColumnWriter() { return(myColumnWriter); }
+
+    /// Set whether or not a summary of all bases should be collected.
+    void setBaseSum(bool baseSum) { myBaseSum = baseSum; }
+    bool getBaseSum() const { return(myBaseSum); }
+
+    /// Pass the analyzed positions on to another accumulator rather than
+    /// writing & summarizing them here, holding them until release is
+    /// called if buffer is true.
+    void setForward(BaseQCAccumulator* forward, bool buffer);
+
+    /// Pass the held positions on & stop holding them.
+    void release();
+
+    /// Write the column values (indexed by BaseQCColumns::Column) of a
+    /// covered position to the output file & add them to the summary.
+    void analyze(const char* chromosome, const uint64_t* values);
+
+    /// Add the column values of an analyzed position on the specified
+    /// chromosome to the summary.
+    void push(const char* chromosome, const uint64_t* values);
+
+    /// Add the summary of another accumulator to this one.  Merging the
+    /// accumulators of separate references in order gives exactly the
+    /// summary of analyzing all of their positions in one accumulator.
+    void merge(const BaseQCAccumulator& other);
+
+    /// Prints the summary to stderr if setBaseSum was passed true.
+    void printSummary();
+
+private:
+    IFILE myOutputFile;
+    BaseQCColumnWriter* myColumnWriter;
+    bool myBaseSum;
     String myOutputString;
+
+    BaseQCAccumulator* myForward;
+    bool myBuffering;
+    // The positions held until release, NUM_COLUMNS values each.
+    std::string myBufferedChromosome;
+    std::vector<uint64_t> myBufferedValues;
+
+    // Summary of a set of positions.
+    struct Summary
+    {
+        void push(const uint64_t* values);
+        void merge(const Summary& other);
+
+        MergeableRunningStat avgTotalReads; 
+        MergeableRunningStat avgDups;
+        MergeableRunningStat avgQCFail;
+        MergeableRunningStat avgMapped;
+        MergeableRunningStat avgPaired;
+        MergeableRunningStat avgProperPaired;
+        MergeableRunningStat avgZeroMapQ;
+        MergeableRunningStat avgLT10MapQ;
+        MergeableRunningStat avgMapQ255;
+        MergeableRunningStat avgMapQPass;
+        MergeableRunningStat avgAvgMapQ;
+        MergeableRunningStat avgAvgMapQCount;
+        MergeableRunningStat avgDepth;
+        MergeableRunningStat avgQ20;
+    };
+
+    // Merge the summary of the current reference into the total.
+    void mergeReference();
+
+    // The positions of each reference are summarized on their own & only
+    // merged into the total at the end of the reference, which is also
+    // what merging the accumulators of separate references does, so the
+    // summary is identical with or without threads.
+    Summary myTotal;
+    Summary myReference;
+    std::string myReferenceName;
+};
+
+
+/// Pileup analysis function (the Pileup's FUNC_CLASS) that analyzes each
+/// element into the pileup's accumulator.
+class BaseQCAnalyzer
+{
+public:
+    BaseQCAnalyzer(BaseQCAccumulator* accumulator)
+        : myAccumulator(accumulator) {}
+
+    void operator() (PileupElementBaseQCStats& element)
+    {
+        element.analyze(*myAccumulator);
+    }
+
+private:
+    BaseQCAccumulator* myAccumulator;
 };
 
 #endif
@@ -0,0 +1,403 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//////////////////////////////////////////////////////////////////////////
+// This file contains the processing for the executable option "pipeline"
+// which runs several tools on a SAM/BAM file in a single process, passing
+// the records from one tool to the next in memory rather than through
+// intermediate files.
+
+#include <string.h>
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include "Pipeline.h"
+#include "BgzfFileType.h"
+#include "Logger.h"
+#include "SamInputFile.h"
+
+Pipeline::Pipeline(CreateBamExeFunc createFunc)
+    : BamExecutable(),
+      myCreateFunc(createFunc),
+      myStages(),
+      myQueues()
+{
+}
+
+
+Pipeline::~Pipeline()
+{
+    cleanup();
+}
+
+
+void Pipeline::printPipelineDescription(std::ostream& os)
+{
+    os << " pipeline - Run several tools on a SAM/BAM file in one process without writing intermediate files" << std::endl;
+}
+
+
+void Pipeline::printDescription(std::ostream& os)
+{
+    printPipelineDescription(os);
+}
+
+
+void Pipeline::printUsage(std::ostream& os)
+{
+    BamExecutable::printUsage(os);
+    os << "\t./bam pipeline --in <inputFile> --out <outputFile> [--tmpPrefix <prefix>] [--noeof] [--params] [--threads <numThreads>] [--level <0-9>] --stage <tool> [<tool arguments>] [--stage <tool> [<tool arguments>]]*" << std::endl;
+    os << "\tRequired Parameters:" << std::endl;
+    os << "\t\t--in        : the SAM/BAM file to be read by the first stage" << std::endl;
+    os << "\t\t--out       : the SAM/BAM file to be written by the last stage" << std::endl;
+    os << "\t\t--stage     : a tool to run followed by its arguments (other than --in/--out)." << std::endl;
+    os << "\t\t              Each stage processes the records output by the previous stage." << std::endl;
+    os << "\t\t              Supported tools: squeeze, clipOverlap, dedup, recab" << std::endl;
+    os << "\tOptional Parameters:" << std::endl;
+    os << "\t\t--tmpPrefix : prefix of the temporary files used by stages that read their input" << std::endl;
+    os << "\t\t              twice (dedup & recab) when they are not the first stage or the input" << std::endl;
+    os << "\t\t              is stdin (default: the output file name)" << std::endl;
+    os << "\t\t--noeof     : do not expect an EOF block on a bam file." << std::endl;
+    os << "\t\t--params    : print the parameter settings" << std::endl;
+    os << "\t\t--threads   : number of threads for reading & compressing BAM files (default 0)" << std::endl;
+    os << "\t\t--level     : BAM compression level, 0 (uncompressed BGZF) to 9 (default -1: zlib default)" << std::endl;
+    os << "\tNotes:" << std::endl;
+    os << "\t\tEach stage runs on its own thread.  The last stage is given the pipeline's --out," << std::endl;
+    os << "\t\tother stages are given --out <outputFile>.stage<N>, which is only used to name" << std::endl;
+    os << "\t\ttheir log & model files.  A stage that fails stops the stages after it." << std::endl;
+    os << std::endl;
+}
+
+
+int Pipeline::execute(int argc, char **argv)
+{
+    String inFile = "";
+    String outFile = "";
+    String tmpPrefix = "";
+    bool noeof = false;
+    bool params = false;
+
+    // The pipeline parameters are before the first stage.
+    int firstStage = 2;
+    while((firstStage < argc) && (strcmp(argv[firstStage], "--stage") != 0))
+    {
+        ++firstStage;
+    }
+
+    ParameterList inputParameters;
+    LongParamContainer parameters;
+
+    parameters.addGroup("Required Parameters");
+    parameters.addString("in", &inFile);
+    parameters.addString("out", &outFile);
+    parameters.addGroup("Optional Parameters");
+    parameters.addString("tmpPrefix", &tmpPrefix);
+    parameters.addBool("noeof", &noeof);
+    parameters.addBool("params", &params);
+    addBamOutputParameters(parameters);
+    parameters.addPhoneHome(VERSION);
+
+    inputParameters.Add(new LongParameters ("Input Parameters",
+                                            parameters.getLongParameterList()));
+
+    // parameters start at index 2 rather than 1.
+    inputParameters.Read(firstStage, argv, 2);
+
+    // If no eof block is required for a bgzf file, set the bgzf file type to
+    // not look for it.
+    if(noeof)
+    {
+        // Set that the eof block is not required.
+        setRequireEofBlock(false);
+    }
+
+    if(inFile.IsEmpty())
+    {
+        printUsage(std::cerr);
+        inputParameters.Status();
+        std::cerr << "Missing required --in parameter" << std::endl;
+        return(-1);
+    }
+
+    if(outFile.IsEmpty())
+    {
+        printUsage(std::cerr);
+        inputParameters.Status();
+        std::cerr << "Missing required --out parameter" << std::endl;
+        return(-1);
+    }
+
+    // Split the remaining arguments into stages.
+    for(int i = firstStage; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--stage") == 0)
+        {
+            if((i + 1 >= argc) || (strcmp(argv[i+1], "--stage") == 0))
+            {
+                printUsage(std::cerr);
+                inputParameters.Status();
+                std::cerr << "--stage must be followed by a tool name" << std::endl;
+                return(-1);
+            }
+            myStages.push_back(new Stage());
+            std::string& name = myStages.back()->name;
+            name = argv[++i];
+            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        }
+        else
+        {
+            myStages.back()->args.push_back(argv[i]);
+        }
+    }
+
+    if(myStages.empty())
+    {
+        printUsage(std::cerr);
+        inputParameters.Status();
+        std::cerr << "Missing required --stage parameter" << std::endl;
+        return(-1);
+    }
+
+    if(!processBamIoParameters())
+    {
+        inputParameters.Status();
+        return(-1);
+    }
+
+    if(params)
+    {
+        inputParameters.Status();
+    }
+
+    std::string stageBase = outFile.c_str();
+    if(stageBase[0] == '-')
+    {
+        stageBase = "bamPipeline";
+    }
+    if(tmpPrefix.IsEmpty())
+    {
+        tmpPrefix = stageBase.c_str();
+    }
+
+    // Setup each stage's tool on this thread so parameter errors are
+    // reported before any records are processed.
+    int numStages = myStages.size();
+    for(int i = 0; i < numStages; i++)
+    {
+        Stage& stage = *(myStages[i]);
+        std::string stageOut = outFile.c_str();
+        if(i != numStages - 1)
+        {
+            std::stringstream stageName;
+            stageName << stageBase << ".stage" << i + 1;
+            stageOut = stageName.str();
+        }
+        stage.args.push_back("--in");
+        stage.args.push_back(inFile.c_str());
+        stage.args.push_back("--out");
+        stage.args.push_back(stageOut);
+        // The pipeline itself phones home.
+        stage.args.push_back("--noPhoneHome");
+
+        int status = setupPipelineStage(stage);
+        if(status != 0)
+        {
+            std::cerr << "Failed to setup pipeline stage " << i + 1
+                      << ": " << stage.name << std::endl;
+            return(status);
+        }
+    }
+
+    // Open the input & output files.
+    SamFileHeader samHeader;
+    SamInputFile samIn;
+    if(!samIn.OpenForRead(inFile, &samHeader))
+    {
+        std::cerr << "Failed to open the input file: " << inFile
+                  << ": " << samIn.GetStatusMessage() << std::endl;
+        return(-1);
+    }
+    SamFile samOut;
+    if(!openForWrite(samOut, outFile, &samHeader))
+    {
+        std::cerr << "Failed to open the output file: " << outFile
+                  << std::endl;
+        return(-1);
+    }
+    SamFileSink samOutSink(samOut);
+
+    // Connect the stages.
+    for(int i = 0; i < numStages; i++)
+    {
+        Stage& stage = *(myStages[i]);
+        stage.header = samHeader;
+        if(i == 0)
+        {
+            stage.source = &samIn;
+        }
+        else
+        {
+            stage.inQueue = myQueues.back();
+            stage.source = &(stage.inQueue->getSource());
+        }
+        if(i == numStages - 1)
+        {
+            stage.sink = &samOutSink;
+        }
+        else
+        {
+            myQueues.push_back(new SamRecordQueue());
+            stage.outQueue = myQueues.back();
+            stage.sink = &(stage.outQueue->getSink());
+        }
+
+        // Stages after the first & stdin cannot be reread, so spool
+        // them if the stage makes two passes.
+        if(stage.tool->stageRewindsInput() &&
+           ((i != 0) || (inFile[0] == '-')))
+        {
+            std::stringstream spoolName;
+            spoolName << tmpPrefix << ".stage" << i + 1 << ".ubam";
+            stage.spoolFile = spoolName.str();
+        }
+    }
+
+    // Run the stages.
+    std::vector<std::thread> threads;
+    for(int i = 0; i < numStages; i++)
+    {
+        threads.push_back(std::thread(runPipelineStage, myStages[i]));
+    }
+    for(int i = 0; i < numStages; i++)
+    {
+        threads[i].join();
+    }
+
+    samIn.Close();
+    samOut.Close();
+
+    // Report the first failure.
+    int status = 0;
+    std::string error;
+    for(int i = 0; i < numStages; i++)
+    {
+        Stage& stage = *(myStages[i]);
+        if(!stage.error.empty() && error.empty())
+        {
+            error = "pipeline stage " + stage.name + ": " + stage.error;
+        }
+        if((stage.status != 0) && (status == 0))
+        {
+            status = stage.status;
+        }
+    }
+    cleanup();
+
+    if(!error.empty())
+    {
+        throw(std::runtime_error(error));
+    }
+    return(status);
+}
+
+
+int Pipeline::setupPipelineStage(Stage& stage)
+{
+    stage.tool = myCreateFunc(stage.name);
+    if((stage.tool == NULL) || (stage.name == "pipeline"))
+    {
+        std::cerr << "Invalid pipeline stage tool: " << stage.name
+                  << std::endl;
+        return(-1);
+    }
+
+    std::vector<char*> stageArgv;
+    stageArgv.push_back((char*)"bam");
+    stageArgv.push_back(&(stage.name[0]));
+    for(unsigned int i = 0; i < stage.args.size(); i++)
+    {
+        stageArgv.push_back(&(stage.args[i][0]));
+    }
+    stageArgv.push_back(NULL);
+
+    int status = stage.tool->setupStage(stageArgv.size() - 1, &(stageArgv[0]));
+
+    // Tools that log set the logger while setting up, so save it
+    // for the stage's thread.
+    stage.logger = Logger::gLogger;
+    Logger::gLogger = NULL;
+    return(status);
+}
+
+
+void Pipeline::runPipelineStage(Stage* stage)
+{
+    Logger::gLogger = stage->logger;
+
+    SamSpoolSource* spool = NULL;
+    try
+    {
+        SamRecordSource* source = stage->source;
+        if(!stage->spoolFile.empty())
+        {
+            spool = new SamSpoolSource(*source, stage->header,
+                                       stage->spoolFile.c_str());
+            source = spool;
+        }
+        stage->status = stage->tool->runStage(stage->header, *source,
+                                              *(stage->sink));
+    }
+    catch(std::exception& e)
+    {
+        stage->status = -1;
+        stage->error = e.what();
+    }
+    if(spool != NULL)
+    {
+        delete spool;
+    }
+
+    // Let the neighboring stages know this stage is done.
+    if(stage->outQueue != NULL)
+    {
+        stage->outQueue->close(stage->status != 0);
+    }
+    if(stage->inQueue != NULL)
+    {
+        stage->inQueue->cancel();
+    }
+}
+
+
+void Pipeline::cleanup()
+{
+    for(unsigned int i = 0; i < myStages.size(); i++)
+    {
+        if(myStages[i]->tool != NULL)
+        {
+            delete myStages[i]->tool;
+        }
+        delete myStages[i];
+    }
+    myStages.clear();
+    for(unsigned int i = 0; i < myQueues.size(); i++)
+    {
+        delete myQueues[i];
+    }
+    myQueues.clear();
+}
@@ -0,0 +1,89 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//////////////////////////////////////////////////////////////////////////
+// This file contains the processing for the executable option "pipeline"
+// which runs several tools on a SAM/BAM file in a single process, passing
+// the records from one tool to the next in memory rather than through
+// intermediate files.
+
+#ifndef __PIPELINE_H__
+#define __PIPELINE_H__
+
+#include <string>
+#include <vector>
+#include "BamExecutable.h"
+#include "SamRecordQueue.h"
+
+class Logger;
+
+class Pipeline : public BamExecutable
+{
+public:
+    /// Function that creates the BamExecutable for a tool name
+    /// (lowercase), returning NULL if it is not a valid tool.
+    typedef BamExecutable* (*CreateBamExeFunc)(const std::string& name);
+
+    Pipeline(CreateBamExeFunc createFunc);
+    ~Pipeline();
+
+    static void printPipelineDescription(std::ostream& os);
+    void printDescription(std::ostream& os);
+    void printUsage(std::ostream& os);
+    int execute(int argc, char **argv);
+    virtual const char* getProgramName() {return("bam:pipeline");}
+
+private:
+    // Each stage of the pipeline runs on its own thread.
+    struct Stage
+    {
+        std::string name;
+        std::vector<std::string> args;
+        BamExecutable* tool;
+        Logger* logger;
+        SamFileHeader header;
+        SamRecordSource* source;
+        SamRecordSink* sink;
+        // Set if the stage rewinds a source that cannot be reread.
+        std::string spoolFile;
+        // Queues to close/cancel when the stage is done.
+        SamRecordQueue* outQueue;
+        SamRecordQueue* inQueue;
+        int status;
+        std::string error;
+        Stage()
+            : name(), args(), tool(NULL), logger(NULL), header(),
+              source(NULL), sink(NULL), spoolFile(), outQueue(NULL),
+              inQueue(NULL), status(0), error() {}
+    };
+
+    // Create the stage's tool & parse its parameters.
+    // Returns 0 on success.
+    int setupPipelineStage(Stage& stage);
+
+    // Run the stage (on its thread).
+    static void runPipelineStage(Stage* stage);
+
+    // Delete the stages & queues.
+    void cleanup();
+
+    CreateBamExeFunc myCreateFunc;
+    std::vector<Stage*> myStages;
+    std::vector<SamRecordQueue*> myQueues;
+};
+
+#endif
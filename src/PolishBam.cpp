@@ -220,6 +220,8 @@ void PolishBam::printUsage(std::ostream& os)
     os << "--UR : UR tag for @SQ tag (if different from --fasta)" << std::endl;
     os << "--SP : SP tag for @SQ tag" << std:: endl;
     os << "--checkSQ : check the consistency of SQ tags (SN and LN) with existing header lines. Must be used with --fasta option" << std::endl;
+    os << "--threads : number of threads for compressing the output BAM file (default 0)" << std::endl;
+    os << "--level : deflate level of the output BAM file, 0 is uncompressed BGZF (default -1: zlib default)" << std::endl;
     os << "\n" << std::endl;
 }
 
@@ -281,6 +283,8 @@ int PolishBam::execute(int argc, char ** argv)
       { "PG", required_argument, NULL, 0},
       { "CO", required_argument, NULL, 0},
       { "checkSQ", no_argument, NULL, 0},
+      { "threads", required_argument, NULL, 0},
+      { "level", required_argument, NULL, 0},
       { "noPhoneHome", no_argument, NULL, 'p'},
       { "nophonehome", no_argument, NULL, 'P'},
       { "phoneHomeThinning", required_argument, NULL, 't'},
@@ -349,6 +353,12 @@ int PolishBam::execute(int argc, char ** argv)
     else if ( strcmp(getopt_long_options[n_option_index].name,"checkSQ") == 0 ) {
       bCheckSQ = true;
     }
+    else if ( strcmp(getopt_long_options[n_option_index].name,"threads") == 0 ) {
+      myNumThreads = atoi(optarg);
+    }
+    else if ( strcmp(getopt_long_options[n_option_index].name,"level") == 0 ) {
+      myCompressionLevel = atoi(optarg);
+    }
     else {
       std::cerr << "Error: Unrecognized option " << getopt_long_options[n_option_index].name << std::endl;
       return(-1);
@@ -372,6 +382,11 @@ int PolishBam::execute(int argc, char ** argv)
       }
   }
 
+  if(!processBamIoParameters())
+  {
+      return(-1);
+  }
+
   Logger::gLogger = new Logger(sLogFile.c_str(), bVerbose);
 
   if ( optind < argc ) {
@@ -460,7 +475,7 @@ int PolishBam::execute(int argc, char ** argv)
   if ( ! samIn.OpenForRead(sInFile.c_str()) ) {
     Logger::gLogger->error("Cannot open BAM file %s for reading - %s",sInFile.c_str(), SamStatus::getStatusString(samIn.GetStatus()) );
   }
-  if ( ! samOut.OpenForWrite(sOutFile.c_str()) ) {
+  if ( ! openForWrite(samOut, sOutFile.c_str()) ) {
     Logger::gLogger->error("Cannot open BAM file %s for writing - %s",sOutFile.c_str(), SamStatus::getStatusString(samOut.GetStatus()) );
   }
 
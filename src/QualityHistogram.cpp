@@ -0,0 +1,107 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "QualityHistogram.h"
+
+QualityHistogram::QualityHistogram()
+{
+    memset(myCounts, 0, sizeof(myCounts));
+}
+
+
+bool QualityHistogram::countSpan(const char* qual, int length)
+{
+    if(!isValidSpan(qual, length))
+    {
+        return(false);
+    }
+
+    const unsigned char* pos = (const unsigned char*)qual;
+    int i = 0;
+    for(; i + NUM_SUB_COUNTS <= length; i += NUM_SUB_COUNTS)
+    {
+        ++(myCounts[0][pos[i]]);
+        ++(myCounts[1][pos[i + 1]]);
+        ++(myCounts[2][pos[i + 2]]);
+        ++(myCounts[3][pos[i + 3]]);
+    }
+    for(; i < length; i++)
+    {
+        ++(myCounts[0][pos[i]]);
+    }
+    return(true);
+}
+
+
+void QualityHistogram::merge(const QualityHistogram& other)
+{
+    for(int i = 0; i < NUM_SUB_COUNTS; i++)
+    {
+        for(int j = 0; j <= MAX_QUAL; j++)
+        {
+            myCounts[i][j] += other.myCounts[i][j];
+        }
+    }
+}
+
+
+uint64_t QualityHistogram::getCount(int qual) const
+{
+    if((qual < 0) || (qual > MAX_QUAL))
+    {
+        return(0);
+    }
+    uint64_t total = 0;
+    for(int i = 0; i < NUM_SUB_COUNTS; i++)
+    {
+        total += myCounts[i][qual];
+    }
+    return(total);
+}
+
+
+bool QualityHistogram::isValidSpan(const char* qual, int length)
+{
+    int i = 0;
+#ifdef __SSE2__
+    // Signed comparisons, so characters over 127 are negative & invalid.
+    const __m128i belowMin = _mm_set1_epi8(START_QUAL - 1);
+    const __m128i aboveMax = _mm_set1_epi8(MAX_QUAL + 1);
+    for(; i + 16 <= length; i += 16)
+    {
+        __m128i quals = _mm_loadu_si128((const __m128i*)(qual + i));
+        __m128i valid = _mm_and_si128(_mm_cmpgt_epi8(quals, belowMin),
+                                      _mm_cmplt_epi8(quals, aboveMax));
+        if(_mm_movemask_epi8(valid) != 0xFFFF)
+        {
+            return(false);
+        }
+    }
+#endif
+    for(; i < length; i++)
+    {
+        if((qual[i] < START_QUAL) || (qual[i] > MAX_QUAL))
+        {
+            return(false);
+        }
+    }
+    return(true);
+}
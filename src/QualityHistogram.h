@@ -0,0 +1,61 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//////////////////////////////////////////////////////////////////////////
+// Histogram of base quality characters, counted a span of qualities at a
+// time.
+
+#ifndef __QUALITY_HISTOGRAM_H__
+#define __QUALITY_HISTOGRAM_H__
+
+#include <stdint.h>
+
+/// Counts the base qualities ('!' to '~') of spans of quality strings.
+/// Each span is validated 16 qualities at a time with SSE2 (when
+/// available) and counted into interleaved sub-histograms so consecutive
+/// qualities do not wait on each other's increments.
+class QualityHistogram
+{
+public:
+    static const int START_QUAL = 33;
+    static const int MAX_QUAL = 126;
+
+    QualityHistogram();
+
+    /// Count the qualities of the span.  Returns false without counting
+    /// any of them if any are outside of START_QUAL to MAX_QUAL.
+    bool countSpan(const char* qual, int length);
+
+    /// Count a single valid quality.
+    void count(char qual) { ++(myCounts[0][(int)qual]); }
+
+    /// Add the counts of another histogram to this one.
+    void merge(const QualityHistogram& other);
+
+    /// Return the number of times the quality character was counted.
+    uint64_t getCount(int qual) const;
+
+    /// Return whether or not all of the qualities of the span are valid.
+    static bool isValidSpan(const char* qual, int length);
+
+private:
+    static const int NUM_SUB_COUNTS = 4;
+
+    uint64_t myCounts[NUM_SUB_COUNTS][MAX_QUAL + 1];
+};
+
+#endif
@@ -0,0 +1,508 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include "ReadNameDictionary.h"
+
+namespace
+{
+    // Sorts the entries in memory by name.
+    struct EntryNameLess
+    {
+        EntryNameLess(const std::vector<char*>& arena,
+                      const std::vector<uint64_t>& offsets,
+                      unsigned int blockBits)
+            : myArena(arena), myOffsets(offsets), myBlockBits(blockBits)
+        {
+        }
+
+        const unsigned char* name(uint64_t entry) const
+        {
+            uint64_t offset = myOffsets[entry];
+            return((const unsigned char*)
+                   (myArena[offset >> myBlockBits] +
+                    (offset & ((((uint64_t)1) << myBlockBits) - 1))));
+        }
+
+        bool operator()(uint64_t entry1, uint64_t entry2) const
+        {
+            const unsigned char* name1 = name(entry1);
+            const unsigned char* name2 = name(entry2);
+            unsigned int length = std::min(name1[0], name2[0]);
+            int cmp = memcmp(name1 + 1, name2 + 1, length);
+            if(cmp != 0)
+            {
+                return(cmp < 0);
+            }
+            return(name1[0] < name2[0]);
+        }
+
+        const std::vector<char*>& myArena;
+        const std::vector<uint64_t>& myOffsets;
+        unsigned int myBlockBits;
+    };
+}
+
+
+ReadNameDictionary::ReadNameDictionary()
+    : myArena(),
+      myArenaUsed(ARENA_BLOCK_SIZE),
+      myOffsets(),
+      mySlots(1024, 0),
+      mySlotMask(1023),
+      myBaseID(0),
+      myNextID(0),
+      myMaxNames(0),
+      myRunPrefix(),
+      myNumRunFiles(0),
+      myRuns()
+{
+}
+
+
+ReadNameDictionary::~ReadNameDictionary()
+{
+    clear();
+}
+
+
+void ReadNameDictionary::setSpill(uint64_t maxNames,
+                                  const std::string& runPrefix)
+{
+    myMaxNames = maxNames;
+    myRunPrefix = runPrefix;
+}
+
+
+uint64_t ReadNameDictionary::find(const char* name, unsigned int length,
+                                  bool& isNew)
+{
+    if(length > MAX_NAME_LENGTH)
+    {
+        throw(std::runtime_error("Read name is longer than 255 characters: " +
+                                 std::string(name, length)));
+    }
+
+    uint64_t hash = hashName(name, length);
+    uint64_t fingerprint = hash >> ENTRY_BITS;
+
+    // Look for the name in memory.
+    uint64_t index = hash & mySlotMask;
+    while(mySlots[index] != 0)
+    {
+        if((mySlots[index] >> ENTRY_BITS) == fingerprint)
+        {
+            uint64_t entry = (mySlots[index] & ENTRY_MASK) - 1;
+            unsigned int entryLength;
+            const char* entryName = getName(entry, entryLength);
+            if((entryLength == length) &&
+               (memcmp(entryName, name, length) == 0))
+            {
+                isNew = false;
+                return(myBaseID + entry);
+            }
+        }
+        index = (index + 1) & mySlotMask;
+    }
+
+    // Look for the name in the runs on disk.
+    uint64_t id;
+    for(unsigned int i = 0; i < myRuns.size(); i++)
+    {
+        if(findInRun(*(myRuns[i]), name, length, hash, id))
+        {
+            isNew = false;
+            return(id);
+        }
+    }
+
+    // New name, so add it to the arena & the empty slot found above.
+    if(myArenaUsed + length + 1 > ARENA_BLOCK_SIZE)
+    {
+        myArena.push_back(new char[ARENA_BLOCK_SIZE]);
+        myArenaUsed = 0;
+    }
+    char* stored = myArena.back() + myArenaUsed;
+    stored[0] = (char)length;
+    memcpy(stored + 1, name, length);
+    uint64_t entry = myOffsets.size();
+    myOffsets.push_back(((uint64_t)(myArena.size() - 1) << ARENA_BLOCK_BITS) |
+                        myArenaUsed);
+    myArenaUsed += length + 1;
+    mySlots[index] = (fingerprint << ENTRY_BITS) | (entry + 1);
+
+    isNew = true;
+    id = myNextID++;
+
+    // Keep the table at most 70% full.
+    if(myOffsets.size() * 10 > mySlots.size() * 7)
+    {
+        growSlots();
+    }
+    if((myMaxNames != 0) && (myOffsets.size() >= myMaxNames))
+    {
+        spill();
+    }
+    return(id);
+}
+
+
+void ReadNameDictionary::clear()
+{
+    for(unsigned int i = 0; i < myArena.size(); i++)
+    {
+        delete[] myArena[i];
+    }
+    myArena.clear();
+    myArenaUsed = ARENA_BLOCK_SIZE;
+    myOffsets.clear();
+    mySlots.assign(1024, 0);
+    mySlotMask = 1023;
+    myBaseID = 0;
+    myNextID = 0;
+    for(unsigned int i = 0; i < myRuns.size(); i++)
+    {
+        removeRun(myRuns[i]);
+    }
+    myRuns.clear();
+    myNumRunFiles = 0;
+}
+
+
+uint64_t ReadNameDictionary::hashName(const char* name, unsigned int length)
+{
+    // 64-bit FNV-1a followed by a final mix so the low bits used for the
+    // slot & the high bits used for the fingerprint both vary.
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for(unsigned int i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)name[i];
+        hash *= 0x100000001b3ULL;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return(hash);
+}
+
+
+int ReadNameDictionary::compareNames(const char* name1, unsigned int length1,
+                                     const char* name2, unsigned int length2)
+{
+    int cmp = memcmp(name1, name2, std::min(length1, length2));
+    if(cmp != 0)
+    {
+        return(cmp);
+    }
+    if(length1 < length2)
+    {
+        return(-1);
+    }
+    return(length1 > length2);
+}
+
+
+void ReadNameDictionary::growSlots()
+{
+    mySlots.assign(mySlots.size() * 2, 0);
+    mySlotMask = mySlots.size() - 1;
+    for(uint64_t entry = 0; entry < myOffsets.size(); entry++)
+    {
+        unsigned int length;
+        const char* name = getName(entry, length);
+        uint64_t hash = hashName(name, length);
+        uint64_t index = hash & mySlotMask;
+        while(mySlots[index] != 0)
+        {
+            index = (index + 1) & mySlotMask;
+        }
+        mySlots[index] = ((hash >> ENTRY_BITS) << ENTRY_BITS) | (entry + 1);
+    }
+}
+
+
+void ReadNameDictionary::spill()
+{
+    std::vector<uint64_t> entries(myOffsets.size());
+    for(uint64_t entry = 0; entry < entries.size(); entry++)
+    {
+        entries[entry] = entry;
+    }
+    std::sort(entries.begin(), entries.end(),
+              EntryNameLess(myArena, myOffsets, ARENA_BLOCK_BITS));
+
+    Run* run = createRun(entries.size());
+    for(uint64_t i = 0; i < entries.size(); i++)
+    {
+        unsigned int length;
+        const char* name = getName(entries[i], length);
+        addToRun(*run, name, length, myBaseID + entries[i]);
+    }
+    finishRun(*run);
+    myRuns.push_back(run);
+
+    // Keep the first arena block & the table for the next names.
+    for(unsigned int i = 1; i < myArena.size(); i++)
+    {
+        delete[] myArena[i];
+    }
+    myArena.resize(std::min(myArena.size(), (size_t)1));
+    myArenaUsed = myArena.empty() ? ARENA_BLOCK_SIZE : 0;
+    myOffsets.clear();
+    mySlots.assign(mySlots.size(), 0);
+    myBaseID = myNextID;
+
+    // The runs are in decreasing tiers, so merging the last MERGE_RUNS
+    // runs once they have the same tier may complete the previous tier.
+    while(myRuns.size() >= MERGE_RUNS)
+    {
+        unsigned int first = myRuns.size() - MERGE_RUNS;
+        if(myRuns[first]->tier != myRuns.back()->tier)
+        {
+            break;
+        }
+        mergeRuns(first);
+    }
+}
+
+
+void ReadNameDictionary::mergeRuns(unsigned int first)
+{
+    uint64_t numNames = 0;
+    for(unsigned int i = first; i < myRuns.size(); i++)
+    {
+        numNames += myRuns[i]->numNames;
+    }
+    Run* merged = createRun(numNames);
+    merged->tier = myRuns[first]->tier + 1;
+
+    // Read the first name of each run.
+    unsigned int numRuns = myRuns.size() - first;
+    Run** runs = &(myRuns[first]);
+    std::vector<std::string> names(numRuns, std::string(MAX_NAME_LENGTH, 0));
+    std::vector<unsigned int> lengths(numRuns, 0);
+    std::vector<uint64_t> ids(numRuns, 0);
+    std::vector<bool> valid(numRuns, false);
+    for(unsigned int i = 0; i < numRuns; i++)
+    {
+        if(fseek(runs[i]->file, 0, SEEK_SET) != 0)
+        {
+            throw(std::runtime_error("Failed to read the read name run file " +
+                                     runs[i]->fileName));
+        }
+        valid[i] = readRunName(*(runs[i]), &(names[i][0]), lengths[i],
+                               ids[i]);
+    }
+
+    // Repeatedly write the smallest name.  A name is only in one run, and
+    // there are few runs, so just scan them.
+    while(true)
+    {
+        int smallest = -1;
+        for(unsigned int i = 0; i < numRuns; i++)
+        {
+            if(valid[i] &&
+               ((smallest < 0) ||
+                (compareNames(names[i].data(), lengths[i],
+                              names[smallest].data(), lengths[smallest]) < 0)))
+            {
+                smallest = i;
+            }
+        }
+        if(smallest < 0)
+        {
+            break;
+        }
+        addToRun(*merged, names[smallest].data(), lengths[smallest],
+                 ids[smallest]);
+        valid[smallest] = readRunName(*(runs[smallest]),
+                                      &(names[smallest][0]),
+                                      lengths[smallest], ids[smallest]);
+    }
+    finishRun(*merged);
+
+    for(unsigned int i = 0; i < numRuns; i++)
+    {
+        removeRun(runs[i]);
+    }
+    myRuns.resize(first);
+    myRuns.push_back(merged);
+}
+
+
+ReadNameDictionary::Run* ReadNameDictionary::createRun(uint64_t numNames)
+{
+    std::stringstream fileName;
+    fileName << myRunPrefix << ".run" << ++myNumRunFiles;
+
+    Run* run = new Run;
+    run->fileName = fileName.str();
+    run->numNames = 0;
+    run->tier = 0;
+    run->size = 0;
+    // Round the filter up to a whole number of words.
+    run->bloom.assign((numNames * BLOOM_BITS_PER_NAME + 63) / 64 + 1, 0);
+    run->file = fopen(run->fileName.c_str(), "w+b");
+    if(run->file == NULL)
+    {
+        delete run;
+        throw(std::runtime_error("Failed to create the read name run file " +
+                                 fileName.str()));
+    }
+    return(run);
+}
+
+
+void ReadNameDictionary::addToRun(Run& run, const char* name,
+                                  unsigned int length, uint64_t id)
+{
+    if((run.numNames % RUN_BLOCK_NAMES) == 0)
+    {
+        run.blockNames.push_back(std::string(name, length));
+        run.blockOffsets.push_back(run.size);
+    }
+
+    // Set the name's bits in the filter, deriving the bit positions from
+    // the two halves of the hash.
+    uint64_t hash = hashName(name, length);
+    uint64_t numBits = run.bloom.size() * 64;
+    uint64_t step = (hash >> 32) | 1;
+    for(unsigned int i = 0; i < BLOOM_HASHES; i++)
+    {
+        uint64_t bit = (hash + i * step) % numBits;
+        run.bloom[bit >> 6] |= ((uint64_t)1) << (bit & 63);
+    }
+
+    // Each name is its length, the name, & its id (little endian).
+    unsigned char record[1 + MAX_NAME_LENGTH + 8];
+    record[0] = length;
+    memcpy(record + 1, name, length);
+    for(unsigned int i = 0; i < 8; i++)
+    {
+        record[1 + length + i] = (unsigned char)(id >> (i * 8));
+    }
+    if(fwrite(record, 1, length + 9, run.file) != length + 9)
+    {
+        throw(std::runtime_error("Failed to write the read name run file " +
+                                 run.fileName));
+    }
+    run.size += length + 9;
+    ++run.numNames;
+}
+
+
+void ReadNameDictionary::finishRun(Run& run)
+{
+    if(fflush(run.file) != 0)
+    {
+        throw(std::runtime_error("Failed to write the read name run file " +
+                                 run.fileName));
+    }
+}
+
+
+bool ReadNameDictionary::findInRun(Run& run, const char* name,
+                                   unsigned int length, uint64_t hash,
+                                   uint64_t& id)
+{
+    uint64_t numBits = run.bloom.size() * 64;
+    uint64_t step = (hash >> 32) | 1;
+    for(unsigned int i = 0; i < BLOOM_HASHES; i++)
+    {
+        uint64_t bit = (hash + i * step) % numBits;
+        if((run.bloom[bit >> 6] & (((uint64_t)1) << (bit & 63))) == 0)
+        {
+            return(false);
+        }
+    }
+
+    // Find the last block starting at or before the name.
+    std::vector<std::string>::iterator block =
+        std::upper_bound(run.blockNames.begin(), run.blockNames.end(),
+                         std::string(name, length));
+    if(block == run.blockNames.begin())
+    {
+        return(false);
+    }
+    uint64_t blockIndex = (block - run.blockNames.begin()) - 1;
+    if(fseek(run.file, run.blockOffsets[blockIndex], SEEK_SET) != 0)
+    {
+        throw(std::runtime_error("Failed to read the read name run file " +
+                                 run.fileName));
+    }
+
+    char runName[MAX_NAME_LENGTH];
+    unsigned int runLength;
+    uint64_t numNames = std::min((uint64_t)RUN_BLOCK_NAMES,
+                                 run.numNames - blockIndex * RUN_BLOCK_NAMES);
+    for(uint64_t i = 0; i < numNames; i++)
+    {
+        if(!readRunName(run, runName, runLength, id))
+        {
+            break;
+        }
+        int cmp = compareNames(runName, runLength, name, length);
+        if(cmp == 0)
+        {
+            return(true);
+        }
+        if(cmp > 0)
+        {
+            // Passed where the name would be.
+            break;
+        }
+    }
+    return(false);
+}
+
+
+bool ReadNameDictionary::readRunName(Run& run, char* name,
+                                     unsigned int& length, uint64_t& id)
+{
+    int lengthByte = fgetc(run.file);
+    if(lengthByte == EOF)
+    {
+        return(false);
+    }
+    length = lengthByte;
+    unsigned char idBytes[8];
+    if((fread(name, 1, length, run.file) != length) ||
+       (fread(idBytes, 1, 8, run.file) != 8))
+    {
+        throw(std::runtime_error("Failed to read the read name run file " +
+                                 run.fileName));
+    }
+    id = 0;
+    for(unsigned int i = 0; i < 8; i++)
+    {
+        id |= ((uint64_t)idBytes[i]) << (i * 8);
+    }
+    return(true);
+}
+
+
+void ReadNameDictionary::removeRun(Run* run)
+{
+    fclose(run->file);
+    remove(run->fileName.c_str());
+    delete run;
+}
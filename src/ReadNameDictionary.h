@@ -0,0 +1,173 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//////////////////////////////////////////////////////////////////////////
+// Dictionary assigning unique integers to read names, storing the names
+// compactly and optionally spilling them to sorted files on disk.
+
+#ifndef __READ_NAME_DICTIONARY_H__
+#define __READ_NAME_DICTIONARY_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/// Assigns each unique read name the next integer (0, 1, 2...).
+///
+/// The names are packed (length prefixed) into large arena blocks, and
+/// found with an open addressing table whose slots hold a fingerprint of
+/// the name's hash & the name's index, so most mismatches are rejected
+/// without comparing the names.  That is about 20 bytes per name plus the
+/// name itself.
+///
+/// If a maximum number of names is set, once it is reached the names in
+/// memory are sorted & written to a run file on disk.  Each run keeps a
+/// Bloom filter & a sparse index of its names in memory, so a name that
+/// is not in a run rarely reads it, and one that is reads a single block.
+/// Runs are merged in tiers: once there are MERGE_RUNS runs of the same
+/// tier, they are merged into one run of the next tier, so each name is
+/// only rewritten once per tier rather than on every merge.
+class ReadNameDictionary
+{
+public:
+    ReadNameDictionary();
+
+    /// Removes the run files.
+    ~ReadNameDictionary();
+
+    /// Once maxNames names are held in memory, write them to a sorted run
+    /// file named <runPrefix>.run<N> (0 holds all of the names in memory).
+    void setSpill(uint64_t maxNames, const std::string& runPrefix);
+
+    /// Return the integer of the name, assigning it the next one if it is
+    /// not yet in the dictionary, in which case isNew is set to true.
+    /// Throws std::runtime_error if a run file cannot be written or read.
+    uint64_t find(const char* name, unsigned int length, bool& isNew);
+
+    /// Return the number of names in the dictionary.
+    uint64_t getNumNames() const { return(myNextID); }
+
+    /// Return the number of run files the names were written to.
+    unsigned int getNumRuns() const { return(myNumRunFiles); }
+
+    /// Remove all of the names & the run files.
+    void clear();
+
+    /// Maximum length of a name (BAM read names are at most 254).
+    static const unsigned int MAX_NAME_LENGTH = 255;
+
+    /// Number of runs of the same tier that are merged into one.
+    static const unsigned int MERGE_RUNS = 8;
+
+private:
+    ReadNameDictionary(const ReadNameDictionary&);
+    ReadNameDictionary& operator=(const ReadNameDictionary&);
+
+    // A sorted run of names written to disk.
+    struct Run
+    {
+        std::string fileName;
+        FILE* file;
+        uint64_t numNames;
+        // 0 for a spilled run, 1 more than the runs merged into it.
+        unsigned int tier;
+        // Bytes written to the file.
+        uint64_t size;
+        std::vector<uint64_t> bloom;
+        // The first name of each block of RUN_BLOCK_NAMES names & its
+        // offset in the file.
+        std::vector<std::string> blockNames;
+        std::vector<uint64_t> blockOffsets;
+    };
+
+    static uint64_t hashName(const char* name, unsigned int length);
+
+    // Compare two names like memcmp, shorter names first.
+    static int compareNames(const char* name1, unsigned int length1,
+                            const char* name2, unsigned int length2);
+
+    // Return the name (& its length) of an entry in memory.
+    inline const char* getName(uint64_t entry, unsigned int& length) const
+    {
+        uint64_t offset = myOffsets[entry];
+        const unsigned char* stored = (const unsigned char*)
+            (myArena[offset >> ARENA_BLOCK_BITS] +
+             (offset & (ARENA_BLOCK_SIZE - 1)));
+        length = stored[0];
+        return((const char*)stored + 1);
+    }
+
+    // Double the number of slots.
+    void growSlots();
+
+    // Write the names in memory to a run & clear them from memory.
+    void spill();
+
+    // Merge the runs from the specified one to the last into a single
+    // run of the next tier.
+    void mergeRuns(unsigned int first);
+
+    // Open a new run file for the specified number of names.
+    Run* createRun(uint64_t numNames);
+
+    // Add a name to the end of the run being created.
+    void addToRun(Run& run, const char* name, unsigned int length,
+                  uint64_t id);
+
+    // Finish writing a run.
+    void finishRun(Run& run);
+
+    // Return whether the run contains the name, setting its id.
+    bool findInRun(Run& run, const char* name, unsigned int length,
+                   uint64_t hash, uint64_t& id);
+
+    // Read the next name of the run at the current file position.
+    bool readRunName(Run& run, char* name, unsigned int& length,
+                     uint64_t& id);
+
+    // Close & remove the run's file & delete it.
+    void removeRun(Run* run);
+
+    static const unsigned int ARENA_BLOCK_BITS = 24;
+    static const uint64_t ARENA_BLOCK_SIZE = 1 << ARENA_BLOCK_BITS;
+    // A slot is the upper FINGERPRINT_BITS of the name's hash followed by
+    // the name's entry + 1 (0 is an empty slot).
+    static const unsigned int ENTRY_BITS = 40;
+    static const uint64_t ENTRY_MASK = (((uint64_t)1) << ENTRY_BITS) - 1;
+    static const unsigned int RUN_BLOCK_NAMES = 64;
+    static const unsigned int BLOOM_BITS_PER_NAME = 10;
+    static const unsigned int BLOOM_HASHES = 7;
+
+    std::vector<char*> myArena;
+    uint64_t myArenaUsed;
+    // Offset of each name in memory in the arena.
+    std::vector<uint64_t> myOffsets;
+    std::vector<uint64_t> mySlots;
+    uint64_t mySlotMask;
+
+    // The names in memory have IDs starting at myBaseID.
+    uint64_t myBaseID;
+    uint64_t myNextID;
+
+    uint64_t myMaxNames;
+    std::string myRunPrefix;
+    unsigned int myNumRunFiles;
+    std::vector<Run*> myRuns;
+};
+
+#endif
@@ -32,6 +32,7 @@
 #include "BaseUtilities.h"
 #include "SamFlag.h"
 #include "BgzfFileType.h"
+#include "SamInputFile.h"
 
 // STL headers
 #include <map>
@@ -50,7 +51,11 @@ Recab::Recab()
       myBuildExcludeFlags("0x0F04"),
       myApplyExcludeFlags("0x0000"),
       myIntBuildExcludeFlags(0),
-      myIntApplyExcludeFlags(0)
+      myIntApplyExcludeFlags(0),
+      myInFile(""),
+      myOutFile(""),
+      myLogFile(""),
+      myVerboseFlag(false)
 {
     myMappedCount = 0;
     myUnMappedCount = 0;
@@ -103,7 +108,7 @@ void Recab::printDescription(std::ostream& os)
 
 void Recab::printUsage(std::ostream& os)
 {
-    os << "Usage: ./bam recab (options) --in <InputBamFile> --out <OutputFile> [--log <logFile>] [--verbose] [--noeof] [--params] ";
+    os << "Usage: ./bam recab (options) --in <InputBamFile> --out <OutputFile> [--log <logFile>] [--verbose] [--noeof] [--params] [--threads <numThreads>] [--level <0-9>] ";
     printRecabSpecificUsageLine(os);
     os << std::endl << std::endl;
 
@@ -115,6 +120,8 @@ void Recab::printUsage(std::ostream& os)
     os << "\t--verbose       : Turn on verbose mode" << std::endl;
     os << "\t--noeof         : do not expect an EOF block on a bam file." << std::endl;
     os << "\t--params        : print the parameter settings" << std::endl;
+    os << "\t--threads       : number of threads for compressing BAM output (default 0)" << std::endl;
+    os << "\t--level         : BAM compression level, 0 (uncompressed BGZF) to 9 (default -1: zlib default)" << std::endl;
     printRecabSpecificUsage(os);
     os << "\n" << std::endl;
 }
@@ -165,27 +172,75 @@ void Recab::printRecabSpecificUsage(std::ostream& os)
 
 int Recab::execute(int argc, char *argv[])
 {
-    bool verboseFlag = false;
+    int status = readParameters(argc, argv);
+    if(status != 0)
+    {
+        return(status);
+    }
+
+    Logger::gLogger = new Logger(myLogFile.c_str(), myVerboseFlag);
+
+    ////////////////
+    //////  Errormodel
+    Logger::gLogger->writeLog("Initialize errormodel structure...");
+
+    ////////////////////////////////////////
+    // SAM/BAM file open
+    ////////////////////////////////////////
+    ////////////////////////////////////////
+
+    SamInputFile samIn;
+    if(!samIn.OpenForRead(myInFile.c_str()))
+    {
+        Logger::gLogger->error("Failed to open SAM/BAM file %s",myInFile.c_str() );
+        return EXIT_FAILURE;
+    }
+    SamFileHeader samHeader;
+    samIn.ReadHeader(samHeader);
+
+    SamFile samOut;
+    openForWrite(samOut, myOutFile.c_str());
+    samOut.WriteHeader(samHeader);
+
+    SamFileSink samOutSink(samOut);
+    return(runStage(samHeader, samIn, samOutSink));
+}
+
+
+int Recab::initStage(int argc, char** argv)
+{
+    int status = readParameters(argc, argv);
+    if(status != 0)
+    {
+        return(status);
+    }
+
+    Logger::gLogger = new Logger(myLogFile.c_str(), myVerboseFlag);
+    Logger::gLogger->writeLog("Initialize errormodel structure...");
+    return(0);
+}
 
-    String inFile,outFile,logFile;
+
+int Recab::readParameters(int argc, char** argv)
+{
+    myVerboseFlag = false;
 
     bool noeof = false;
     bool params = false;
 
-    SamFile samIn,samOut;
-
     ParameterList inputParameters;
 
     LongParamContainer parameters;
 
     parameters.addGroup("Required Generic Parameters");
-    parameters.addString("in", &inFile);
-    parameters.addString("out", &outFile);
+    parameters.addString("in", &myInFile);
+    parameters.addString("out", &myOutFile);
     parameters.addGroup("Optional Generic Parameters");
-    parameters.addString("log", &logFile);
-    parameters.addBool("verbose", &verboseFlag);
+    parameters.addString("log", &myLogFile);
+    parameters.addBool("verbose", &myVerboseFlag);
     parameters.addBool("noeof", &noeof);
     parameters.addBool("params", &params);
+    addBamOutputParameters(parameters);
     parameters.addPhoneHome(VERSION);
     addRecabSpecificParameters(parameters);
     inputParameters.Add(new LongParameters ("Input Parameters", 
@@ -199,10 +254,10 @@ int Recab::execute(int argc, char *argv[])
     if(noeof)
     {
         // Set that the eof block is not required.
-        BgzfFileType::setRequireEofBlock(false);
+        setRequireEofBlock(false);
     }
 
-    if(inFile.IsEmpty())
+    if(myInFile.IsEmpty())
     {
         printUsage(std::cerr);
         inputParameters.Status();
@@ -212,18 +267,18 @@ int Recab::execute(int argc, char *argv[])
 
     // inFile is not empty, so there is at least one character.  Check if
     // it is specifing stdin since that is not supported for Recab.
-    if(inFile[0] == '-')
+    if((myInFile[0] == '-') && !myIsStage)
     {
         // ERROR: stdin specified, but since Recab requires 2 passes through
         // the input file, stdin is not supported.
         printUsage(std::cerr);
         inputParameters.Status();
-        std::cerr << "ERROR: stdin ('" << inFile << "') is not a supported input file because Recab requires two passes through the input file." << std::endl;
+        std::cerr << "ERROR: stdin ('" << myInFile << "') is not a supported input file because Recab requires two passes through the input file." << std::endl;
         return EXIT_FAILURE;
     }
 
 
-    if(outFile.IsEmpty())
+    if(myOutFile.IsEmpty())
     {
         printUsage(std::cerr);
         inputParameters.Status();
@@ -238,43 +293,36 @@ int Recab::execute(int argc, char *argv[])
         return(status);
     }
 
-    if ( logFile.IsEmpty() )
+    if ( myLogFile.IsEmpty() )
     {
-        logFile = outFile + ".log";
+        myLogFile = myOutFile + ".log";
     }
   
-    if(params)
+    if(!processBamIoParameters())
     {
         inputParameters.Status();
+        return EXIT_FAILURE;
     }
-    
-    Logger::gLogger = new Logger(logFile.c_str(), verboseFlag);
-
-    ////////////////
-    //////  Errormodel
-    Logger::gLogger->writeLog("Initialize errormodel structure...");
-
-    ////////////////////////////////////////
-    // SAM/BAM file open
-    ////////////////////////////////////////
-    ////////////////////////////////////////
 
-    // Iterate SAM records
-    if(!samIn.OpenForRead(inFile.c_str()))
+    if(params)
     {
-        Logger::gLogger->error("Failed to open SAM/BAM file %s",inFile.c_str() );
-        return EXIT_FAILURE;
+        inputParameters.Status();
     }
+    return(0);
+}
 
-    Logger::gLogger->writeLog("Start iterating SAM/BAM file %s",inFile.c_str());
+
+int Recab::runStage(SamFileHeader& samHeader, SamRecordSource& samIn,
+                    SamRecordSink& samOut)
+{
+    // Iterate SAM records
+    Logger::gLogger->writeLog("Start iterating SAM/BAM file %s",myInFile.c_str());
 
     time_t now = time(0);
     tm* localtm = localtime(&now);
 
     Logger::gLogger->writeLog("Start: %s", asctime(localtm));
     SamRecord samRecord;
-    SamFileHeader samHeader;
-    samIn.ReadHeader(samHeader);
 
     srand (time(NULL));
 
@@ -285,7 +333,7 @@ int Recab::execute(int argc, char *argv[])
 
         //Status info
         numRecs++;
-        if(verboseFlag)
+        if(myVerboseFlag)
         {
             if(numRecs%10000000==0)
                 Logger::gLogger->writeLog("%ld records processed", numRecs);
@@ -296,25 +344,26 @@ int Recab::execute(int argc, char *argv[])
     localtm = localtime(&now);
     Logger::gLogger->writeLog("End: %s", asctime(localtm));
 
-    if((outFile[0] == '-') && (logFile[0] != '-'))
+    if((myOutFile[0] == '-') && (myLogFile[0] != '-'))
     {
         // Since outFile is to stdout, and logfile isn't, pass logfile name 
-        modelFitPrediction(logFile);
+        modelFitPrediction(myLogFile);
     }
     else
     {
-        modelFitPrediction(outFile);
+        modelFitPrediction(myOutFile);
     }
 
-    Logger::gLogger->writeLog("Writing recalibrated file %s",outFile.c_str());
+    Logger::gLogger->writeLog("Writing recalibrated file %s",myOutFile.c_str());
 
     ////////////////////////
     ////////////////////////
     //// Write file
-    samIn.OpenForRead(inFile.c_str());
-    samOut.OpenForWrite(outFile.c_str());
-    samIn.ReadHeader(samHeader);
-    samOut.WriteHeader(samHeader);
+    if(!samIn.Rewind())
+    {
+        Logger::gLogger->error("Failed to reread SAM/BAM file %s",myInFile.c_str() );
+        return EXIT_FAILURE;
+    }
     
     while(samIn.ReadRecord(samHeader, samRecord) == true)
     {
@@ -369,10 +418,10 @@ int Recab::processRecabParam()
 
 bool Recab::processReadBuildTable(SamRecord& samRecord)
 {
-    static BaseData data;
-    static std::string chromosomeName;
-    static std::string readGroup;
-    static std::string aligTypes;
+    static thread_local BaseData data;
+    static thread_local std::string chromosomeName;
+    static thread_local std::string readGroup;
+    static thread_local std::string aligTypes;
 
     int seqLen = samRecord.getReadLength();
     
@@ -666,9 +715,9 @@ bool Recab::processReadBuildTable(SamRecord& samRecord)
 
 bool Recab::processReadApplyTable(SamRecord& samRecord)
 {
-    static BaseData data;
-    static std::string readGroup;
-    static std::string aligTypes;
+    static thread_local BaseData data;
+    static thread_local std::string readGroup;
+    static thread_local std::string aligTypes;
 
     int seqLen = samRecord.getReadLength();
 
@@ -55,6 +55,10 @@ public:
     int execute(int argc, char **argv);
     virtual const char* getProgramName() {return("bam:recab");}
 
+    bool stageRewindsInput() {return(true);}
+    int runStage(SamFileHeader& samHeader, SamRecordSource& samIn,
+                 SamRecordSink& samOut);
+
     bool processReadBuildTable(SamRecord& record);
     bool processReadApplyTable(SamRecord& record);
     void modelFitPrediction(const char* outputBase);
@@ -62,6 +66,9 @@ public:
     void addRecabSpecificParameters(LongParamContainer& params);
     int processRecabParam();
 
+protected:
+    int initStage(int argc, char** argv);
+
 private:
     static const int DEFAULT_MIN_BASE_QUAL = 5;
     static const int DEFAULT_MAX_BASE_QUAL = 50;
@@ -74,6 +81,10 @@ private:
 
     void processParams();
 
+    // Read & validate the parameters for running on its own or as a
+    // pipeline stage.  Returns 0 on success.
+    int readParameters(int argc, char** argv);
+
     // So external programs can read recab parameters.
     bool myParamsSetup;
     String myRefFile;
@@ -84,6 +95,10 @@ private:
     String myApplyExcludeFlags;
     uint16_t myIntBuildExcludeFlags;
     uint16_t myIntApplyExcludeFlags;
+    String myInFile;
+    String myOutFile;
+    String myLogFile;
+    bool myVerboseFlag;
     int myMinBaseQual;
     int myMaxBaseQual;
     int myMaxBaseQualChar;
@@ -0,0 +1,286 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include "RegionPlanner.h"
+#include "BamIndex.h"
+
+RegionPlanner::RegionPlanner()
+    : myRegions(),
+      myGroups(),
+      myNextGroup(0),
+      myFirstActive(0),
+      myGroupEnd(0),
+      myUnmappedGroup(false)
+{
+}
+
+
+void RegionPlanner::clear()
+{
+    myRegions.clear();
+    myGroups.clear();
+    myNextGroup = 0;
+    myFirstActive = 0;
+    myGroupEnd = 0;
+    myUnmappedGroup = false;
+}
+
+
+void RegionPlanner::addRegion(int32_t refID, int32_t start, int32_t end)
+{
+    Region region;
+    region.refID = refID;
+    region.start = start;
+    region.end = end;
+    myRegions.push_back(region);
+}
+
+
+void RegionPlanner::plan(const char* indexFile)
+{
+    std::stable_sort(myRegions.begin(), myRegions.end(), regionLess);
+    myGroups.clear();
+    myNextGroup = 0;
+    myFirstActive = 0;
+    myGroupEnd = 0;
+
+    BamIndex index;
+    bool haveIndex = (indexFile != NULL) &&
+        (index.readIndex(indexFile) == SamStatus::SUCCESS);
+
+    // Virtual file offset that the last group's chunks end at.
+    uint64_t groupChunkEnd = 0;
+    bool groupHasChunks = false;
+    for(int i = 0; i < (int)myRegions.size(); i++)
+    {
+        const Region& region = myRegions[i];
+
+        // Determine the range of the file that contains the region.
+        uint64_t chunkBeg = 0;
+        uint64_t chunkEnd = 0;
+        bool hasChunks = false;
+        SortedChunkList chunks;
+        if(haveIndex && (region.refID >= 0) &&
+           index.getChunksForRegion(region.refID, region.start, region.end,
+                                    chunks) && !chunks.empty())
+        {
+            // The chunks are sorted by their start.
+            Chunk chunk = chunks.pop();
+            chunkBeg = chunk.chunk_beg;
+            chunkEnd = chunk.chunk_end;
+            while(!chunks.empty())
+            {
+                chunk = chunks.pop();
+                chunkEnd = std::max(chunkEnd, chunk.chunk_end);
+            }
+            hasChunks = true;
+        }
+
+        bool join = false;
+        if(!myGroups.empty() && (myGroups.back().refID == region.refID))
+        {
+            const Group& group = myGroups.back();
+            if((region.refID < 0) || (group.end == -1) ||
+               (region.start <= group.end))
+            {
+                // Overlapping or adjacent.
+                join = true;
+            }
+            else if(hasChunks && groupHasChunks &&
+                    ((chunkBeg >> 16) <= (groupChunkEnd >> 16)))
+            {
+                // The upper 48 bits of a virtual offset are the offset of
+                // the BGZF block, so this region starts in a block the
+                // group already reads.
+                join = true;
+            }
+        }
+
+        if(join)
+        {
+            Group& group = myGroups.back();
+            group.last = i + 1;
+            if((region.end == -1) || (group.end == -1))
+            {
+                group.end = -1;
+            }
+            else
+            {
+                group.end = std::max(group.end, region.end);
+            }
+            if(hasChunks)
+            {
+                groupChunkEnd = groupHasChunks ?
+                    std::max(groupChunkEnd, chunkEnd) : chunkEnd;
+                groupHasChunks = true;
+            }
+        }
+        else
+        {
+            Group group;
+            group.refID = region.refID;
+            group.start = region.start;
+            group.end = region.end;
+            group.first = i;
+            group.last = i + 1;
+            myGroups.push_back(group);
+            groupChunkEnd = chunkEnd;
+            groupHasChunks = hasChunks;
+        }
+    }
+}
+
+
+bool RegionPlanner::nextGroup(int32_t& refID, int32_t& start, int32_t& end)
+{
+    if(myNextGroup >= (int)myGroups.size())
+    {
+        myFirstActive = myGroupEnd = 0;
+        return(false);
+    }
+    const Group& group = myGroups[myNextGroup++];
+    myFirstActive = group.first;
+    myGroupEnd = group.last;
+    myUnmappedGroup = (group.refID < 0);
+    refID = group.refID;
+    start = group.start;
+    end = group.end;
+    if(myUnmappedGroup)
+    {
+        // Positions do not apply to unmapped reads, read all of them.
+        start = -1;
+        end = -1;
+    }
+    return(true);
+}
+
+
+void RegionPlanner::getGroupRegions(int& first, int& last) const
+{
+    first = myGroups[myNextGroup - 1].first;
+    last = myGroups[myNextGroup - 1].last;
+}
+
+
+void RegionPlanner::findRegions(SamRecord& record, bool contained,
+                                std::vector<int>& regions)
+{
+    regions.clear();
+    if(myUnmappedGroup)
+    {
+        for(int i = myFirstActive; i < myGroupEnd; i++)
+        {
+            regions.push_back(i);
+        }
+        return;
+    }
+
+    int32_t recordStart = record.get0BasedPosition();
+    int32_t recordEnd = record.get0BasedAlignmentEnd();
+
+    // The records are sorted, so regions ending before this record will
+    // not overlap any of the later records either.
+    while((myFirstActive < myGroupEnd) &&
+          isFinished(myFirstActive, recordStart))
+    {
+        ++myFirstActive;
+    }
+
+    for(int i = myFirstActive; i < myGroupEnd; i++)
+    {
+        if(myRegions[i].start > recordEnd)
+        {
+            // This & the rest of the regions start after the record.
+            break;
+        }
+        if(isInRegion(myRegions[i], recordStart, recordEnd, contained))
+        {
+            regions.push_back(i);
+        }
+    }
+}
+
+
+bool RegionPlanner::isInEarlierGroup(SamRecord& record, bool contained) const
+{
+    if(myUnmappedGroup)
+    {
+        return(false);
+    }
+
+    int32_t recordStart = record.get0BasedPosition();
+    int32_t recordEnd = record.get0BasedAlignmentEnd();
+
+    // The groups of a reference do not overlap, so only the groups just
+    // before the current one can end after the record starts.
+    int32_t refID = myGroups[myNextGroup - 1].refID;
+    for(int g = myNextGroup - 2; g >= 0; g--)
+    {
+        const Group& group = myGroups[g];
+        if((group.refID != refID) ||
+           ((group.end != -1) && (group.end <= recordStart)))
+        {
+            break;
+        }
+        for(int i = group.first; i < group.last; i++)
+        {
+            if(isInRegion(myRegions[i], recordStart, recordEnd, contained))
+            {
+                return(true);
+            }
+        }
+    }
+    return(false);
+}
+
+
+bool RegionPlanner::isFinished(int index, int32_t position) const
+{
+    const Region& region = myRegions[index];
+    return((region.end != -1) && (region.end <= position));
+}
+
+
+bool RegionPlanner::isInRegion(const Region& region, int32_t recordStart,
+                               int32_t recordEnd, bool contained)
+{
+    if((region.start > recordEnd) ||
+       ((region.end != -1) && (recordStart >= region.end)))
+    {
+        // Does not overlap.
+        return(false);
+    }
+    if(contained)
+    {
+        return((recordStart >= region.start) &&
+               ((region.end == -1) || (recordEnd < region.end)));
+    }
+    return(true);
+}
+
+
+bool RegionPlanner::regionLess(const Region& region1, const Region& region2)
+{
+    // Unmapped reads (-1) are at the end of the file, so compare the
+    // reference ids unsigned to sort them last.
+    if(region1.refID != region2.refID)
+    {
+        return((uint32_t)region1.refID < (uint32_t)region2.refID);
+    }
+    return(region1.start < region2.start);
+}
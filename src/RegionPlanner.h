@@ -0,0 +1,117 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//////////////////////////////////////////////////////////////////////////
+// Plans reading a list of regions from an indexed BAM file so each part
+// of the file is only read once.
+
+#ifndef __REGION_PLANNER_H__
+#define __REGION_PLANNER_H__
+
+#include <stdint.h>
+#include <vector>
+#include "SamRecord.h"
+
+/// Sorts a list of regions & groups them into the sections of the file to
+/// read.  Regions that overlap or are adjacent are grouped, as are regions
+/// whose index chunks start in the BGZF block the previous region's chunks
+/// end in, so reading each group once avoids seeking back & reinflating
+/// the same blocks for each region.  The records read for a group are then
+/// dispatched to each of the group's regions that they overlap.
+class RegionPlanner
+{
+public:
+    /// A 0-based region with an exclusive end (-1 for the end of the
+    /// reference).
+    struct Region
+    {
+        int32_t refID;
+        int32_t start;
+        int32_t end;
+    };
+
+    RegionPlanner();
+
+    /// Remove all regions.
+    void clear();
+
+    /// Add a region.  Regions may be added in any order.
+    void addRegion(int32_t refID, int32_t start, int32_t end);
+
+    /// Return the number of regions.
+    int getNumRegions() const { return(myRegions.size()); }
+
+    /// Return the specified region.  Once planned, the regions are in
+    /// sorted order.
+    const Region& getRegion(int index) const { return(myRegions[index]); }
+
+    /// Sort the regions & group them into the sections to read.  If
+    /// indexFile is not NULL, it is read to group regions whose index
+    /// chunks are in the same BGZF block.
+    void plan(const char* indexFile);
+
+    /// Advance to the next group of regions, setting the section to read
+    /// for it.  Returns false when there are no more groups.
+    bool nextGroup(int32_t& refID, int32_t& start, int32_t& end);
+
+    /// Set the range of the indices of the current group's regions.
+    void getGroupRegions(int& first, int& last) const;
+
+    /// Set regions to the indices of the regions of the current group
+    /// that the record overlaps (or is fully contained in if contained is
+    /// true).  The records must be passed in the order they were read.
+    void findRegions(SamRecord& record, bool contained,
+                     std::vector<int>& regions);
+
+    /// Return whether or not the record is in a region of an earlier
+    /// group (the groups are disjoint, but a record can span the gap
+    /// between two of them), so was already found when reading that group.
+    bool isInEarlierGroup(SamRecord& record, bool contained) const;
+
+    /// Return whether or not the region ends before the specified
+    /// position, so no more records of its group will overlap it.
+    bool isFinished(int index, int32_t position) const;
+
+private:
+    // The section covering a range of the sorted regions.
+    struct Group
+    {
+        int32_t refID;
+        int32_t start;
+        int32_t end;
+        int first;
+        int last;
+    };
+
+    // Return whether or not the record overlaps (or is contained in) the
+    // region.
+    static bool isInRegion(const Region& region, int32_t recordStart,
+                           int32_t recordEnd, bool contained);
+
+    static bool regionLess(const Region& region1, const Region& region2);
+
+    std::vector<Region> myRegions;
+    std::vector<Group> myGroups;
+    int myNextGroup;
+    // Range of the regions of the current group that records may still
+    // overlap.
+    int myFirstActive;
+    int myGroupEnd;
+    bool myUnmappedGroup;
+};
+
+#endif
@@ -46,7 +46,7 @@ void Revert::printDescription(std::ostream& os)
 void Revert::printUsage(std::ostream& os)
 {
     BamExecutable::printUsage(os);
-    os << "\t./bam revert --in <inputFile> --out <outputFile.sam/bam/ubam (ubam is uncompressed bam)> [--cigar] [--qual] [--keepTags] [--rmBQ] [--rmTags <Tag:Type[,Tag:Type]*>] [--noeof] [--params]" << std::endl;
+    os << "\t./bam revert --in <inputFile> --out <outputFile.sam/bam/ubam (ubam is uncompressed bam)> [--cigar] [--qual] [--keepTags] [--rmBQ] [--rmTags <Tag:Type[,Tag:Type]*>] [--noeof] [--params] [--threads <numThreads>] [--level <0-9>]" << std::endl;
     os << "\tRequired Parameters:" << std::endl;
     os << "\t\t--in         : the SAM/BAM file to be read" << std::endl;
     os << "\t\t--out        : the SAM/BAM file to be written" << std::endl;
@@ -58,6 +58,8 @@ void Revert::printUsage(std::ostream& os)
     os << "\t\t--rmTags     : Remove the specified Tags formatted as Tag:Type,Tag:Type,Tag:Type..." << std::endl;
     os << "\t\t--noeof      : do not expect an EOF block on a bam file." << std::endl;
     os << "\t\t--params     : print the parameter settings" << std::endl;
+    os << "\t\t--threads    : number of threads for compressing BAM output (default 0)" << std::endl;
+    os << "\t\t--level      : BAM compression level, 0 (uncompressed BGZF) to 9 (default -1: zlib default)" << std::endl;
     os << std::endl;
 }
 
@@ -86,6 +88,7 @@ int Revert::execute(int argc, char **argv)
         LONG_STRINGPARAMETER("rmTags", &rmTags)
         LONG_PARAMETER("noeof", &noeof)
         LONG_PARAMETER("params", &params)
+        LONG_BAM_OUTPUT_PARAMETERS()
         LONG_PHONEHOME(VERSION)
         END_LONG_PARAMETERS();
    
@@ -100,7 +103,7 @@ int Revert::execute(int argc, char **argv)
     if(noeof)
     {
         // Set that the eof block is not required.
-        BgzfFileType::setRequireEofBlock(false);
+        setRequireEofBlock(false);
     }
     
     // Check to see if the in file was specified, if not, report an error.
@@ -124,6 +127,12 @@ int Revert::execute(int argc, char **argv)
         return(-1);
     }
 
+    if(!processBamIoParameters())
+    {
+        inputParameters.Status();
+        return(-1);
+    }
+
     if(params)
     {
         inputParameters.Status();
@@ -135,7 +144,7 @@ int Revert::execute(int argc, char **argv)
 
     // Open the output file for writing.
     SamFile samOut;
-    samOut.OpenForWrite(outFile);
+    openForWrite(samOut, outFile);
 
     // Read the sam header.
     SamFileHeader samHeader;
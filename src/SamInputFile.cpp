@@ -0,0 +1,548 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "ErrorHandler.h"
+#include "SamInputFile.h"
+#include "ThreadPool.h"
+
+// Size of the fixed length portion of a BAM record following the
+// block size.
+static const int32_t BAM_FIXED_RECORD_SIZE = 32;
+
+SamInputFile::SamInputFile()
+    : mySamFile(ErrorHandler::EXCEPTION),
+      myReader(),
+      myReadAhead(false),
+      myFilename(),
+      myHeaderRead(false),
+      myRecordRead(false),
+      myRecordCount(0),
+      myStatus(ErrorHandler::EXCEPTION),
+      myErrorHandling(ErrorHandler::EXCEPTION),
+      myRecordBuffer(),
+      myRefPtr(NULL),
+      myReadTranslation(SamRecord::NONE),
+      myRequiredFlags(0),
+      myExcludeFlags(0),
+      mySortType(SamFile::UNSORTED),
+      myStatistics(NULL)
+{
+}
+
+
+SamInputFile::SamInputFile(ErrorHandler::HandlingType errorHandlingType)
+    : mySamFile(errorHandlingType),
+      myReader(),
+      myReadAhead(false),
+      myFilename(),
+      myHeaderRead(false),
+      myRecordRead(false),
+      myRecordCount(0),
+      myStatus(errorHandlingType),
+      myErrorHandling(errorHandlingType),
+      myRecordBuffer(),
+      myRefPtr(NULL),
+      myReadTranslation(SamRecord::NONE),
+      myRequiredFlags(0),
+      myExcludeFlags(0),
+      mySortType(SamFile::UNSORTED),
+      myStatistics(NULL)
+{
+}
+
+
+SamInputFile::~SamInputFile()
+{
+    Close();
+    if(myStatistics != NULL)
+    {
+        delete myStatistics;
+        myStatistics = NULL;
+    }
+}
+
+
+bool SamInputFile::OpenForRead(const char* filename, SamFileHeader* header)
+{
+    Close();
+
+    myFilename = filename;
+    myHeaderRead = false;
+    myRecordRead = false;
+    myRecordCount = 0;
+    myStatus.reset();
+    if(myStatistics != NULL)
+    {
+        myStatistics->reset();
+    }
+
+    // Stdin cannot be reopened if it turns out not to be BGZF BAM,
+    // so only read ahead on files.  Sort validation is done by SamFile.
+    if((ThreadPool::getSharedPool() != NULL) && (filename[0] != '-') &&
+       (mySortType == SamFile::UNSORTED) && openReadAhead(filename))
+    {
+        myReadAhead = true;
+    }
+    else
+    {
+        myReadAhead = false;
+        if(!mySamFile.OpenForRead(filename))
+        {
+            return(false);
+        }
+        mySamFile.SetReference(myRefPtr);
+        mySamFile.SetReadSequenceTranslation(myReadTranslation);
+        mySamFile.SetReadFlags(myRequiredFlags, myExcludeFlags);
+        mySamFile.GenerateStatistics(myStatistics != NULL);
+        mySamFile.setSortedValidation(mySortType);
+    }
+
+    if(header != NULL)
+    {
+        return(ReadHeader(*header));
+    }
+    return(true);
+}
+
+
+void SamInputFile::Close()
+{
+    myReader.close();
+    mySamFile.Close();
+    myReadAhead = false;
+    myHeaderRead = false;
+    myRecordRead = false;
+}
+
+
+bool SamInputFile::IsOpen()
+{
+    if(myReadAhead)
+    {
+        return(myReader.isOpen());
+    }
+    return(mySamFile.IsOpen());
+}
+
+
+bool SamInputFile::ReadHeader(SamFileHeader& header)
+{
+    if(!myReadAhead)
+    {
+        myHeaderRead = mySamFile.ReadHeader(header);
+        return(myHeaderRead);
+    }
+
+    if(myHeaderRead)
+    {
+        setFailure(SamStatus::FAIL_ORDER,
+                           "Cannot read the header more than once");
+        return(false);
+    }
+
+    // The magic number was already checked when opening.
+    int32_t textLen = 0;
+    if(!readBytes(&textLen, sizeof(int32_t)))
+    {
+        return(false);
+    }
+    if(textLen < 0)
+    {
+        setFailure(SamStatus::FAIL_PARSE,
+                           "Invalid BAM header text length");
+        return(false);
+    }
+    std::vector<char> text(textLen + 1, '\0');
+    if((textLen > 0) && !readBytes(&(text[0]), textLen))
+    {
+        return(false);
+    }
+
+    header.resetHeader();
+    // Invalid header lines are skipped and recorded in the header.
+    header.addHeader(&(text[0]));
+
+    // The reference ids of the records index the binary reference list.
+    int32_t numRefs = 0;
+    if(!readBytes(&numRefs, sizeof(int32_t)))
+    {
+        return(false);
+    }
+    SamReferenceInfo* refInfo = header.getReferenceInfoForBamInterface();
+    refInfo->clear();
+    std::vector<char> refName;
+    for(int32_t i = 0; i < numRefs; i++)
+    {
+        int32_t nameLen = 0;
+        int32_t refLen = 0;
+        if(!readBytes(&nameLen, sizeof(int32_t)))
+        {
+            return(false);
+        }
+        if(nameLen <= 0)
+        {
+            setFailure(SamStatus::FAIL_PARSE,
+                               "Invalid BAM reference name length");
+            return(false);
+        }
+        refName.assign(nameLen + 1, '\0');
+        if(!readBytes(&(refName[0]), nameLen) ||
+           !readBytes(&refLen, sizeof(int32_t)))
+        {
+            return(false);
+        }
+        refInfo->add(&(refName[0]), refLen);
+    }
+
+    myHeaderRead = true;
+    myStatus.reset();
+    return(true);
+}
+
+
+bool SamInputFile::ReadRecord(SamFileHeader& header, SamRecord& record)
+{
+    if(!myReadAhead)
+    {
+        return(mySamFile.ReadRecord(header, record));
+    }
+
+    if(!myHeaderRead)
+    {
+        setFailure(SamStatus::FAIL_ORDER,
+                           "Cannot read a record before reading the header");
+        return(false);
+    }
+    myRecordRead = true;
+
+    while(true)
+    {
+        int32_t blockSize = 0;
+        if(!readBytes(&blockSize, sizeof(int32_t), true))
+        {
+            return(false);
+        }
+        if(blockSize < BAM_FIXED_RECORD_SIZE)
+        {
+            setFailure(SamStatus::FAIL_PARSE,
+                               "Invalid BAM record block size");
+            return(false);
+        }
+
+        // The record buffer includes the block size.
+        myRecordBuffer.resize(blockSize + sizeof(int32_t));
+        memcpy(&(myRecordBuffer[0]), &blockSize, sizeof(int32_t));
+        if(!readBytes(&(myRecordBuffer[sizeof(int32_t)]), blockSize))
+        {
+            return(false);
+        }
+
+        SamStatus::Status status =
+            record.setBuffer(&(myRecordBuffer[0]), myRecordBuffer.size(),
+                             header);
+        if(status != SamStatus::SUCCESS)
+        {
+            setFailure(status, "Failed to parse the BAM record");
+            return(false);
+        }
+        record.setReference(myRefPtr);
+        record.setSequenceTranslation(myReadTranslation);
+
+        // Skip records that do not match the flag settings.
+        uint16_t flag = record.getFlag();
+        if(((flag & myRequiredFlags) != myRequiredFlags) ||
+           ((flag & myExcludeFlags) != 0))
+        {
+            continue;
+        }
+
+        ++myRecordCount;
+        if(myStatistics != NULL)
+        {
+            myStatistics->updateStatistics(record);
+        }
+        myStatus.reset();
+        return(true);
+    }
+}
+
+
+void SamInputFile::SetReference(GenomeSequence* reference)
+{
+    myRefPtr = reference;
+    if(!myReadAhead)
+    {
+        mySamFile.SetReference(reference);
+    }
+}
+
+
+void SamInputFile::SetReadSequenceTranslation(SamRecord::SequenceTranslation translation)
+{
+    myReadTranslation = translation;
+    if(!myReadAhead)
+    {
+        mySamFile.SetReadSequenceTranslation(translation);
+    }
+}
+
+
+void SamInputFile::SetReadFlags(uint32_t requiredFlags, uint32_t excludeFlags)
+{
+    myRequiredFlags = requiredFlags;
+    myExcludeFlags = excludeFlags;
+    if(!myReadAhead)
+    {
+        mySamFile.SetReadFlags(requiredFlags, excludeFlags);
+    }
+}
+
+
+void SamInputFile::setSortedValidation(SamFile::SortedType sortType)
+{
+    mySortType = sortType;
+    if(sortType != SamFile::UNSORTED)
+    {
+        useSamFile();
+    }
+    if(!myReadAhead)
+    {
+        mySamFile.setSortedValidation(sortType);
+    }
+}
+
+
+bool SamInputFile::ReadBamIndex(const char* filename)
+{
+    if(!useSamFile())
+    {
+        return(false);
+    }
+    return(mySamFile.ReadBamIndex(filename));
+}
+
+
+bool SamInputFile::ReadBamIndex()
+{
+    if(!useSamFile())
+    {
+        return(false);
+    }
+    return(mySamFile.ReadBamIndex());
+}
+
+
+bool SamInputFile::SetReadSection(int32_t refID)
+{
+    if(!useSamFile())
+    {
+        return(false);
+    }
+    return(mySamFile.SetReadSection(refID));
+}
+
+
+bool SamInputFile::SetReadSection(int32_t refID, int32_t start,
+                                  int32_t end, bool overlap)
+{
+    if(!useSamFile())
+    {
+        return(false);
+    }
+    return(mySamFile.SetReadSection(refID, start, end, overlap));
+}
+
+
+bool SamInputFile::SetReadSection(const char* refName, int32_t start,
+                                  int32_t end, bool overlap)
+{
+    if(!useSamFile())
+    {
+        return(false);
+    }
+    return(mySamFile.SetReadSection(refName, start, end, overlap));
+}
+
+
+void SamInputFile::GenerateStatistics(bool genStats)
+{
+    if(genStats && (myStatistics == NULL))
+    {
+        myStatistics = new SamStatistics();
+    }
+    else if(!genStats && (myStatistics != NULL))
+    {
+        delete myStatistics;
+        myStatistics = NULL;
+    }
+    if(!myReadAhead)
+    {
+        mySamFile.GenerateStatistics(genStats);
+    }
+}
+
+
+void SamInputFile::PrintStatistics()
+{
+    if(!myReadAhead)
+    {
+        mySamFile.PrintStatistics();
+    }
+    else if(myStatistics != NULL)
+    {
+        myStatistics->print();
+    }
+}
+
+
+uint32_t SamInputFile::GetCurrentRecordCount()
+{
+    if(myReadAhead)
+    {
+        return(myRecordCount);
+    }
+    return(mySamFile.GetCurrentRecordCount());
+}
+
+
+bool SamInputFile::Rewind()
+{
+    if(myFilename.empty() || (myFilename[0] == '-'))
+    {
+        setFailure(SamStatus::FAIL_ORDER,
+                           "Cannot reread the records from stdin");
+        return(false);
+    }
+    // OpenForRead resets myFilename, so open from a copy.
+    std::string filename = myFilename;
+    SamFileHeader header;
+    return(OpenForRead(filename.c_str(), &header));
+}
+
+
+SamStatus::Status SamInputFile::GetStatus()
+{
+    if(myReadAhead)
+    {
+        return(myStatus.getStatus());
+    }
+    return(mySamFile.GetStatus());
+}
+
+
+const char* SamInputFile::GetStatusMessage()
+{
+    if(myReadAhead)
+    {
+        return(myStatus.getStatusMessage());
+    }
+    return(mySamFile.GetStatusMessage());
+}
+
+
+bool SamInputFile::openReadAhead(const char* filename)
+{
+    if(!myReader.open(filename))
+    {
+        // Not BGZF.
+        return(false);
+    }
+    char magic[4];
+    if((myReader.read(magic, sizeof(magic)) != sizeof(magic)) ||
+       (memcmp(magic, "BAM\1", sizeof(magic)) != 0))
+    {
+        // BGZF, but not BAM.
+        myReader.close();
+        return(false);
+    }
+    return(true);
+}
+
+
+bool SamInputFile::useSamFile()
+{
+    if(!myReadAhead)
+    {
+        return(true);
+    }
+    if(myRecordRead)
+    {
+        setFailure(SamStatus::FAIL_ORDER,
+                           "Indexed reading and sort validation must be set before reading records");
+        return(false);
+    }
+
+    myReader.close();
+    myReadAhead = false;
+    if(!mySamFile.OpenForRead(myFilename.c_str()))
+    {
+        return(false);
+    }
+    mySamFile.SetReference(myRefPtr);
+    mySamFile.SetReadSequenceTranslation(myReadTranslation);
+    mySamFile.SetReadFlags(myRequiredFlags, myExcludeFlags);
+    mySamFile.GenerateStatistics(myStatistics != NULL);
+
+    if(myHeaderRead)
+    {
+        // The caller already has the header, so just skip past it.
+        SamFileHeader header;
+        return(mySamFile.ReadHeader(header));
+    }
+    return(true);
+}
+
+
+void SamInputFile::setFailure(SamStatus::Status status, const char* message)
+{
+    myStatus.setStatus(status, message);
+    // Handle it the way the SamFile would: throw, abort, or just return.
+    ErrorHandler::handleError(myStatus.getStatusMessage(), myErrorHandling);
+}
+
+
+bool SamInputFile::readBytes(void* buffer, unsigned int length, bool allowEOF)
+{
+    int numRead = myReader.read(buffer, length);
+    if(numRead == (int)length)
+    {
+        return(true);
+    }
+    if((numRead == 0) && allowEOF)
+    {
+        myStatus.setStatus(SamStatus::NO_MORE_RECS,
+                           "No more records left to read");
+    }
+    else if((numRead < 0) && myReader.isMissingEofBlock())
+    {
+        std::string msg = "Missing the BGZF EOF block at the end of " +
+            myFilename + " (it may be truncated, use --noeof to allow this)";
+        setFailure(SamStatus::FAIL_IO, msg.c_str());
+    }
+    else if(numRead < 0)
+    {
+        std::string msg = "Invalid BGZF block in " + myFilename;
+        setFailure(SamStatus::FAIL_IO, msg.c_str());
+    }
+    else
+    {
+        std::string msg = "Unexpected end of " + myFilename;
+        setFailure(SamStatus::FAIL_IO, msg.c_str());
+    }
+    return(false);
+}
@@ -0,0 +1,162 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//////////////////////////////////////////////////////////////////////////
+// Input SAM/BAM file that reads BAM files through a multi-threaded
+// read-ahead BgzfReader when a shared thread pool has been set up.
+
+#ifndef __SAM_INPUT_FILE_H__
+#define __SAM_INPUT_FILE_H__
+
+#include <string>
+#include <vector>
+#include "SamFile.h"
+#include "SamStatistics.h"
+#include "SamRecordStream.h"
+#include "BgzfReader.h"
+
+/// Drop in replacement for reading with a SamFile.  SamFile decompresses
+/// BAM files on the calling thread, so when the shared ThreadPool is set
+/// up, BGZF compressed BAM files are instead read with a BgzfReader that
+/// decompresses upcoming blocks on the pool, and the records are parsed
+/// from the decompressed buffers.  Anything else (SAM files, stdin, no
+/// thread pool) is read with a SamFile.
+///
+/// Indexed reading (ReadBamIndex/SetReadSection) and sort validation are
+/// only done by SamFile, so setting them switches over to reading with a
+/// SamFile, which must be done before the first record is read.
+class SamInputFile : public SamRecordSource
+{
+public:
+    SamInputFile();
+    SamInputFile(ErrorHandler::HandlingType errorHandlingType);
+    ~SamInputFile();
+
+    /// Open the file for reading, reading the header into the specified
+    /// header if it is not NULL.
+    bool OpenForRead(const char* filename, SamFileHeader* header = NULL);
+
+    /// Close the file if it is open.
+    void Close();
+
+    /// Return whether or not the file is open.
+    bool IsOpen();
+
+    /// Read the header from the file.
+    bool ReadHeader(SamFileHeader& header);
+
+    /// Read the next record from the file.  Returns false if there are
+    /// no more records (status NO_MORE_RECS) or on failure.
+    bool ReadRecord(SamFileHeader& header, SamRecord& record);
+
+    /// Set the reference used by the records that are read.
+    void SetReference(GenomeSequence* reference);
+
+    /// Set how the bases of the records that are read are translated.
+    void SetReadSequenceTranslation(SamRecord::SequenceTranslation translation);
+
+    /// Only return records with all of the requiredFlags and none of the
+    /// excludeFlags set.
+    void SetReadFlags(uint32_t requiredFlags, uint32_t excludeFlags);
+
+    /// Set the sort order to validate, switching to SamFile if it
+    /// is not UNSORTED.
+    void setSortedValidation(SamFile::SortedType sortType);
+
+    /// Read the BAM index, switching to SamFile.
+    bool ReadBamIndex(const char* filename);
+
+    /// Read the BAM index named after the BAM file, switching to SamFile.
+    bool ReadBamIndex();
+
+    /// Only read the records for the specified reference id,
+    /// switching to SamFile.
+    bool SetReadSection(int32_t refID);
+
+    /// Only read the records in the specified region of the reference id,
+    /// switching to SamFile.
+    bool SetReadSection(int32_t refID, int32_t start, int32_t end,
+                        bool overlap = true);
+
+    /// Only read the records in the specified region, switching to SamFile.
+    bool SetReadSection(const char* refName, int32_t start, int32_t end,
+                        bool overlap = true);
+
+    /// Generate statistics on the records that are read.
+    void GenerateStatistics(bool genStats);
+
+    /// Print the statistics generated on the records that were read.
+    void PrintStatistics();
+
+    /// Return the number of records that have been read.
+    uint32_t GetCurrentRecordCount();
+
+    /// Return the status of the last operation.
+    SamStatus::Status GetStatus();
+
+    /// Return the status message of the last operation.
+    const char* GetStatusMessage();
+
+    /// Reopen the file and skip past the header to start reading from
+    /// the first record again.  Fails for stdin.
+    bool Rewind();
+
+    /// Return whether or not the file is being read with multi-threaded
+    /// read-ahead rather than by SamFile.
+    bool isReadAhead() const { return(myReadAhead); }
+
+private:
+    SamInputFile(const SamInputFile&);
+    SamInputFile& operator=(const SamInputFile&);
+
+    // Try to open the file for multi-threaded read-ahead, returning false
+    // if it is not a BGZF compressed BAM file.
+    bool openReadAhead(const char* filename);
+
+    // Switch from read-ahead to reading with SamFile, reopening the file.
+    bool useSamFile();
+
+    // Set the failure status and handle the error based on the error
+    // handling type (throwing an exception by default).
+    void setFailure(SamStatus::Status status, const char* message);
+
+    // Read exactly length bytes, setting the status on failure.
+    // Returns false on failure or if there was nothing left to read
+    // (sets NO_MORE_RECS if allowEOF is true).
+    bool readBytes(void* buffer, unsigned int length, bool allowEOF = false);
+
+    SamFile mySamFile;
+    BgzfReader myReader;
+    bool myReadAhead;
+    std::string myFilename;
+    bool myHeaderRead;
+    bool myRecordRead;
+    uint32_t myRecordCount;
+    SamStatus myStatus;
+    ErrorHandler::HandlingType myErrorHandling;
+    std::vector<char> myRecordBuffer;
+
+    // Settings applied to the SamFile when switching to it.
+    GenomeSequence* myRefPtr;
+    SamRecord::SequenceTranslation myReadTranslation;
+    uint32_t myRequiredFlags;
+    uint32_t myExcludeFlags;
+    SamFile::SortedType mySortType;
+    SamStatistics* myStatistics;
+};
+
+#endif
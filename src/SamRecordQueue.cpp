@@ -0,0 +1,222 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "SamRecordQueue.h"
+
+SamRecordQueue::SamRecordQueue(unsigned int maxBatches)
+    : mySource(*this),
+      mySink(*this),
+      myMutex(),
+      myNotEmpty(),
+      myNotFull(),
+      myBatches(),
+      myFreeBatches(),
+      myMaxBatches(maxBatches),
+      myClosed(false),
+      myFailed(false),
+      myCancelled(false)
+{
+    if(myMaxBatches < 1)
+    {
+        myMaxBatches = 1;
+    }
+}
+
+
+void SamRecordQueue::close(bool failed)
+{
+    if(!failed)
+    {
+        // Queue the partial batch.
+        failed = !mySink.flushBatch();
+    }
+    {
+        std::lock_guard<std::mutex> lock(myMutex);
+        myClosed = true;
+        myFailed = failed;
+    }
+    myNotEmpty.notify_all();
+}
+
+
+void SamRecordQueue::cancel()
+{
+    {
+        std::lock_guard<std::mutex> lock(myMutex);
+        myCancelled = true;
+        myBatches.clear();
+    }
+    myNotFull.notify_all();
+}
+
+
+bool SamRecordQueue::pushBatch(std::string& batch)
+{
+    std::unique_lock<std::mutex> lock(myMutex);
+    while(!myCancelled && (myBatches.size() >= myMaxBatches))
+    {
+        myNotFull.wait(lock);
+    }
+    if(myCancelled)
+    {
+        batch.clear();
+        return(false);
+    }
+    myBatches.push_back(std::string());
+    myBatches.back().swap(batch);
+
+    // Reuse the memory of a batch the reader is done with.
+    if(!myFreeBatches.empty())
+    {
+        batch.swap(myFreeBatches.back());
+        myFreeBatches.pop_back();
+    }
+    lock.unlock();
+    myNotEmpty.notify_one();
+    return(true);
+}
+
+
+bool SamRecordQueue::popBatch(std::string& batch)
+{
+    std::unique_lock<std::mutex> lock(myMutex);
+    while(myBatches.empty() && !myClosed)
+    {
+        myNotEmpty.wait(lock);
+    }
+    if(myBatches.empty())
+    {
+        return(false);
+    }
+    // Hand the previous batch back for reuse.
+    batch.clear();
+    myFreeBatches.push_back(std::string());
+    myFreeBatches.back().swap(batch);
+    batch.swap(myBatches.front());
+    myBatches.pop_front();
+    lock.unlock();
+    myNotFull.notify_one();
+    return(true);
+}
+
+
+SamRecordQueue::Source::Source(SamRecordQueue& queue)
+    : myQueue(queue),
+      myBatch(),
+      myBatchPos(0),
+      myRecordCount(0),
+      myStatus(ErrorHandler::RETURN)
+{
+}
+
+
+bool SamRecordQueue::Source::ReadRecord(SamFileHeader& header,
+                                        SamRecord& record)
+{
+    while(myBatchPos >= myBatch.size())
+    {
+        if(!myQueue.popBatch(myBatch))
+        {
+            if(myQueue.myFailed)
+            {
+                myStatus.setStatus(SamStatus::FAIL_IO,
+                                   "The previous pipeline stage failed");
+            }
+            else
+            {
+                myStatus.setStatus(SamStatus::NO_MORE_RECS,
+                                   "No more records left to read");
+            }
+            return(false);
+        }
+        myBatchPos = 0;
+    }
+
+    // The buffer of each record starts with the size of the
+    // rest of the record.
+    int32_t blockSize = 0;
+    memcpy(&blockSize, myBatch.data() + myBatchPos, sizeof(int32_t));
+    SamStatus::Status status =
+        record.setBuffer(myBatch.data() + myBatchPos,
+                         blockSize + sizeof(int32_t), header);
+    myBatchPos += blockSize + sizeof(int32_t);
+    if(status != SamStatus::SUCCESS)
+    {
+        myStatus.setStatus(status, "Failed to parse the queued record");
+        return(false);
+    }
+    ++myRecordCount;
+    myStatus.reset();
+    return(true);
+}
+
+
+SamRecordQueue::Sink::Sink(SamRecordQueue& queue)
+    : myQueue(queue),
+      myBatch(),
+      myTranslation(SamRecord::NONE),
+      myRefPtr(NULL),
+      myRecordCount(0),
+      myStatus(ErrorHandler::RETURN)
+{
+}
+
+
+bool SamRecordQueue::Sink::WriteRecord(SamFileHeader& header,
+                                       SamRecord& record)
+{
+    if(myRefPtr != NULL)
+    {
+        record.setReference(myRefPtr);
+    }
+    const char* buffer =
+        (const char*)record.getRecordBuffer(myTranslation);
+    if(buffer == NULL)
+    {
+        myStatus.setStatus(SamStatus::FAIL_PARSE,
+                           "Failed to get the record's BAM buffer");
+        return(false);
+    }
+    int32_t blockSize = 0;
+    memcpy(&blockSize, buffer, sizeof(int32_t));
+    myBatch.append(buffer, blockSize + sizeof(int32_t));
+    ++myRecordCount;
+
+    if((myBatch.size() >= BATCH_SIZE) && !flushBatch())
+    {
+        return(false);
+    }
+    myStatus.reset();
+    return(true);
+}
+
+
+bool SamRecordQueue::Sink::flushBatch()
+{
+    if(myBatch.empty())
+    {
+        return(true);
+    }
+    if(!myQueue.pushBatch(myBatch))
+    {
+        myStatus.setStatus(SamStatus::FAIL_IO,
+                           "The next pipeline stage stopped reading");
+        return(false);
+    }
+    return(true);
+}
@@ -0,0 +1,135 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//////////////////////////////////////////////////////////////////////////
+// Bounded in-memory queue of SAM/BAM records used to pass records from
+// one thread to another.
+
+#ifndef __SAM_RECORD_QUEUE_H__
+#define __SAM_RECORD_QUEUE_H__
+
+#include <deque>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include "SamRecordStream.h"
+
+/// Passes records from a writer thread to a reader thread.  Records are
+/// copied in their binary BAM form into batches, so each thread uses its
+/// own SamRecord & SamFileHeader objects, and the writer blocks when the
+/// queue is holding the maximum number of batches.
+///
+/// The writer writes to getSink() and calls close() when done, the reader
+/// reads from getSource() until it returns false and then calls cancel(),
+/// which makes any further writes fail if the reader stopped early.
+class SamRecordQueue
+{
+public:
+    /// Create a queue that buffers up to maxBatches batches of records.
+    SamRecordQueue(unsigned int maxBatches = DEFAULT_MAX_BATCHES);
+
+    /// Return the source for the reader thread.
+    SamRecordSource& getSource() { return(mySource); }
+
+    /// Return the sink for the writer thread.
+    SamRecordSink& getSink() { return(mySink); }
+
+    /// Called by the writer after the last record to queue any partial
+    /// batch.  If failed is true, the reader fails after reading the
+    /// queued records rather than reaching the end of the records.
+    void close(bool failed = false);
+
+    /// Called by the reader when it is done reading, discarding any
+    /// queued records and failing subsequent writes.
+    void cancel();
+
+    /// Default number of batches buffered by a queue.
+    static const unsigned int DEFAULT_MAX_BATCHES = 64;
+
+    /// Size (bytes) at which a batch of records is queued.
+    static const unsigned int BATCH_SIZE = 0x10000;
+
+private:
+    SamRecordQueue(const SamRecordQueue&);
+    SamRecordQueue& operator=(const SamRecordQueue&);
+
+    class Source : public SamRecordSource
+    {
+    public:
+        Source(SamRecordQueue& queue);
+        bool ReadRecord(SamFileHeader& header, SamRecord& record);
+        uint32_t GetCurrentRecordCount() { return(myRecordCount); }
+        SamStatus::Status GetStatus() { return(myStatus.getStatus()); }
+        const char* GetStatusMessage() { return(myStatus.getStatusMessage()); }
+
+    private:
+        SamRecordQueue& myQueue;
+        std::string myBatch;
+        size_t myBatchPos;
+        uint32_t myRecordCount;
+        SamStatus myStatus;
+    };
+
+    class Sink : public SamRecordSink
+    {
+    public:
+        Sink(SamRecordQueue& queue);
+        bool WriteRecord(SamFileHeader& header, SamRecord& record);
+        void SetWriteSequenceTranslation(SamRecord::SequenceTranslation translation)
+        { myTranslation = translation; }
+        void SetReference(GenomeSequence* reference) { myRefPtr = reference; }
+        uint32_t GetCurrentRecordCount() { return(myRecordCount); }
+        SamStatus::Status GetStatus() { return(myStatus.getStatus()); }
+        const char* GetStatusMessage() { return(myStatus.getStatusMessage()); }
+
+        // Queue the current batch, returning false if the queue
+        // was cancelled.
+        bool flushBatch();
+
+    private:
+        SamRecordQueue& myQueue;
+        std::string myBatch;
+        SamRecord::SequenceTranslation myTranslation;
+        GenomeSequence* myRefPtr;
+        uint32_t myRecordCount;
+        SamStatus myStatus;
+    };
+
+    // Swap the batch into the queue, waiting for room.
+    // Returns false if the queue was cancelled.
+    bool pushBatch(std::string& batch);
+
+    // Swap the next batch out of the queue, waiting for one.
+    // Returns false if there are no more batches.
+    bool popBatch(std::string& batch);
+
+    Source mySource;
+    Sink mySink;
+
+    std::mutex myMutex;
+    std::condition_variable myNotEmpty;
+    std::condition_variable myNotFull;
+    std::deque<std::string> myBatches;
+    std::vector<std::string> myFreeBatches;
+    unsigned int myMaxBatches;
+    bool myClosed;
+    bool myFailed;
+    bool myCancelled;
+};
+
+#endif
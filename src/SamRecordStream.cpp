@@ -0,0 +1,495 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <iostream>
+#include <sstream>
+#include "SamRecordStream.h"
+#include "SamHelper.h"
+
+SamSpoolSource::SamSpoolSource(SamRecordSource& source,
+                               SamFileHeader& header,
+                               const char* spoolFile)
+    : mySource(source),
+      myHeader(header),
+      mySpoolFile(spoolFile),
+      mySpoolOut(),
+      mySpoolIn(),
+      mySpooling(true),
+      myWriteFailed(false),
+      myRecordCount(0)
+{
+    // Throws an exception if the spool file cannot be opened.
+    mySpoolOut.OpenForWrite(mySpoolFile.c_str(), &myHeader);
+}
+
+
+SamSpoolSource::~SamSpoolSource()
+{
+    mySpoolOut.Close();
+    mySpoolIn.Close();
+    remove(mySpoolFile.c_str());
+}
+
+
+bool SamSpoolSource::ReadRecord(SamFileHeader& header, SamRecord& record)
+{
+    if(!mySpooling)
+    {
+        if(!mySpoolIn.ReadRecord(header, record))
+        {
+            return(false);
+        }
+        ++myRecordCount;
+        return(true);
+    }
+
+    if(!mySource.ReadRecord(header, record))
+    {
+        return(false);
+    }
+    // Spool the record before the caller modifies it.
+    if(!mySpoolOut.WriteRecord(myHeader, record))
+    {
+        myWriteFailed = true;
+        return(false);
+    }
+    ++myRecordCount;
+    return(true);
+}
+
+
+uint32_t SamSpoolSource::GetCurrentRecordCount()
+{
+    return(myRecordCount);
+}
+
+
+SamStatus::Status SamSpoolSource::GetStatus()
+{
+    if(!mySpooling)
+    {
+        return(mySpoolIn.GetStatus());
+    }
+    if(myWriteFailed)
+    {
+        return(mySpoolOut.GetStatus());
+    }
+    return(mySource.GetStatus());
+}
+
+
+const char* SamSpoolSource::GetStatusMessage()
+{
+    if(!mySpooling)
+    {
+        return(mySpoolIn.GetStatusMessage());
+    }
+    if(myWriteFailed)
+    {
+        return(mySpoolOut.GetStatusMessage());
+    }
+    return(mySource.GetStatusMessage());
+}
+
+
+bool SamSpoolSource::Rewind()
+{
+    if(mySpooling)
+    {
+        if(myWriteFailed)
+        {
+            return(false);
+        }
+        // Spool the records the caller did not read.
+        SamRecord record;
+        while(mySource.ReadRecord(myHeader, record))
+        {
+            if(!mySpoolOut.WriteRecord(myHeader, record))
+            {
+                myWriteFailed = true;
+                return(false);
+            }
+        }
+        if(mySource.GetStatus() != SamStatus::NO_MORE_RECS)
+        {
+            return(false);
+        }
+        mySpoolOut.Close();
+        mySpooling = false;
+    }
+
+    SamFileHeader spoolHeader;
+    if(!mySpoolIn.OpenForRead(mySpoolFile.c_str(), &spoolHeader))
+    {
+        return(false);
+    }
+    myRecordCount = 0;
+    return(true);
+}
+
+
+SamSpillRuns::SamSpillRuns()
+    : myHeader(),
+      myPrefix(),
+      myReference(NULL),
+      myRuns(),
+      myMergeRecord(),
+      myNumRunFiles(0),
+      myNumSpilled(0)
+{
+}
+
+
+SamSpillRuns::~SamSpillRuns()
+{
+    while(!myRuns.empty())
+    {
+        removeRun(myRuns.size() - 1);
+    }
+}
+
+
+void SamSpillRuns::setup(SamFileHeader& header, const char* tmpPrefix,
+                         GenomeSequence* reference)
+{
+    myHeader = header;
+    myPrefix = tmpPrefix;
+    myReference = reference;
+}
+
+
+bool SamSpillRuns::writeRun(const std::vector<SpillRecord>& records)
+{
+    if(records.empty())
+    {
+        return(true);
+    }
+
+    SamFile runOut;
+    Run* run = openRun(runOut);
+    if(run == NULL)
+    {
+        return(false);
+    }
+
+    // Merge the open runs into this one if there are too many.  On ties,
+    // the records from the earlier runs are written first.
+    bool merge = (myRuns.size() >= MAX_RUNS);
+    bool success = true;
+    size_t index = 0;
+    uint64_t tag;
+    while(success && ((index < records.size()) || (merge && !empty())))
+    {
+        if(merge && !empty() &&
+           ((index == records.size()) || (nextKey() <= records[index].key)))
+        {
+            uint64_t key = nextKey();
+            success = readNext(myMergeRecord, tag) &&
+                writeRunRecord(run, runOut, myMergeRecord, key, tag);
+        }
+        else
+        {
+            success = writeRunRecord(run, runOut, *(records[index].record),
+                                     records[index].key, records[index].tag);
+            ++index;
+        }
+    }
+    if(!success)
+    {
+        // Drop the partial run.
+        run->keys.clear();
+    }
+    if(!closeRun(run, runOut))
+    {
+        return(false);
+    }
+    myNumSpilled += records.size();
+    return(true);
+}
+
+
+SamSpillRuns::Run* SamSpillRuns::openRun(SamFile& runOut)
+{
+    Run* run = new Run();
+    std::stringstream fileName;
+    fileName << myPrefix << ".spill" << ++myNumRunFiles << ".ubam";
+    run->fileName = fileName.str();
+    run->next = 0;
+
+    if(!runOut.OpenForWrite(run->fileName.c_str(), &myHeader))
+    {
+        std::cerr << "Failed to open the spill file: " << run->fileName
+                  << ": " << runOut.GetStatusMessage() << std::endl;
+        delete run;
+        return(NULL);
+    }
+    if(myReference != NULL)
+    {
+        runOut.SetReference(myReference);
+        runOut.SetWriteSequenceTranslation(SamRecord::BASES);
+    }
+    return(run);
+}
+
+
+bool SamSpillRuns::writeRunRecord(Run* run, SamFile& runOut,
+                                  SamRecord& record,
+                                  uint64_t key, uint64_t tag)
+{
+    if(!runOut.WriteRecord(myHeader, record))
+    {
+        std::cerr << "Failed to write the spill file: " << run->fileName
+                  << ": " << runOut.GetStatusMessage() << std::endl;
+        return(false);
+    }
+    run->keys.push_back(key);
+    run->tags.push_back(tag);
+    return(true);
+}
+
+
+bool SamSpillRuns::closeRun(Run* run, SamFile& runOut)
+{
+    runOut.Close();
+    // A run without any keys failed to be written.
+    if(run->keys.empty())
+    {
+        remove(run->fileName.c_str());
+        delete run;
+        return(false);
+    }
+
+    SamFileHeader runHeader;
+    if(!run->file.OpenForRead(run->fileName.c_str(), &runHeader))
+    {
+        std::cerr << "Failed to reopen the spill file: " << run->fileName
+                  << ": " << run->file.GetStatusMessage() << std::endl;
+        remove(run->fileName.c_str());
+        delete run;
+        return(false);
+    }
+    myRuns.push_back(run);
+    return(true);
+}
+
+
+uint64_t SamSpillRuns::nextKey() const
+{
+    const Run* run = myRuns[nextRun()];
+    return(run->keys[run->next]);
+}
+
+
+bool SamSpillRuns::readNext(SamRecord& record, uint64_t& tag)
+{
+    if(myRuns.empty())
+    {
+        return(false);
+    }
+    size_t index = nextRun();
+    Run* run = myRuns[index];
+    if(!run->file.ReadRecord(myHeader, record))
+    {
+        std::cerr << "Failed to read the spill file: " << run->fileName
+                  << ": " << run->file.GetStatusMessage() << std::endl;
+        return(false);
+    }
+    tag = run->tags[run->next];
+    if(++(run->next) == run->keys.size())
+    {
+        removeRun(index);
+    }
+    return(true);
+}
+
+
+size_t SamSpillRuns::nextRun() const
+{
+    // Runs are in the order they were written, so only a strictly smaller
+    // key replaces an earlier run.
+    size_t minIndex = 0;
+    for(size_t i = 1; i < myRuns.size(); i++)
+    {
+        if(myRuns[i]->keys[myRuns[i]->next] <
+           myRuns[minIndex]->keys[myRuns[minIndex]->next])
+        {
+            minIndex = i;
+        }
+    }
+    return(minIndex);
+}
+
+
+void SamSpillRuns::removeRun(size_t index)
+{
+    Run* run = myRuns[index];
+    run->file.Close();
+    remove(run->fileName.c_str());
+    delete run;
+    myRuns.erase(myRuns.begin() + index);
+}
+
+
+SamCoordSink::SamCoordSink(SamRecordPool& pool)
+    : myPool(&pool),
+      mySink(NULL),
+      myHeader(NULL),
+      myReadBuffer(),
+      mySpillEnabled(false),
+      myRuns(),
+      myRunRecord()
+{
+}
+
+
+SamCoordSink::~SamCoordSink()
+{
+    flushAll();
+}
+
+
+void SamCoordSink::setOutput(SamRecordSink* sink, SamFileHeader* header)
+{
+    mySink = sink;
+    myHeader = header;
+}
+
+
+void SamCoordSink::enableSpill(const char* tmpPrefix)
+{
+    if(myHeader != NULL)
+    {
+        myRuns.setup(*myHeader, tmpPrefix);
+        mySpillEnabled = true;
+    }
+}
+
+
+bool SamCoordSink::spill()
+{
+    if(!mySpillEnabled)
+    {
+        return(false);
+    }
+
+    // The buffer is already in coordinate order.
+    std::vector<SamSpillRuns::SpillRecord> records;
+    records.reserve(myReadBuffer.size());
+    for(std::multimap<uint64_t, SamRecord*>::iterator iter =
+            myReadBuffer.begin(); iter != myReadBuffer.end(); iter++)
+    {
+        SamSpillRuns::SpillRecord spillRecord;
+        spillRecord.key = iter->first;
+        spillRecord.tag = 0;
+        spillRecord.record = iter->second;
+        records.push_back(spillRecord);
+    }
+    if(!myRuns.writeRun(records))
+    {
+        return(false);
+    }
+    for(std::multimap<uint64_t, SamRecord*>::iterator iter =
+            myReadBuffer.begin(); iter != myReadBuffer.end(); iter++)
+    {
+        myPool->releaseRecord(iter->second);
+    }
+    myReadBuffer.clear();
+    return(true);
+}
+
+
+bool SamCoordSink::add(SamRecord* record)
+{
+    if(record == NULL)
+    {
+        return(false);
+    }
+    myReadBuffer.insert(std::make_pair(
+        SamHelper::combineChromPos(record->getReferenceID(),
+                                   record->get0BasedPosition()),
+        record));
+    return(true);
+}
+
+
+bool SamCoordSink::flushAll()
+{
+    return(flush(-1, -1));
+}
+
+
+bool SamCoordSink::flush(int32_t chromID, int32_t pos0Based)
+{
+    uint64_t chromPos = SamHelper::combineChromPos(chromID, pos0Based);
+    bool returnVal = true;
+
+    if((mySink == NULL) || (myHeader == NULL))
+    {
+        if(!myReadBuffer.empty())
+        {
+            std::cerr << "SamCoordSink::flush, no output is set, so records "
+                      << "are removed without being written\n";
+            returnVal = false;
+        }
+    }
+
+    // Merge the spilled records with the buffer.  Records with the same
+    // position are written from the spill files first since they were
+    // added before the records still in memory.
+    uint64_t tag;
+    std::multimap<uint64_t, SamRecord*>::iterator iter = myReadBuffer.begin();
+    while(true)
+    {
+        bool fromRuns = !myRuns.empty() &&
+            ((myRuns.nextKey() <= chromPos) || (chromID == -1));
+        bool fromBuffer = (iter != myReadBuffer.end()) &&
+            ((iter->first <= chromPos) || (chromID == -1));
+        if(fromRuns && fromBuffer && (iter->first < myRuns.nextKey()))
+        {
+            fromRuns = false;
+        }
+
+        if(fromRuns)
+        {
+            if(!myRuns.readNext(myRunRecord, tag))
+            {
+                returnVal = false;
+                break;
+            }
+            if((mySink != NULL) && (myHeader != NULL))
+            {
+                returnVal &= mySink->WriteRecord(*myHeader, myRunRecord);
+            }
+        }
+        else if(fromBuffer)
+        {
+            if((mySink != NULL) && (myHeader != NULL))
+            {
+                returnVal &= mySink->WriteRecord(*myHeader, *(iter->second));
+            }
+            myPool->releaseRecord(iter->second);
+            myReadBuffer.erase(iter);
+            iter = myReadBuffer.begin();
+        }
+        else
+        {
+            break;
+        }
+    }
+    return(returnVal);
+}
@@ -0,0 +1,297 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//////////////////////////////////////////////////////////////////////////
+// Record level interfaces for reading & writing SAM/BAM records so tools
+// can process records coming from/going to either a file or another tool.
+
+#ifndef __SAM_RECORD_STREAM_H__
+#define __SAM_RECORD_STREAM_H__
+
+#include <map>
+#include <string>
+#include <vector>
+#include "SamFile.h"
+#include "SamRecordPool.h"
+
+/// Source of SAM/BAM records, read with the same calls as a SamFile.
+class SamRecordSource
+{
+public:
+    virtual ~SamRecordSource() {}
+
+    /// Read the next record.  Returns false if there are no more records
+    /// (status NO_MORE_RECS) or on failure.
+    virtual bool ReadRecord(SamFileHeader& header, SamRecord& record) = 0;
+
+    /// Return the number of records read since opening/rewinding.
+    virtual uint32_t GetCurrentRecordCount() = 0;
+
+    /// Return the status of the last read.
+    virtual SamStatus::Status GetStatus() = 0;
+
+    /// Return the status message of the last read.
+    virtual const char* GetStatusMessage() = 0;
+
+    /// Start over reading from the first record, for tools that make
+    /// two passes through their input.  Returns false if this source
+    /// cannot be reread.
+    virtual bool Rewind() { return(false); }
+};
+
+
+/// Destination of SAM/BAM records, written with the same calls as a
+/// SamFile.
+class SamRecordSink
+{
+public:
+    virtual ~SamRecordSink() {}
+
+    /// Write the record.  Returns false on failure.
+    virtual bool WriteRecord(SamFileHeader& header, SamRecord& record) = 0;
+
+    /// Set how the bases of the records are translated when written.
+    virtual void SetWriteSequenceTranslation(SamRecord::SequenceTranslation translation) = 0;
+
+    /// Set the reference used to translate the bases when written.
+    virtual void SetReference(GenomeSequence* reference) = 0;
+
+    /// Return the number of records written.
+    virtual uint32_t GetCurrentRecordCount() = 0;
+
+    /// Return the status of the last write.
+    virtual SamStatus::Status GetStatus() = 0;
+
+    /// Return the status message of the last write.
+    virtual const char* GetStatusMessage() = 0;
+};
+
+
+/// SamRecordSink that writes to a SamFile opened for writing.
+class SamFileSink : public SamRecordSink
+{
+public:
+    SamFileSink(SamFile& samFile) : mySamFile(samFile) {}
+
+    bool WriteRecord(SamFileHeader& header, SamRecord& record)
+    { return(mySamFile.WriteRecord(header, record)); }
+
+    void SetWriteSequenceTranslation(SamRecord::SequenceTranslation translation)
+    { mySamFile.SetWriteSequenceTranslation(translation); }
+
+    void SetReference(GenomeSequence* reference)
+    { mySamFile.SetReference(reference); }
+
+    uint32_t GetCurrentRecordCount()
+    { return(mySamFile.GetCurrentRecordCount()); }
+
+    SamStatus::Status GetStatus() { return(mySamFile.GetStatus()); }
+
+    const char* GetStatusMessage() { return(mySamFile.GetStatusMessage()); }
+
+private:
+    SamFile& mySamFile;
+};
+
+
+/// Makes a source that can only be read once (like a SamRecordQueue)
+/// rewindable by spooling the records to an uncompressed BAM file as they
+/// are read the first time and reading them back from that file after
+/// Rewind.
+class SamSpoolSource : public SamRecordSource
+{
+public:
+    /// Spool the records from source (which use header) to spoolFile,
+    /// which should end in ".ubam" so it is not compressed.
+    SamSpoolSource(SamRecordSource& source, SamFileHeader& header,
+                   const char* spoolFile);
+
+    /// Removes the spool file.
+    ~SamSpoolSource();
+
+    bool ReadRecord(SamFileHeader& header, SamRecord& record);
+    uint32_t GetCurrentRecordCount();
+    SamStatus::Status GetStatus();
+    const char* GetStatusMessage();
+
+    /// Spool any records that have not been read yet and start reading
+    /// from the beginning of the spool file.
+    bool Rewind();
+
+private:
+    SamSpoolSource(const SamSpoolSource&);
+    SamSpoolSource& operator=(const SamSpoolSource&);
+
+    SamRecordSource& mySource;
+    SamFileHeader myHeader;
+    std::string mySpoolFile;
+    SamFile mySpoolOut;
+    SamFile mySpoolIn;
+    bool mySpooling;
+    bool myWriteFailed;
+    uint32_t myRecordCount;
+};
+
+
+/// Temporary uncompressed BAM files ("runs") holding records that do not
+/// fit in memory.  Each run is written sorted by a caller supplied key and
+/// the records are read back in key order across all of the runs.  Only
+/// the key & a caller supplied tag of each spilled record are kept in
+/// memory.
+class SamSpillRuns
+{
+public:
+    /// A record to write to a run.
+    struct SpillRecord
+    {
+        uint64_t key;
+        uint64_t tag;
+        SamRecord* record;
+    };
+
+    SamSpillRuns();
+
+    /// Removes any run files that are still open.
+    ~SamSpillRuns();
+
+    /// Set the header of the records and the prefix of the run files,
+    /// which are named <tmpPrefix>.spill<N>.ubam.  If reference is set,
+    /// '=' bases are written as the reference bases.
+    void setup(SamFileHeader& header, const char* tmpPrefix,
+               GenomeSequence* reference = NULL);
+
+    /// Write the records, which must be sorted by key, to a new run.
+    /// The caller still owns the records.  If MAX_RUNS runs are already
+    /// open, they are merged with the records into a single run.
+    /// Returns false on failure.
+    bool writeRun(const std::vector<SpillRecord>& records);
+
+    /// Maximum number of runs to keep open.
+    static const unsigned int MAX_RUNS = 64;
+
+    /// Return true if all spilled records have been read back.
+    bool empty() const { return(myRuns.empty()); }
+
+    /// Return the smallest key of the records not yet read back
+    /// (only valid if not empty).
+    uint64_t nextKey() const;
+
+    /// Read back the record with the smallest key (records with the same
+    /// key are read in the order they were written), setting its tag.
+    /// Returns false on failure.
+    bool readNext(SamRecord& record, uint64_t& tag);
+
+    /// Return the number of records that have been spilled.
+    uint64_t getNumSpilled() const { return(myNumSpilled); }
+
+    /// Return the number of runs that have been written.
+    uint32_t getNumRuns() const { return(myNumRunFiles); }
+
+private:
+    SamSpillRuns(const SamSpillRuns&);
+    SamSpillRuns& operator=(const SamSpillRuns&);
+
+    struct Run
+    {
+        std::string fileName;
+        SamFile file;
+        std::vector<uint64_t> keys;
+        std::vector<uint64_t> tags;
+        size_t next;
+    };
+
+    // Open a new run file for writing.
+    Run* openRun(SamFile& runOut);
+
+    // Write a record to a run being written.
+    bool writeRunRecord(Run* run, SamFile& runOut, SamRecord& record,
+                        uint64_t key, uint64_t tag);
+
+    // Finish writing a run & open it for reading.
+    bool closeRun(Run* run, SamFile& runOut);
+
+    // Return the index of the run with the smallest next key.
+    size_t nextRun() const;
+
+    // Close & remove the run at the specified index.
+    void removeRun(size_t index);
+
+    SamFileHeader myHeader;
+    std::string myPrefix;
+    GenomeSequence* myReference;
+    std::vector<Run*> myRuns;
+    // Record that runs are read into when merging them.
+    SamRecord myMergeRecord;
+    uint32_t myNumRunFiles;
+    uint64_t myNumSpilled;
+};
+
+
+/// Buffers records from a SamRecordPool, writing them to a SamRecordSink
+/// in coordinate order as they are flushed and releasing them back to
+/// the pool (SamCoordOutput, but for a SamRecordSink).
+class SamCoordSink
+{
+public:
+    SamCoordSink(SamRecordPool& pool);
+
+    /// Flushes any records that are still buffered.
+    ~SamCoordSink();
+
+    /// Set the sink & header to write to.
+    void setOutput(SamRecordSink* sink, SamFileHeader* header);
+
+    /// Add a record to the buffer.
+    bool add(SamRecord* record);
+
+    /// Write all of the buffered records.
+    bool flushAll();
+
+    /// Write the buffered records up to and including the specified
+    /// chromosome/0-based position (all of them if chromID is -1).
+    bool flush(int32_t chromID, int32_t pos0Based);
+
+    /// Return the number of records buffered in memory.
+    uint32_t size() const { return(myReadBuffer.size()); }
+
+    /// Allow the buffered records to be spilled to temporary files
+    /// starting with tmpPrefix (must be called after setOutput).
+    void enableSpill(const char* tmpPrefix);
+
+    /// Write the records buffered in memory to a temporary file, releasing
+    /// them to the pool.  They are read back from the file as they are
+    /// flushed.  Returns false on failure or if spilling is not enabled.
+    bool spill();
+
+    /// Return the number of records that have been spilled.
+    uint64_t getNumSpilled() const { return(myRuns.getNumSpilled()); }
+
+private:
+    SamCoordSink(const SamCoordSink&);
+    SamCoordSink& operator=(const SamCoordSink&);
+
+    SamRecordPool* myPool;
+    SamRecordSink* mySink;
+    SamFileHeader* myHeader;
+    std::multimap<uint64_t, SamRecord*> myReadBuffer;
+    bool mySpillEnabled;
+    SamSpillRuns myRuns;
+    // Record that spilled records are read back into.
+    SamRecord myRunRecord;
+};
+
+#endif
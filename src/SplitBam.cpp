@@ -18,17 +18,19 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
-#include <map>
+#include <unordered_map>
 #include <vector>
 #include <string>
 #include <cstdlib>
 #include <unistd.h>
 #include <getopt.h>
+#include <string.h>
 #include "SplitBam.h"
-#include "SamFile.h"
+#include "SamInputFile.h"
 #include "Logger.h"
 #include "BgzfFileType.h"
 #include "PhoneHome.h"
+#include "OutputFileCache.h"
 
 ////////////////////////////////////////////////////////////////////////
 // SplitBam : 
@@ -72,7 +74,7 @@ void SplitBam::printDescription(std::ostream& os)
 void SplitBam::printUsage(std::ostream& os)
 {
     BamExecutable::printUsage(os);
-    os << "\t ./bam splitBam [-v] -i <inputBAMFile> -o <outPrefix> [-L logFile]" << std::endl;
+    os << "\t ./bam splitBam [-v] -i <inputBAMFile> -o <outPrefix> [-L logFile] [--threads <numThreads>] [--level <0-9>] [--maxOpen <numFiles>]" << std::endl;
     os << "splitBam splits a BAM file into multiple BAM files based on" << std::endl;
     os << "ReadGroup according to the following details." << std::endl;
     os << "\t(1) Creates multiple output files named [outprefix].[RGID].bam, for" << std::endl;
@@ -88,6 +90,37 @@ void SplitBam::printUsage(std::ostream& os)
     os << "-L/--log [logFile]  : log file name. default is listFile.log" << std::endl;
     os << "-v/--verbose : turn on verbose mode" << std::endl;
     os << "-n/--noeof : turn off the check for an EOF block at the end of a bam file" << std::endl;
+    os << "--threads [numThreads] : number of threads for reading the input & compressing the output bam files (default 0)" << std::endl;
+    os << "--level [0-9] : deflate level of the output bam files, 0 is uncompressed BGZF (default -1: zlib default)" << std::endl;
+    os << "--maxOpen [numFiles] : maximum number of output bam files to keep open at a time, others are" << std::endl;
+    os << "\tbuffered in memory & reopened to append to them (default " << OutputFileCache::DEFAULT_MAX_OPEN << ")" << std::endl;
+}
+
+
+// Append the BAM binary header (magic, header text & references) to buffer.
+static void appendBamHeader(SamFileHeader& header, std::string& buffer)
+{
+    std::string headerText;
+    header.getHeaderString(headerText);
+
+    int32_t value = headerText.size();
+    buffer.append("BAM\1", 4);
+    buffer.append((const char*)&value, sizeof(value));
+    buffer += headerText;
+
+    const SamReferenceInfo& refInfo = header.getReferenceInfo();
+    value = refInfo.getNumEntries();
+    buffer.append((const char*)&value, sizeof(value));
+    for(int i = 0; i < refInfo.getNumEntries(); i++)
+    {
+        const String& refName = refInfo.getReferenceLabel(i);
+        // The name length includes the null terminator.
+        value = refName.Length() + 1;
+        buffer.append((const char*)&value, sizeof(value));
+        buffer.append(refName.c_str(), value);
+        value = refInfo.getReferenceLength(i);
+        buffer.append((const char*)&value, sizeof(value));
+    }
 }
 
 // main function
@@ -101,6 +134,9 @@ int SplitBam::execute(int argc, char ** argv)
       { "verbose", no_argument, NULL, 'v'},
       { "noeof", no_argument, NULL, 'n'},
       { "log", required_argument, NULL, 'L'},
+      { "threads", required_argument, NULL, 'z'},
+      { "level", required_argument, NULL, 'Z'},
+      { "maxOpen", required_argument, NULL, 'm'},
       { "noPhoneHome", no_argument, NULL, 'p'},
       { "nophonehome", no_argument, NULL, 'P'},
       { "phoneHomeThinning", required_argument, NULL, 't'},
@@ -113,6 +149,7 @@ int SplitBam::execute(int argc, char ** argv)
   bool b_verbose = false;
   bool noeof = false;
   bool noPhoneHome = false;
+  int maxOpen = OutputFileCache::DEFAULT_MAX_OPEN;
 
   std::string s_in, s_out, s_logger;
 
@@ -133,6 +170,15 @@ int SplitBam::execute(int argc, char ** argv)
     case 'L':
       s_logger = optarg;
       break;
+    case 'z':
+      myNumThreads = atoi(optarg);
+      break;
+    case 'Z':
+      myCompressionLevel = atoi(optarg);
+      break;
+    case 'm':
+      maxOpen = atoi(optarg);
+      break;
     case 'p':
     case 'P':
       noPhoneHome = true;
@@ -167,7 +213,12 @@ int SplitBam::execute(int argc, char ** argv)
   if(noeof)
   {
       // Set that the eof block is not required.
-      BgzfFileType::setRequireEofBlock(false);
+      setRequireEofBlock(false);
+  }
+
+  if(!processBamIoParameters())
+  {
+      return(-1);
   }
 
   // create a logger object, now possible to write logs/warnings/errors
@@ -191,11 +242,17 @@ int SplitBam::execute(int argc, char ** argv)
   Logger::gLogger->writeLog("Verbose mode    : %s",b_verbose ? "On" : "Off");
   Logger::gLogger->writeLog("BGFZ EOF indicator : %s",noeof ? "Off" : "On");
   
-  SamFile inBam;
+  SamInputFile inBam;
   SamFileHeader inHeader;
-  std::map<std::string,uint32_t> msRGidx;
+  std::unordered_map<std::string,uint32_t> msRGidx;
   std::vector<std::string> vsRGIDs;
-  std::vector<SamFile*> vpOutBams;
+  // The output files are written through a cache that only keeps
+  // maxOpen of them open, so files with many readGroups do not run
+  // out of file descriptors.
+  OutputFileCache outBams;
+  outBams.setLimits(maxOpen);
+  std::vector<int> vOutIdx;
+  std::vector<uint32_t> vNumRecords;
   std::vector<SamFileHeader*> vpOutHeaders;
 
   if ( ! (inBam.OpenForRead(s_in.c_str()))  ) {
@@ -214,13 +271,13 @@ int SplitBam::execute(int argc, char ** argv)
       vsRGIDs.push_back(sRGID);
       uint32_t idx = msRGidx.size();
       msRGidx[sRGID] = idx;
-      SamFile* pNewFile = new SamFile;
-      vpOutBams.push_back(pNewFile);
-      
       std::string outFileName = s_out + "." + sRGID + ".bam";
-      if ( !pNewFile->OpenForWrite(outFileName.c_str()) ) {
+      int outIdx = outBams.add(outFileName.c_str(), true, myCompressionLevel);
+      if ( outIdx < 0 ) {
 	Logger::gLogger->error("Cannot open BAM file %s for writing",outFileName.c_str());
       }
+      vOutIdx.push_back(outIdx);
+      vNumRecords.push_back(0);
       
       SamFileHeader* pNewHeader = new SamFileHeader(inHeader);
       vpOutHeaders.push_back(pNewHeader);
@@ -251,51 +308,68 @@ int SplitBam::execute(int argc, char ** argv)
   }
 
   // write headers to the output file
+  std::string headerBuffer;
   for(uint32_t i=0; i < vsRGIDs.size(); ++i) {
-    vpOutBams[i]->WriteHeader(*vpOutHeaders[i]);
+    headerBuffer.clear();
+    appendBamHeader(*vpOutHeaders[i], headerBuffer);
+    outBams.write(vOutIdx[i], headerBuffer.data(), headerBuffer.size());
   }
 
+  // Records of a readGroup tend to be together, so remember the last
+  // readGroup to skip most of the index lookups.
+  std::string lastRG;
+  uint32_t lastIdx = 0;
+  bool haveLastRG = false;
+  std::string rgKey;
+
   SamRecord record;
   while( inBam.ReadRecord(inHeader, record) == true ) {
-    char tag[3];
-    char vtype;
-    void* value;
-    bool found = false;
-    while( record.getNextSamTag(tag, vtype, &value) != false ) {
-      if ( strcmp(tag,"RG") == 0 ) {
-	found = true;
-	if ( vtype == 'Z' ) {
-	  std::string sValue = ((String)*(String*)value).c_str();
-	  if ( msRGidx.find(sValue) != msRGidx.end() ) {
-	    uint32_t idx = msRGidx[sValue];
-	    if ( (idx >= 0 ) && ( idx < vsRGIDs.size () ) ) {
-	      vpOutBams[idx]->WriteRecord(inHeader, record);
-	    }
-	    else {
-	      Logger::gLogger->error("ReadGroup Index Lookup Failure");
-	    }
-	  }
-	  else {
-	    Logger::gLogger->error("ReadGroup ID %s cannot be found",sValue.c_str());
-	  }
-	}
-	else {
+    const String* pRG = record.getStringTag("RG");
+    if ( pRG == NULL ) {
+      // Report whether the tag is missing or is not a string.
+      char tag[3];
+      char vtype;
+      void* value;
+      while( record.getNextSamTag(tag, vtype, &value) != false ) {
+	if ( strcmp(tag,"RG") == 0 ) {
 	  Logger::gLogger->error("vtype of RG tag must be 'Z'");
 	}
-	break;
       }
-    }
-    if ( found == false ) {
       Logger::gLogger->error("Cannot find RG tag for readName %s",record.getReadName());
     }
+
+    uint32_t idx = lastIdx;
+    if ( !haveLastRG || (strcmp(pRG->c_str(), lastRG.c_str()) != 0) ) {
+      rgKey = pRG->c_str();
+      std::unordered_map<std::string,uint32_t>::const_iterator it = msRGidx.find(rgKey);
+      if ( it == msRGidx.end() ) {
+	Logger::gLogger->error("ReadGroup ID %s cannot be found",rgKey.c_str());
+      }
+      idx = it->second;
+      lastRG = rgKey;
+      lastIdx = idx;
+      haveLastRG = true;
+    }
+
+    // Copy the record's BAM bytes rather than reformatting it.
+    const void* buffer = record.getRecordBuffer(SamRecord::NONE);
+    if ( (buffer == NULL) ||
+	 !outBams.write(vOutIdx[idx], buffer, record.getBlockSize() + 4) ) {
+      Logger::gLogger->error("Failed to write readName %s for readGroup %s",record.getReadName(),vsRGIDs[idx].c_str());
+    }
+    ++vNumRecords[idx];
   }
 
+  if ( !outBams.closeAll() ) {
+    Logger::gLogger->error("Failed to write the output BAM files");
+  }
   for(uint32_t i=0; i < vsRGIDs.size(); ++i) {
-    Logger::gLogger->writeLog("Successfully wrote %d record for readGroup %s",vpOutBams[i]->GetCurrentRecordCount(), vsRGIDs[i].c_str());
-    vpOutBams[i]->Close();
-    delete vpOutBams[i];
+    Logger::gLogger->writeLog("Successfully wrote %d record for readGroup %s",vNumRecords[i], vsRGIDs[i].c_str());
     delete vpOutHeaders[i];
   }
+  if ( outBams.getNumReopens() > 0 ) {
+    Logger::gLogger->writeLog("Reopened output BAM files %u times to append to them",outBams.getNumReopens());
+  }
 
   delete Logger::gLogger;
   return 0;
@@ -38,7 +38,7 @@ void SplitChromosome::printDescription(std::ostream& os)
 void SplitChromosome::printUsage(std::ostream& os)
 {
     BamExecutable::printUsage(os);
-    os << "\t./bam splitChromosome --in <inputFilename>  --out <outputFileBaseName> [--noeof] [--bamout|--samout] [--params]"<< std::endl;
+    os << "\t./bam splitChromosome --in <inputFilename>  --out <outputFileBaseName> [--noeof] [--bamout|--samout] [--params] [--threads <numThreads>] [--level <0-9>]"<< std::endl;
     os << "\tRequired Parameters:" << std::endl;
     os << "\t\t--in       : the BAM file to be split" << std::endl;
     os << "\t\t--out      : the base filename for the SAM/BAM files to write into.  Does not include the extension.\n";
@@ -48,6 +48,8 @@ void SplitChromosome::printUsage(std::ostream& os)
     os << "\t\t--bamout : write the output files in BAM format (default)." << std::endl;
     os << "\t\t--samout : write the output files in SAM format." << std::endl;
     os << "\t\t--params : print the parameter settings" << std::endl;
+    os << "\t\t--threads : number of threads for compressing BAM output (default 0)" << std::endl;
+    os << "\t\t--level   : BAM compression level, 0 (uncompressed BGZF) to 9 (default -1: zlib default)" << std::endl;
     os << std::endl;
 }
 
@@ -70,6 +72,7 @@ int SplitChromosome::execute(int argc, char **argv)
         LONG_STRINGPARAMETER("out", &outFileBase)
         LONG_PARAMETER("noeof", &noeof)
         LONG_PARAMETER("params", &params)
+        LONG_BAM_OUTPUT_PARAMETERS()
         LONG_PARAMETER_GROUP("Output Type")
            EXCLUSIVE_PARAMETER("bamout", &bamOut)
            EXCLUSIVE_PARAMETER("samout", &samOut)
@@ -92,7 +95,7 @@ int SplitChromosome::execute(int argc, char **argv)
     if(noeof)
     {
         // Set that the eof block is not required.
-        BgzfFileType::setRequireEofBlock(false);
+        setRequireEofBlock(false);
     }
 
     // Check to see if the in file was specified, if not, report an error.
@@ -115,6 +118,12 @@ int SplitChromosome::execute(int argc, char **argv)
         return(-1);
     }
 
+    if(!processBamIoParameters())
+    {
+        inputParameters.Status();
+        return(-1);
+    }
+
     if(params)
     {
         inputParameters.Status();
@@ -178,7 +187,7 @@ int SplitChromosome::execute(int argc, char **argv)
             {
                 outputName += ".sam";
             }
-            outFile.OpenForWrite(outputName.c_str());
+            openForWrite(outFile, outputName.c_str());
             outFile.WriteHeader(samHeader);
             numSectionRecords = 0;
             prevRefID = samRecord.getReferenceID();
@@ -15,8 +15,18 @@
  *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdio.h>
+#include <string.h>
+// The SSSE3 quality binning is compiled for its own function & only used
+// if the CPU supports it, so the build does not need -mssse3.
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+#define SQUEEZE_SSSE3
+#include <tmmintrin.h>
+#endif
 #include "Squeeze.h"
 #include "BgzfFileType.h"
+#include "SamInputFile.h"
 // #include <stdio.h>
 // #include <string.h>
 // #include "SamFile.h"
@@ -27,12 +37,24 @@ Squeeze::Squeeze()
       myBinCustom(false),
       myBinHigh(false),
       myBinQualS(""),
-      myBinQualF("")
+      myBinQualF(""),
+      myInFile(""),
+      myOutFile(""),
+      myRefFile(""),
+      myKeepOQ(false),
+      myKeepDups(false),
+      mySortedReadName(false),
+      myReadNameFile(NULL),
+      myReadNames(),
+      myReadNameBuffer(),
+      myRmTags(""),
+      myRemoveTags()
 {
     for(int i = 0; i <= MAX_QUAL_CHAR; i++)
     {
         myQualBinMap[i] = 0;
     }
+    setupBinLookup();
 }
 
 Squeeze::~Squeeze()
@@ -76,7 +98,7 @@ void Squeeze::printBinningUsage(std::ostream& os)
 void Squeeze::printUsage(std::ostream& os)
 {
     BamExecutable::printUsage(os);
-    os << "\t./bam squeeze --in <inputFile> --out <outputFile.sam/bam/ubam (ubam is uncompressed bam)> [--refFile <refFilePath/Name>] [--keepOQ] [--keepDups] [--readName <readNameMapFile.txt>] [--sReadName <readNameMapFile.txt>] [--rmTags <Tag:Type[,Tag:Type]*>] [--noeof] [--params] ";
+    os << "\t./bam squeeze --in <inputFile> --out <outputFile.sam/bam/ubam (ubam is uncompressed bam)> [--refFile <refFilePath/Name>] [--keepOQ] [--keepDups] [--readName <readNameMapFile.txt>] [--sReadName <readNameMapFile.txt>] [--rnMaxNames <numNames>] [--rmTags <Tag:Type[,Tag:Type]*>] [--noeof] [--params] [--threads <numThreads>] [--level <0-9>] ";
     printBinningUsageLine(os);
     os << std::endl;
     os << "\tRequired Parameters:" << std::endl;
@@ -92,10 +114,16 @@ void Squeeze::printUsage(std::ostream& os)
     os << "                   get mapped to multiple new values." << std::endl;
     os << "\t\t--readName   : Replace read names with unique integers and write the mapping to the specified file." << std::endl;
     os << "                   This version does not require the input file to have been presorted by readname," << std::endl;
-    os << "                   but uses a lot of memory since it stores all the read names." << std::endl;
+    os << "                   but stores all the read names (packed into blocks of memory, about 20 bytes" << std::endl;
+    os << "                   per name plus the name)." << std::endl;
+    os << "\t\t--rnMaxNames : maximum number of read names --readName holds in memory.  Once reached, they are" << std::endl;
+    os << "                   sorted & written to temporary files named <readNameMapFile>.run<N>, which are" << std::endl;
+    os << "                   searched for later read names (default 0: hold all read names in memory)" << std::endl;
     os << "\t\t--rmTags     : Remove the specified Tags formatted as Tag:Type,Tag:Type,Tag:Type..." << std::endl;
     os << "\t\t--noeof      : do not expect an EOF block on a bam file." << std::endl;
     os << "\t\t--params     : print the parameter settings" << std::endl;
+    os << "\t\t--threads    : number of threads for compressing BAM output (default 0)" << std::endl;
+    os << "\t\t--level      : BAM compression level, 0 (uncompressed BGZF) to 9 (default -1: zlib default)" << std::endl;
     printBinningUsage(os);
     os << std::endl;
 }
@@ -103,36 +131,77 @@ void Squeeze::printUsage(std::ostream& os)
 // main function
 int Squeeze::execute(int argc, char ** argv)
 {
-    String inFile = "";
-    String outFile = "";
-    String refFile = "";
+    int status = readParameters(argc, argv);
+    if(status != 0)
+    {
+        return(status);
+    }
+
+    // Open the input file for reading.
+    SamInputFile samIn;
+    samIn.OpenForRead(myInFile);
+
+    // Open the output file for writing.
+    SamFile samOut;
+    openForWrite(samOut, myOutFile);
+
+    // Read the sam header.
+    SamFileHeader samHeader;
+    samIn.ReadHeader(samHeader);
+
+    // Write the sam header.
+    samOut.WriteHeader(samHeader);
+
+    SamFileSink samOutSink(samOut);
+    status = runStage(samHeader, samIn, samOutSink);
+
+    samIn.Close();
+    samOut.Close();
+    return(status);
+}
+
+
+int Squeeze::initStage(int argc, char** argv)
+{
+    return(readParameters(argc, argv));
+}
+
+
+int Squeeze::readParameters(int argc, char** argv)
+{
     bool noeof = false;
     bool params = false;
-    bool keepOQ = false;
-    bool keepDups =  false;
     String readName = "";
     String sReadName = "";
-    IFILE readNameFile = NULL;
+    int rnMaxNames = 0;
     myBinMid = false;
     myBinCustom = false;
     myBinHigh = false;
-    String rmTags = "";
+    myInFile = "";
+    myOutFile = "";
+    myRefFile = "";
+    myKeepOQ = false;
+    myKeepDups = false;
+    myReadNameFile = NULL;
+    myRmTags = "";
 
     ParameterList inputParameters;
     LongParamContainer parameters;
 
     parameters.addGroup("Required Parameters");
-    parameters.addString("in", &inFile);
-    parameters.addString("out", &outFile);
+    parameters.addString("in", &myInFile);
+    parameters.addString("out", &myOutFile);
     parameters.addGroup("Optional Parameters");
-    parameters.addString("refFile", &refFile);
-    parameters.addBool("keepOQ", &keepOQ);
-    parameters.addBool("keepDups", &keepDups);
+    parameters.addString("refFile", &myRefFile);
+    parameters.addBool("keepOQ", &myKeepOQ);
+    parameters.addBool("keepDups", &myKeepDups);
     parameters.addString("readName", &readName);
     parameters.addString("sReadName", &sReadName);
-    parameters.addString("rmTags", &rmTags);
+    parameters.addInt("rnMaxNames", &rnMaxNames);
+    parameters.addString("rmTags", &myRmTags);
     parameters.addBool("noeof", &noeof);
     parameters.addBool("params", &params);
+    addBamOutputParameters(parameters);
     parameters.addPhoneHome(VERSION);
     addBinningParameters(parameters);    
 
@@ -147,11 +216,11 @@ int Squeeze::execute(int argc, char ** argv)
     if(noeof)
     {
         // Set that the eof block is not required.
-        BgzfFileType::setRequireEofBlock(false);
+        setRequireEofBlock(false);
     }
     
     // Check to see if the in file was specified, if not, report an error.
-    if(inFile == "")
+    if(myInFile == "")
     {
         printUsage(std::cerr);
         inputParameters.Status();
@@ -161,7 +230,7 @@ int Squeeze::execute(int argc, char ** argv)
         return(-1);
     }
 
-    if(outFile == "")
+    if(myOutFile == "")
     {
         printUsage(std::cerr);
         inputParameters.Status();
@@ -189,60 +258,74 @@ int Squeeze::execute(int argc, char ** argv)
         return(status);
     }
 
+    if(!setupRemoveTags())
+    {
+        printUsage(std::cerr);
+        inputParameters.Status();
+        std::cerr << "ERROR: --rmTags must be formatted as Tag:Type,Tag:Type...: "
+                  << myRmTags << std::endl;
+        return(-1);
+    }
+
     // Setup the read name map file.
-    if(!sReadName.IsEmpty())
+    mySortedReadName = !sReadName.IsEmpty();
+    if(mySortedReadName)
     {
         readName = sReadName;
     }
     if(!readName.IsEmpty())
     {
-        readNameFile = ifopen(readName, "w");
-        if(readNameFile == NULL)
+        myReadNameFile = ifopen(readName, "w");
+        if(myReadNameFile == NULL)
         {
             std::cerr << "Failed to open the readName File for write: " << readName << std::endl;
             return(-1);
         }
+        // Name the spilled read name files after the map file.
+        std::string runPrefix = readName.c_str();
+        if(runPrefix[0] == '-')
+        {
+            runPrefix = "bamSqueeze";
+        }
+        myReadNames.clear();
+        myReadNames.setSpill(rnMaxNames > 0 ? rnMaxNames : 0, runPrefix);
+        myReadNameBuffer.clear();
+    }
+
+    if(!processBamIoParameters())
+    {
+        inputParameters.Status();
+        return(-1);
     }
 
     if(params)
     {
         inputParameters.Status();
     }
+    return(0);
+}
 
-    // Open the input file for reading.
-    SamFile samIn;
-    samIn.OpenForRead(inFile);
 
-    // Open the output file for writing.
-    SamFile samOut;
-    samOut.OpenForWrite(outFile);
+int Squeeze::runStage(SamFileHeader& samHeader, SamRecordSource& samIn,
+                      SamRecordSink& samOut)
+{
     // Check to see if the ref file was specified.
     // Open the reference.
     GenomeSequence* refPtr = NULL;
-    if(refFile != "")
+    if(myRefFile != "")
     {
-        refPtr = new GenomeSequence(refFile);
+        refPtr = new GenomeSequence(myRefFile);
         // Since a reference was specified, convert matching bases to '='.
         samOut.SetWriteSequenceTranslation(SamRecord::EQUAL);
         // Set the reference for the output file.
         samOut.SetReference(refPtr);
     }
 
-    // Read the sam header.
-    SamFileHeader samHeader;
-    samIn.ReadHeader(samHeader);
-
-    // Write the sam header.
-    samOut.WriteHeader(samHeader);
-
     SamRecord samRecord;
 
-    // Create the hash for readnames.
-    StringIntHash rnHash;
-    // Track the next read name to assign.
-    int32_t nextRn = 0;
-    int32_t numHashEntries = rnHash.Entries();
-    String newRn = "";
+    // Track the next read name to assign when sorted by read name.
+    uint64_t nextRn = 0;
+    char newRn[24] = "";
     String prevRn = "";
 
     // Set returnStatus to success.  It will be changed to the
@@ -256,41 +339,30 @@ int Squeeze::execute(int argc, char ** argv)
 
         // Remove the record if it is a duplicate and we are not
         // supposed to keep duplicates.
-        if(!keepDups && SamFlag::isDuplicate(samRecord.getFlag()))
+        if(!myKeepDups && SamFlag::isDuplicate(samRecord.getFlag()))
         {
             // Duplicate, so do not write it to the output
             // file and just continue to the next record.
             continue;
         }
 
-        if(readNameFile != NULL)
+        if(myReadNameFile != NULL)
         {
             // Shorten the readname.
-            // Check the hash for the readname.
             const char* readName = samRecord.getReadName();
             
-            if(sReadName.IsEmpty())
+            if(!mySortedReadName)
             {
-                // Lookup the readname in the hash.
-                int index = rnHash.Find(readName, nextRn);
-                
-                // Check to see if the nextRn was added to the hash.
-                if(rnHash.Entries() != numHashEntries)
+                // Lookup the readname, adding it if it is new.
+                bool isNew = false;
+                uint64_t index = myReadNames.find(readName, strlen(readName),
+                                                  isNew);
+                snprintf(newRn, sizeof(newRn), "%llu",
+                         (unsigned long long)index);
+                if(isNew)
                 {
-                    // New Read Name was added to the hash.
-                    numHashEntries = rnHash.Entries();
-                    newRn = nextRn;
-                    
                     // Write it to the file.
-                    ifprintf(readNameFile, "%s\t%d\n", readName, nextRn);
-                    
-                    // Update the next read name.
-                    ++nextRn;
-                }
-                else
-                {
-                    // Found the read name, so use that value.
-                    newRn = rnHash.Integer(index);
+                    writeReadName(readName, newRn);
                 }
             }
             else
@@ -300,10 +372,11 @@ int Squeeze::execute(int argc, char ** argv)
                 if(prevRn != readName)
                 {
                     // New read name 
-                    newRn = nextRn;
+                    snprintf(newRn, sizeof(newRn), "%llu",
+                             (unsigned long long)nextRn);
                     
                     // Write it to the file.
-                    ifprintf(readNameFile, "%s\t%d\n", readName, nextRn);
+                    writeReadName(readName, newRn);
                     
                     // Update the next read name.
                     ++nextRn;
@@ -311,30 +384,17 @@ int Squeeze::execute(int argc, char ** argv)
                 }
                 
             }
-            samRecord.setReadName(newRn.c_str());
-        }
-
-        // Remove the OQ tag if we are not supposed to remove OQ tags.
-        if(!keepOQ)
-        {
-            if(!samRecord.rmTag("OQ", 'Z'))
-            {
-                // Failed to remove a tag.
-                SamStatus errorStatus = samRecord.getStatus();
-                fprintf(stderr, "%s\n", errorStatus.getStatusMessage());
-                returnStatus = errorStatus.getStatus();
-            }
+            samRecord.setReadName(newRn);
         }
 
-        // Remove any specified tags.
-        if(!rmTags.IsEmpty())
+        // Remove the OQ tag if we are not supposed to keep OQ tags, and any
+        // specified tags.
+        if(!myRemoveTags.empty() && !removeTags(samRecord))
         {
-            if(!samRecord.rmTags(rmTags.c_str()))
-            {
-                // Failed to remove the specified tags.
-                fprintf(stderr, "%s\n", samIn.GetStatusMessage());
-                returnStatus = samIn.GetStatus();
-            }
+            // Failed to remove a tag.
+            SamStatus errorStatus = samRecord.getStatus();
+            fprintf(stderr, "%s\n", errorStatus.getStatusMessage());
+            returnStatus = errorStatus.getStatus();
         }
 
         // Bin the qualities.
@@ -360,15 +420,126 @@ int Squeeze::execute(int argc, char ** argv)
     std::cerr << "Number of records written = " << 
         samOut.GetCurrentRecordCount() << std::endl;
 
+    if(myReadNameFile != NULL)
+    {
+        flushReadNames();
+        ifclose(myReadNameFile);
+        myReadNameFile = NULL;
+        // Remove any spilled read names.
+        myReadNames.clear();
+    }
+
     // Since the reads were successful, return the status based
     // on the status of the reads/writes.  If any failed, return
     // their failure status.
-    samIn.Close();
-    samOut.Close();
     return returnStatus;
 }
 
 
+void Squeeze::writeReadName(const char* readName, const char* newRn)
+{
+    myReadNameBuffer += readName;
+    myReadNameBuffer += '\t';
+    myReadNameBuffer += newRn;
+    myReadNameBuffer += '\n';
+    if(myReadNameBuffer.size() >= READ_NAME_BUFFER_SIZE)
+    {
+        flushReadNames();
+    }
+}
+
+
+void Squeeze::flushReadNames()
+{
+    if(!myReadNameBuffer.empty())
+    {
+        ifwrite(myReadNameFile, myReadNameBuffer.data(),
+                myReadNameBuffer.size());
+        myReadNameBuffer.clear();
+    }
+}
+
+
+bool Squeeze::setupRemoveTags()
+{
+    myRemoveTags.clear();
+    RemoveTag removeTag;
+    if(!myKeepOQ)
+    {
+        strcpy(removeTag.tag, "OQ");
+        removeTag.type = 'Z';
+        myRemoveTags.push_back(removeTag);
+    }
+
+    // Tag:Type separated by ',' or ';'.
+    const char* tags = myRmTags.c_str();
+    unsigned int length = strlen(tags);
+    unsigned int pos = 0;
+    while(pos < length)
+    {
+        if((pos + 4 > length) || (tags[pos + 2] != ':') ||
+           ((pos + 4 < length) && (tags[pos + 4] != ',') &&
+            (tags[pos + 4] != ';')))
+        {
+            return(false);
+        }
+        removeTag.tag[0] = tags[pos];
+        removeTag.tag[1] = tags[pos + 1];
+        removeTag.tag[2] = 0;
+        removeTag.type = tags[pos + 3];
+        myRemoveTags.push_back(removeTag);
+        pos += 5;
+    }
+    return(true);
+}
+
+
+bool Squeeze::removeTags(SamRecord& samRecord)
+{
+    // Find which of the tags to remove are in the record, so records
+    // without them are not searched for each one.
+    static thread_local std::vector<bool> found;
+    found.assign(myRemoveTags.size(), false);
+    bool anyFound = false;
+    char tag[3];
+    char vtype;
+    void* value;
+    samRecord.resetTagIter();
+    while(samRecord.getNextSamTag(tag, vtype, &value))
+    {
+        // Tags to remove are specified with the general integer type.
+        if(samRecord.isIntegerType(vtype))
+        {
+            vtype = 'i';
+        }
+        for(unsigned int i = 0; i < myRemoveTags.size(); i++)
+        {
+            if((myRemoveTags[i].tag[0] == tag[0]) &&
+               (myRemoveTags[i].tag[1] == tag[1]) &&
+               (myRemoveTags[i].type == vtype))
+            {
+                found[i] = true;
+                anyFound = true;
+            }
+        }
+    }
+
+    bool status = true;
+    if(anyFound)
+    {
+        for(unsigned int i = 0; i < myRemoveTags.size(); i++)
+        {
+            if(found[i] && !samRecord.rmTag(myRemoveTags[i].tag,
+                                           myRemoveTags[i].type))
+            {
+                status = false;
+            }
+        }
+    }
+    return(status);
+}
+
+
 void Squeeze::addBinningParameters(LongParamContainer& params)
 {
     params.addGroup("Optional Quality Binning Parameters");
@@ -497,6 +668,7 @@ int Squeeze::processBinningParam()
 	  binPhredQuals(nextBinStart, MAX_PHRED_QUAL);
 	}
     }
+    setupBinLookup();
     return(0);
 }
 
@@ -540,9 +712,22 @@ void Squeeze::binPhredQuals(int binStartPhred, int binEndPhred)
 }
 
 
+void Squeeze::setupBinLookup()
+{
+    for(int i = 0; i < 256; i++)
+    {
+        myQualBinLookup[i] = i;
+        if((i <= MAX_QUAL_CHAR) && (myQualBinMap[i] != 0))
+        {
+            myQualBinLookup[i] = myQualBinMap[i];
+        }
+    }
+}
+
+
 void Squeeze::bin(SamRecord& samRecord)
 {
-    static String qual = "";
+    static thread_local std::string qual;
     if (!myBinQualS.IsEmpty())
     {
         qual = samRecord.getQuality();
@@ -550,13 +735,62 @@ void Squeeze::bin(SamRecord& samRecord)
         if(qual != "*")
         {
             // Only bin set qualities.
-            for(int i = 0; i < qual.Length(); i++)
-            {
-                // Update the quality by looking its value up
-                // in the quality bin map.
-                qual[i] = (char)(myQualBinMap[(int)(qual[i])]);
-            }
-            samRecord.setQuality(qual);
+            binQualities(&(qual[0]), qual.size(), myQualBinLookup);
+            samRecord.setQuality(qual.c_str());
         }
     }
 }
+
+
+#ifdef SQUEEZE_SSSE3
+// Bin the qualities 16 characters at a time, returning how many were binned
+// (the length rounded down to a multiple of 16).  The low nibble indexes
+// each of the 8 16 byte tables covering 0-127 & the high nibble selects the
+// table.  Characters over 127 select no table and are kept unchanged.
+__attribute__((target("ssse3")))
+static int binQualitiesSsse3(char* qual, int length, const uint8_t* lookup)
+{
+    __m128i tables[8];
+    for(int t = 0; t < 8; t++)
+    {
+        tables[t] = _mm_loadu_si128((const __m128i*)(lookup + t * 16));
+    }
+    const __m128i lowMask = _mm_set1_epi8(0x0F);
+    int i = 0;
+    for(; i + 16 <= length; i += 16)
+    {
+        __m128i quals = _mm_loadu_si128((const __m128i*)(qual + i));
+        __m128i low = _mm_and_si128(quals, lowMask);
+        __m128i high = _mm_and_si128(_mm_srli_epi16(quals, 4), lowMask);
+        __m128i binned =
+            _mm_and_si128(quals, _mm_cmplt_epi8(quals, _mm_setzero_si128()));
+        for(int t = 0; t < 8; t++)
+        {
+            __m128i select = _mm_cmpeq_epi8(high, _mm_set1_epi8(t));
+            binned = _mm_or_si128(binned,
+                                  _mm_and_si128(select,
+                                                _mm_shuffle_epi8(tables[t],
+                                                                 low)));
+        }
+        _mm_storeu_si128((__m128i*)(qual + i), binned);
+    }
+    return(i);
+}
+#endif
+
+
+void Squeeze::binQualities(char* qual, int length, const uint8_t* lookup)
+{
+    int i = 0;
+#ifdef SQUEEZE_SSSE3
+    static const bool hasSsse3 = __builtin_cpu_supports("ssse3");
+    if(hasSsse3)
+    {
+        i = binQualitiesSsse3(qual, length, lookup);
+    }
+#endif
+    for(; i < length; i++)
+    {
+        qual[i] = lookup[(unsigned char)qual[i]];
+    }
+}
@@ -26,7 +26,10 @@
 #include <stack>
 #include <list>
 #include <map>
+#include <string>
+#include <vector>
 #include "BamExecutable.h"
+#include "ReadNameDictionary.h"
 #include "SamFile.h"
 
 class Squeeze : public BamExecutable
@@ -42,14 +45,40 @@ public:
     int execute(int argc, char **argv);
     virtual const char* getProgramName() {return("bam:squeeze");}
 
+    int runStage(SamFileHeader& samHeader, SamRecordSource& samIn,
+                 SamRecordSink& samOut);
+
     void addBinningParameters(LongParamContainer& params);
     int processBinningParam();
     int getQualCharFromQemp(uint8_t qemp);
 
+protected:
+    int initStage(int argc, char** argv);
+
 private:
+    // Read & validate the parameters.  Returns 0 on success.
+    int readParameters(int argc, char** argv);
+
+    // Add a read name & its new name to the read name map file.
+    void writeReadName(const char* readName, const char* newRn);
+    // Write the buffered read name map to the file.
+    void flushReadNames();
+
+    // Parse the tags to remove (OQ & --rmTags).  Returns false if
+    // --rmTags is not formatted as Tag:Type[,Tag:Type]*.
+    bool setupRemoveTags();
+    // Remove the tags in a single scan of the record's tags.
+    bool removeTags(SamRecord& samRecord);
+
     void binPhredQuals(int binStartPhred, int binEndPhred);
+    // Fill the byte lookup used to bin qualities from myQualBinMap.
+    void setupBinLookup();
     void bin(SamRecord& samRecord);
 
+    // Replace each quality character with its entry in the 256 byte
+    // lookup, 16 at a time when the CPU supports SSSE3.
+    static void binQualities(char* qual, int length, const uint8_t* lookup);
+
     // Non-phred max
     static const int MAX_QUAL_CHAR = 126;
     static const int MAX_PHRED_QUAL = 93;
@@ -61,6 +90,32 @@ private:
     String myBinQualF;
     // Non-phred indices
     int myQualBinMap[MAX_QUAL_CHAR+1];
+    // myQualBinMap as bytes for every character, unmapped ones unchanged.
+    uint8_t myQualBinLookup[256];
+
+    String myInFile;
+    String myOutFile;
+    String myRefFile;
+    bool myKeepOQ;
+    bool myKeepDups;
+    // Whether the read names are sorted, so they can be shortened
+    // without a hash.
+    bool mySortedReadName;
+    IFILE myReadNameFile;
+    // Read names mapped to their new names when they are not sorted.
+    ReadNameDictionary myReadNames;
+    // The read name map is buffered & written in large blocks.
+    std::string myReadNameBuffer;
+    static const unsigned int READ_NAME_BUFFER_SIZE = 0x100000;
+    String myRmTags;
+
+    // A tag to remove from each record.
+    struct RemoveTag
+    {
+        char tag[3];
+        char type;
+    };
+    std::vector<RemoveTag> myRemoveTags;
 };
 
 #endif
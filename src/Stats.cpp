@@ -18,13 +18,43 @@
 //////////////////////////////////////////////////////////////////////////
 // This file contains the processing for the executable option "stats"
 // which generates some statistics for SAM/BAM files.
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <thread>
 #include "Stats.h"
 #include "SamFile.h"
 #include "BgzfFileType.h"
 #include "Pileup.h"
 #include "PileupElementBaseQCStats.h"
+#include "BaseQCPileup.h"
 #include "SamFlag.h"
 
+Stats::Stats()
+    : BamExecutable(),
+      myRegionList(NULL),
+      myStartPos(0),
+      myEndPos(-1),
+      myRegBuffer(),
+      myRegColumn(),
+      myWithinRegion(false),
+      myQual(false),
+      myPhred(false),
+      myQualExcludeClips(false),
+      myPileup(false),
+      myDepth(false),
+      myBufferSize(PileupHelper::DEFAULT_WINDOW_SIZE),
+      myRequiredFlags(0),
+      myExcludeFlags(0),
+      myDbsnpList(NULL),
+      myQualityHist(),
+      myCoverage(),
+      mySampler()
+{
+}
+
 void Stats::printStatsDescription(std::ostream& os)
 {
     os << " stats - Stats a SAM/BAM File" << std::endl;
@@ -40,8 +70,8 @@ void Stats::printDescription(std::ostream& os)
 void Stats::printUsage(std::ostream& os)
 {
     BamExecutable::printUsage(os);
-    os << "\t./bam stats --in <inputFile> [--basic] [--qual] [--phred] [--pBaseQC <outputFileName>] [--cBaseQC <outputFileName>] [--maxNumReads <maxNum>]"
-              << "[--unmapped] [--bamIndex <bamIndexFile>] [--regionList <regFileName>] [--requiredFlags <integerRequiredFlags>] [--excludeFlags <integerExcludeFlags>] [--noeof] [--params] [--withinRegion] [--baseSum] [--bufferSize <buffSize>] [--minMapQual <minMapQ>] [--dbsnp <dbsnpFile>]" << std::endl;
+    os << "\t./bam stats --in <inputFile> [--basic] [--qual] [--phred] [--pBaseQC <outputFileName>] [--cBaseQC <outputFileName>] [--bBaseQC <outputFileName>] [--depth <outputFileName>] [--sample <fraction>] [--maxNumReads <maxNum>]"
+              << "[--unmapped] [--bamIndex <bamIndexFile>] [--regionList <regFileName>] [--requiredFlags <integerRequiredFlags>] [--excludeFlags <integerExcludeFlags>] [--noeof] [--params] [--threads <numThreads>] [--withinRegion] [--baseSum] [--bufferSize <buffSize>] [--minMapQual <minMapQ>] [--dbsnp <dbsnpFile>] [--depthThresholds <list>] [--sampleWindow <windowSize>] [--seed <seed>]" << std::endl;
     os << "\tRequired Parameters:" << std::endl;
     os << "\t\t--in : the SAM/BAM file to calculate stats for" << std::endl;
     os << "\tTypes of Statistics that can be generated:" << std::endl;
@@ -49,39 +79,78 @@ void Stats::printUsage(std::ostream& os)
     os << "\t\t--qual          : Generate a count for each quality (displayed as non-phred quality)" << std::endl;
     os << "\t\t--phred         : Generate a count for each quality (displayed as phred quality)" << std::endl;
     os << "\t\t--pBaseQC       : Write per base statistics as Percentages to the specified file. (use - for stdout)" << std::endl;
-    os << "\t\t                  pBaseQC & cBaseQC cannot both be specified." << std::endl;
+    os << "\t\t                  Only one of pBaseQC, cBaseQC, & bBaseQC can be specified." << std::endl;
     os << "\t\t--cBaseQC       : Write per base statistics as Counts to the specified file. (use - for stdout)" << std::endl;
-    os << "\t\t                  pBaseQC & cBaseQC cannot both be specified." << std::endl;
+    os << "\t\t                  Only one of pBaseQC, cBaseQC, & bBaseQC can be specified." << std::endl;
+    os << "\t\t--bBaseQC       : Write per base statistics as Counts to the specified compressed binary" << std::endl;
+    os << "\t\t                  columnar file. (use - for stdout)  Use 'bam stats view' to convert it to" << std::endl;
+    os << "\t\t                  the cBaseQC or pBaseQC text.  Only one of pBaseQC, cBaseQC, & bBaseQC" << std::endl;
+    os << "\t\t                  can be specified." << std::endl;
+    os << "\t\t--depth         : Write the mean depth & breadth of coverage of each reference (or region)" << std::endl;
+    os << "\t\t                  followed by a depth histogram to the specified file. (use - for stdout)" << std::endl;
+    os << "\t\t                  Calculated from the aligned blocks of each read without a pileup, so" << std::endl;
+    os << "\t\t                  requires a coordinate sorted file." << std::endl;
+    os << "\t\t--sample        : Estimate the flag & base quality rates with 95% confidence intervals from" << std::endl;
+    os << "\t\t                  this fraction (0-1) of the windows, picked uniformly at random from the" << std::endl;
+    os << "\t\t                  windows the bamIndex has data for.  Only records starting in the windows are" << std::endl;
+    os << "\t\t                  read, unplaced unmapped records are not sampled.  --qual/--phred count the" << std::endl;
+    os << "\t\t                  sampled records.  Cannot be used with the other statistics or --regionList." << std::endl;
     os << "\tOptional Parameters:" << std::endl;
     os << "\t\t--maxNumReads   : Maximum number of reads to process" << std::endl;
     os << "\t\t                  Defaults to -1 to indicate all reads." << std::endl;
     os << "\t\t--unmapped      : Only process unmapped reads (requires a bamIndex file)" << std::endl;
     os << "\t\t--bamIndex      : The path/name of the bam index file" << std::endl;
     os << "\t\t                  (if required and not specified, uses the --in value + \".bai\")" << std::endl;
+    os << "\t\t                  With --threads, the baseQC statistics of each reference are generated" << std::endl;
+    os << "\t\t                  on their own thread (not with --basic, --unmapped, --regionList, or --maxNumReads)." << std::endl;
     os << "\t\t--regionList    : File containing the regions to be processed chr<tab>start_pos<tab>end_pos." << std::endl;
     os << "\t\t                  Positions are 0 based and the end_pos is not included in the region." << std::endl;
-    os << "\t\t                  Uses bamIndex." << std::endl;
+    os << "\t\t                  Uses bamIndex.  The regions are processed in sorted order, each" << std::endl;
+    os << "\t\t                  overlapping record is processed once per region it overlaps." << std::endl;
     os << "\t\t--excludeFlags  : Skip any records with any of the specified flags set\n";
     os << "\t\t                  (specify an integer representation of the flags)\n";
     os << "\t\t--requiredFlags : Only process records with all of the specified flags set\n";
     os << "\t\t                  (specify an integer representation of the flags)\n";
     os << "\t\t--noeof         : Do not expect an EOF block on a bam file." << std::endl;
     os << "\t\t--params        : Print the parameter settings." << std::endl;
+    os << "\t\t--threads       : number of threads for decompressing BAM input, or with 2 or more, for" << std::endl;
+    os << "\t\t                  generating the baseQC statistics by reference if the input has an index," << std::endl;
+    os << "\t\t                  --bamIndex or the --in value + \".bai\" (default 0)" << std::endl;
     os << "\tOptional phred/qual Only Parameters:" << std::endl;
     os << "\t\t--withinRegion  : Only count qualities if they fall within regions specified.\n";
     os << "\t\t                  Only applicable if regionList is also specified.\n";
     os << "\tOptional BaseQC Only Parameters:" << std::endl;
     os << "\t\t--baseSum       : Print an overall summary of the baseQC for the file to stderr." << std::endl;
-    os << "\t\t--bufferSize    : Size of the pileup buffer for calculating the BaseQC parameters." << std::endl;
+    os << "\t\t--bufferSize    : Initial size of the pileup buffer for calculating the BaseQC parameters," << std::endl;
+    os << "\t\t                  it grows to fit longer reads." << std::endl;
     os << "\t\t                  Default: " << PileupHelper::DEFAULT_WINDOW_SIZE << std::endl;
     os << "\t\t--minMapQual    : The minimum mapping quality for filtering reads in the baseQC stats." << std::endl;
     os << "\t\t--dbsnp         : The dbSnp file of positions to exclude from baseQC analysis." << std::endl;
+    os << "\tOptional Depth Only Parameters:" << std::endl;
+    os << "\t\t--depthThresholds : Comma separated depths to report the breadth of coverage for." << std::endl;
+    os << "\t\t                    Default: 1,10,20,30" << std::endl;
+    os << "\t\t--minMapQual also applies to the depth, which, like the baseQC depth, excludes" << std::endl;
+    os << "\t\tduplicates, QC failures, and a mapping quality of 255." << std::endl;
+    os << "\tOptional Sample Only Parameters:" << std::endl;
+    os << "\t\t--sampleWindow  : Size of the windows to sample.  Default: " << DEFAULT_SAMPLE_WINDOW << std::endl;
+    os << "\t\t--seed          : Seed for picking the windows to sample.  Default: 1" << std::endl;
+    os << std::endl;
+    os << "\t./bam stats view --in <bBaseQCFile> [--out <outputFileName>] [--percent]" << std::endl;
+    os << "\tConvert a --bBaseQC file to the --cBaseQC text." << std::endl;
+    os << "\t\t--in      : the --bBaseQC file to convert" << std::endl;
+    os << "\t\t--out     : the text file to write (default: - for stdout)" << std::endl;
+    os << "\t\t--percent : write the --pBaseQC text rather than the --cBaseQC text" << std::endl;
     os << std::endl;
 }
 
 
 int Stats::execute(int argc, char **argv)
 {
+    if((argc > 2) && (strcmp(argv[2], "view") == 0))
+    {
+        return(executeView(argc, argv));
+    }
+
     // Extract command line arguments.
     String inFile = "";
     String indexFile = "";
@@ -94,6 +163,12 @@ int Stats::execute(int argc, char **argv)
     bool unmapped = false;
     String pBaseQC = "";
     String cBaseQC = "";
+    String bBaseQC = "";
+    String depth = "";
+    String depthThresholds = "1,10,20,30";
+    double sample = 0;
+    int sampleWindow = DEFAULT_SAMPLE_WINDOW;
+    int seed = 1;
     String regionList = "";
     int excludeFlags = 0;
     int requiredFlags = 0;
@@ -114,6 +189,9 @@ int Stats::execute(int argc, char **argv)
         LONG_PARAMETER("phred", &phred)
         LONG_STRINGPARAMETER("pBaseQC", &pBaseQC)
         LONG_STRINGPARAMETER("cBaseQC", &cBaseQC)
+        LONG_STRINGPARAMETER("bBaseQC", &bBaseQC)
+        LONG_STRINGPARAMETER("depth", &depth)
+        LONG_DOUBLEPARAMETER("sample", &sample)
         LONG_PARAMETER_GROUP("Optional Parameters")
         LONG_INTPARAMETER("maxNumReads", &maxNumReads)
         LONG_PARAMETER("unmapped", &unmapped)
@@ -123,6 +201,7 @@ int Stats::execute(int argc, char **argv)
         LONG_INTPARAMETER("requiredFlags", &requiredFlags)
         LONG_PARAMETER("noeof", &noeof)
         LONG_PARAMETER("params", &params)
+        LONG_BAM_IO_PARAMETERS()
         LONG_PARAMETER_GROUP("Optional phred/qual Only Parameters")
         LONG_PARAMETER("withinRegion", &withinRegion)
         LONG_PARAMETER_GROUP("Optional BaseQC Only Parameters")
@@ -130,6 +209,11 @@ int Stats::execute(int argc, char **argv)
         LONG_INTPARAMETER("bufferSize", &bufferSize)
         LONG_INTPARAMETER("minMapQual", &minMapQual)
         LONG_STRINGPARAMETER("dbsnp", &dbsnp)
+        LONG_PARAMETER_GROUP("Optional Depth Only Parameters")
+        LONG_STRINGPARAMETER("depthThresholds", &depthThresholds)
+        LONG_PARAMETER_GROUP("Optional Sample Only Parameters")
+        LONG_INTPARAMETER("sampleWindow", &sampleWindow)
+        LONG_INTPARAMETER("seed", &seed)
         LONG_PHONEHOME(VERSION)
         END_LONG_PARAMETERS();
    
@@ -144,7 +228,7 @@ int Stats::execute(int argc, char **argv)
     if(noeof)
     {
         // Set that the eof block is not required.
-        BgzfFileType::setRequireEofBlock(false);
+        setRequireEofBlock(false);
     }
 
     // Check to see if the in file was specified, if not, report an error.
@@ -158,8 +242,32 @@ int Stats::execute(int argc, char **argv)
         return(-1);
     }
 
-    // Use the index file if unmapped or regionList is not empty.
-    bool useIndex = (unmapped|| (!regionList.IsEmpty()));
+    if(sample != 0)
+    {
+        if((sample < 0) || (sample > 1) || (sampleWindow < 1))
+        {
+            printUsage(std::cerr);
+            inputParameters.Status();
+            std::cerr << "--sample must be between 0 and 1 and --sampleWindow must be positive."
+                      << std::endl;
+            return(-1);
+        }
+        if(basic || !pBaseQC.IsEmpty() || !cBaseQC.IsEmpty() ||
+           !bBaseQC.IsEmpty() || baseSum ||
+           !depth.IsEmpty() || unmapped || !regionList.IsEmpty() ||
+           (maxNumReads >= 0))
+        {
+            printUsage(std::cerr);
+            inputParameters.Status();
+            std::cerr << "--sample cannot be used with --basic, --pBaseQC, --cBaseQC, --bBaseQC, --baseSum, "
+                      << "--depth, --unmapped, --regionList, or --maxNumReads."
+                      << std::endl;
+            return(-1);
+        }
+    }
+
+    // Use the index file if unmapped, sampling, or regionList is not empty.
+    bool useIndex = (unmapped || (sample != 0) || (!regionList.IsEmpty()));
 
     // IndexFile is required, so check to see if it has been set.
     if(useIndex && (indexFile == ""))
@@ -168,21 +276,18 @@ int Stats::execute(int argc, char **argv)
         // + ".bai"
         indexFile = inFile + ".bai";
     }
-    ////////////////////////////////////////
-    // Setup in case pileup is used.
-    Pileup<PileupElementBaseQCStats> pileup(bufferSize);
     // Initialize start/end positions.
     myStartPos = 0;
     myEndPos = -1;
     
     // Open the output qc file if applicable.
     IFILE baseQCPtr = NULL;
-    if(!pBaseQC.IsEmpty() && !cBaseQC.IsEmpty())
+    if((!pBaseQC.IsEmpty() + !cBaseQC.IsEmpty() + !bBaseQC.IsEmpty()) > 1)
     {
         printUsage(std::cerr);
         inputParameters.Status();
-        // Cannot specify both types of baseQC.
-        std::cerr << "Cannot specify both --pBaseQC & --cBaseQC." << std::endl;
+        // Cannot specify more than one type of baseQC.
+        std::cerr << "Cannot specify more than one of --pBaseQC, --cBaseQC, & --bBaseQC." << std::endl;
         return(-1);
     }
     else if(!pBaseQC.IsEmpty())
@@ -196,15 +301,35 @@ int Stats::execute(int argc, char **argv)
         PileupElementBaseQCStats::setPercentStats(false);
     }
 
+    ////////////////////////////////////////
+    // Setup in case pileup is used.
+    BaseQCAccumulator baseQC;
     if(baseQCPtr != NULL)
     {
-        PileupElementBaseQCStats::setOutputFile(baseQCPtr);
-        PileupElementBaseQCStats::printHeader();
+        baseQC.setOutputFile(baseQCPtr);
+        PileupElementBaseQCStats::printHeader(baseQCPtr);
     }
     if((baseQCPtr != NULL) || baseSum)
     {
         PileupElementBaseQCStats::setMapQualFilter(minMapQual);
-        PileupElementBaseQCStats::setBaseSum(baseSum);
+        baseQC.setBaseSum(baseSum);
+    }
+
+    std::vector<int> thresholds;
+    if(!CoverageCounter::parseThresholds(depthThresholds.c_str(), thresholds))
+    {
+        printUsage(std::cerr);
+        inputParameters.Status();
+        std::cerr << "Invalid --depthThresholds: " << depthThresholds
+                  << ", must be increasing positive integers separated by commas."
+                  << std::endl;
+        return(-1);
+    }
+
+    if(!processBamIoParameters())
+    {
+        inputParameters.Status();
+        return(-1);
     }
 
     if(params)
@@ -213,7 +338,7 @@ int Stats::execute(int argc, char **argv)
     }
 
     // Open the file for reading.
-    SamFile samIn;
+    SamInputFile samIn;
     if(!samIn.OpenForRead(inFile))
     {
         fprintf(stderr, "%s\n", samIn.GetStatusMessage());
@@ -233,6 +358,34 @@ int Stats::execute(int argc, char **argv)
         return(samIn.GetStatus());
     }
 
+    // Open the binary baseQC file & write its header.
+    BaseQCColumnWriter columnWriter;
+    if(!bBaseQC.IsEmpty())
+    {
+        if(!columnWriter.open(bBaseQC.c_str(), samHeader))
+        {
+            std::cerr << "Failed to open the baseQC file: " << bBaseQC
+                      << std::endl;
+            return(-1);
+        }
+        baseQC.setColumnWriter(&columnWriter);
+        PileupElementBaseQCStats::setMapQualFilter(minMapQual);
+    }
+
+    // Open the depth file & write its header.
+    IFILE depthPtr = NULL;
+    if(!depth.IsEmpty())
+    {
+        depthPtr = ifopen(depth, "w");
+        if(depthPtr == NULL)
+        {
+            std::cerr << "Failed to open the depth file: " << depth
+                      << std::endl;
+            return(-1);
+        }
+        myCoverage.init(samHeader, depthPtr, thresholds, minMapQual);
+    }
+
     // Open the bam index file for reading if we are
     // doing unmapped reads (also set the read section).
     if(useIndex)
@@ -244,9 +397,24 @@ int Stats::execute(int argc, char **argv)
             samIn.SetReadSection(-1);
         }
 
+        if(sample != 0)
+        {
+            if(!mySampler.init(indexFile, samHeader, sampleWindow))
+            {
+                std::cerr << "Failed to read the bam index: " << indexFile
+                          << std::endl;
+                return(-1);
+            }
+            mySampler.sample(sample, seed);
+        }
+
         if(!regionList.IsEmpty())
         {
             myRegionList = ifopen(regionList, "r");
+            if(myRegionList != NULL)
+            {
+                readRegionList(samHeader, indexFile);
+            }
         }
     }
 
@@ -322,167 +490,148 @@ int Stats::execute(int argc, char **argv)
         ifclose(fdbSnp);
     }
 
-    // Read the sam records.
-    SamRecord samRecord;
+    // Settings for processing each record.
+    myQual = qual;
+    myPhred = phred;
+    myWithinRegion = withinRegion;
+    myPileup = (baseQCPtr != NULL) || !bBaseQC.IsEmpty() || baseSum;
+    myDepth = (depthPtr != NULL);
+    myBufferSize = bufferSize;
+    myRequiredFlags = requiredFlags;
+    myExcludeFlags = excludeFlags;
+    myDbsnpList = dbsnpListPtr;
+    // Exclude clips from the qual/phred counts if unmapped reads are excluded.
+    myQualExcludeClips = excludeFlags & SamFlag::UNMAPPED;
 
-    int numReads = 0;
+    uint32_t numRecords = 0;
+    int status = SamStatus::SUCCESS;
+    int32_t numRefs = samHeader.getReferenceInfo().getNumEntries();
 
-    //////////////////////
-    // Setup in case doing a quality count.
-    // Quality histogram.
-    const int MAX_QUAL = 126;
-    const int START_QUAL = 33;
-    uint64_t qualCount[MAX_QUAL+1];
-    for(int i = 0; i <= MAX_QUAL; i++)
+    // With an index, the pileup of each reference can be generated on its
+    // own thread.  The basic statistics, depth, binary baseQC, regions &
+    // read limit need the records to be read in order.
+    bool partition =
+        (myPileup && !myDepth && bBaseQC.IsEmpty() && !useIndex && !basic &&
+         (maxNumReads < 0) && (myNumThreads >= 2) && (inFile != "-") &&
+         (numRefs > 0));
+    if(partition && indexFile.IsEmpty())
     {
-        qualCount[i] = 0;
+        // Without --bamIndex, use the input's index if it has one.
+        indexFile = inFile + ".bai";
+        SamInputFile indexedIn(ErrorHandler::RETURN);
+        partition = (indexedIn.OpenForRead(inFile) &&
+                     indexedIn.ReadBamIndex(indexFile));
+        if(!partition)
+        {
+            indexFile = "";
+        }
     }
-    
-    const int START_PHRED = 0;
-    const int PHRED_DIFF = START_QUAL - START_PHRED;
-    const int MAX_PHRED = MAX_QUAL - PHRED_DIFF;
-    uint64_t phredCount[MAX_PHRED+1];
-    for(int i = 0; i <= MAX_PHRED; i++)
+    if(partition)
     {
-        phredCount[i] = 0;
+        samIn.Close();
+        std::string tmpBase = "bamStats";
+        String& baseQCName = pBaseQC.IsEmpty() ? cBaseQC : pBaseQC;
+        if(!baseQCName.IsEmpty() && (baseQCName != "-"))
+        {
+            tmpBase = baseQCName.c_str();
+        }
+        status = processPartitions(inFile, indexFile, tmpBase, numRefs,
+                                   baseQC, numRecords);
     }
-    
-    int refPos = 0;
-    Cigar* cigarPtr = NULL;
-    char cigarChar = '?';
-    // Exclude clips from the qual/phred counts if unmapped reads are excluded.
-    bool qualExcludeClips = excludeFlags & SamFlag::UNMAPPED;
-
-    //////////////////////////////////
-    // When not reading by sections, getNextSection returns true
-    // the first time, then false the next time.
-    while(getNextSection(samIn))
+    else
     {
-        // Keep reading records from the file until SamFile::ReadRecord
-        // indicates to stop (returns false).
-        while(((maxNumReads < 0) || (numReads < maxNumReads)) && samIn.ReadRecord(samHeader, samRecord))
+        BaseQCPileup pileup(bufferSize, &baseQC);
+
+        // Read the sam records.
+        SamRecord samRecord;
+
+        int numReads = 0;
+        bool sorted = true;
+
+        if(sample != 0)
+        {
+            numRecords = processSample(samIn, samHeader);
+        }
+        else if(myRegionList == NULL)
         {
-            // Another record was read, so increment the number of reads.
-            ++numReads;
-            // See if the quality histogram should be genereated.
-            if(qual || phred)
+            // Keep reading records from the file until SamFile::ReadRecord
+            // indicates to stop (returns false).
+            while(((maxNumReads < 0) || (numReads < maxNumReads)) && samIn.ReadRecord(samHeader, samRecord))
             {
-                // Get the quality.
-                const char* qual = samRecord.getQuality();
-                // Check for no quality ('*').
-                if((qual[0] == '*') && (qual[1] == 0))
+                // Another record was read, so increment the number of reads.
+                ++numReads;
+                // See if the quality histogram should be genereated.
+                if(qual || phred)
                 {
-                    // This record does not have a quality string, so no 
-                    // quality processing is necessary.
+                    countQualities(samRecord);
                 }
-                else
-                {
-                    int index = 0;
-                    cigarPtr = samRecord.getCigarInfo();
-                    cigarChar = '?';
-                    refPos = samRecord.get0BasedPosition();
-                    if(!qualExcludeClips && (cigarPtr != NULL))
-                    {
-                        // Offset the reference position by any soft clips
-                        // by subtracting the queryIndex of this start position.
-                        // refPos is now the start position of the clips.
-                        refPos -= cigarPtr->getQueryIndex(0);
-                    }
 
-                    while(qual[index] != 0)
-                    {
-                        // Skip this quality if it is clipped and we are skipping clips.
-                        if(cigarPtr != NULL)
-                        {
-                            cigarChar = cigarPtr->getCigarCharOpFromQueryIndex(index);
-                        }
-                        if(qualExcludeClips && Cigar::isClip(cigarChar))
-                        {
-                            // Skip a clipped quality.
-                            ++index;
-                            // Increment the position.
-                            continue;
-                        }
-
-                        if(withinRegion && (myEndPos != -1) && (refPos >= myEndPos))
-                        {
-                            // We have hit the end of the region, stop processing this
-                            // quality string.
-                            break;
-                        }
-
-                        if(withinRegion && (refPos < myStartPos))
-                        {
-                            // This position is not in the target.
-                            ++index;
-                            // Update the position if this is found in the reference or a clip.
-                            if(Cigar::foundInReference(cigarChar) || Cigar::isClip(cigarChar))
-                            {
-                                ++refPos;
-                            }
-                            continue;
-                        }
+                // Check the next thing to do for the read.
+                if(myPileup)
+                {
+                    // Pileup the bases for this read.
+                    pileup.processAlignmentRegion(samRecord, myStartPos, myEndPos, dbsnpListPtr);
+                }
 
-                        // Check for valid quality.
-                        if((qual[index] < START_QUAL) || (qual[index] > MAX_QUAL))
-                        {
-                            if(qual)
-                            {
-                                std::cerr << "Invalid Quality found: " << qual[index] 
-                                          << ".  Must be between "
-                                          << START_QUAL << " and " << MAX_QUAL << ".\n";
-                            }
-                            if(phred)
-                            {
-                                std::cerr << "Invalid Phred Quality found: " << qual[index] - PHRED_DIFF
-                                          << ".  Must be between "
-                                          << START_QUAL << " and " << MAX_QUAL << ".\n";
-                            }
-                            // Skip an invalid quality.
-                            ++index;
-                            // Update the position if this is found in the reference or a clip.
-                            if(Cigar::foundInReference(cigarChar) || Cigar::isClip(cigarChar))
-                            {
-                                ++refPos;
-                            }
-                            continue;
-                        }
-                        
-                        // Increment the count for this quality.
-                        ++(qualCount[(int)(qual[index])]);
-                        ++(phredCount[(int)(qual[index]) - PHRED_DIFF]);
-                        // Update the position if this is found in the reference or a clip.
-                        if(Cigar::foundInReference(cigarChar) || Cigar::isClip(cigarChar))
-                        {
-                            ++refPos;
-                        }
-                        ++index;
-                    }
+                if(myDepth && !myCoverage.addReferenceRecord(samRecord))
+                {
+                    std::cerr << "ERROR: --depth requires a coordinate sorted file, "
+                              << samRecord.getReadName() << " is out of order."
+                              << std::endl;
+                    sorted = false;
+                    break;
                 }
             }
 
-            // Check the next thing to do for the read.
-            if((baseQCPtr != NULL) || baseSum)
+            // Done reading, so flush the pileup.
+            pileup.flushPileup();
+            if(myDepth)
             {
-                // Pileup the bases for this read.
-                pileup.processAlignmentRegion(samRecord, myStartPos, myEndPos, dbsnpListPtr);
+                myCoverage.endReferences();
             }
+            numRecords = samIn.GetCurrentRecordCount();
+        }
+        else
+        {
+            numRecords = processRegions(samIn, samHeader, maxNumReads, baseQC);
         }
 
-        // Done with a section, move on to the next one.
-
-        // New section, so flush the pileup.
-        pileup.flushPileup();
+        status = samIn.GetStatus();
+        if(status == SamStatus::NO_MORE_RECS)
+        {
+            // A status of NO_MORE_RECS means that all reads were successful.
+            status = SamStatus::SUCCESS;
+        }
+        if(!sorted)
+        {
+            status = SamStatus::FAIL_ORDER;
+        }
     }
 
-    if((baseQCPtr != NULL) || baseSum)
+    if(myPileup)
     {
-        PileupElementBaseQCStats::printSummary();
+        baseQC.printSummary();
         ifclose(baseQCPtr);
+        if(!bBaseQC.IsEmpty() && !columnWriter.close())
+        {
+            std::cerr << "Failed to write the baseQC file: " << bBaseQC
+                      << std::endl;
+            status = SamStatus::FAIL_IO;
+        }
     }
 
-    std::cerr << "Number of records read = " << 
-        samIn.GetCurrentRecordCount() << std::endl;
+    if(myDepth)
+    {
+        myCoverage.printHistogram();
+        ifclose(depthPtr);
+    }
+
+    std::cerr << "Number of records read = " << numRecords << std::endl;
+
+    if(sample != 0)
+    {
+        printSampleEstimates();
+    }
 
     if(basic)
     {
@@ -497,7 +646,7 @@ int Stats::execute(int argc, char **argv)
         std::cerr << "Quality\tCount\n";
         for(int i = START_QUAL; i <= MAX_QUAL; i++)
         {
-            std::cerr << i << "\t" << qualCount[i] << std::endl;
+            std::cerr << i << "\t" << myQualityHist.getCount(i) << std::endl;
         }
     }
     // Print the phred quality stats.
@@ -507,106 +656,878 @@ int Stats::execute(int argc, char **argv)
         std::cerr << "Phred\tCount\n";
         for(int i = START_PHRED; i <= MAX_PHRED; i++)
         {
-            std::cerr << i << "\t" << phredCount[i] << std::endl;
+            std::cerr << i << "\t" << myQualityHist.getCount(i + PHRED_DIFF)
+                      << std::endl;
         }
     }
 
-    SamStatus::Status status = samIn.GetStatus();
-    if(status == SamStatus::NO_MORE_RECS)
+    return(status);
+}
+
+
+void Stats::countQualities(SamRecord& samRecord)
+{
+    // Get the quality.
+    const char* qual = samRecord.getQuality();
+    // Check for no quality ('*').
+    if((qual[0] == '*') && (qual[1] == 0))
     {
-        // A status of NO_MORE_RECS means that all reads were successful.
-        status = SamStatus::SUCCESS;
+        // This record does not have a quality string, so no 
+        // quality processing is necessary.
+        return;
     }
+    int qualLen = strlen(qual);
 
-    return(status);
+    Cigar* cigarPtr = samRecord.getCigarInfo();
+    if(!myWithinRegion && (!myQualExcludeClips || (cigarPtr == NULL)))
+    {
+        // Every quality is counted, so count them as a single span.
+        countQualitySpan(qual, qualLen);
+        return;
+    }
+
+    int refPos = samRecord.get0BasedPosition();
+    if(!myQualExcludeClips && (cigarPtr != NULL))
+    {
+        // Offset the reference position by any soft clips
+        // by subtracting the queryIndex of this start position.
+        // refPos is now the start position of the clips.
+        refPos -= cigarPtr->getQueryIndex(0);
+    }
+
+    // Walk the cigar once, handling the qualities of each operation as a
+    // single span.  Qualities past the end of the cigar (all of them if
+    // there is no cigar) do not advance the reference position.
+    int numOps = 0;
+    if(cigarPtr != NULL)
+    {
+        numOps = cigarPtr->size();
+    }
+    int index = 0;
+    for(int op = 0; (op <= numOps) && (index < qualLen); op++)
+    {
+        int spanLen = qualLen - index;
+        bool advances = false;
+        if(op < numOps)
+        {
+            const Cigar::CigarOperator& cigarOp = (*cigarPtr)[op];
+            if(!Cigar::foundInQuery(cigarOp.operation))
+            {
+                // No qualities for this operation.
+                continue;
+            }
+            spanLen = std::min((int)cigarOp.count, spanLen);
+            if(myQualExcludeClips && Cigar::isClip(cigarOp.operation))
+            {
+                // Skip the clipped qualities.
+                index += spanLen;
+                continue;
+            }
+            // Update the position if this is found in the reference or
+            // a clip.
+            advances = Cigar::foundInReference(cigarOp.operation) ||
+                Cigar::isClip(cigarOp.operation);
+        }
+
+        // Determine the part of the span that is within the region.
+        int start = 0;
+        int end = spanLen;
+        bool stop = false;
+        if(myWithinRegion)
+        {
+            if(advances)
+            {
+                start = std::max(0, std::min(myStartPos - refPos, spanLen));
+                if((myEndPos != -1) && (myEndPos - refPos < spanLen))
+                {
+                    // The end of the region is hit within this span.
+                    end = std::max(myEndPos - refPos, 0);
+                    stop = true;
+                }
+            }
+            else if((myEndPos != -1) && (refPos >= myEndPos))
+            {
+                end = 0;
+                stop = true;
+            }
+            else if(refPos < myStartPos)
+            {
+                start = spanLen;
+            }
+            if(start > end)
+            {
+                start = end;
+            }
+        }
+
+        countQualitySpan(qual + index + start, end - start);
+        if(stop)
+        {
+            // We have hit the end of the region, stop processing this
+            // quality string.
+            break;
+        }
+        index += spanLen;
+        if(advances)
+        {
+            refPos += spanLen;
+        }
+    }
 }
 
 
-bool Stats::getNextSection(SamFile &samIn)
+void Stats::countQualitySpan(const char* qual, int length)
 {
-    static bool alreadyRead = false;
-    if(myRegionList == NULL)
+    if(myQualityHist.countSpan(qual, length))
     {
-        // no region list is set, so just read once.
-        if(alreadyRead)
+        return;
+    }
+
+    // There is an invalid quality in the span, so count the valid ones
+    // individually.
+    for(int index = 0; index < length; index++)
+    {
+        // Check for valid quality.
+        if((qual[index] < START_QUAL) || (qual[index] > MAX_QUAL))
         {
-            // No regions and it has already been read, so
-            // return false, no more to read.
-            return(false);
+            if(qual)
+            {
+                std::cerr << "Invalid Quality found: " << qual[index] 
+                          << ".  Must be between "
+                          << START_QUAL << " and " << MAX_QUAL << ".\n";
+            }
+            if(myPhred)
+            {
+                std::cerr << "Invalid Phred Quality found: " << qual[index] - PHRED_DIFF
+                          << ".  Must be between "
+                          << START_QUAL << " and " << MAX_QUAL << ".\n";
+            }
+            // Skip an invalid quality.
+            continue;
         }
-        // Return true that there is more to read, but
-        // set the flag that it has already been read
-        // so the next call will return false.
-        alreadyRead = true;
-        return(true);
+        // Increment the count for this quality.
+        myQualityHist.count(qual[index]);
     }
-    else
+}
+
+
+int Stats::executeView(int argc, char **argv)
+{
+    String inFile = "";
+    String outFile = "-";
+    bool percent = false;
+    bool params = false;
+
+    ParameterList inputParameters;
+    BEGIN_LONG_PARAMETERS(longParameterList)
+        LONG_PARAMETER_GROUP("Required Parameters")
+        LONG_STRINGPARAMETER("in", &inFile)
+        LONG_PARAMETER_GROUP("Optional Parameters")
+        LONG_STRINGPARAMETER("out", &outFile)
+        LONG_PARAMETER("percent", &percent)
+        LONG_PARAMETER("params", &params)
+        LONG_PHONEHOME(VERSION)
+        END_LONG_PARAMETERS();
+
+    inputParameters.Add(new LongParameters ("Input Parameters",
+                                            longParameterList));
+
+    // parameters start at index 3 (after "stats view").
+    inputParameters.Read(argc, argv, 3);
+
+    if(inFile == "")
     {
-        // There is a region list, so read process that.
-        // Track whether or not a section has been found.
-        bool sectionFound = false;
-        myStartPos = 0;
-        myEndPos = 0;
+        printUsage(std::cerr);
+        inputParameters.Status();
+        std::cerr << "--in is a mandatory argument for stats view, "
+                  << "but was not specified" << std::endl;
+        return(-1);
+    }
 
-        // Loop until the end of the file or the end of the file or 
-        // a section is found.
-        while(!sectionFound && !ifeof(myRegionList))
+    if(params)
+    {
+        inputParameters.Status();
+    }
+
+    BaseQCColumnReader reader;
+    if(!reader.open(inFile.c_str()))
+    {
+        std::cerr << "Failed to read the baseQC file: " << inFile
+                  << std::endl;
+        return(-1);
+    }
+    IFILE outputPtr = ifopen(outFile, "w");
+    if(outputPtr == NULL)
+    {
+        std::cerr << "Failed to open the output file: " << outFile
+                  << std::endl;
+        return(-1);
+    }
+
+    PileupElementBaseQCStats::setPercentStats(percent);
+    PileupElementBaseQCStats::printHeader(outputPtr);
+    String line;
+    uint64_t values[BaseQCColumns::NUM_COLUMNS];
+    while(reader.readBlock())
+    {
+        for(unsigned int i = 0; i < reader.getNumPositions(); i++)
+        {
+            reader.getValues(i, values);
+            PileupElementBaseQCStats::formatColumns(line,
+                                                    reader.getChromosome(),
+                                                    values);
+            ifwrite(outputPtr, line.c_str(), line.Length());
+        }
+    }
+    ifclose(outputPtr);
+    reader.close();
+
+    if(reader.hasFailed())
+    {
+        std::cerr << "Invalid baseQC file: " << inFile << std::endl;
+        return(SamStatus::FAIL_PARSE);
+    }
+    return(SamStatus::SUCCESS);
+}
+
+
+void Stats::readRegionList(SamFileHeader& header, const char* indexFile)
+{
+    int startPos = 0;
+    int endPos = 0;
+    myRegions.clear();
+    while(!ifeof(myRegionList))
+    {
+        myRegBuffer.Clear();
+        myRegBuffer.ReadLine(myRegionList);
+        if(myRegBuffer.IsEmpty())
+        {
+            // Nothing read, so continue to the next line.
+            continue;
+        }
+        
+        // A line was read, so parse it.
+        myRegColumn.ReplaceColumns(myRegBuffer, '\t');
+        if(myRegColumn.Length() < 3)
         {
-            myRegBuffer.Clear();
-            myRegBuffer.ReadLine(myRegionList);
-            if(myRegBuffer.IsEmpty())
+            // Incorrectly formatted line.
+            std::cerr << "Improperly formatted reg line: "
+                      << myRegBuffer
+                      << "; Skipping to the next line.\n";
+            continue;
+        }
+            
+        // Check the columns.
+        if(!myRegColumn[1].AsInteger(startPos))
+        {
+            // The start position (2nd column) is not an integer.
+            std::cerr << "Improperly formatted region line, start position "
+                      << "(2nd column) is not an integer: "
+                      << myRegColumn[1]
+                      << "; Skipping to the next line.\n";         
+        }
+        else if(!myRegColumn[2].AsInteger(endPos))
+        {
+            // The end position (3rd column) is not an integer.
+            std::cerr << "Improperly formatted region line, end position "
+                      << "(3rd column) is not an integer: "
+                      << myRegColumn[2]
+                      << "; Skipping to the next line.\n";         
+        }
+        else if((startPos >= endPos) && (endPos != -1))
+        {
+            // The start position is >= the end position
+            std::cerr << "Improperly formatted region line, the start position "
+                      << "is >= end position: "
+                      << myRegColumn[1]
+                      << " >= "
+                      << myRegColumn[2]
+                      << "; Skipping to the next line.\n";         
+        }
+        else
+        {
+            // Regions on references that are not in the file have no
+            // records.
+            int refID = header.getReferenceID(myRegColumn[0]);
+            if(refID != SamReferenceInfo::NO_REF_ID)
+            {
+                myRegions.addRegion(refID, startPos, endPos);
+            }
+        }
+    }
+    myRegions.plan(indexFile);
+}
+
+
+// The pileup of a region, analyzing into its own accumulator so its
+// positions can be held while an earlier region is still being piled up.
+struct Stats::RegionPileup
+{
+    RegionPileup(int bufferSize)
+        : accumulator(), pileup(bufferSize, &accumulator) {}
+
+    BaseQCAccumulator accumulator;
+    BaseQCPileup pileup;
+};
+
+
+uint32_t Stats::processRegions(SamInputFile& samIn, SamFileHeader& header,
+                               int maxNumReads, BaseQCAccumulator& baseQC)
+{
+    // Each region is piled up separately, so overlapping regions each
+    // report their positions.  A region's pileup is flushed once the
+    // records are past its end, & is then reused for a later region.
+    // The regions are output in order: a region's positions are held
+    // while an earlier region is still being piled up.
+    std::map<int, RegionPileup*> activePileups;
+    std::map<int, RegionPileup*> flushedPileups;
+    std::vector<RegionPileup*> freePileups;
+    std::map<int, RegionPileup*>::iterator iter;
+    // The first region whose positions have not all been output.
+    int nextOutput = 0;
+    int groupFirst = 0;
+    int groupLast = 0;
+
+    SamRecord samRecord;
+    std::vector<int> regions;
+    // Count each record once per region it is processed for.
+    uint32_t numReads = 0;
+    int32_t refID = 0;
+    int32_t start = 0;
+    int32_t end = 0;
+    while(((maxNumReads < 0) || (numReads < (uint32_t)maxNumReads)) &&
+          myRegions.nextGroup(refID, start, end))
+    {
+        samIn.SetReadSection(refID, start, end);
+        myRegions.getGroupRegions(groupFirst, groupLast);
+        nextOutput = groupFirst;
+        bool groupDepth = myDepth && (refID >= 0);
+        if(groupDepth)
+        {
+            myCoverage.startSection(refID, start, end);
+            for(int i = groupFirst; i < groupLast; i++)
+            {
+                const RegionPlanner::Region& region = myRegions.getRegion(i);
+                myCoverage.addTarget(region.start, region.end);
+            }
+        }
+        while(((maxNumReads < 0) || (numReads < (uint32_t)maxNumReads)) &&
+              samIn.ReadRecord(header, samRecord))
+        {
+            // Flush the regions that end before this record.
+            int32_t position = samRecord.get0BasedPosition();
+            iter = activePileups.begin();
+            while(iter != activePileups.end())
+            {
+                if(myRegions.isFinished(iter->first, position))
+                {
+                    iter->second->pileup.flushPileup();
+                    flushedPileups[iter->first] = iter->second;
+                    activePileups.erase(iter++);
+                }
+                else
+                {
+                    ++iter;
+                }
+            }
+            nextOutput = outputRegions(nextOutput, groupLast, position, false,
+                                       activePileups, flushedPileups,
+                                       freePileups);
+
+            if(groupDepth)
+            {
+                // The records of an indexed section are sorted.
+                myCoverage.addRecord(samRecord);
+            }
+
+            myRegions.findRegions(samRecord, false, regions);
+            for(size_t i = 0; (i < regions.size()) &&
+                    ((maxNumReads < 0) || (numReads < (uint32_t)maxNumReads));
+                i++)
             {
-                // Nothing read, so continue to the next line.
+                ++numReads;
+                const RegionPlanner::Region& region =
+                    myRegions.getRegion(regions[i]);
+                myStartPos = region.start;
+                myEndPos = region.end;
+                if(myQual || myPhred)
+                {
+                    countQualities(samRecord);
+                }
+                if(myPileup)
+                {
+                    RegionPileup*& regionPileup = activePileups[regions[i]];
+                    if(regionPileup == NULL)
+                    {
+                        if(freePileups.empty())
+                        {
+                            regionPileup = new RegionPileup(myBufferSize);
+                        }
+                        else
+                        {
+                            regionPileup = freePileups.back();
+                            freePileups.pop_back();
+                        }
+                        // Hold the positions until the earlier regions
+                        // are output.
+                        regionPileup->accumulator.setForward(
+                            &baseQC, regions[i] != nextOutput);
+                    }
+                    regionPileup->pileup.processAlignmentRegion(samRecord,
+                                                                myStartPos,
+                                                                myEndPos,
+                                                                myDbsnpList);
+                }
+            }
+        }
+
+        if(groupDepth)
+        {
+            myCoverage.endSection();
+        }
+
+        // Done with a group, so flush the rest of its regions.
+        for(iter = activePileups.begin(); iter != activePileups.end(); ++iter)
+        {
+            iter->second->pileup.flushPileup();
+            flushedPileups[iter->first] = iter->second;
+        }
+        activePileups.clear();
+        outputRegions(nextOutput, groupLast, 0, true, activePileups,
+                      flushedPileups, freePileups);
+    }
+
+    for(size_t i = 0; i < freePileups.size(); i++)
+    {
+        delete freePileups[i];
+    }
+    return(numReads);
+}
+
+
+int Stats::outputRegions(int nextOutput, int groupLast, int32_t position,
+                         bool groupDone,
+                         std::map<int, RegionPileup*>& activePileups,
+                         std::map<int, RegionPileup*>& flushedPileups,
+                         std::vector<RegionPileup*>& freePileups)
+{
+    while(nextOutput < groupLast)
+    {
+        std::map<int, RegionPileup*>::iterator iter =
+            flushedPileups.find(nextOutput);
+        if(iter != flushedPileups.end())
+        {
+            // Done with this region, so output any positions it held.
+            iter->second->accumulator.release();
+            freePileups.push_back(iter->second);
+            flushedPileups.erase(iter);
+        }
+        else
+        {
+            iter = activePileups.find(nextOutput);
+            if(iter != activePileups.end())
+            {
+                // Still being piled up, so output its positions as they
+                // are analyzed.
+                iter->second->accumulator.release();
+                break;
+            }
+            if(!groupDone && !myRegions.isFinished(nextOutput, position))
+            {
+                // A later record may still be in this region.
+                break;
+            }
+            // No records in this region.
+        }
+        ++nextOutput;
+    }
+    return(nextOutput);
+}
+
+
+uint32_t Stats::processSample(SamInputFile& samIn, SamFileHeader& header)
+{
+    int numSampled = mySampler.getNumSampled();
+    for(int i = 0; i < NUM_SAMPLE_STATS; i++)
+    {
+        mySampleCounts[i].assign(numSampled, 0);
+    }
+
+    SamRecord samRecord;
+    uint32_t numRecords = 0;
+    for(int i = 0; i < numSampled; i++)
+    {
+        const IndexSampler::Window& window = mySampler.getSampled(i);
+        samIn.SetReadSection(window.refID, window.start, window.end);
+        QualityHistogram windowQuals;
+        while(samIn.ReadRecord(header, samRecord))
+        {
+            if(samRecord.get0BasedPosition() < window.start)
+            {
+                // Starts in the previous window, so only sample it there.
                 continue;
             }
-        
-            // A line was read, so parse it.
-            myRegColumn.ReplaceColumns(myRegBuffer, '\t');
-            if(myRegColumn.Length() < 3)
+            ++numRecords;
+            if(myQual || myPhred)
+            {
+                countQualities(samRecord);
+            }
+
+            uint16_t flag = samRecord.getFlag();
+            ++mySampleCounts[SAMPLE_RECORDS][i];
+            mySampleCounts[SAMPLE_MAPPED][i] += SamFlag::isMapped(flag);
+            mySampleCounts[SAMPLE_PAIRED][i] += SamFlag::isPaired(flag);
+            mySampleCounts[SAMPLE_PROPER_PAIR][i] += SamFlag::isProperPair(flag);
+            mySampleCounts[SAMPLE_DUPLICATE][i] += SamFlag::isDuplicate(flag);
+            mySampleCounts[SAMPLE_QC_FAILURE][i] += SamFlag::isQCFailure(flag);
+            mySampleCounts[SAMPLE_SECONDARY][i] += SamFlag::isSecondary(flag);
+            mySampleCounts[SAMPLE_SUPPLEMENTARY][i] +=
+                ((flag & SamFlag::SUPPLEMENTARY_ALIGNMENT) != 0);
+
+            const char* qual = samRecord.getQuality();
+            if((qual[0] == '*') && (qual[1] == 0))
             {
-                // Incorrectly formatted line.
-                std::cerr << "Improperly formatted reg line: "
-                          << myRegBuffer
-                          << "; Skipping to the next line.\n";
                 continue;
             }
-            
-            // Check the columns.
-            if(!myRegColumn[1].AsInteger(myStartPos))
+            int qualLen = strlen(qual);
+            if(!windowQuals.countSpan(qual, qualLen))
+            {
+                // Only count the valid qualities.
+                for(int j = 0; j < qualLen; j++)
+                {
+                    if((qual[j] >= START_QUAL) && (qual[j] <= MAX_QUAL))
+                    {
+                        windowQuals.count(qual[j]);
+                    }
+                }
+            }
+        }
+
+        for(int q = START_QUAL; q <= MAX_QUAL; q++)
+        {
+            double count = windowQuals.getCount(q);
+            mySampleCounts[SAMPLE_BASES][i] += count;
+            mySampleCounts[SAMPLE_PHRED_SUM][i] += count * (q - PHRED_DIFF);
+            if(q - PHRED_DIFF >= 20)
+            {
+                mySampleCounts[SAMPLE_Q20][i] += count;
+            }
+        }
+    }
+    return(numRecords);
+}
+
+
+void Stats::printSampleEstimates()
+{
+    static const char* recordStatNames[] =
+        {"", "Mapped(%)", "Paired(%)", "ProperPaired(%)", "Duplicate(%)",
+         "QCFailure(%)", "Secondary(%)", "Supplementary(%)"};
+
+    fprintf(stderr, "\nSampled %d of %d windows (%.3f%% of the data)\n",
+            mySampler.getNumSampled(), mySampler.getNumWindows(),
+            100 * mySampler.getSampledFraction());
+    fprintf(stderr, "Statistic\tEstimate\tLower95\tUpper95\n");
+    for(int i = SAMPLE_MAPPED; i <= SAMPLE_SUPPLEMENTARY; i++)
+    {
+        printSampleEstimate(recordStatNames[i], mySampleCounts[i],
+                            mySampleCounts[SAMPLE_RECORDS], 100);
+    }
+    printSampleEstimate("MeanPhred", mySampleCounts[SAMPLE_PHRED_SUM],
+                        mySampleCounts[SAMPLE_BASES], 1);
+    printSampleEstimate("Q20Bases(%)", mySampleCounts[SAMPLE_Q20],
+                        mySampleCounts[SAMPLE_BASES], 100);
+}
+
+
+void Stats::printSampleEstimate(const char* name,
+                                const std::vector<double>& numerators,
+                                const std::vector<double>& denominators,
+                                double scale)
+{
+    double estimate = 0;
+    double halfWidth = 0;
+    if(!mySampler.estimateRatio(numerators, denominators,
+                                estimate, halfWidth))
+    {
+        fprintf(stderr, "%s\tNA\tNA\tNA\n", name);
+    }
+    else if(halfWidth < 0)
+    {
+        fprintf(stderr, "%s\t%.3f\tNA\tNA\n", name, scale * estimate);
+    }
+    else
+    {
+        fprintf(stderr, "%s\t%.3f\t%.3f\t%.3f\n", name, scale * estimate,
+                scale * (estimate - halfWidth),
+                scale * (estimate + halfWidth));
+    }
+}
+
+
+int Stats::processPartitions(const String& inFile, const String& indexFile,
+                             const std::string& tmpBase, int32_t numRefs,
+                             BaseQCAccumulator& baseQC, uint32_t& numRecords)
+{
+    // A partition per reference & one for the unmapped reads.  The pileup
+    // is flushed at the end of each reference, so processing them
+    // separately gives the same per base statistics.
+    IFILE output = baseQC.getOutputFile();
+    PartitionList list;
+    list.next = 0;
+    list.copied = 0;
+    list.stop = false;
+    for(int32_t i = 0; i <= numRefs; i++)
+    {
+        Partition partition;
+        partition.refID = (i < numRefs) ? i : -1;
+        if(output != NULL)
+        {
+            std::stringstream partName;
+            partName << tmpBase << ".part" << i + 1 << ".baseQC";
+            partition.baseQCName = partName.str();
+        }
+        partition.baseQC.setBaseSum(baseQC.getBaseSum());
+        partition.numRecords = 0;
+        partition.done = false;
+        partition.status = 0;
+        list.partitions.push_back(partition);
+    }
+
+    int numWorkers = std::min(myNumThreads, (int)list.partitions.size());
+    list.maxAhead = numWorkers;
+    std::vector<Stats*> workers;
+    std::vector<std::thread> threads;
+    for(int i = 0; i < numWorkers; i++)
+    {
+        workers.push_back(new Stats());
+        workers.back()->initPartitionWorker(*this);
+        threads.push_back(std::thread(&Stats::statPartitions,
+                                      workers.back(), std::ref(list),
+                                      std::string(inFile.c_str()),
+                                      std::string(indexFile.c_str())));
+    }
+
+    // Copy each partition to the output & merge its summary in reference
+    // order once it is done.
+    int status = 0;
+    numRecords = 0;
+    for(size_t i = 0; i < list.partitions.size(); i++)
+    {
+        Partition& partition = list.partitions[i];
+        {
+            std::unique_lock<std::mutex> lock(list.mutex);
+            while(!partition.done)
             {
-                // The start position (2nd column) is not an integer.
-                std::cerr << "Improperly formatted region line, start position "
-                          << "(2nd column) is not an integer: "
-                          << myRegColumn[1]
-                          << "; Skipping to the next line.\n";         
+                list.doneCond.wait(lock);
             }
-            else if(!myRegColumn[2].AsInteger(myEndPos))
+        }
+        if(partition.status != 0)
+        {
+            status = partition.status;
+            break;
+        }
+        if((output != NULL) &&
+           !copyBaseQCPartition(partition.baseQCName, output))
+        {
+            status = SamStatus::FAIL_IO;
+            break;
+        }
+        baseQC.merge(partition.baseQC);
+        numRecords += partition.numRecords;
+        {
+            // Let the workers start the next partition.
+            std::lock_guard<std::mutex> lock(list.mutex);
+            list.copied = i + 1;
+        }
+        list.copiedCond.notify_all();
+    }
+
+    if(status != 0)
+    {
+        // Stop the workers from starting more partitions.
+        {
+            std::lock_guard<std::mutex> lock(list.mutex);
+            list.stop = true;
+        }
+        list.copiedCond.notify_all();
+    }
+    for(int i = 0; i < numWorkers; i++)
+    {
+        threads[i].join();
+        myQualityHist.merge(workers[i]->myQualityHist);
+        delete workers[i];
+    }
+    for(size_t i = 0; i < list.partitions.size(); i++)
+    {
+        if(!list.partitions[i].baseQCName.empty())
+        {
+            remove(list.partitions[i].baseQCName.c_str());
+        }
+    }
+    return(status);
+}
+
+
+void Stats::initPartitionWorker(const Stats& parent)
+{
+    myStartPos = parent.myStartPos;
+    myEndPos = parent.myEndPos;
+    myWithinRegion = parent.myWithinRegion;
+    myQual = parent.myQual;
+    myPhred = parent.myPhred;
+    myQualExcludeClips = parent.myQualExcludeClips;
+    myPileup = parent.myPileup;
+    myBufferSize = parent.myBufferSize;
+    myRequiredFlags = parent.myRequiredFlags;
+    myExcludeFlags = parent.myExcludeFlags;
+    // The dbsnp positions are only read.
+    myDbsnpList = parent.myDbsnpList;
+}
+
+
+void Stats::statPartitions(PartitionList& list, std::string inFile,
+                           std::string indexFile)
+{
+    // Each worker reads the input with its own file & index.
+    SamInputFile samIn;
+    SamFileHeader header;
+    bool opened = false;
+    try
+    {
+        opened = (samIn.OpenForRead(inFile.c_str(), &header) &&
+                  samIn.ReadBamIndex(indexFile.c_str()));
+    }
+    catch(std::exception& e)
+    {
+        std::cerr << "ERROR: " << e.what() << std::endl;
+    }
+    if(!opened)
+    {
+        std::cerr << "Failed to open " << inFile << " with the index "
+                  << indexFile << std::endl;
+    }
+    samIn.SetReadFlags(myRequiredFlags, myExcludeFlags);
+
+    while(true)
+    {
+        Partition* partition = NULL;
+        {
+            // Wait for the output to catch up rather than fill the disk
+            // with per base statistics that cannot be copied yet.
+            std::unique_lock<std::mutex> lock(list.mutex);
+            while(!list.stop && (list.next < list.partitions.size()) &&
+                  (list.next >= list.copied + list.maxAhead))
             {
-                // The end position (3rd column) is not an integer.
-                std::cerr << "Improperly formatted region line, end position "
-                          << "(3rd column) is not an integer: "
-                          << myRegColumn[2]
-                          << "; Skipping to the next line.\n";         
+                list.copiedCond.wait(lock);
             }
-            else if((myStartPos >= myEndPos) && (myEndPos != -1))
+            if(list.stop || (list.next == list.partitions.size()))
             {
-                // The start position is >= the end position
-                std::cerr << "Improperly formatted region line, the start position "
-                          << "is >= end position: "
-                          << myRegColumn[1]
-                          << " >= "
-                          << myRegColumn[2]
-                          << "; Skipping to the next line.\n";         
+                break;
             }
-            else
+            partition = &(list.partitions[list.next++]);
+        }
+
+        int status = SamStatus::FAIL_IO;
+        if(opened)
+        {
+            try
             {
-                sectionFound = true;
-                samIn.SetReadSection(myRegColumn[0].c_str(), myStartPos, myEndPos);
+                status = statPartition(samIn, header, *partition);
             }
+            catch(std::exception& e)
+            {
+                std::cerr << "ERROR: " << e.what() << std::endl;
+                status = SamStatus::FAIL_IO;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(list.mutex);
+            partition->status = status;
+            partition->done = true;
         }
-        return(sectionFound);
+        list.doneCond.notify_all();
     }
 }
 
 
+int Stats::statPartition(SamInputFile& samIn, SamFileHeader& header,
+                         Partition& partition)
+{
+    if(!samIn.SetReadSection(partition.refID))
+    {
+        std::cerr << "Failed to read reference " << partition.refID
+                  << " from the index" << std::endl;
+        return(SamStatus::FAIL_IO);
+    }
+
+    IFILE baseQCFile = NULL;
+    if(!partition.baseQCName.empty())
+    {
+        baseQCFile = ifopen(partition.baseQCName.c_str(), "w");
+        if(baseQCFile == NULL)
+        {
+            std::cerr << "Failed to open the temporary file: "
+                      << partition.baseQCName << std::endl;
+            return(SamStatus::FAIL_IO);
+        }
+        partition.baseQC.setOutputFile(baseQCFile);
+    }
+
+    BaseQCPileup pileup(myBufferSize, &(partition.baseQC));
 
+    uint32_t startCount = samIn.GetCurrentRecordCount();
+    SamRecord samRecord;
+    while(samIn.ReadRecord(header, samRecord))
+    {
+        if(myQual || myPhred)
+        {
+            countQualities(samRecord);
+        }
+        pileup.processAlignmentRegion(samRecord, myStartPos, myEndPos,
+                                      myDbsnpList);
+    }
+    pileup.flushPileup();
+    partition.numRecords = samIn.GetCurrentRecordCount() - startCount;
+
+    partition.baseQC.setOutputFile(NULL);
+    if(baseQCFile != NULL)
+    {
+        ifclose(baseQCFile);
+    }
+
+    SamStatus::Status status = samIn.GetStatus();
+    if(status == SamStatus::NO_MORE_RECS)
+    {
+        status = SamStatus::SUCCESS;
+    }
+    return(status);
+}
+
+
+bool Stats::copyBaseQCPartition(const std::string& partName, IFILE output)
+{
+    FILE* partIn = fopen(partName.c_str(), "rb");
+    if(partIn == NULL)
+    {
+        std::cerr << "Failed to open the temporary file: " << partName
+                  << std::endl;
+        return(false);
+    }
+    bool copied = true;
+    char buffer[0x10000];
+    size_t numRead = 0;
+    while((numRead = fread(buffer, 1, sizeof(buffer), partIn)) > 0)
+    {
+        if(ifwrite(output, buffer, numRead) != numRead)
+        {
+            std::cerr << "Failed to write the baseQC statistics" << std::endl;
+            copied = false;
+            break;
+        }
+    }
+    fclose(partIn);
+    remove(partName.c_str());
+    return(copied);
+}
@@ -22,12 +22,27 @@
 #ifndef __STATS_H__
 #define __STATS_H__
 
+#include <map>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
 #include "BamExecutable.h"
 #include "SamFile.h"
+#include "SamInputFile.h"
+#include "PileupElementBaseQCStats.h"
+#include "QualityHistogram.h"
+#include "RegionPlanner.h"
+#include "CoverageCounter.h"
+#include "IndexSampler.h"
+
+class PosList;
 
 class Stats : public BamExecutable
 {
 public:
+    Stats();
+
     static void printStatsDescription(std::ostream& os);
     void printDescription(std::ostream& os);
     void printUsage(std::ostream& os);
@@ -35,7 +50,119 @@ public:
     virtual const char* getProgramName() {return("bam:stats");}
 
 private:
-    bool getNextSection(SamFile& samIn);
+    // Convert a binary baseQC file to text ("stats view").
+    int executeView(int argc, char **argv);
+
+    // Quality histogram range.
+    static const int MAX_QUAL = 126;
+    static const int START_QUAL = 33;
+    static const int START_PHRED = 0;
+    static const int PHRED_DIFF = START_QUAL - START_PHRED;
+    static const int MAX_PHRED = MAX_QUAL - PHRED_DIFF;
+
+    static const int DEFAULT_SAMPLE_WINDOW = 1000000;
+
+    // Counts of each sampled window used to estimate the statistics.
+    enum SampleStat
+    {
+        SAMPLE_RECORDS, SAMPLE_MAPPED, SAMPLE_PAIRED, SAMPLE_PROPER_PAIR,
+        SAMPLE_DUPLICATE, SAMPLE_QC_FAILURE, SAMPLE_SECONDARY,
+        SAMPLE_SUPPLEMENTARY, SAMPLE_BASES, SAMPLE_PHRED_SUM, SAMPLE_Q20,
+        NUM_SAMPLE_STATS
+    };
+
+    // Read the regions of the region list & plan reading them.
+    void readRegionList(SamFileHeader& header, const char* indexFile);
+
+    // Process the records of each region of the region list, reading each
+    // planned group of regions once.  Returns the number of records
+    // processed, counting a record once for each region it overlaps.
+    uint32_t processRegions(SamInputFile& samIn, SamFileHeader& header,
+                            int maxNumReads, BaseQCAccumulator& baseQC);
+
+    struct RegionPileup;
+
+    // Output the regions of the group from nextOutput that are done (all
+    // if groupDone) in order, releasing the positions held by each, and
+    // return the first region that is not yet done.  A region that is
+    // still being piled up outputs its positions directly from then on.
+    int outputRegions(int nextOutput, int groupLast, int32_t position,
+                      bool groupDone,
+                      std::map<int, RegionPileup*>& activePileups,
+                      std::map<int, RegionPileup*>& flushedPileups,
+                      std::vector<RegionPileup*>& freePileups);
+
+    // Count the qualities of the record in the quality histograms.
+    void countQualities(SamRecord& samRecord);
+
+    // Count a span of qualities, reporting any invalid ones.
+    void countQualitySpan(const char* qual, int length);
+
+    // Read the records starting in each sampled window, counting the
+    // per window statistics.  Returns the number of records sampled.
+    uint32_t processSample(SamInputFile& samIn, SamFileHeader& header);
+
+    // Print the estimates from the sampled windows.
+    void printSampleEstimates();
+
+    // Print an estimate of the ratio of the per window counts, scaled.
+    void printSampleEstimate(const char* name,
+                             const std::vector<double>& numerators,
+                             const std::vector<double>& denominators,
+                             double scale);
+
+    ///////////////////////////////////////////////////////////////////
+    // Methods to generate the baseQC statistics of each reference of an
+    // indexed BAM on its own thread.
+
+    // Reference processed by a worker thread, writing the per base
+    // statistics to a temporary file that is then copied to the output.
+    struct Partition
+    {
+        int32_t refID;
+        std::string baseQCName;
+        BaseQCAccumulator baseQC;
+        uint32_t numRecords;
+        bool done;
+        int status;
+    };
+
+    // Partitions shared by the worker threads.
+    struct PartitionList
+    {
+        std::vector<Partition> partitions;
+        size_t next;
+        // Number of partitions copied to the output.  Workers only start
+        // partitions before copied + maxAhead, so at most maxAhead
+        // partitions wait in temporary files.
+        size_t copied;
+        size_t maxAhead;
+        bool stop;
+        std::mutex mutex;
+        std::condition_variable doneCond;
+        std::condition_variable copiedCond;
+    };
+
+    // Process each reference (and the unmapped reads) on worker threads,
+    // copying the per base statistics to the output in reference order &
+    // merging the rest.  numRecords is set to the number of records read.
+    int processPartitions(const String& inFile, const String& indexFile,
+                          const std::string& tmpBase, int32_t numRefs,
+                          BaseQCAccumulator& baseQC, uint32_t& numRecords);
+
+    // Setup this object as a worker with the settings of the parent.
+    void initPartitionWorker(const Stats& parent);
+
+    // Process partitions until there are none left, run on a worker thread.
+    void statPartitions(PartitionList& list, std::string inFile,
+                        std::string indexFile);
+
+    // Process the records of a single partition.
+    int statPartition(SamInputFile& samIn, SamFileHeader& header,
+                      Partition& partition);
+
+    // Copy a partition's temporary file to the output.
+    bool copyBaseQCPartition(const std::string& partName, IFILE output);
 
     // Pointer to the region list file
     IFILE  myRegionList;
@@ -46,7 +173,29 @@ private:
     String myRegBuffer;
     StringArray myRegColumn;
 
+    RegionPlanner myRegions;
+
     bool myWithinRegion;
+
+    // Settings for processing each record.
+    bool myQual;
+    bool myPhred;
+    bool myQualExcludeClips;
+    bool myPileup;
+    bool myDepth;
+    int myBufferSize;
+    int myRequiredFlags;
+    int myExcludeFlags;
+    PosList* myDbsnpList;
+
+    // Quality histogram, the phred histogram is the same counts offset
+    // by PHRED_DIFF.
+    QualityHistogram myQualityHist;
+
+    CoverageCounter myCoverage;
+
+    IndexSampler mySampler;
+    std::vector<double> mySampleCounts[NUM_SAMPLE_STATS];
 };
 
 #endif
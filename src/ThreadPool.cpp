@@ -0,0 +1,92 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ThreadPool.h"
+
+ThreadPool* ThreadPool::ourSharedPool = NULL;
+
+ThreadPool::ThreadPool(int numThreads)
+    : myWorkers(),
+      myTasks(),
+      myMutex(),
+      myTaskAvailable(),
+      myShutdown(false)
+{
+    if(numThreads < 1)
+    {
+        numThreads = 1;
+    }
+    for(int i = 0; i < numThreads; i++)
+    {
+        myWorkers.push_back(std::thread(&ThreadPool::runWorker, this));
+    }
+}
+
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(myMutex);
+        myShutdown = true;
+    }
+    myTaskAvailable.notify_all();
+    for(unsigned int i = 0; i < myWorkers.size(); i++)
+    {
+        myWorkers[i].join();
+    }
+}
+
+
+void ThreadPool::setSharedPoolSize(int numThreads)
+{
+    if((ourSharedPool != NULL) &&
+       (ourSharedPool->getNumThreads() == numThreads))
+    {
+        // Already the requested size.
+        return;
+    }
+    delete ourSharedPool;
+    ourSharedPool = NULL;
+    if(numThreads > 0)
+    {
+        ourSharedPool = new ThreadPool(numThreads);
+    }
+}
+
+
+void ThreadPool::runWorker()
+{
+    while(true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(myMutex);
+            while(!myShutdown && myTasks.empty())
+            {
+                myTaskAvailable.wait(lock);
+            }
+            if(myTasks.empty())
+            {
+                // Shutting down and nothing left to run.
+                return;
+            }
+            task = myTasks.front();
+            myTasks.pop_front();
+        }
+        task();
+    }
+}
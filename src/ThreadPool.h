@@ -0,0 +1,90 @@
+/*
+ *  Copyright (C) 2026  Regents of the University of Michigan
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+//////////////////////////////////////////////////////////////////////////
+// Fixed size pool of worker threads used to run independent tasks such
+// as compressing or inflating BGZF blocks.
+
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+
+/// Pool of worker threads that run submitted tasks in submission order.
+/// Tasks must not wait on other tasks in the same pool, otherwise all
+/// workers can end up blocked waiting on tasks that never get to run.
+class ThreadPool
+{
+public:
+    /// Create a pool with the specified number of worker threads
+    /// (at least 1 thread is always created).
+    ThreadPool(int numThreads);
+
+    /// Finishes any queued tasks and then joins the worker threads.
+    ~ThreadPool();
+
+    /// Queue the specified function to run on a worker thread.
+    /// The returned future is used to wait for and retrieve the result.
+    template<typename FUNC>
+    std::future<typename std::result_of<FUNC()>::type> submit(FUNC func)
+    {
+        typedef typename std::result_of<FUNC()>::type ResultType;
+        std::shared_ptr<std::packaged_task<ResultType()> > task =
+            std::make_shared<std::packaged_task<ResultType()> >(func);
+        std::future<ResultType> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(myMutex);
+            myTasks.push_back([task]() { (*task)(); });
+        }
+        myTaskAvailable.notify_one();
+        return(result);
+    }
+
+    /// Return the number of worker threads in this pool.
+    int getNumThreads() const { return(myWorkers.size()); }
+
+    /// Set the number of threads in the pool shared by the BGZF readers
+    /// and writers.  0 or less removes the shared pool so all work is done
+    /// on the calling thread.  Must not be called while the pool is in use.
+    static void setSharedPoolSize(int numThreads);
+
+    /// Return the shared pool or NULL if threading has not been enabled.
+    static ThreadPool* getSharedPool() { return(ourSharedPool); }
+
+private:
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+    void runWorker();
+
+    std::vector<std::thread> myWorkers;
+    std::deque<std::function<void()> > myTasks;
+    std::mutex myMutex;
+    std::condition_variable myTaskAvailable;
+    bool myShutdown;
+
+    static ThreadPool* ourSharedPool;
+};
+
+#endif
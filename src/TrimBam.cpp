@@ -51,6 +51,8 @@ void TrimBam::printUsage(std::ostream& os)
     os << "Optionally --ignoreStrand/-i can be specified to ignore the strand information and treat forward/reverse the same.\n";
     os << "trimBam will modify the sequences to 'N', and the quality string to '!', unless --clip/-c is specified.\n";
     os << "--clip/-c indicates to soft clip instead of modifying the sequence or quality\n";
+    os << "--threads <numThreads> sets the number of threads for compressing a BAM output file (default 0)\n";
+    os << "--level <0-9> sets the deflate level of a BAM output file, 0 is uncompressed BGZF (default -1: zlib default)\n";
     os << "\tWhen clipping:\n";
     os << "\t  * if the entire read would be soft clipped, no clipping is done, and instead the read is marked as unmapped\n";
     os << "\t  * mate information is not updated (start positions/mapping may change after soft clipping)\n";
@@ -91,6 +93,8 @@ int TrimBam::execute(int argc, char ** argv)
       { "ignoreStrand", no_argument, NULL, 'i'},
       { "clip", no_argument, NULL, 'c'},
       { "noeof", no_argument, NULL, 'n'},
+      { "threads", required_argument, NULL, 'z'},
+      { "level", required_argument, NULL, 'Z'},
       { "noPhoneHome", no_argument, NULL, 'p'},
       { "nophonehome", no_argument, NULL, 'P'},
       { "phoneHomeThinning", required_argument, NULL, 't'},
@@ -132,6 +136,12 @@ int TrimBam::execute(int argc, char ** argv)
           case 'n':
               noeof = true;
               break;
+          case 'z':
+              myNumThreads = atoi(optarg);
+              break;
+          case 'Z':
+              myCompressionLevel = atoi(optarg);
+              break;
           case 'p':
           case 'P':
               noPhoneHome = true;
@@ -155,7 +165,12 @@ int TrimBam::execute(int argc, char ** argv)
   if(noeof)
   {
       // Set that the eof block is not required.
-      BgzfFileType::setRequireEofBlock(false);
+      setRequireEofBlock(false);
+  }
+
+  if(!processBamIoParameters())
+  {
+      return(-1);
   }
 
   if ( ! samIn.OpenForRead(inName.c_str()) ) {
@@ -163,7 +178,7 @@ int TrimBam::execute(int argc, char ** argv)
     return(-1);
   }
 
-  if(!samOut.OpenForWrite(outName.c_str())) {
+  if(!openForWrite(samOut, outName.c_str())) {
     fprintf(stderr, "%s\n", samOut.GetStatusMessage());
     return(samOut.GetStatus());
   }
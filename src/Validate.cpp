@@ -21,6 +21,7 @@
 // from it.
 #include "Validate.h"
 #include "SamFile.h"
+#include "SamInputFile.h"
 #include "Parameters.h"
 #include "BgzfFileType.h"
 #include "SamValidation.h"
@@ -40,7 +41,7 @@ void Validate::printDescription(std::ostream& os)
 void Validate::printUsage(std::ostream& os)
 {
     BamExecutable::printUsage(os);
-    os << "\t./bam validate --in <inputFile> [--noeof] [--so_flag|--so_coord|--so_query] [--maxErrors <numErrors>] [--verbose] [--printableErrors <numReportedErrors>] [--disableStatistics] [--params]" << std::endl;
+    os << "\t./bam validate --in <inputFile> [--noeof] [--so_flag|--so_coord|--so_query] [--maxErrors <numErrors>] [--verbose] [--printableErrors <numReportedErrors>] [--disableStatistics] [--params] [--threads <numThreads>]" << std::endl;
     os << "\tRequired Parameters:" << std::endl;
     os << "\t\t--in : the SAM/BAM file to be validated" << std::endl;
     os << "\tOptional Parameters:" << std::endl;
@@ -58,6 +59,7 @@ void Validate::printUsage(std::ostream& os)
               << std::endl;
     os << "\t\t--disableStatistics : Turn off statistic generation" << std::endl;
     os << "\t\t--params            : Print the parameter settings" << std::endl;
+    os << "\t\t--threads           : number of threads for decompressing BAM input (default 0)" << std::endl;
     //    std::cerr << "\t\t--quiet             : Suppress the display of errors and summary statistics" << std::endl;
     os << std::endl;
 }
@@ -88,6 +90,7 @@ int Validate::execute(int argc, char **argv)
         LONG_INTPARAMETER("printableErrors", &printableErrors)
         LONG_PARAMETER("disableStatistics", &disableStatistics)
         LONG_PARAMETER("params", &params)
+        LONG_BAM_IO_PARAMETERS()
         LONG_PARAMETER_GROUP("SortOrder")
         EXCLUSIVE_PARAMETER("so_flag", &so_flag)
         EXCLUSIVE_PARAMETER("so_coord", &so_coord)
@@ -121,7 +124,7 @@ int Validate::execute(int argc, char **argv)
     if(noeof)
     {
         // Set that the eof block is not required.
-        BgzfFileType::setRequireEofBlock(false);
+        setRequireEofBlock(false);
     }
 
     // Check to see if the in file was specified, if not, report an error.
@@ -143,6 +146,12 @@ int Validate::execute(int argc, char **argv)
         refPtr = new GenomeSequence(refFile);
     }
 
+    if(!processBamIoParameters())
+    {
+        inputParameters.Status();
+        return(-1);
+    }
+
     if(params)
     {
         inputParameters.Status();
@@ -150,7 +159,7 @@ int Validate::execute(int argc, char **argv)
 
     // Since we want to accumulate multiple errors, use RETURN rather
     // than throwing exceptions.
-    SamFile samIn(ErrorHandler::RETURN);
+    SamInputFile samIn(ErrorHandler::RETURN);
     // Open the file for reading.   
     if(!samIn.OpenForRead(inFile))
     {
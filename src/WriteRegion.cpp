@@ -38,13 +38,12 @@ WriteRegion::WriteRegion()
       myWroteReg(false),
       myStart(UNSPECIFIED_INT),
       myEnd(UNSPECIFIED_INT),
-      myPrevStart(UNSPECIFIED_INT),
-      myPrevEnd(UNSPECIFIED_INT),
       myRefID(UNSPECIFIED_INT),
       myRefName(),
       myPrevRefName(),
       myBedRefID(SamReferenceInfo::NO_REF_ID),
-      myBedFile(NULL)
+      myBedFile(NULL),
+      myBedRegions()
 {
     
 }
@@ -65,7 +64,7 @@ void WriteRegion::printUsage(std::ostream& os)
     os << "\t./bam writeRegion --in <inputFilename>  --out <outputFilename> [--bamIndex <bamIndexFile>] "
               << "[--refName <reference Name> | --refID <reference ID>] [--start <0-based start pos>] "
               << "[--end <0-based end psoition>] [--bed <bed filename>] [--withinRegion] [--readName <readName>] [--rnFile <readNameFileName>] "
-              << "[--lshift] [--params] [--noeof]" << std::endl;
+              << "[--lshift] [--params] [--threads <numThreads>] [--level <0-9>] [--noeof]" << std::endl;
     os << "\tRequired Parameters:" << std::endl;
     os << "\t\t--in        : the BAM file to be read" << std::endl;
     os << "\t\t--out       : the SAM/BAM file to write to" << std::endl;
@@ -85,7 +84,7 @@ void WriteRegion::printUsage(std::ostream& os)
     os << "\t\t--end       : exclusive 0-based end position." << std::endl;
     os << "\t\t              Defaults to -1: meaning til the end of the reference." << std::endl;
     os << "\t\t              Only applicable if refName/refID is set." << std::endl;
-    os << "\t\t--bed       : use the specified bed file for regions." << std::endl;
+    os << "\t\t--bed       : use the specified bed file for regions, which may be unsorted & overlap." << std::endl;
     os << "\t\t--withinReg : only print reads fully enclosed within the region." << std::endl;
     os << "\t\t--readName  : only print reads with this read name." << std::endl;
     os << "\t\t--rnFile    : only print reads with read names found in the specified file,\n";
@@ -97,6 +96,8 @@ void WriteRegion::printUsage(std::ostream& os)
     os << "\t\t--requiredFlags : Only process records with all of the specified flags set\n";
     os << "\t\t                  (specify an integer representation of the flags)\n";
     os << "\t\t--params        : print the parameter settings" << std::endl;
+    os << "\t\t--threads       : number of threads for compressing BAM output (default 0)" << std::endl;
+    os << "\t\t--level         : BAM compression level, 0 (uncompressed BGZF) to 9 (default -1: zlib default)" << std::endl;
     os << "\t\t--noeof         : do not expect an EOF block on a bam file." << std::endl;
     os << std::endl;
 }
@@ -114,8 +115,6 @@ int WriteRegion::execute(int argc, char **argv)
     ReadNameSet rnSet;
     myStart = UNSPECIFIED_INT;
     myEnd = UNSPECIFIED_INT;
-    myPrevStart = UNSPECIFIED_INT;
-    myPrevEnd = UNSPECIFIED_INT;
     myRefID = UNSET_REF;
     myRefName.Clear();
     myPrevRefName.Clear();
@@ -149,6 +148,7 @@ int WriteRegion::execute(int argc, char **argv)
         LONG_STRINGPARAMETER("requiredFlags", &requiredFlags)
         LONG_PARAMETER("noeof", &noeof)
         LONG_PARAMETER("params", &params)
+        LONG_BAM_OUTPUT_PARAMETERS()
         LONG_PHONEHOME(VERSION)
         END_LONG_PARAMETERS();
    
@@ -163,7 +163,7 @@ int WriteRegion::execute(int argc, char **argv)
     if(noeof)
     {
         // Set that the eof block is not required.
-        BgzfFileType::setRequireEofBlock(false);
+        setRequireEofBlock(false);
     }
 
     // Check to see if the in file was specified, if not, report an error.
@@ -241,6 +241,12 @@ int WriteRegion::execute(int argc, char **argv)
         }
     }
 
+    if(!processBamIoParameters())
+    {
+        inputParameters.Status();
+        return(-1);
+    }
+
     if(params)
     {
         inputParameters.Status();
@@ -253,7 +259,7 @@ int WriteRegion::execute(int argc, char **argv)
 
     // Open the output file for writing.
     SamFile samOut;
-    samOut.OpenForWrite(outFile);
+    openForWrite(samOut, outFile);
 
     // Open the bam index file for reading if a region was specified.
     if((myRefName.Length() != 0) || (myRefID != UNSET_REF) || (myBedFile != NULL))
@@ -265,10 +271,19 @@ int WriteRegion::execute(int argc, char **argv)
     mySamIn.ReadHeader(mySamHeader);
     samOut.WriteHeader(mySamHeader);
 
+    // Read all of the bed regions so they can be read in sorted order
+    // with each part of the file only read once.
+    if(myBedFile != NULL)
+    {
+        readBedFile(indexFile);
+    }
+
     // Read the sam records.
     SamRecord samRecord;
     // Track the status.
     int numSectionRecords = 0;
+    // Bed regions a record is in.
+    std::vector<int> bedRegions;
 
     // Set returnStatus to success.  It will be changed
     // to the failure reason if any of the writes fail.
@@ -279,6 +294,19 @@ int WriteRegion::execute(int argc, char **argv)
         // Keep reading records until they aren't anymore.
         while(mySamIn.ReadRecord(mySamHeader, samRecord))
         {
+            if(myBedFile != NULL)
+            {
+                // Each record is read once for the group of bed regions,
+                // so check that it is in one of them & was not already
+                // written for an earlier group.
+                myBedRegions.findRegions(samRecord, myWithinReg, bedRegions);
+                if(bedRegions.empty() ||
+                   myBedRegions.isInEarlierGroup(samRecord, myWithinReg))
+                {
+                    // Not in a new region, so continue to the next record.
+                    continue;
+                }
+            }
             if(!readName.IsEmpty())
             {
                 // Check for readname.
@@ -297,26 +325,6 @@ int WriteRegion::execute(int argc, char **argv)
                 }
             }
 
-            // Check to see if the read has already been processed.
-            if(myPrevEnd != UNSPECIFIED_INT)
-            {
-                // Because we already know that the bed was sorted, 
-                // we know that the previous section started before
-                // this one, so if the previous end is greater than
-                // this record's start position we know that it
-                // was already written in the previous section.
-                // Note: can't be equal to the previous end since
-                // the end range was exclusive, while
-                // get0BasedPosition is inclusive.
-                // myPrevEnd is reset by getNextSection when a new
-                // chromosome is hit.
-                if(samRecord.get0BasedPosition() < myPrevEnd)
-                {
-                    // This record was already written.
-                    continue;
-                }
-            }
-
             // Shift left if applicable.
             if(lshift)
             {
@@ -368,113 +376,14 @@ bool WriteRegion::getNextSection()
     }
     else if(myBedFile != NULL)
     {
-        // There is a bed file, so read the next line.
-        while(!anotherSection)
+        // There is a bed file, so use the next planned group of regions.
+        int32_t refID = 0;
+        int32_t start = 0;
+        int32_t end = 0;
+        if(myBedRegions.nextGroup(refID, start, end))
         {
-            myBedBuffer.Clear();
-            myBedBuffer.ReadLine(myBedFile);
-            if(ifeof(myBedFile) && myBedBuffer.IsEmpty())
-            {
-                // End of the file, so break.
-                break;
-            }
-            // Not the end of the file, so parse the line.
-            myBedColumn.ReplaceColumns(myBedBuffer, '\t');
-            if(myBedColumn.Length() != 3)
-            {
-                // Incorrectly formatted line.
-                std::cerr << "Improperly formatted bed line: "
-                          << myBedBuffer
-                          << "; Skipping to the next line.\n";
-            }
-            else
-            {
-                // Check the reference name.
-                if(myPrevRefName != myBedColumn[0])
-                {
-                    // New reference name (chromosome), so clear the previous
-                    // start/end.
-                    myPrevStart = UNSPECIFIED_INT;
-                    myPrevEnd = UNSPECIFIED_INT;
-                    myPrevRefName = myBedColumn[0];
-
-                    // Get the reference ID for the reference name.
-                    myBedRefID = mySamHeader.getReferenceID(myPrevRefName);
-                    
-                    // Check to see if the reference ID is found.
-                    if(myBedRefID == SamReferenceInfo::NO_REF_ID)
-                    {
-                        // The specified Reference ID is not in the file,
-                        // so check to see if it has chr.
-                        // Check to see if it is the same except for 'chr' appended.
-                        if((myPrevRefName[0] == 'c') && 
-                           (myPrevRefName[1] == 'h') && 
-                           (myPrevRefName[2] == 'r'))
-                        {
-                            // It starts with chr, so look up with out the chr
-                            myBedRefID = mySamHeader.getReferenceID(myPrevRefName.c_str() + 3);
-                        }
-                    }
-                }
-                else
-                {
-                    // Not a new reference name.
-                    // Store the previous positions before overwriting them.
-                    myPrevStart = myStart;
-                    if(myPrevEnd < myEnd)
-                    {
-                        // The last section ends later than the previous one,
-                        // So update the previous latest end.
-                        myPrevEnd = myEnd;
-                    }
-                }
-
-                // If the refID is still NO_REF_ID, just continue to the next bed line.
-                if(myBedRefID == SamReferenceInfo::NO_REF_ID)
-                {
-                    continue;
-                }
-
-                // Correct number of columns, check the columns.
-                if(!myBedColumn[1].AsInteger(myStart))
-                {
-                    // The start position (2nd column) is not an integer.
-                    std::cerr << "Improperly formatted bed line, start position (2nd column) is not an integer: "
-                              << myBedColumn[1]
-                              << "; Skipping to the next line.\n";         
-                }
-                else if(!myBedColumn[2].AsInteger(myEnd))
-                {
-                    // The end position (3rd column) is not an integer.
-                    std::cerr << "Improperly formatted bed line, end position (3rd column) is not an integer: "
-                              << myBedColumn[2]
-                              << "; Skipping to the next line.\n";         
-                }
-                else if(myStart >= myEnd)
-                {
-                    // The start position is >= the end
-                    std::cerr << "Improperly formatted bed line, the start position is >= end position: "
-                              << myBedColumn[1]
-                              << " >= "
-                              << myBedColumn[2]
-                              << "; Skipping to the next line.\n";         
-                }
-                else if(myPrevStart > myStart)
-                {
-                    // Same reference name, but the position goes backwards.
-                    // This is against the assumption that the bed is sorted.
-                    std::cerr << "Improperly formatted bed, the start position is < the previous start (bed is assumed to be sorted): "
-                              << myStart
-                              << " < "
-                              << myPrevStart
-                              << "; Skipping to the next line.\n";
-                }
-                else
-                {
-                    anotherSection = true;
-                    mySamIn.SetReadSection(myBedRefID, myStart, myEnd, !myWithinReg);
-                }
-            }
+            anotherSection = true;
+            mySamIn.SetReadSection(refID, start, end);
         }
     }
     else
@@ -486,3 +395,93 @@ bool WriteRegion::getNextSection()
     
     return(anotherSection);
 }
+
+
+void WriteRegion::readBedFile(const char* indexFile)
+{
+    myBedRegions.clear();
+    while(true)
+    {
+        myBedBuffer.Clear();
+        myBedBuffer.ReadLine(myBedFile);
+        if(ifeof(myBedFile) && myBedBuffer.IsEmpty())
+        {
+            // End of the file, so break.
+            break;
+        }
+        // Not the end of the file, so parse the line.
+        myBedColumn.ReplaceColumns(myBedBuffer, '\t');
+        if(myBedColumn.Length() != 3)
+        {
+            // Incorrectly formatted line.
+            std::cerr << "Improperly formatted bed line: "
+                      << myBedBuffer
+                      << "; Skipping to the next line.\n";
+        }
+        else
+        {
+            // Check the reference name.
+            if(myPrevRefName != myBedColumn[0])
+            {
+                // New reference name (chromosome), so look up its id.
+                myPrevRefName = myBedColumn[0];
+
+                // Get the reference ID for the reference name.
+                myBedRefID = mySamHeader.getReferenceID(myPrevRefName);
+                
+                // Check to see if the reference ID is found.
+                if(myBedRefID == SamReferenceInfo::NO_REF_ID)
+                {
+                    // The specified Reference ID is not in the file,
+                    // so check to see if it has chr.
+                    // Check to see if it is the same except for 'chr' appended.
+                    if((myPrevRefName[0] == 'c') && 
+                       (myPrevRefName[1] == 'h') && 
+                       (myPrevRefName[2] == 'r'))
+                    {
+                        // It starts with chr, so look up with out the chr
+                        myBedRefID = mySamHeader.getReferenceID(myPrevRefName.c_str() + 3);
+                    }
+                }
+            }
+
+            // If the refID is still NO_REF_ID, just continue to the next bed line.
+            if(myBedRefID == SamReferenceInfo::NO_REF_ID)
+            {
+                continue;
+            }
+
+            // Correct number of columns, check the columns.
+            if(!myBedColumn[1].AsInteger(myStart))
+            {
+                // The start position (2nd column) is not an integer.
+                std::cerr << "Improperly formatted bed line, start position (2nd column) is not an integer: "
+                          << myBedColumn[1]
+                          << "; Skipping to the next line.\n";         
+            }
+            else if(!myBedColumn[2].AsInteger(myEnd))
+            {
+                // The end position (3rd column) is not an integer.
+                std::cerr << "Improperly formatted bed line, end position (3rd column) is not an integer: "
+                          << myBedColumn[2]
+                          << "; Skipping to the next line.\n";         
+            }
+            else if(myStart >= myEnd)
+            {
+                // The start position is >= the end
+                std::cerr << "Improperly formatted bed line, the start position is >= end position: "
+                          << myBedColumn[1]
+                          << " >= "
+                          << myBedColumn[2]
+                          << "; Skipping to the next line.\n";         
+            }
+            else
+            {
+                // The regions are sorted when planned, so need not be
+                // in order.
+                myBedRegions.addRegion(myBedRefID, myStart, myEnd);
+            }
+        }
+    }
+    myBedRegions.plan(indexFile);
+}
@@ -24,6 +24,7 @@
 
 #include "BamExecutable.h"
 #include "SamFile.h"
+#include "RegionPlanner.h"
 
 class WriteRegion : public BamExecutable
 {
@@ -38,6 +39,9 @@ public:
 private:
     bool getNextSection();
 
+    // Read the regions of the bed file & plan reading them.
+    void readBedFile(const char* indexFile);
+
     static const int UNSPECIFIED_INT = -1;
     static const int UNSET_REF = -2;
 
@@ -46,8 +50,6 @@ private:
 
     int myStart;
     int myEnd;
-    int myPrevStart;
-    int myPrevEnd;
 
     int myRefID;
     String myRefName;
@@ -58,6 +60,7 @@ private:
     IFILE       myBedFile;
     String      myBedBuffer;
     StringArray myBedColumn;
+    RegionPlanner myBedRegions;
 
     SamFile mySamIn;
     SamFileHeader mySamHeader;
@@ -40,6 +40,25 @@ then
     ERROR=true
 fi
 
+# Read a BAM truncated at a block boundary (missing the EOF block) with
+# multi-threaded read-ahead, which fails unless --noeof is specified.
+head -c -28 testFilesLibBam/testBam.bam > results/truncatedBam.bam
+../bin/bam validate --in results/truncatedBam.bam --threads 2 --noph 2> results/validateTruncatedBam.txt
+if [ $? -eq 0 ] || ! grep -q "Missing the BGZF EOF block" results/validateTruncatedBam.txt
+then
+    ERROR=true
+fi
+../bin/bam stats --basic --in results/truncatedBam.bam --threads 2 --noph 2> results/statsTruncatedBam.txt
+if [ $? -eq 0 ] || ! grep -q "Missing the BGZF EOF block" results/statsTruncatedBam.txt
+then
+    ERROR=true
+fi
+../bin/bam validate --in results/truncatedBam.bam --threads 2 --noeof --noph 2> results/validateTruncatedBamNoEof.txt
+if [ $? -ne 0 ]
+then
+    ERROR=true
+fi
+
 # Test converting bam to sam 
 ../bin/bam convert --params --in testFilesLibBam/testBam.bam --out results/convertBam.sam --noph 2> results/convertBam.log && diff results/convertBam.sam expected/convertBam.sam && diff results/convertBam.log expected/convertBam.log
 if [ $? -ne 0 ]
@@ -75,6 +94,20 @@ then
     ERROR=true
 fi
 
+# Test converting sam to bam compressing with multiple threads and back to sam
+../bin/bam convert --in testFilesLibBam/testSam.sam --out results/convertSamThreads.bam --threads 2 --noph 2> results/convertSamThreads.log && ../bin/bam convert --in results/convertSamThreads.bam --out results/convertSamThreadsSam.sam --noph 2> results/convertSamThreadsSam.log && diff results/convertSamThreadsSam.sam expected/convertBam.sam && diff results/convertSamThreads.log expected/convertSam.log && diff results/convertSamThreadsSam.log expected/convertSam.log
+if [ $? -ne 0 ]
+then
+    ERROR=true
+fi
+
+# Test converting sam to uncompressed BGZF bam and back to sam
+../bin/bam convert --in testFilesLibBam/testSam.sam --out results/convertSamLevel0.bam --level 0 --noph 2> results/convertSamLevel0.log && ../bin/bam convert --in results/convertSamLevel0.bam --out results/convertSamLevel0Sam.sam --noph 2> results/convertSamLevel0Sam.log && diff results/convertSamLevel0Sam.sam expected/convertBam.sam && diff results/convertSamLevel0.log expected/convertSam.log && diff results/convertSamLevel0Sam.log expected/convertSam.log
+if [ $? -ne 0 ]
+then
+    ERROR=true
+fi
+
 # Test converting sam to bam and back to sam via stdout, pipe, and stdin reading bam via stdin
 ../bin/bam convert --in testFilesLibBam/testSam.sam --out -.bam  --noph 2> results/convertSamStdoutBamPipe.log | ../bin/bam convert --in -.bam --out results/convertSamStdoutBamPipeSam.sam --noph 2> results/convertSamStdoutBamPipeSam.log && diff results/convertSamStdoutBamPipeSam.sam expected/convertBam.sam && diff results/convertSamStdoutBamPipeSam.log expected/convertSamStdoutBamPipeSam.log && diff results/convertSamStdoutBamPipe.log expected/convertSamStdoutBamPipe.log
 if [ $? -ne 0 ]
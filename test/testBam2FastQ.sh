@@ -25,6 +25,23 @@ let "status |= $?"
 diff results/testBam2FastQCoord.log expected/testBam2FastQCoord.log
 let "status |= $?"
 
+# Test spilling the reads waiting for their mates to temporary files.
+../bin/bam bam2FastQ --in testFiles/testBam2FastQCoord.sam --outBase results/testBam2FastQCoordSpill --spillSize 1 --noph 2> results/testBam2FastQCoordSpill.log
+let "status |= $?"
+diff results/testBam2FastQCoordSpill.fastq expected/testBam2FastQCoord.fastq
+let "status |= $?"
+diff results/testBam2FastQCoordSpill_1.fastq expected/testBam2FastQCoord_1.fastq
+let "status |= $?"
+diff results/testBam2FastQCoordSpill_2.fastq expected/testBam2FastQCoord_2.fastq
+let "status |= $?"
+diff results/testBam2FastQCoordSpill.log expected/testBam2FastQCoord.log
+let "status |= $?"
+if ls results/testBam2FastQCoordSpill.spill* > /dev/null 2>&1
+then
+    echo "bam2FastQ did not remove its spill files."
+    let "status = 1"
+fi
+
 ##########################################
 # Test with secondary & supplementary
 ../bin/bam bam2FastQ --in testFiles/testBam2FastQCoordSecSup.sam --outBase results/testBam2FastQCoordSecSup --noph 2> results/testBam2FastQCoordSecSup.log
@@ -209,6 +226,24 @@ then
   let "status = 1"
 fi
 
+# Test streaming the interleaved pairs to stdout.
+../bin/bam bam2FastQ --in testFiles/testBam2FastQCoord.sam --outBase results/testBam2FastQCoordStdout --stdout --noph > results/testBam2FastQCoordStdout_interleaved.fastq 2> results/testBam2FastQCoordStdout.log
+let "status |= $?"
+diff results/testBam2FastQCoordStdout.fastq expected/testBam2FastQCoord.fastq
+let "status |= $?"
+diff results/testBam2FastQCoordStdout_interleaved.fastq expected/testBam2FastQCoord_interleaved.fastq
+let "status |= $?"
+diff results/testBam2FastQCoordStdout.log expected/testBam2FastQCoord.log
+let "status |= $?"
+
+# --stdout cannot also write the unpaired reads to stdout.
+../bin/bam bam2FastQ --in testFiles/testBam2FastQCoord.sam --unpairedOut - --stdout --noph > /dev/null 2> results/testBam2FastQCoordStdoutFail.log
+if [ $? -eq 0 ]
+then
+  echo "bam2FastQ --stdout passed when expected to fail."
+  let "status = 1"
+fi
+
 
 ##########################################
 # Test merged output file for paired-end by filenames rather than --merge
@@ -392,6 +427,28 @@ then
   let "status = 1"
 fi
 
+# Only keep one read group file open at a time.
+../bin/bam bam2FastQ --in testFiles/testBam2FastQCoordRG.sam --outBase results/testBam2FastQCoordRGOpen1 --noph --splitRG --qualField OQ --maxOpen 1 2> results/testBam2FastQCoordRGOpen1.log
+let "status |= $?"
+diff results/testBam2FastQCoordRGOpen1_1.fastq expected/testBam2FastQCoordRG_1.fastq
+let "status |= $?"
+diff results/testBam2FastQCoordRGOpen1_2.fastq expected/testBam2FastQCoordRG_2.fastq
+let "status |= $?"
+diff results/testBam2FastQCoordRGOpen1.rg1.fastq expected/testBam2FastQCoordRG.rg1.fastq
+let "status |= $?"
+diff results/testBam2FastQCoordRGOpen1.rg1_1.fastq expected/testBam2FastQCoordRG.rg1_1.fastq
+let "status |= $?"
+diff results/testBam2FastQCoordRGOpen1.rg1_2.fastq expected/testBam2FastQCoordRG.rg1_2.fastq
+let "status |= $?"
+diff results/testBam2FastQCoordRGOpen1.rg2_1.fastq expected/testBam2FastQCoordRG.rg2_1.fastq
+let "status |= $?"
+diff results/testBam2FastQCoordRGOpen1.rg2_2.fastq expected/testBam2FastQCoordRG.rg2_2.fastq
+let "status |= $?"
+diff results/testBam2FastQCoordRGOpen1.log expected/testBam2FastQCoordRG.log
+let "status |= $?"
+diff <(sed 's/RGOpen1/RG/g' results/testBam2FastQCoordRGOpen1.list) expected/testBam2FastQCoordRG.list
+let "status |= $?"
+
 ../bin/bam bam2FastQ --readName --in testFiles/testBam2FastQReadNameRG.sam --outBase results/testBam2FastQReadNameRG --noph --splitRG --qualField OQ 2> results/testBam2FastQReadNameRG.log
 let "status |= $?"
 diff results/testBam2FastQReadNameRG_1.fastq expected/testBam2FastQReadNameRG_1.fastq
@@ -526,6 +583,20 @@ let "status |= $?"
 diff results/testBam2FastQCoordGZ.log expected/testBam2FastQCoord.log
 let "status |= $?"
 
+# Test compressing on multiple threads.
+../bin/bam bam2FastQ --in testFiles/testBam2FastQCoord.sam --outBase results/testBam2FastQCoordGZThreads --gzip --threads 2 --noph 2> results/testBam2FastQCoordGZThreads.log
+let "status |= $?"
+diff <(gunzip -c results/testBam2FastQCoordGZThreads.fastq) expected/testBam2FastQCoord.fastq
+let "status |= $?"
+diff <(gunzip -c results/testBam2FastQCoordGZThreads_1.fastq) expected/testBam2FastQCoord_1.fastq
+let "status |= $?"
+diff <(gunzip -c results/testBam2FastQCoordGZThreads_2.fastq) expected/testBam2FastQCoord_2.fastq
+let "status |= $?"
+cmp results/testBam2FastQCoordGZThreads_1.fastq results/testBam2FastQCoordGZ_1.fastq
+let "status |= $?"
+diff results/testBam2FastQCoordGZThreads.log expected/testBam2FastQCoord.log
+let "status |= $?"
+
 ../bin/bam bam2FastQ --in testFiles/testBam2FastQCoordRG.sam --outBase results/testBam2FastQCoordRGgz --noph --splitRG --gzip 2> results/testBam2FastQCoordRGgz.log
 let "status |= $?"
 diff <(gunzip -c results/testBam2FastQCoordRGgz_1.fastq) expected/testBam2FastQCoordRG_1.fastq
@@ -0,0 +1,98 @@
+#!/bin/bash
+
+#####
+# The checksums do not depend on the record order or on whether the
+# records are read from SAM or BAM.
+
+
+status=0;
+###############
+# SAM, BAM & threaded BAM
+../bin/bam checksum --noph --in testFiles/sortedBam1.bam --out results/checksumBam.txt 2> results/checksumBam.log
+let "status |= $?"
+diff results/checksumBam.txt expected/checksum.txt
+let "status |= $?"
+diff results/checksumBam.log expected/empty.log
+let "status |= $?"
+
+../bin/bam checksum --noph --in testFiles/sortedBam1.bam --threads 2 > results/checksumBamThreads.txt 2> results/checksumBamThreads.log
+let "status |= $?"
+diff results/checksumBamThreads.txt expected/checksum.txt
+let "status |= $?"
+diff results/checksumBamThreads.log expected/empty.log
+let "status |= $?"
+
+../bin/bam checksum --noph --in testFiles/sortedBam1.sam --out results/checksumSam.txt 2> /dev/null
+let "status |= $?"
+diff results/checksumSam.txt expected/checksum.txt
+let "status |= $?"
+
+###############
+# Records in reverse order
+(grep "^@" testFiles/sortedBam1.sam; grep -v "^@" testFiles/sortedBam1.sam | tac) > results/checksumReverse.sam
+../bin/bam checksum --noph --in results/checksumReverse.sam --out results/checksumReverse.txt 2> /dev/null
+let "status |= $?"
+diff results/checksumReverse.txt expected/checksum.txt
+let "status |= $?"
+
+###############
+# Reversed @SQ lines, so the records have different reference ids
+(grep "^@" testFiles/sortedBam1.sam | grep -v "^@SQ"; grep "^@SQ" testFiles/sortedBam1.sam | tac; grep -v "^@" testFiles/sortedBam1.sam) > results/checksumSQOrder.sam
+../bin/bam checksum --noph --in results/checksumSQOrder.sam --out results/checksumSQOrder.txt 2> /dev/null
+let "status |= $?"
+diff <(sort results/checksumSQOrder.txt) <(sort expected/checksum.txt)
+let "status |= $?"
+
+###############
+# Tags
+../bin/bam checksum --noph --in testFiles/sortedBam1.bam --tags MD:Z,NM:i --out results/checksumTagsBam.txt 2> /dev/null
+let "status |= $?"
+../bin/bam checksum --noph --in results/checksumReverse.sam --tags MD:Z,NM:i --out results/checksumTagsSam.txt 2> /dev/null
+let "status |= $?"
+diff results/checksumTagsBam.txt results/checksumTagsSam.txt
+let "status |= $?"
+if diff -q <(tail -n +3 results/checksumTagsBam.txt) <(tail -n +2 expected/checksum.txt) > /dev/null
+then
+    echo "Checksum did not change with --tags."
+    let "status = 1"
+fi
+
+###############
+# A changed quality only changes the checksum of its reference & the file,
+# and not at all if the quality is not checksummed.
+sed '0,/;>>>>/s//;>>>?/' results/checksumReverse.sam > results/checksumQual.sam
+../bin/bam checksum --noph --in results/checksumQual.sam --out results/checksumQual.txt 2> /dev/null
+let "status |= $?"
+diff <(cut -f1,2 results/checksumQual.txt) <(cut -f1,2 expected/checksum.txt)
+let "status |= $?"
+if [ `diff results/checksumQual.txt expected/checksum.txt | grep -c "^<"` -ne 2 ]
+then
+    echo "Checksum did not change the reference & file checksums for a changed quality."
+    let "status = 1"
+fi
+../bin/bam checksum --noph --in results/checksumQual.sam --fields name,flag,pos,cigar,seq --out results/checksumNoQual.txt 2> /dev/null
+let "status |= $?"
+../bin/bam checksum --noph --in testFiles/sortedBam1.bam --fields seq,cigar,pos,flag,name --out results/checksumNoQualBam.txt 2> /dev/null
+let "status |= $?"
+diff results/checksumNoQual.txt results/checksumNoQualBam.txt
+let "status |= $?"
+
+###############
+# Invalid field
+../bin/bam checksum --noph --in testFiles/sortedBam1.bam --fields name,mapq --out results/checksumInvalid.txt 2> results/checksumInvalid.log
+if [ $? -eq 0 ]
+then
+    echo "Checksum passed when expected to fail."
+    let "status = 1"
+fi
+if [ -e results/checksumInvalid.txt ]
+then
+    let "status = 2"
+fi
+
+
+if [ $status != 0 ]
+then
+  echo failed testChecksum.sh
+  exit 1
+fi
@@ -9,6 +9,14 @@ let "status |= $?"
 diff results/testClipOverlapReadName.log expected/testClipOverlapReadName.log
 let "status |= $?"
 
+# Test clipping files sorted by read name in batches on other threads.
+../bin/bam clipOverlap --readName --in testFiles/testClipOverlapReadName.sam --out results/testClipOverlapReadNameThreads.sam --storeOrig XC --threads 2 --noph 2> results/testClipOverlapReadNameThreads.log
+let "status |= $?"
+diff results/testClipOverlapReadNameThreads.sam expected/testClipOverlapReadName.sam
+let "status |= $?"
+diff results/testClipOverlapReadNameThreads.log expected/testClipOverlapReadName.log
+let "status |= $?"
+
 # Test clipping files sorted by coordinate
 ../bin/bam clipOverlap --in testFiles/testClipOverlapCoord.sam --out results/testClipOverlapCoord.sam --storeOrig XC --noph 2> results/testClipOverlapCoord.log
 let "status |= $?"
@@ -17,6 +25,22 @@ let "status |= $?"
 diff results/testClipOverlapCoord.log expected/testClipOverlapCoord.log
 let "status |= $?"
 
+# Test compressing on other threads with a header larger than the 64KB pipe
+# buffer, which must not block before the compression thread starts.
+(grep "^@" testFiles/testClipOverlapCoord.sam; \
+ for i in $(seq 1 2000); do echo -e "@CO\tLong header comment $i to fill more than the pipe buffer.............."; done; \
+ grep -v "^@" testFiles/testClipOverlapCoord.sam) > results/testClipOverlapBigHeader.in.sam
+../bin/bam clipOverlap --in results/testClipOverlapBigHeader.in.sam --out results/testClipOverlapBigHeaderSeq.sam --storeOrig XC --noph 2> results/testClipOverlapBigHeaderSeq.log
+let "status |= $?"
+timeout 120 ../bin/bam clipOverlap --in results/testClipOverlapBigHeader.in.sam --out results/testClipOverlapBigHeader.bam --storeOrig XC --threads 2 --noph 2> results/testClipOverlapBigHeader.log
+let "status |= $?"
+../bin/bam convert --in results/testClipOverlapBigHeader.bam --out results/testClipOverlapBigHeader.sam --noph 2> /dev/null
+let "status |= $?"
+diff results/testClipOverlapBigHeader.sam results/testClipOverlapBigHeaderSeq.sam
+let "status |= $?"
+diff results/testClipOverlapBigHeader.log expected/testClipOverlapCoord.log
+let "status |= $?"
+
 # Test clipping files sorted by coordinate with Secondary & Supplementary
 ../bin/bam clipOverlap --in testFiles/testClipOverlapCoordSecSup.sam --out results/testClipOverlapCoordSecSup.sam --storeOrig XC --noph 2> results/testClipOverlapCoordSecSup.log
 let "status |= $?"
@@ -33,6 +57,18 @@ let "status |= $?"
 diff results/testClipOverlapCoordUnmap.log expected/testClipOverlapCoord.log
 let "status |= $?"
 
+# Test clipping files sorted by coordinate with a small pool, spilling the
+# output rather than giving up on the mates.
+../bin/bam clipOverlap --in testFiles/testClipOverlapCoord.sam --out results/testClipOverlapCoordSpill.sam --storeOrig XC --poolSize 10 --spill --noph 2> results/testClipOverlapCoordSpill.log
+let "status |= $?"
+diff results/testClipOverlapCoordSpill.sam expected/testClipOverlapCoord.sam
+let "status |= $?"
+if ls results/testClipOverlapCoordSpill.sam.spill* > /dev/null 2>&1
+then
+    echo "clipOverlap did not remove its spill files."
+    let "status = 1"
+fi
+
 # Test clipping files sorted by coordinate with small pool without default clipping
 ../bin/bam clipOverlap --in testFiles/testClipOverlapCoord.sam --out results/testClipOverlapCoordPool3.sam --storeOrig XC --poolSize 3 --poolSkipClip --noph 2> results/testClipOverlapCoordPool3.log
 if [ $? != 2 ]
@@ -77,6 +113,15 @@ let "status |= $?"
 diff results/testClipOverlapReadNameStats.log expected/testClipOverlapReadNameStats.log
 let "status |= $?"
 
+# Test clipping files sorted by read name with stats in batches on other
+# threads, merging each batch's stats to match the single threaded run.
+../bin/bam clipOverlap --stats --readName --in testFiles/testClipOverlapReadName.sam --out results/testClipOverlapReadNameStatsThreads.sam --storeOrig XC --threads 2 --noph 2> results/testClipOverlapReadNameStatsThreads.log
+let "status |= $?"
+diff results/testClipOverlapReadNameStatsThreads.sam expected/testClipOverlapReadName.sam
+let "status |= $?"
+diff results/testClipOverlapReadNameStatsThreads.log results/testClipOverlapReadNameStats.log
+let "status |= $?"
+
 # Test clipping files sorted by coordinate
 ../bin/bam clipOverlap --stats --in testFiles/testClipOverlapCoord.sam --out results/testClipOverlapCoordStats.sam --storeOrig XC --noph 2> results/testClipOverlapCoordStats.log
 let "status |= $?"
@@ -185,6 +230,14 @@ let "status |= $?"
 diff results/testClipOverlapReadNameStatsClipsOnly.log expected/testClipOverlapReadNameStats.log
 let "status |= $?"
 
+# Test clipping files sorted by read name in batches on other threads.
+../bin/bam clipOverlap --stats --readName --overlapsOnly --in testFiles/testClipOverlapReadName.sam --out results/testClipOverlapReadNameStatsClipsOnlyThreads.sam --storeOrig XC --threads 2 --noph 2> results/testClipOverlapReadNameStatsClipsOnlyThreads.log
+let "status |= $?"
+diff results/testClipOverlapReadNameStatsClipsOnlyThreads.sam expected/testClipOverlapReadNameClipsOnly.sam
+let "status |= $?"
+diff results/testClipOverlapReadNameStatsClipsOnlyThreads.log results/testClipOverlapReadNameStatsClipsOnly.log
+let "status |= $?"
+
 # Test clipping files sorted by coordinate
 ../bin/bam clipOverlap --stats --clipsOnly --in testFiles/testClipOverlapCoord.sam --out results/testClipOverlapCoordStatsClipsOnly.sam --storeOrig XC --noph 2> results/testClipOverlapCoordStatsClipsOnly.log
 let "status |= $?"
@@ -281,6 +334,21 @@ let "status |= $?"
 diff results/testClipOverlapReadNameNoAlphaSortNoValidate.log expected/testClipOverlapReadName.log
 let "status |= $?"
 
+# Test clipping each reference of an indexed bam on its own thread.
+../bin/bam clipOverlap --in testFiles/sortedBam1.bam --out results/testClipOverlapIndexedSeq.sam --storeOrig XC --stats --noph 2> results/testClipOverlapIndexedSeq.log
+let "status |= $?"
+../bin/bam clipOverlap --in testFiles/sortedBam1.bam --out results/testClipOverlapIndexed.sam --storeOrig XC --stats --threads 3 --noph 2> results/testClipOverlapIndexed.log
+let "status |= $?"
+diff results/testClipOverlapIndexed.sam results/testClipOverlapIndexedSeq.sam
+let "status |= $?"
+diff results/testClipOverlapIndexed.log results/testClipOverlapIndexedSeq.log
+let "status |= $?"
+if ls results/testClipOverlapIndexed.sam.part* > /dev/null 2>&1
+then
+    echo "clipOverlap did not remove its partition files."
+    let "status = 1"
+fi
+
 
 if [ $status != 0 ]
 then
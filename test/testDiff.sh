@@ -1,9 +1,26 @@
 # Diff identical sam/bam
 ../bin/bam diff --in1 testFiles/testDiff1.sam --in2 testFiles/testDiff1.bam --seq --baseQual --tags "OP:i;MD:Z" --noph > results/diffSameSamBam.log 2> results/empty.log && diff results/diffSameSamBam.log expected/diffSameSamBam.log && diff results/empty.log expected/empty.txt \
 && \
+# Diff identical bams, comparing the records' BAM fields first.
+../bin/bam diff --all --in1 testFiles/testDiff1.bam --in2 testFiles/testDiff1.bam --noph > results/diffSameBam.log 2> results/empty.log && diff results/diffSameBam.log expected/diffSameSamBam.log && diff results/empty.log expected/empty.txt \
+&& \
+# Diff bams that differ, the same as diffing one of them as a sam.
+../bin/bam convert --in testFiles/sortedBam2.bam --out results/diffSortedBam2.sam --noph 2> /dev/null \
+&& ../bin/bam diff --all --in1 testFiles/sortedBam1.bam --in2 results/diffSortedBam2.sam --noph > results/diffBamSam.log 2> results/empty.log \
+&& ../bin/bam diff --all --in1 testFiles/sortedBam1.bam --in2 testFiles/sortedBam2.bam --noph > results/diffBamBam.log 2> results/empty.log \
+&& diff results/diffBamBam.log results/diffBamSam.log && diff results/empty.log expected/empty.txt \
+&& \
 # Different order/pos on one of the records.
 ../bin/bam diff --in1 testFiles/testDiff1.sam --in2 testFiles/testDiff2.sam --seq --baseQual --tags "OP:i;MD:Z" --onlyDiffs --out results/diffOrderSam.log --noph 2> results/empty.log && diff results/diffOrderSam.log expected/diffOrderSam.log && diff results/empty.log expected/empty.txt \
 && \
+# Different order/pos on one of the records, spilling to disk when the pool of 2 records is full.
+../bin/bam diff --in1 testFiles/testDiff1.sam --in2 testFiles/testDiff2.sam --recPoolSize 2 --spill --seq --baseQual --tags "OP:i;MD:Z" --onlyDiffs --out results/diffOrderSamSpill.log --noph 2> results/diffOrderSamSpill.txt && diff results/diffOrderSamSpill.log expected/diffOrderSam.log && grep -q "records to temporary files" results/diffOrderSamSpill.txt && ! grep -q WARNING results/diffOrderSamSpill.txt \
+&& \
+# Records waiting far longer than the pool of 2 records for their match,
+# spilling them & their read names to disk, the same as an unlimited pool.
+../bin/bam diff --in1 testFiles/testDiffSpill1.sam --in2 testFiles/testDiffSpill2.sam --recPoolSize -1 --seq --out results/diffSpillUnlimited.log --noph 2> results/empty.log && diff results/empty.log expected/empty.txt \
+&& ../bin/bam diff --in1 testFiles/testDiffSpill1.sam --in2 testFiles/testDiffSpill2.sam --recPoolSize 2 --spill --seq --out results/diffSpill.log --noph 2> results/diffSpill.txt && diff results/diffSpill.log results/diffSpillUnlimited.log && grep -q "records to temporary files" results/diffSpill.txt && ! grep -q WARNING results/diffSpill.txt \
+&& \
 # Different order/pos on one of the records, but only 4 records in the pool.
 ../bin/bam diff --in1 testFiles/testDiff1.sam --in2 testFiles/testDiff2.sam --recPoolSize 4 --seq --baseQual --tags "OP:i;MD:Z" --onlyDiffs --out results/diffOrderSamPool4.txt --noph 2> results/diffOrderSamPool4.log && diff results/diffOrderSamPool4.txt expected/diffOrderSamPool4.txt && diff results/diffOrderSamPool4.log expected/diffOrderSamPool4.log \
 && \
@@ -97,6 +114,14 @@
 # Diff semi-real example sam output.
 ../bin/bam diff --in1 testFiles/testDiff3.sam --in2 testFiles/testDiff4.sam --seq --baseQual --tags "NM:i;OQ:Z;OP:i;OC:Z" --out results/diffAshg.sam --noph 2> results/empty.log \
 && diff results/diffAshg.sam expected/diffAshg.sam && diff results/diffAshg_only1_testDiff3.sam expected/diffAshg_only1_testDiff3.sam && diff results/diffAshg_only2_testDiff4.sam expected/diffAshg_only2_testDiff4.sam && diff results/empty.log expected/empty.txt \
+&& \
+################ Diff indexed bams by reference on multiple threads.
+../bin/bam diff --in1 testFiles/sortedBam1.bam --in2 testFiles/sortedBam2.bam --all --posDiff 10 --out results/diffIndexedSeq.log --noph 2> results/diffIndexedSeq.err \
+&& ../bin/bam diff --in1 testFiles/sortedBam1.bam --in2 testFiles/sortedBam2.bam --all --posDiff 10 --threads 3 --out results/diffIndexed.log --noph 2> results/diffIndexed.err \
+&& diff results/diffIndexed.log results/diffIndexedSeq.log && diff results/diffIndexed.err results/diffIndexedSeq.err \
+&& ../bin/bam diff --in1 testFiles/sortedBam1.bam --in2 testFiles/sortedBam2.bam --all --posDiff 10 --out results/diffIndexedSeq.sam --noph 2> results/empty.log \
+&& ../bin/bam diff --in1 testFiles/sortedBam1.bam --in2 testFiles/sortedBam2.bam --all --posDiff 10 --threads 3 --out results/diffIndexed.sam --noph 2> results/empty.log \
+&& diff results/diffIndexed.sam results/diffIndexedSeq.sam && diff results/diffIndexed_only1_sortedBam1.sam results/diffIndexedSeq_only1_sortedBam1.sam && diff results/diffIndexed_only2_sortedBam2.sam results/diffIndexedSeq_only2_sortedBam2.sam && diff results/empty.log expected/empty.txt \
 
 if [ $? -ne 0 ]
 then
@@ -160,3 +185,15 @@ if [ -e results/diffNoThresh2.sam ]
 then
   exit 1
 fi
+if ls results/diffIndexed.*part* > /dev/null 2>&1
+then
+  exit 1
+fi
+if ls results/diffOrderSamSpill.log.spill* > /dev/null 2>&1
+then
+  exit 1
+fi
+if ls results/diffSpill.log.spill* > /dev/null 2>&1
+then
+  exit 1
+fi
@@ -0,0 +1,93 @@
+#!/bin/bash
+
+#####
+# Stages after the first receive their records as BAM records, so chained
+# stages are compared to running the tools one at a time through BAM files.
+
+
+status=0;
+###############
+# Single stage
+../bin/bam pipeline --noph --in testFiles/testClipOverlapCoord.sam --out results/pipeClipOverlap.sam --stage clipOverlap --storeOrig XC 2> results/pipeClipOverlap.log
+let "status |= $?"
+diff results/pipeClipOverlap.sam expected/testClipOverlapCoord.sam
+let "status |= $?"
+diff results/pipeClipOverlap.log expected/testClipOverlapCoord.log
+let "status |= $?"
+
+../bin/bam pipeline --noph --in testFiles/testDedup.sam --out results/pipeDedup.sam --stage dedup 2> results/pipeDedup.txt
+let "status |= $?"
+diff results/pipeDedup.txt expected/testDedup.txt
+let "status |= $?"
+diff results/pipeDedup.sam expected/testDedup.sam
+let "status |= $?"
+diff -I "Writing .*" results/pipeDedup.sam.log expected/testDedup.sam.log
+let "status |= $?"
+
+###############
+# Two pass stage reading from stdin.
+../bin/bam convert --noph --in testFiles/testDedup.sam --out results/pipeDedupSeq.bam 2> /dev/null
+let "status |= $?"
+../bin/bam dedup --noph --in results/pipeDedupSeq.bam --out results/pipeDedupSeq.sam 2> /dev/null
+let "status |= $?"
+cat testFiles/testDedup.sam | ../bin/bam pipeline --noph --in - --out results/pipeDedupStdin.sam --tmpPrefix results/pipeDedupStdin --stage dedup 2> results/pipeDedupStdin.txt
+let "status |= $?"
+diff results/pipeDedupStdin.txt expected/testDedup.txt
+let "status |= $?"
+diff results/pipeDedupStdin.sam results/pipeDedupSeq.sam
+let "status |= $?"
+if [ -e results/pipeDedupStdin.stage1.ubam ]
+then
+    echo "Pipeline did not remove its spool file."
+    let "status = 1"
+fi
+
+###############
+# Chained stages
+../bin/bam clipOverlap --noph --in testFiles/testDedup.sam --out results/pipeClipDedupSeq.bam 2> /dev/null
+let "status |= $?"
+../bin/bam dedup --noph --in results/pipeClipDedupSeq.bam --out results/pipeClipDedupSeq.sam 2> results/pipeClipDedupSeq.txt
+let "status |= $?"
+../bin/bam pipeline --noph --in testFiles/testDedup.sam --out results/pipeClipDedup.sam --stage clipOverlap --stage dedup 2> results/pipeClipDedup.txt
+let "status |= $?"
+diff results/pipeClipDedup.sam results/pipeClipDedupSeq.sam
+let "status |= $?"
+diff -I "Writing .*" results/pipeClipDedup.sam.log results/pipeClipDedupSeq.sam.log
+let "status |= $?"
+
+../bin/bam squeeze --noph --in testFiles/testRecab.sam --out results/pipeSqueezeRecabSeq.bam --keepOQ --keepDups 2> /dev/null
+let "status |= $?"
+../bin/bam recab --noph --in results/pipeSqueezeRecabSeq.bam --out results/pipeSqueezeRecabSeq.sam --refFile testFilesLibBam/chr1_partial.fa --fitModel > results/pipeSqueezeRecabSeq.txt 2> /dev/null
+let "status |= $?"
+../bin/bam pipeline --noph --in testFiles/testRecab.sam --out results/pipeSqueezeRecab.sam --threads 2 --stage squeeze --keepOQ --keepDups --stage recab --refFile testFilesLibBam/chr1_partial.fa --fitModel > results/pipeSqueezeRecab.txt 2> results/pipeSqueezeRecab.log
+let "status |= $?"
+diff results/pipeSqueezeRecab.sam results/pipeSqueezeRecabSeq.sam
+let "status |= $?"
+diff results/pipeSqueezeRecab.txt results/pipeSqueezeRecabSeq.txt
+let "status |= $?"
+diff results/pipeSqueezeRecab.log expected/empty.log
+let "status |= $?"
+diff <(sort results/pipeSqueezeRecab.sam.qemp) <(sort results/pipeSqueezeRecabSeq.sam.qemp)
+let "status |= $?"
+diff -I "Start.*" -I "End: .*" -I "Writing .*" results/pipeSqueezeRecab.sam.log results/pipeSqueezeRecabSeq.sam.log
+let "status |= $?"
+
+###############
+# Invalid stage
+../bin/bam pipeline --noph --in testFiles/testDedup.sam --out results/pipeInvalid.sam --stage dumpHeader 2> results/pipeInvalid.txt
+if [ $? -eq 0 ]
+then
+    echo "Pipeline passed when expected to fail."
+    let "status = 1"
+fi
+if [ -e results/pipeInvalid.sam ]
+then
+    let "status = 2"
+fi
+
+
+if [ $status != 0 ]
+then
+  echo failed testPipeline.sh
+  exit 1
+fi
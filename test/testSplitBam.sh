@@ -28,6 +28,36 @@ then
     ERROR=true
 fi
 
+# Only keep one output file open at a time.
+../bin/bam splitBam -i testFiles/splitBam.bam -o results/splitOpen1 --maxOpen 1 --noph
+
+diff results/splitOpen1.RG1.bam expected/split.RG1.bam
+if [ $? -ne 0 ]
+then
+    ERROR=true
+fi
+
+diff results/splitOpen1.RG2.bam expected/split.RG2.bam
+if [ $? -ne 0 ]
+then
+    ERROR=true
+fi
+
+# Read & compress on other threads.
+../bin/bam splitBam -i testFiles/splitBam.bam -o results/splitThreads --threads 2 --noph
+
+diff results/splitThreads.RG1.bam expected/split.RG1.bam
+if [ $? -ne 0 ]
+then
+    ERROR=true
+fi
+
+diff results/splitThreads.RG2.bam expected/split.RG2.bam
+if [ $? -ne 0 ]
+then
+    ERROR=true
+fi
+
 if($ERROR == true)
 then
   exit 1
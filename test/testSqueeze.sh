@@ -82,6 +82,27 @@ then
     ERROR=true
 fi
 
+# squeeze sam to sam, reducing read names while holding only 2 names in
+# memory, so earlier names are found in the spilled read name files.
+../bin/bam squeeze --in testFilesLibBam/testSam.sam --out results/squeezeReadNameSpill.sam --readName results/squeezeReadNameMapSpill.txt --rnMaxNames 2 --keepDups --keepOQ --noph 2> results/squeezeReadNameSpill.log && \
+diff results/squeezeReadNameSpill.sam expected/squeezeReadName.sam && diff results/squeezeReadNameSpill.log expected/squeezeReadName.log && diff results/squeezeReadNameMapSpill.txt expected/squeezeReadNameMap.txt && \
+[ ! -e results/squeezeReadNameMapSpill.txt.run1 ]
+if [ $? -ne 0 ]
+then
+    ERROR=true
+fi
+
+# squeeze sam to sam, reducing 30 read names while holding only 2 in memory,
+# so the names are spilled to 15 runs, the first 8 of which are merged, &
+# repeated names are found in both the merged & the spilled runs.
+../bin/bam squeeze --in testFiles/squeezeManyNames.sam --out results/squeezeManyNames.sam --readName results/squeezeManyNamesMap.txt --rnMaxNames 2 --keepDups --keepOQ --noph 2> results/squeezeManyNames.log && \
+diff results/squeezeManyNames.sam expected/squeezeManyNames.sam && diff results/squeezeManyNames.log expected/squeezeManyNames.log && diff results/squeezeManyNamesMap.txt expected/squeezeManyNamesMap.txt && \
+[ ! -e results/squeezeManyNamesMap.txt.run1 ] && [ ! -e results/squeezeManyNamesMap.txt.run16 ]
+if [ $? -ne 0 ]
+then
+    ERROR=true
+fi
+
 # squeeze bam to bam, just reducing read names (keep OQ, keep dups).
 ../bin/bam squeeze --in testFilesLibBam/testBam.bam --out results/squeezeReadName.bam --readName results/squeezeReadNameMapBam.txt --keepDups --keepOQ --noph 2> results/squeezeReadNameBam.log && \
 diff results/squeezeReadName.bam expected/squeezeReadName.bam && diff results/squeezeReadNameBam.log expected/squeezeReadName.log && diff results/squeezeReadNameMapBam.txt expected/squeezeReadNameMap.txt
@@ -141,6 +162,35 @@ then
 fi
 
 
+# squeeze sam to sam, remove string, character & integer (of several sizes)
+# tags that only some records have, keeping a tag with a removed name but a
+# different type, & bin qualities of 16 or more characters.
+../bin/bam squeeze --in testFiles/squeezeTagsQual.sam --out results/squeezeTagsQual.sam --rmTags "NM:i,XT:A,XC:i" --binQualS 19,23,26,27 --noph 2> results/squeezeTagsQual.log && \
+diff results/squeezeTagsQual.sam expected/squeezeTagsQual.sam && diff results/squeezeTagsQual.log expected/squeezeTagsQual.log
+if [ $? -ne 0 ]
+then
+    ERROR=true
+fi
+
+
+# squeeze sam to sam, removing tags that no record has.
+../bin/bam squeeze --in testFiles/squeezeTagsQual.sam --out results/squeezeTagsAbsent.sam --rmTags "ZZ:Z;YY:i" --noph 2> results/squeezeTagsAbsent.log && \
+diff results/squeezeTagsAbsent.sam testFiles/squeezeTagsQual.sam && diff results/squeezeTagsAbsent.log expected/squeezeTagsQual.log
+if [ $? -ne 0 ]
+then
+    ERROR=true
+fi
+
+
+# squeeze with a malformed --rmTags fails.
+! ../bin/bam squeeze --in testFiles/squeezeTagsQual.sam --out results/squeezeTagsBad.sam --rmTags "NM:i,XT" --noph 2> results/squeezeTagsBad.log && \
+grep -q "ERROR: --rmTags must be formatted as Tag:Type,Tag:Type...: NM:i,XT" results/squeezeTagsBad.log
+if [ $? -ne 0 ]
+then
+    ERROR=true
+fi
+
+
 if($ERROR == true)
 then
     echo "Fail testSqueeze.sh"
@@ -18,6 +18,12 @@
 ../bin/bam stats --basic --in testFilesLibBam/sortedBam.bam --noph 2> results/sortedStats.txt \
 && diff results/sortedStats.txt expected/sortedStats.txt \
 && \
+../bin/bam stats --basic --in testFilesLibBam/testBam.bam --qual --threads 2 --noph 2> results/qualStatsThreads.txt \
+&& diff results/qualStatsThreads.txt expected/qualStats.txt \
+&& \
+../bin/bam stats --basic --in testFilesLibBam/sortedBam.bam --threads 2 --noph 2> results/sortedStatsThreads.txt \
+&& diff results/sortedStatsThreads.txt expected/sortedStats.txt \
+&& \
 ../bin/bam stats --in testFilesLibBam/sortedBam.bam --qual --noph 2> results/sortedQualStats.txt \
 && diff results/sortedQualStats.txt expected/sortedQualStats.txt \
 && \
@@ -63,12 +69,55 @@
 ../bin/bam stats --in testFiles/testStatsBaseQC.sam --pBaseQC results/statsBaseQCsamPercent.txt --noph 2> results/statsBaseQCsamPercent.log \
 && diff results/statsBaseQCsamPercent.txt expected/statsBaseQCPercent.txt && diff results/statsBaseQCsamPercent.log expected/statsBaseQC.log \
 && \
+../bin/bam stats --in testFiles/testStatsBaseQC.sam --cBaseQC results/statsBaseQCsamBuf.txt --bufferSize 2 --noph 2> results/statsBaseQCsamBuf.log \
+&& diff results/statsBaseQCsamBuf.txt expected/statsBaseQC.txt && diff results/statsBaseQCsamBuf.log expected/statsBaseQC.log \
+&& \
 ../bin/bam stats --in testFiles/testStatsBaseQC.bam --pBaseQC results/statsBaseQCbamPercent.txt --noph 2> results/statsBaseQCbamPercent.log \
 && diff results/statsBaseQCbamPercent.txt expected/statsBaseQCPercent.txt && diff results/statsBaseQCbamPercent.log expected/statsBaseQC.log \
 && \
+../bin/bam stats --in testFiles/testStatsBaseQC.bam --bBaseQC results/statsBaseQCbam.bqc --noph 2> results/statsBaseQCbin.log \
+&& diff results/statsBaseQCbin.log expected/statsBaseQC.log \
+&& ../bin/bam stats view --in results/statsBaseQCbam.bqc --out results/statsBaseQCbin.txt --noph \
+&& diff results/statsBaseQCbin.txt expected/statsBaseQC.txt \
+&& ../bin/bam stats view --in results/statsBaseQCbam.bqc --out results/statsBaseQCbinPercent.txt --percent --noph \
+&& diff results/statsBaseQCbinPercent.txt expected/statsBaseQCPercent.txt \
+&& \
 ../bin/bam stats --in testFiles/testStatsBaseQCSorted.bam --cBaseQC results/statsBaseQCreg.txt --regionList testFiles/region.txt --noph 2> results/statsBaseQCreg.log \
 && diff results/statsBaseQCreg.txt expected/statsBaseQCreg.txt && diff results/statsBaseQCreg.log expected/statsBaseQCreg.log \
 && \
+tac testFiles/region.txt > results/regionReversed.txt \
+&& ../bin/bam stats --in testFiles/testStatsBaseQCSorted.bam --cBaseQC results/statsBaseQCregReversed.txt --regionList results/regionReversed.txt --noph 2> results/statsBaseQCregReversed.log \
+&& diff results/statsBaseQCregReversed.txt expected/statsBaseQCreg.txt && diff results/statsBaseQCregReversed.log expected/statsBaseQCreg.log \
+&& \
+printf "1\t100\t130\n1\t110\t112\n1\t105\t115\n" > results/regionOverlap.txt \
+&& printf "1\t100\t130\n" > results/regionOverlap1.txt \
+&& printf "1\t105\t115\n" > results/regionOverlap2.txt \
+&& printf "1\t110\t112\n" > results/regionOverlap3.txt \
+&& ../bin/bam stats --in testFiles/testStatsBaseQCSorted.bam --cBaseQC results/statsBaseQCregOverlap1.txt --regionList results/regionOverlap1.txt --noph 2> /dev/null \
+&& ../bin/bam stats --in testFiles/testStatsBaseQCSorted.bam --cBaseQC results/statsBaseQCregOverlap2.txt --regionList results/regionOverlap2.txt --noph 2> /dev/null \
+&& ../bin/bam stats --in testFiles/testStatsBaseQCSorted.bam --cBaseQC results/statsBaseQCregOverlap3.txt --regionList results/regionOverlap3.txt --noph 2> /dev/null \
+&& ../bin/bam stats --in testFiles/testStatsBaseQCSorted.bam --cBaseQC results/statsBaseQCregOverlap.txt --regionList results/regionOverlap.txt --noph 2> /dev/null \
+&& (cat results/statsBaseQCregOverlap1.txt; tail -n +2 results/statsBaseQCregOverlap2.txt; tail -n +2 results/statsBaseQCregOverlap3.txt) > results/statsBaseQCregOverlapSeq.txt \
+&& diff results/statsBaseQCregOverlap.txt results/statsBaseQCregOverlapSeq.txt \
+&& \
+../bin/bam stats --in testFiles/testStatsBaseQCSorted.bam --depth results/statsDepth.txt --noph 2> results/statsDepth.log \
+&& diff results/statsDepth.txt expected/statsDepth.txt && diff results/statsDepth.log expected/statsBaseQC.log \
+&& \
+../bin/bam stats --in testFiles/testStatsBaseQCSorted.bam --depth results/statsDepthReg.txt --regionList testFiles/region.txt --noph 2> results/statsDepthReg.log \
+&& diff results/statsDepthReg.txt expected/statsDepthReg.txt && diff results/statsDepthReg.log expected/statsBaseQCreg.log \
+&& \
+../bin/bam stats --in testFiles/testStatsBaseQCSorted.bam --depth results/statsDepthRegOverlap.txt --regionList results/regionOverlap.txt --noph 2> /dev/null \
+&& ../bin/bam stats --in testFiles/testStatsBaseQCSorted.bam --depth results/statsDepthRegOverlap1.txt --regionList results/regionOverlap1.txt --noph 2> /dev/null \
+&& sed -n '/^Depth/,$p' results/statsDepthRegOverlap.txt > results/statsDepthRegOverlapHist.txt \
+&& sed -n '/^Depth/,$p' results/statsDepthRegOverlap1.txt > results/statsDepthRegOverlap1Hist.txt \
+&& diff results/statsDepthRegOverlapHist.txt results/statsDepthRegOverlap1Hist.txt \
+&& \
+../bin/bam stats --in testFiles/testStatsBaseQCSorted.bam --sample 1 --noph 2> results/statsSample.log \
+&& diff results/statsSample.log expected/statsSample.log \
+&& \
+../bin/bam stats --in testFiles/testStatsBaseQCSorted.bam --sample 0.5 --sampleWindow 1000 --seed 4 --noph 2> results/statsSampleFraction.log \
+&& diff results/statsSampleFraction.log expected/statsSampleFraction.log \
+&& \
 ../bin/bam stats --in testFiles/testStatsBaseQCSorted.bam --pBaseQC results/statsBaseQCregPercent.txt --regionList testFiles/region.txt --noph 2> results/statsBaseQCregPercent.log \
 && diff results/statsBaseQCregPercent.txt expected/statsBaseQCregPercent.txt && diff results/statsBaseQCregPercent.log expected/statsBaseQCreg.log \
 && \
@@ -112,5 +161,13 @@
 && diff results/statsBaseQCregQual2SummaryNoDetail.log expected/statsBaseQCregQual2PercentSummary.log \
 && \
 ../bin/bam stats --in testFiles/testStatsBaseQCSorted.bam --regionList testFiles/region.txt --minMapQual 20 --baseSum --noph 2> results/statsBaseQCregQual20SummaryNoDetail.log \
-&& diff results/statsBaseQCregQual20SummaryNoDetail.log expected/statsBaseQCregQual20Summary.log 
+&& diff results/statsBaseQCregQual20SummaryNoDetail.log expected/statsBaseQCregQual20Summary.log \
+&& \
+../bin/bam stats --in testFiles/sortedBam1.bam --cBaseQC results/statsBaseQCSeq.txt --baseSum --qual --noph 2> results/statsBaseQCSeq.log \
+&& ../bin/bam stats --in testFiles/sortedBam1.bam --cBaseQC results/statsBaseQCThreads.txt --baseSum --qual --bamIndex testFiles/sortedBam1.bam.bai --threads 3 --noph 2> results/statsBaseQCThreads.log \
+&& diff results/statsBaseQCThreads.txt results/statsBaseQCSeq.txt && diff results/statsBaseQCThreads.log results/statsBaseQCSeq.log \
+&& [ ! -e results/statsBaseQCThreads.txt.part1.baseQC ] \
+&& ../bin/bam stats --in testFiles/sortedBam1.bam --cBaseQC results/statsBaseQCThreadsBai.txt --baseSum --qual --threads 3 --noph 2> results/statsBaseQCThreadsBai.log \
+&& diff results/statsBaseQCThreadsBai.txt results/statsBaseQCSeq.txt && diff results/statsBaseQCThreadsBai.log results/statsBaseQCSeq.log \
+&& [ ! -e results/statsBaseQCThreadsBai.txt.part1.baseQC ]
 
@@ -36,6 +36,12 @@ ERROR=false
 ../bin/bam writeRegion --noph --in testFilesLibBam/sortedBam.bam --out results/regionRead11.sam --bed testFiles/bedFile2.bed 2> results/regionRead11.txt \
 && diff results/regionRead11.sam expected/regionRead9.sam && diff results/regionRead11.txt expected/regionRead11.txt \
 && \
+../bin/bam writeRegion --noph --in testFilesLibBam/sortedBam.bam --out results/regionBedUnsorted.sam --bed testFiles/bedFileUnsorted.bed 2> results/regionBedUnsorted.txt \
+&& diff results/regionBedUnsorted.sam expected/regionRead9.sam && diff results/regionBedUnsorted.txt expected/regionBedUnsorted.txt \
+&& \
+../bin/bam writeRegion --noph --in testFilesLibBam/sortedBam.bam --out results/regionBedUnsortedWithin.sam --bed testFiles/bedFileUnsorted.bed --withinReg 2> results/regionBedUnsortedWithin.txt \
+&& diff results/regionBedUnsortedWithin.sam expected/regionRead8.sam && diff results/regionBedUnsortedWithin.txt expected/regionBedUnsortedWithin.txt \
+&& \
 ../bin/bam writeRegion --noph --in testFilesLibBam/testShift.sam --out results/regionShift.sam --lshift 2> results/regionShift.txt \
 && diff results/regionShift.sam expected/regionShift.sam && diff results/regionShift.txt expected/regionShift.txt\
 && \